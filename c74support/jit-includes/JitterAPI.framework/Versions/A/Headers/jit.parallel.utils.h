@@ -4,6 +4,9 @@
 
 #define JIT_PARALLEL_NDIM_MAX_IO				16
 #define JIT_PARALLEL_NDIM_FLAGS_FULL_MATRIX		0x00000001
+#define JIT_PARALLEL_NDIM_FLAGS_DYNAMIC			0x00000002	// split the outer dimension into chunks claimed at run time
+#define JIT_PARALLEL_NDIM_DYNAMIC_CHUNKS		64			// number of chunks a dynamic calc is split into
+#define JIT_PARALLEL_NDIM_REDUCE_MAX_PARTIALS	64			// most per-worker partial states a reduction keeps
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,6 +46,25 @@ typedef struct _jit_parallel_ndim_worker
 	long					extent[2];	
 } t_jit_parallel_ndim_worker;
 
+// a reduction over one input matrix (jit.parallel.dynamic.c). every worker gets its own partial state 
+// of statesize bytes, set up by init, and accumulate folds each chunk of the matrix into it. offset is 
+// the position of the chunk along the split dimension (dim[1], or dim[0] for 1d matrices). when all 
+// chunks are done each partial is passed to combine in turn, so the shared result is only ever 
+// touched by the calling thread.
+//
+//	void init(void *data, void *state);
+//	void accumulate(void *data, void *state, long offset, long dimcount, long *dim, long planecount, 
+//		t_jit_matrix_info *minfo, char *bp);
+//	void combine(void *data, void *result, void *state);
+typedef struct _jit_parallel_ndim_reduce
+{
+	void		*data;
+	long		statesize;
+	method		init;
+	method		accumulate;
+	method		combine;
+} t_jit_parallel_ndim_reduce;
+
 
 void jit_parallel_utils_init(void);
 void jit_parallel_ndim_calc(t_jit_parallel_ndim *p);
@@ -55,6 +77,38 @@ void jit_parallel_ndim_simplecalc4(method fn, void *data, long dimcount, long *d
 	t_jit_matrix_info *minfo2, char *bp2, t_jit_matrix_info *minfo3, char *bp3, t_jit_matrix_info *minfo4, char *bp4, 
 	long flags1, long flags2, long flags3, long flags4);
 
+// dynamic variants (jit.parallel.dynamic.c). when JIT_PARALLEL_NDIM_FLAGS_DYNAMIC is set, in 
+// jit_parallel_ndim.flags or in any of the simplecalc io flags, the outer dimension is split into 
+// small chunks which workers claim from a shared counter until none are left, so rows that are 
+// more expensive than others no longer hold up the whole calculation. without the flag these 
+// behave exactly like the functions above.
+void jit_parallel_ndim_dynamic_calc(t_jit_parallel_ndim *p);
+void jit_parallel_ndim_dynamic_simplecalc1(method fn, void *data, long dimcount, long *dim, long planecount, t_jit_matrix_info *minfo1, char *bp1, long flags1);
+void jit_parallel_ndim_dynamic_simplecalc2(method fn, void *data, long dimcount, long *dim, long planecount, t_jit_matrix_info *minfo1, char *bp1, 
+	t_jit_matrix_info *minfo2, char *bp2, long flags1, long flags2);
+void jit_parallel_ndim_dynamic_simplecalc3(method fn, void *data, long dimcount, long *dim, long planecount, t_jit_matrix_info *minfo1, char *bp1, 
+	t_jit_matrix_info *minfo2, char *bp2, t_jit_matrix_info *minfo3, char *bp3, long flags1, long flags2, long flags3);
+void jit_parallel_ndim_dynamic_simplecalc4(method fn, void *data, long dimcount, long *dim, long planecount, t_jit_matrix_info *minfo1, char *bp1, 
+	t_jit_matrix_info *minfo2, char *bp2, t_jit_matrix_info *minfo3, char *bp3, t_jit_matrix_info *minfo4, char *bp4, 
+	long flags1, long flags2, long flags3, long flags4);
+
+// the result is not initialised by the reduction; seed it before calling
+void jit_parallel_ndim_reduce1(t_jit_parallel_ndim_reduce *r, void *result, long dimcount, long *dim, long planecount, 
+	t_jit_matrix_info *minfo1, char *bp1, long flags1);
+
+// define JIT_PARALLEL_NDIM_DYNAMIC_DEFAULT before including jit.common.h (and add jit.parallel.dynamic.c 
+// to the project) to route every existing simplecalc call through dynamic splitting without source changes
+#ifdef JIT_PARALLEL_NDIM_DYNAMIC_DEFAULT
+#define jit_parallel_ndim_simplecalc1(fn,data,dimcount,dim,planecount,minfo1,bp1,flags1) \
+	jit_parallel_ndim_dynamic_simplecalc1(fn,data,dimcount,dim,planecount,minfo1,bp1,(flags1)|JIT_PARALLEL_NDIM_FLAGS_DYNAMIC)
+#define jit_parallel_ndim_simplecalc2(fn,data,dimcount,dim,planecount,minfo1,bp1,minfo2,bp2,flags1,flags2) \
+	jit_parallel_ndim_dynamic_simplecalc2(fn,data,dimcount,dim,planecount,minfo1,bp1,minfo2,bp2,(flags1)|JIT_PARALLEL_NDIM_FLAGS_DYNAMIC,flags2)
+#define jit_parallel_ndim_simplecalc3(fn,data,dimcount,dim,planecount,minfo1,bp1,minfo2,bp2,minfo3,bp3,flags1,flags2,flags3) \
+	jit_parallel_ndim_dynamic_simplecalc3(fn,data,dimcount,dim,planecount,minfo1,bp1,minfo2,bp2,minfo3,bp3,(flags1)|JIT_PARALLEL_NDIM_FLAGS_DYNAMIC,flags2,flags3)
+#define jit_parallel_ndim_simplecalc4(fn,data,dimcount,dim,planecount,minfo1,bp1,minfo2,bp2,minfo3,bp3,minfo4,bp4,flags1,flags2,flags3,flags4) \
+	jit_parallel_ndim_dynamic_simplecalc4(fn,data,dimcount,dim,planecount,minfo1,bp1,minfo2,bp2,minfo3,bp3,minfo4,bp4,(flags1)|JIT_PARALLEL_NDIM_FLAGS_DYNAMIC,flags2,flags3,flags4)
+#endif
+
 #if C74_PRAGMA_STRUCT_PACKPUSH
     #pragma pack(pop)
 #elif C74_PRAGMA_STRUCT_PACK
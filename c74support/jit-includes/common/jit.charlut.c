@@ -0,0 +1,58 @@
+/*
+	jit.charlut.c
+
+	per plane functions of char data through 256 entry lookup tables, for objects
+	whose char path is a multiply, shift and clamp of each value (jit.map, jit.clip,
+	jit.scalebias). the object fills a t_jit_charlut from its attributes when they differ
+	from those it was last built from, and every value then costs one load.
+
+	the tables are applied with plain loads, four values at a time. a pshufb lookup
+	needs sixteen shuffles per register for a 256 entry table, and one set per
+	table when the planes differ, which came out several times slower.
+
+	add this file to your project to use jit_charlut_vector().
+*/
+
+#include "jit.charlut.h"
+
+// n values from in to out. with one table any strides work. with four, value k of 
+// the row uses table k%4, so in and out should start on plane 0
+void jit_charlut_vector(long n, t_jit_charlut *lut, t_jit_op_info *in, t_jit_op_info *out)
+{
+	uchar *ip,*op,*t0,*t1,*t2,*t3;
+	long is,os,k;
+
+	ip = (uchar *)in->p;
+	op = (uchar *)out->p;
+	is = in->stride;
+	os = out->stride;
+	t0 = lut->table[0];
+
+	if ((is==1)&&(os==1)) {
+		if (lut->tablecount==JIT_CHARLUT_MAX_TABLES) {
+			t1 = lut->table[1];
+			t2 = lut->table[2];
+			t3 = lut->table[3];
+		} else {
+			t1 = t2 = t3 = t0;
+		}
+		for (;n>=4;n-=4,ip+=4,op+=4) {
+			op[0] = t0[ip[0]];
+			op[1] = t1[ip[1]];
+			op[2] = t2[ip[2]];
+			op[3] = t3[ip[3]];
+		}
+		for (k=0;k<n;k++)
+			op[k] = lut->table[k%lut->tablecount][ip[k]];
+	} else if (lut->tablecount==1) {
+		while (n--) {
+			*op = t0[*ip];
+			ip+=is;op+=os;
+		}
+	} else {
+		for (k=0;k<n;k++) {
+			*op = lut->table[k%lut->tablecount][*ip];
+			ip+=is;op+=os;
+		}
+	}
+}
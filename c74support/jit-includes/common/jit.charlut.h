@@ -0,0 +1,36 @@
+/*
+	jit.charlut.h
+
+	256 entry tables for per plane functions of char data, applied by jit.charlut.c.
+	include as "common/jit.charlut.h" and add jit.charlut.c to your project.
+*/
+
+#ifndef _JIT_CHARLUT_H_
+#define _JIT_CHARLUT_H_
+
+#include "jit.common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//objects fill the tables in matrix_calc, and keep the parameters they were built from to
+//rebuild them when those differ (valid is 0 until the first build). attribute setters don't 
+//touch the tables, since they can run while one is being built. with 4 tables, byte k of 
+//contiguous data goes through table k%4
+#define JIT_CHARLUT_MAX_TABLES	4
+
+typedef struct _jit_charlut
+{
+	long		valid;
+	long		tablecount;		//1 or JIT_CHARLUT_MAX_TABLES
+	uchar		table[JIT_CHARLUT_MAX_TABLES][256];
+} t_jit_charlut;
+
+void jit_charlut_vector(long n, t_jit_charlut *lut, t_jit_op_info *in, t_jit_op_info *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //_JIT_CHARLUT_H_
@@ -0,0 +1,748 @@
+/*
+	jit.op.simd.c
+
+	SSE2/AVX2 (intel) and NEON (arm64) versions of the jit.op vector operators.
+
+	the altivec versions in the library only help on powerpc, so everywhere else
+	every jit_op_vector_* function is a scalar stride loop. jit_op_simd_init() picks
+	the widest instruction set the processor supports, and jit_op_simd_sym2fn() then
+	returns a vectorized operator for the arithmetic, bitwise, logical and comparison
+	ops it knows, or NULL to use the library's. jit_op_simd_math_sym2fn() does the
+	same for the polynomial versions of the float transcendental ops (see
+	jit.op.simd.math.h), which jit.op uses when its precision attribute is "fast".
+
+	the kernels only vectorize contiguous data (stride 1, or stride 0 for a scalar
+	input, as jit.op uses for the val attribute). for anything else they call the
+	library's scalar operator, so results never depend on which path was taken.
+	char multiply/divide/modulo, shifts, avg on char and long, and the flipped
+	arithmetic ops are left to the library, since their fixed point rounding is
+	defined there.
+
+	add this file to your project, and call jit_op_simd_init() from your class init
+	before using jit_op_simd_sym2fn().
+*/
+
+#include "jit.common.h"
+#include "jit.op.h"
+#include <math.h>
+#include <float.h>
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define JIT_OP_SIMD_X86		1
+#if (defined(__clang__) && __clang_major__ >= 10) || (defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 5) || (defined(_MSC_VER) && _MSC_VER >= 1700)
+#define JIT_OP_SIMD_X86_AVX2	1	// compiler can build avx2 code without it being enabled for the whole file
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <emmintrin.h>
+#if JIT_OP_SIMD_X86_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define JIT_OP_SIMD_ARM64	1
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#define JIT_OP_SIMD_INLINE	static __inline
+#else
+#define JIT_OP_SIMD_INLINE	static inline
+#endif
+
+typedef int t_jit_op_simd_long;		// long planes are 32 bit, whatever the size of a C long
+
+typedef struct _jit_op_simd_entry
+{
+	const char		*op;		// operator name, as used by the op attribute
+	const char		*name;		// kernel name, ending in the type
+	t_symbol		*opsym;
+	t_symbol		*type;
+	t_jit_op_fn		fn;
+} t_jit_op_simd_entry;
+
+static long s_jit_op_simd_capability = JIT_OP_SIMD_NONE;
+static t_jit_op_simd_entry *s_jit_op_simd_table = NULL;
+static t_jit_op_simd_entry *s_jit_op_simd_mathtable = NULL;
+
+// constants for jit.op.simd.math.h. the _HI parts have enough trailing zero bits
+// that multiplying them by an exponent or quadrant number is exact
+#define JIT_OP_SIMD_ROUND_D		6755399441055744.		// 1.5*2^52, adding it rounds to an integer held in the low bits
+#define JIT_OP_SIMD_ROUND_F		12582912.f				// 1.5*2^23
+#define JIT_OP_SIMD_LOG2E		1.4426950408889634
+#define JIT_OP_SIMD_LOG10E		0.43429448190325182
+#define JIT_OP_SIMD_LN2			0.69314718055994531
+#define JIT_OP_SIMD_LN2_HI		6.93147180369123816490e-01
+#define JIT_OP_SIMD_LN2_LO		1.90821492927058770002e-10
+#define JIT_OP_SIMD_LN2_HI_F	0.693359375f
+#define JIT_OP_SIMD_LN2_LO_F	-2.12194440e-4f
+#define JIT_OP_SIMD_LOG10_2_HI	3.01029995663611771306e-01
+#define JIT_OP_SIMD_LOG10_2_LO	3.69423907715893078616e-13
+#define JIT_OP_SIMD_LOG10_2_HI_F	0.30078125f
+#define JIT_OP_SIMD_LOG10_2_LO_F	2.48745663981195e-4f
+#define JIT_OP_SIMD_SQRT2		1.4142135623730951
+#define JIT_OP_SIMD_2_PI		0.63661977236758134
+#define JIT_OP_SIMD_PIO2_1		1.57079632673412561417e+00
+#define JIT_OP_SIMD_PIO2_2		6.07710050630396597660e-11
+#define JIT_OP_SIMD_PIO2_3		2.02226624879595063154e-21
+#define JIT_OP_SIMD_SIN_D_MAX	65536.		// three part reduction stays within an ulp up to here
+#define JIT_OP_SIMD_TAN_PI_8	0.41421356237309503
+#define JIT_OP_SIMD_PIO4_HI		7.85398163397448278999e-01
+#define JIT_OP_SIMD_PIO4_LO		3.06161699786838301793e-17
+#define JIT_OP_SIMD_PIO2_HI		1.57079632679489655800e+00
+#define JIT_OP_SIMD_PIO2_LO		6.12323399573676603587e-17
+#define JIT_OP_SIMD_PI_HI		3.14159265358979311600e+00
+#define JIT_OP_SIMD_PI_LO		1.22464679914735317720e-16
+
+// polynomial coefficients, highest order first
+#define JIT_OP_SIMD_EXP_P_D_COUNT	3		// e^r = 1+2rP(r^2)/(Q(r^2)-rP(r^2)), pade approximant (cephes exp)
+static const double jit_op_simd_exp_p_d[JIT_OP_SIMD_EXP_P_D_COUNT] = {
+	1.26177193074810590878e-4, 3.02994407707441961300e-2, 9.99999999999999999910e-1
+};
+#define JIT_OP_SIMD_EXP_Q_D_COUNT	4
+static const double jit_op_simd_exp_q_d[JIT_OP_SIMD_EXP_Q_D_COUNT] = {
+	3.00198505138664455042e-6, 2.52448340349684104192e-3, 2.27265548208155028766e-1, 2.00000000000000000009e0
+};
+#define JIT_OP_SIMD_EXP_F_COUNT		6		// (e^r-1-r)/r^2, minimax (cephes expf)
+static const float jit_op_simd_exp_f[JIT_OP_SIMD_EXP_F_COUNT] = {
+	1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f, 4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f
+};
+#define JIT_OP_SIMD_ATANH_D_COUNT	7		// (2atanh(s)/s-2)/s^2 in s^2 for |s| <= 3-2sqrt(2), minimax (fdlibm log)
+static const double jit_op_simd_atanh_d[JIT_OP_SIMD_ATANH_D_COUNT] = {
+	1.479819860511658591e-01, 1.531383769920937332e-01, 1.818357216161805012e-01, 2.222219843214978396e-01,
+	2.857142874366239149e-01, 3.999999999940941908e-01, 6.666666666666735130e-01
+};
+#define JIT_OP_SIMD_ATANH_F_COUNT	4		// the same as a series
+static const float jit_op_simd_atanh_f[JIT_OP_SIMD_ATANH_F_COUNT] = {
+	2.f/9.f, 2.f/7.f, 2.f/5.f, 2.f/3.f
+};
+#define JIT_OP_SIMD_SIN_D_COUNT		6		// (sin(r)-r)/r^3 and (cos(r)-1+r^2/2)/r^4 for |r| <= pi/4 (fdlibm)
+static const double jit_op_simd_sin_d[JIT_OP_SIMD_SIN_D_COUNT] = {
+	1.58969099521155010221e-10, -2.50507602534068634195e-08, 2.75573137070700676789e-06,
+	-1.98412698298579493134e-04, 8.33333333332248946124e-03, -1.66666666666666324348e-01
+};
+#define JIT_OP_SIMD_COS_D_COUNT		6
+static const double jit_op_simd_cos_d[JIT_OP_SIMD_COS_D_COUNT] = {
+	-1.13596475577881948265e-11, 2.08757232129817482790e-09, -2.75573143513906633035e-07,
+	2.48015872894767294178e-05, -1.38888888888741095749e-03, 4.16666666666666019037e-02
+};
+#define JIT_OP_SIMD_ATAN_EVEN_D_COUNT	6	// atan(a) for |a| <= tan(pi/8), split in two for a shorter dependency chain (fdlibm)
+static const double jit_op_simd_atan_even_d[JIT_OP_SIMD_ATAN_EVEN_D_COUNT] = {
+	1.62858201153657823623e-02, 4.97687799461593236017e-02, 6.66107313738753120669e-02,
+	9.09088713343650656196e-02, 1.42857142725034663711e-01, 3.33333333333329318027e-01
+};
+#define JIT_OP_SIMD_ATAN_ODD_D_COUNT	5
+static const double jit_op_simd_atan_odd_d[JIT_OP_SIMD_ATAN_ODD_D_COUNT] = {
+	-3.65315727442169155270e-02, -5.83357013379057348645e-02, -7.69187620504482999495e-02,
+	-1.11111104054623557880e-01, -1.99999999998764832476e-01
+};
+
+
+#if JIT_OP_SIMD_X86
+
+// -------- SSE2 --------
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to=function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+JIT_OP_SIMD_INLINE __m128i jit_op_sse2_not(__m128i a)
+{
+	return _mm_xor_si128(a,_mm_set1_epi32(-1));
+}
+
+JIT_OP_SIMD_INLINE __m128i jit_op_sse2_sel(__m128i m, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(m,a),_mm_andnot_si128(m,b));
+}
+
+JIT_OP_SIMD_INLINE __m128i jit_op_sse2_mul_epi32(__m128i a, __m128i b)
+{
+	// no pmulld before sse4.1, so multiply the even and odd lanes separately
+	__m128i even = _mm_mul_epu32(a,b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a,32),_mm_srli_epi64(b,32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even,_MM_SHUFFLE(0,0,2,0)),_mm_shuffle_epi32(odd,_MM_SHUFFLE(0,0,2,0)));
+}
+
+JIT_OP_SIMD_INLINE __m128i jit_op_sse2_abs_epi32(__m128i a)
+{
+	__m128i s = _mm_srai_epi32(a,31);
+	return _mm_sub_epi32(_mm_xor_si128(a,s),s);
+}
+
+#define JIT_OP_SIMD_SUFFIX	_sse2
+
+#define B_T				uchar
+#define B_V				__m128i
+#define B_W				16
+#define B_LOAD(p)		_mm_loadu_si128((__m128i *)(p))
+#define B_STORE(p,v)	_mm_storeu_si128((__m128i *)(p),v)
+#define B_SPLAT(x)		_mm_set1_epi8((char)(x))
+#define B_ADD			_mm_add_epi8
+#define B_SUB			_mm_sub_epi8
+#define B_ADDS			_mm_adds_epu8
+#define B_SUBS			_mm_subs_epu8
+#define B_MIN			_mm_min_epu8
+#define B_MAX			_mm_max_epu8
+#define B_ABSDIFF(a,b)	_mm_or_si128(_mm_subs_epu8(a,b),_mm_subs_epu8(b,a))
+#define B_AND			_mm_and_si128
+#define B_OR			_mm_or_si128
+#define B_XOR			_mm_xor_si128
+#define B_NOT			jit_op_sse2_not
+#define B_EQ			_mm_cmpeq_epi8
+#define B_NE(a,b)		jit_op_sse2_not(_mm_cmpeq_epi8(a,b))
+#define B_GE(a,b)		_mm_cmpeq_epi8(_mm_max_epu8(a,b),a)		// no unsigned byte compares in sse2
+#define B_GT(a,b)		jit_op_sse2_not(B_GE(b,a))
+#define B_LT(a,b)		B_GT(b,a)
+#define B_LE(a,b)		B_GE(b,a)
+#define B_MAND			_mm_and_si128
+#define B_MOR			_mm_or_si128
+#define B_MONE(m)		_mm_and_si128(m,_mm_set1_epi8(1))
+#define B_MPASS			_mm_and_si128
+
+#define L_T				t_jit_op_simd_long
+#define L_V				__m128i
+#define L_W				4
+#define L_LOAD(p)		_mm_loadu_si128((__m128i *)(p))
+#define L_STORE(p,v)	_mm_storeu_si128((__m128i *)(p),v)
+#define L_SPLAT(x)		_mm_set1_epi32(x)
+#define L_ADD			_mm_add_epi32
+#define L_SUB			_mm_sub_epi32
+#define L_MUL			jit_op_sse2_mul_epi32
+#define L_MIN(a,b)		jit_op_sse2_sel(_mm_cmplt_epi32(a,b),a,b)
+#define L_MAX(a,b)		jit_op_sse2_sel(_mm_cmpgt_epi32(a,b),a,b)
+#define L_ABS			jit_op_sse2_abs_epi32
+#define L_AND			_mm_and_si128
+#define L_OR			_mm_or_si128
+#define L_XOR			_mm_xor_si128
+#define L_NOT			jit_op_sse2_not
+#define L_EQ			_mm_cmpeq_epi32
+#define L_NE(a,b)		jit_op_sse2_not(_mm_cmpeq_epi32(a,b))
+#define L_GT			_mm_cmpgt_epi32
+#define L_GE(a,b)		jit_op_sse2_not(_mm_cmplt_epi32(a,b))
+#define L_LT			_mm_cmplt_epi32
+#define L_LE(a,b)		jit_op_sse2_not(_mm_cmpgt_epi32(a,b))
+#define L_MAND			_mm_and_si128
+#define L_MOR			_mm_or_si128
+#define L_MONE(m)		_mm_and_si128(m,_mm_set1_epi32(1))
+#define L_MPASS			_mm_and_si128
+
+#define F_T				float
+#define F_V				__m128
+#define F_W				4
+#define F_LOAD(p)		_mm_loadu_ps(p)
+#define F_STORE(p,v)	_mm_storeu_ps(p,v)
+#define F_SPLAT(x)		_mm_set1_ps(x)
+#define F_ADD			_mm_add_ps
+#define F_SUB			_mm_sub_ps
+#define F_MUL			_mm_mul_ps
+#define F_DIV			_mm_div_ps
+#define F_MIN			_mm_min_ps		// (a<b)?a:b, including for nans
+#define F_MAX			_mm_max_ps
+#define F_ABS(a)		_mm_andnot_ps(_mm_set1_ps(-0.f),a)
+#define F_EQ			_mm_cmpeq_ps
+#define F_NE			_mm_cmpneq_ps
+#define F_GT			_mm_cmpgt_ps
+#define F_GE			_mm_cmpge_ps
+#define F_LT			_mm_cmplt_ps
+#define F_LE			_mm_cmple_ps
+#define F_MAND			_mm_and_ps
+#define F_MOR			_mm_or_ps
+#define F_MONE(m)		_mm_and_ps(m,_mm_set1_ps(1.f))
+#define F_MPASS			_mm_and_ps
+#define F_I				__m128i
+#define F_ASI			_mm_castps_si128
+#define F_ASF			_mm_castsi128_ps
+#define F_ITOM			_mm_castsi128_ps
+#define F_ICONST(c)		_mm_set1_epi32((int)(c))
+#define F_IADD			_mm_add_epi32
+#define F_ISUB			_mm_sub_epi32
+#define F_IAND			_mm_and_si128
+#define F_IOR			_mm_or_si128
+#define F_IXOR			_mm_xor_si128
+#define F_ISHL			_mm_slli_epi32
+#define F_ISRL			_mm_srli_epi32
+#define F_SEL(m,a,b)	_mm_or_ps(_mm_and_ps(m,a),_mm_andnot_ps(m,b))
+#define F_ALL(m)		(_mm_movemask_ps(m)==0xf)
+#define F_SQRT			_mm_sqrt_ps
+#define F_TOD_LO(a)		_mm_cvtps_pd(a)
+#define F_TOD_HI(a)		_mm_cvtps_pd(_mm_movehl_ps(a,a))
+#define F_FROMD(lo,hi)	_mm_movelh_ps(_mm_cvtpd_ps(lo),_mm_cvtpd_ps(hi))
+
+#define D_T				double
+#define D_V				__m128d
+#define D_W				2
+#define D_LOAD(p)		_mm_loadu_pd(p)
+#define D_STORE(p,v)	_mm_storeu_pd(p,v)
+#define D_SPLAT(x)		_mm_set1_pd(x)
+#define D_ADD			_mm_add_pd
+#define D_SUB			_mm_sub_pd
+#define D_MUL			_mm_mul_pd
+#define D_DIV			_mm_div_pd
+#define D_MIN			_mm_min_pd
+#define D_MAX			_mm_max_pd
+#define D_ABS(a)		_mm_andnot_pd(_mm_set1_pd(-0.),a)
+#define D_EQ			_mm_cmpeq_pd
+#define D_NE			_mm_cmpneq_pd
+#define D_GT			_mm_cmpgt_pd
+#define D_GE			_mm_cmpge_pd
+#define D_LT			_mm_cmplt_pd
+#define D_LE			_mm_cmple_pd
+#define D_MAND			_mm_and_pd
+#define D_MOR			_mm_or_pd
+#define D_MONE(m)		_mm_and_pd(m,_mm_set1_pd(1.))
+#define D_MPASS			_mm_and_pd
+#define D_I				__m128i
+#define D_ASI			_mm_castpd_si128
+#define D_ASF			_mm_castsi128_pd
+#define D_ITOM			_mm_castsi128_pd
+#define D_ICONST(c)		_mm_set1_epi64x((long long)(c))
+#define D_IADD			_mm_add_epi64
+#define D_ISUB			_mm_sub_epi64
+#define D_IAND			_mm_and_si128
+#define D_IOR			_mm_or_si128
+#define D_IXOR			_mm_xor_si128
+#define D_ISHL			_mm_slli_epi64
+#define D_ISRL			_mm_srli_epi64
+#define D_SEL(m,a,b)	_mm_or_pd(_mm_and_pd(m,a),_mm_andnot_pd(m,b))
+#define D_ALL(m)		(_mm_movemask_pd(m)==0x3)
+#define D_SQRT			_mm_sqrt_pd
+
+#include "jit.op.simd.kernels.h"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+
+// -------- AVX2 --------
+
+#if JIT_OP_SIMD_X86_AVX2
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to=function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+JIT_OP_SIMD_INLINE __m256i jit_op_avx2_not(__m256i a)
+{
+	return _mm256_xor_si256(a,_mm256_set1_epi32(-1));
+}
+
+#define JIT_OP_SIMD_SUFFIX	_avx2
+
+#define B_T				uchar
+#define B_V				__m256i
+#define B_W				32
+#define B_LOAD(p)		_mm256_loadu_si256((__m256i *)(p))
+#define B_STORE(p,v)	_mm256_storeu_si256((__m256i *)(p),v)
+#define B_SPLAT(x)		_mm256_set1_epi8((char)(x))
+#define B_ADD			_mm256_add_epi8
+#define B_SUB			_mm256_sub_epi8
+#define B_ADDS			_mm256_adds_epu8
+#define B_SUBS			_mm256_subs_epu8
+#define B_MIN			_mm256_min_epu8
+#define B_MAX			_mm256_max_epu8
+#define B_ABSDIFF(a,b)	_mm256_or_si256(_mm256_subs_epu8(a,b),_mm256_subs_epu8(b,a))
+#define B_AND			_mm256_and_si256
+#define B_OR			_mm256_or_si256
+#define B_XOR			_mm256_xor_si256
+#define B_NOT			jit_op_avx2_not
+#define B_EQ			_mm256_cmpeq_epi8
+#define B_NE(a,b)		jit_op_avx2_not(_mm256_cmpeq_epi8(a,b))
+#define B_GE(a,b)		_mm256_cmpeq_epi8(_mm256_max_epu8(a,b),a)
+#define B_GT(a,b)		jit_op_avx2_not(B_GE(b,a))
+#define B_LT(a,b)		B_GT(b,a)
+#define B_LE(a,b)		B_GE(b,a)
+#define B_MAND			_mm256_and_si256
+#define B_MOR			_mm256_or_si256
+#define B_MONE(m)		_mm256_and_si256(m,_mm256_set1_epi8(1))
+#define B_MPASS			_mm256_and_si256
+
+#define L_T				t_jit_op_simd_long
+#define L_V				__m256i
+#define L_W				8
+#define L_LOAD(p)		_mm256_loadu_si256((__m256i *)(p))
+#define L_STORE(p,v)	_mm256_storeu_si256((__m256i *)(p),v)
+#define L_SPLAT(x)		_mm256_set1_epi32(x)
+#define L_ADD			_mm256_add_epi32
+#define L_SUB			_mm256_sub_epi32
+#define L_MUL			_mm256_mullo_epi32
+#define L_MIN			_mm256_min_epi32
+#define L_MAX			_mm256_max_epi32
+#define L_ABS			_mm256_abs_epi32
+#define L_AND			_mm256_and_si256
+#define L_OR			_mm256_or_si256
+#define L_XOR			_mm256_xor_si256
+#define L_NOT			jit_op_avx2_not
+#define L_EQ			_mm256_cmpeq_epi32
+#define L_NE(a,b)		jit_op_avx2_not(_mm256_cmpeq_epi32(a,b))
+#define L_GT			_mm256_cmpgt_epi32
+#define L_GE(a,b)		jit_op_avx2_not(_mm256_cmpgt_epi32(b,a))
+#define L_LT(a,b)		_mm256_cmpgt_epi32(b,a)
+#define L_LE(a,b)		jit_op_avx2_not(_mm256_cmpgt_epi32(a,b))
+#define L_MAND			_mm256_and_si256
+#define L_MOR			_mm256_or_si256
+#define L_MONE(m)		_mm256_and_si256(m,_mm256_set1_epi32(1))
+#define L_MPASS			_mm256_and_si256
+
+#define F_T				float
+#define F_V				__m256
+#define F_W				8
+#define F_LOAD(p)		_mm256_loadu_ps(p)
+#define F_STORE(p,v)	_mm256_storeu_ps(p,v)
+#define F_SPLAT(x)		_mm256_set1_ps(x)
+#define F_ADD			_mm256_add_ps
+#define F_SUB			_mm256_sub_ps
+#define F_MUL			_mm256_mul_ps
+#define F_DIV			_mm256_div_ps
+#define F_MIN			_mm256_min_ps
+#define F_MAX			_mm256_max_ps
+#define F_ABS(a)		_mm256_andnot_ps(_mm256_set1_ps(-0.f),a)
+#define F_EQ(a,b)		_mm256_cmp_ps(a,b,_CMP_EQ_OQ)
+#define F_NE(a,b)		_mm256_cmp_ps(a,b,_CMP_NEQ_UQ)
+#define F_GT(a,b)		_mm256_cmp_ps(a,b,_CMP_GT_OQ)
+#define F_GE(a,b)		_mm256_cmp_ps(a,b,_CMP_GE_OQ)
+#define F_LT(a,b)		_mm256_cmp_ps(a,b,_CMP_LT_OQ)
+#define F_LE(a,b)		_mm256_cmp_ps(a,b,_CMP_LE_OQ)
+#define F_MAND			_mm256_and_ps
+#define F_MOR			_mm256_or_ps
+#define F_MONE(m)		_mm256_and_ps(m,_mm256_set1_ps(1.f))
+#define F_MPASS			_mm256_and_ps
+#define F_I				__m256i
+#define F_ASI			_mm256_castps_si256
+#define F_ASF			_mm256_castsi256_ps
+#define F_ITOM			_mm256_castsi256_ps
+#define F_ICONST(c)		_mm256_set1_epi32((int)(c))
+#define F_IADD			_mm256_add_epi32
+#define F_ISUB			_mm256_sub_epi32
+#define F_IAND			_mm256_and_si256
+#define F_IOR			_mm256_or_si256
+#define F_IXOR			_mm256_xor_si256
+#define F_ISHL			_mm256_slli_epi32
+#define F_ISRL			_mm256_srli_epi32
+#define F_SEL(m,a,b)	_mm256_blendv_ps(b,a,m)
+#define F_ALL(m)		(_mm256_movemask_ps(m)==0xff)
+#define F_SQRT			_mm256_sqrt_ps
+#define F_TOD_LO(a)		_mm256_cvtps_pd(_mm256_castps256_ps128(a))
+#define F_TOD_HI(a)		_mm256_cvtps_pd(_mm256_extractf128_ps(a,1))
+#define F_FROMD(lo,hi)	_mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)),_mm256_cvtpd_ps(hi),1)
+
+#define D_T				double
+#define D_V				__m256d
+#define D_W				4
+#define D_LOAD(p)		_mm256_loadu_pd(p)
+#define D_STORE(p,v)	_mm256_storeu_pd(p,v)
+#define D_SPLAT(x)		_mm256_set1_pd(x)
+#define D_ADD			_mm256_add_pd
+#define D_SUB			_mm256_sub_pd
+#define D_MUL			_mm256_mul_pd
+#define D_DIV			_mm256_div_pd
+#define D_MIN			_mm256_min_pd
+#define D_MAX			_mm256_max_pd
+#define D_ABS(a)		_mm256_andnot_pd(_mm256_set1_pd(-0.),a)
+#define D_EQ(a,b)		_mm256_cmp_pd(a,b,_CMP_EQ_OQ)
+#define D_NE(a,b)		_mm256_cmp_pd(a,b,_CMP_NEQ_UQ)
+#define D_GT(a,b)		_mm256_cmp_pd(a,b,_CMP_GT_OQ)
+#define D_GE(a,b)		_mm256_cmp_pd(a,b,_CMP_GE_OQ)
+#define D_LT(a,b)		_mm256_cmp_pd(a,b,_CMP_LT_OQ)
+#define D_LE(a,b)		_mm256_cmp_pd(a,b,_CMP_LE_OQ)
+#define D_MAND			_mm256_and_pd
+#define D_MOR			_mm256_or_pd
+#define D_MONE(m)		_mm256_and_pd(m,_mm256_set1_pd(1.))
+#define D_MPASS			_mm256_and_pd
+#define D_I				__m256i
+#define D_ASI			_mm256_castpd_si256
+#define D_ASF			_mm256_castsi256_pd
+#define D_ITOM			_mm256_castsi256_pd
+#define D_ICONST(c)		_mm256_set1_epi64x((long long)(c))
+#define D_IADD			_mm256_add_epi64
+#define D_ISUB			_mm256_sub_epi64
+#define D_IAND			_mm256_and_si256
+#define D_IOR			_mm256_or_si256
+#define D_IXOR			_mm256_xor_si256
+#define D_ISHL			_mm256_slli_epi64
+#define D_ISRL			_mm256_srli_epi64
+#define D_SEL(m,a,b)	_mm256_blendv_pd(b,a,m)
+#define D_ALL(m)		(_mm256_movemask_pd(m)==0xf)
+#define D_SQRT			_mm256_sqrt_pd
+
+#include "jit.op.simd.kernels.h"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif // JIT_OP_SIMD_X86_AVX2
+
+#endif // JIT_OP_SIMD_X86
+
+
+#if JIT_OP_SIMD_ARM64
+
+// -------- NEON --------
+
+// min/max go through compares so nans behave like the scalar (a<b)?a:b
+#define JIT_OP_SIMD_SUFFIX	_neon
+
+#define B_T				uchar
+#define B_V				uint8x16_t
+#define B_W				16
+#define B_LOAD(p)		vld1q_u8(p)
+#define B_STORE(p,v)	vst1q_u8(p,v)
+#define B_SPLAT(x)		vdupq_n_u8(x)
+#define B_ADD			vaddq_u8
+#define B_SUB			vsubq_u8
+#define B_ADDS			vqaddq_u8
+#define B_SUBS			vqsubq_u8
+#define B_MIN			vminq_u8
+#define B_MAX			vmaxq_u8
+#define B_ABSDIFF		vabdq_u8
+#define B_AND			vandq_u8
+#define B_OR			vorrq_u8
+#define B_XOR			veorq_u8
+#define B_NOT			vmvnq_u8
+#define B_EQ			vceqq_u8
+#define B_NE(a,b)		vmvnq_u8(vceqq_u8(a,b))
+#define B_GT			vcgtq_u8
+#define B_GE			vcgeq_u8
+#define B_LT			vcltq_u8
+#define B_LE			vcleq_u8
+#define B_MAND			vandq_u8
+#define B_MOR			vorrq_u8
+#define B_MONE(m)		vandq_u8(m,vdupq_n_u8(1))
+#define B_MPASS			vandq_u8
+
+#define L_T				t_jit_op_simd_long
+#define L_V				int32x4_t
+#define L_W				4
+#define L_LOAD(p)		vld1q_s32(p)
+#define L_STORE(p,v)	vst1q_s32(p,v)
+#define L_SPLAT(x)		vdupq_n_s32(x)
+#define L_ADD			vaddq_s32
+#define L_SUB			vsubq_s32
+#define L_MUL			vmulq_s32
+#define L_MIN			vminq_s32
+#define L_MAX			vmaxq_s32
+#define L_ABS			vabsq_s32
+#define L_AND			vandq_s32
+#define L_OR			vorrq_s32
+#define L_XOR			veorq_s32
+#define L_NOT			vmvnq_s32
+#define L_EQ			vceqq_s32
+#define L_NE(a,b)		vmvnq_u32(vceqq_s32(a,b))
+#define L_GT			vcgtq_s32
+#define L_GE			vcgeq_s32
+#define L_LT			vcltq_s32
+#define L_LE			vcleq_s32
+#define L_MAND			vandq_u32
+#define L_MOR			vorrq_u32
+#define L_MONE(m)		vreinterpretq_s32_u32(vandq_u32(m,vdupq_n_u32(1)))
+#define L_MPASS(m,a)	vandq_s32(vreinterpretq_s32_u32(m),a)
+
+#define F_T				float
+#define F_V				float32x4_t
+#define F_W				4
+#define F_LOAD(p)		vld1q_f32(p)
+#define F_STORE(p,v)	vst1q_f32(p,v)
+#define F_SPLAT(x)		vdupq_n_f32(x)
+#define F_ADD			vaddq_f32
+#define F_SUB			vsubq_f32
+#define F_MUL			vmulq_f32
+#define F_DIV			vdivq_f32
+#define F_MIN(a,b)		vbslq_f32(vcltq_f32(a,b),a,b)
+#define F_MAX(a,b)		vbslq_f32(vcgtq_f32(a,b),a,b)
+#define F_ABS			vabsq_f32
+#define F_EQ			vceqq_f32
+#define F_NE(a,b)		vmvnq_u32(vceqq_f32(a,b))
+#define F_GT			vcgtq_f32
+#define F_GE			vcgeq_f32
+#define F_LT			vcltq_f32
+#define F_LE			vcleq_f32
+#define F_MAND			vandq_u32
+#define F_MOR			vorrq_u32
+#define F_MONE(m)		vreinterpretq_f32_u32(vandq_u32(m,vreinterpretq_u32_f32(vdupq_n_f32(1.f))))
+#define F_MPASS(m,a)	vreinterpretq_f32_u32(vandq_u32(m,vreinterpretq_u32_f32(a)))
+#define F_I				int32x4_t
+#define F_ASI			vreinterpretq_s32_f32
+#define F_ASF			vreinterpretq_f32_s32
+#define F_ITOM			vreinterpretq_u32_s32
+#define F_ICONST(c)		vdupq_n_s32((int)(c))
+#define F_IADD			vaddq_s32
+#define F_ISUB			vsubq_s32
+#define F_IAND			vandq_s32
+#define F_IOR			vorrq_s32
+#define F_IXOR			veorq_s32
+#define F_ISHL			vshlq_n_s32
+#define F_ISRL(i,n)		vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(i),n))
+#define F_SEL			vbslq_f32
+#define F_ALL(m)		(vminvq_u32(m)!=0)
+#define F_SQRT			vsqrtq_f32
+#define F_TOD_LO(a)		vcvt_f64_f32(vget_low_f32(a))
+#define F_TOD_HI(a)		vcvt_high_f64_f32(a)
+#define F_FROMD(lo,hi)	vcvt_high_f32_f64(vcvt_f32_f64(lo),hi)
+
+#define D_T				double
+#define D_V				float64x2_t
+#define D_W				2
+#define D_LOAD(p)		vld1q_f64(p)
+#define D_STORE(p,v)	vst1q_f64(p,v)
+#define D_SPLAT(x)		vdupq_n_f64(x)
+#define D_ADD			vaddq_f64
+#define D_SUB			vsubq_f64
+#define D_MUL			vmulq_f64
+#define D_DIV			vdivq_f64
+#define D_MIN(a,b)		vbslq_f64(vcltq_f64(a,b),a,b)
+#define D_MAX(a,b)		vbslq_f64(vcgtq_f64(a,b),a,b)
+#define D_ABS			vabsq_f64
+#define D_EQ			vceqq_f64
+#define D_NE(a,b)		veorq_u64(vceqq_f64(a,b),vdupq_n_u64(~0ULL))
+#define D_GT			vcgtq_f64
+#define D_GE			vcgeq_f64
+#define D_LT			vcltq_f64
+#define D_LE			vcleq_f64
+#define D_MAND			vandq_u64
+#define D_MOR			vorrq_u64
+#define D_MONE(m)		vreinterpretq_f64_u64(vandq_u64(m,vreinterpretq_u64_f64(vdupq_n_f64(1.))))
+#define D_MPASS(m,a)	vreinterpretq_f64_u64(vandq_u64(m,vreinterpretq_u64_f64(a)))
+#define D_I				int64x2_t
+#define D_ASI			vreinterpretq_s64_f64
+#define D_ASF			vreinterpretq_f64_s64
+#define D_ITOM			vreinterpretq_u64_s64
+#define D_ICONST(c)		vdupq_n_s64((long long)(c))
+#define D_IADD			vaddq_s64
+#define D_ISUB			vsubq_s64
+#define D_IAND			vandq_s64
+#define D_IOR			vorrq_s64
+#define D_IXOR			veorq_s64
+#define D_ISHL			vshlq_n_s64
+#define D_ISRL(i,n)		vreinterpretq_s64_u64(vshrq_n_u64(vreinterpretq_u64_s64(i),n))
+#define D_SEL			vbslq_f64
+#define D_ALL(m)		(vminvq_u32(vreinterpretq_u32_u64(m))!=0)
+#define D_SQRT			vsqrtq_f64
+
+#include "jit.op.simd.kernels.h"
+
+#endif // JIT_OP_SIMD_ARM64
+
+
+static long jit_op_simd_detect(void)
+{
+#if JIT_OP_SIMD_X86
+	unsigned int a,b,c,d;
+	unsigned int xcr0=0;
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info,1);
+	a = info[0]; b = info[1]; c = info[2]; d = info[3];
+#else
+	if (!__get_cpuid(1,&a,&b,&c,&d))
+		return JIT_OP_SIMD_NONE;
+#endif
+#if JIT_OP_SIMD_X86_AVX2
+	// avx2 needs the os to save the upper halves of the ymm registers (osxsave, then xcr0 bits 1 and 2)
+	if ((c&(1<<27))&&(c&(1<<28))) {
+#ifdef _MSC_VER
+		xcr0 = (unsigned int)_xgetbv(0);
+		__cpuidex(info,7,0);
+		b = info[1];
+#else
+		__asm__ __volatile__ ("xgetbv" : "=a" (xcr0) : "c" (0) : "%edx");
+		__cpuid_count(7,0,a,b,c,d);
+#endif
+		if (((xcr0&6)==6)&&(b&(1<<5)))
+			return JIT_OP_SIMD_AVX2;
+	}
+#endif
+	if (d&(1<<26))
+		return JIT_OP_SIMD_SSE2;
+#elif JIT_OP_SIMD_ARM64
+	return JIT_OP_SIMD_NEON;	// part of the arm64 baseline, nothing to ask the os
+#endif
+	return JIT_OP_SIMD_NONE;
+}
+
+long jit_op_simd_init(void)
+{
+	t_jit_op_simd_entry *e;
+
+	if (s_jit_op_simd_table)
+		return s_jit_op_simd_capability;
+
+	s_jit_op_simd_capability = jit_op_simd_detect();
+	switch (s_jit_op_simd_capability) {
+#if JIT_OP_SIMD_X86
+#if JIT_OP_SIMD_X86_AVX2
+	case JIT_OP_SIMD_AVX2:
+		s_jit_op_simd_table = jit_op_simd_table_avx2;
+		s_jit_op_simd_mathtable = jit_op_simd_mathtable_avx2;
+		break;
+#endif
+	case JIT_OP_SIMD_SSE2:
+		s_jit_op_simd_table = jit_op_simd_table_sse2;
+		s_jit_op_simd_mathtable = jit_op_simd_mathtable_sse2;
+		break;
+#endif
+#if JIT_OP_SIMD_ARM64
+	case JIT_OP_SIMD_NEON:
+		s_jit_op_simd_table = jit_op_simd_table_neon;
+		s_jit_op_simd_mathtable = jit_op_simd_mathtable_neon;
+		break;
+#endif
+	default:				return JIT_OP_SIMD_NONE;
+	}
+	for (e=s_jit_op_simd_table;e->op;e++) {
+		e->opsym = gensym((char *)e->op);
+		e->type = gensym(strrchr(e->name,'_')+1);
+	}
+	for (e=s_jit_op_simd_mathtable;e->op;e++) {
+		e->opsym = gensym((char *)e->op);
+		e->type = gensym(strrchr(e->name,'_')+1);
+	}
+	return s_jit_op_simd_capability;
+}
+
+long jit_op_simd_capability(void)
+{
+	return s_jit_op_simd_capability;
+}
+
+t_jit_op_fn jit_op_simd_sym2fn(t_symbol *opsym, t_symbol *type)
+{
+	t_jit_op_simd_entry *e;
+
+	if (!s_jit_op_simd_table)
+		return NULL;
+	for (e=s_jit_op_simd_table;e->op;e++) {
+		if (e->opsym==opsym&&e->type==type)
+			return e->fn;
+	}
+	return NULL;
+}
+
+t_jit_op_fn jit_op_simd_math_sym2fn(t_symbol *opsym, t_symbol *type)
+{
+	t_jit_op_simd_entry *e;
+
+	if (!s_jit_op_simd_mathtable)
+		return NULL;
+	for (e=s_jit_op_simd_mathtable;e->op;e++) {
+		if (e->opsym==opsym&&e->type==type)
+			return e->fn;
+	}
+	return NULL;
+}
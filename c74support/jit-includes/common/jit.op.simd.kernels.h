@@ -0,0 +1,394 @@
+/*
+	jit.op.simd.kernels.h
+
+	jit.op vector kernels, written once against a small set of vector macros
+	and included by jit.op.simd.c for each instruction set it supports.
+
+	Before including, define JIT_OP_SIMD_SUFFIX (e.g. _sse2) and for each of
+	the element types B (uchar), L (32 bit long), F (float32) and D (float64):
+
+	X_T, X_V, X_W					scalar type, vector type, elements per vector
+	X_LOAD(p), X_STORE(p,v)			unaligned load/store
+	X_SPLAT(x)						broadcast a scalar
+	X_ADD, X_SUB, X_MIN, X_MAX		arithmetic, with X_MUL for L, F and D, X_DIV for F and D
+	X_EQ, X_NE, X_GT, X_GE, X_LT, X_LE	comparisons, returning a mask
+	X_MAND, X_MOR					mask and/or
+	X_MONE(m)						1 where the mask is set, 0 elsewhere
+	X_MPASS(m,a)					a where the mask is set, 0 elsewhere
+
+	plus B_ADDS, B_SUBS, B_ABSDIFF, X_ABS for L, F and D, X_AND, X_OR,
+	X_XOR, X_NOT for B and L, and the integer/select macros listed in
+	jit.op.simd.math.h for F and D. Everything is #undef'd again at the end.
+*/
+
+#define JIT_OP_SIMD_CAT(a,b,c)		a##b##c
+#define JIT_OP_SIMD_XCAT(a,b,c)		JIT_OP_SIMD_CAT(a,b,c)
+#define JIT_OP_SIMD_FN(name)		JIT_OP_SIMD_XCAT(jit_op_simd_,name,JIT_OP_SIMD_SUFFIX)
+
+// only unit strides (or 0 for a scalar input) are vectorized, anything else
+// is handed to the scalar version of the same operator
+#define JIT_OP_SIMD_BINARY(name,X,vexpr,sexpr) \
+static void JIT_OP_SIMD_FN(name)(long n, void *vecdata, t_jit_op_info *in0, t_jit_op_info *in1, t_jit_op_info *out) \
+{ \
+	X##_T *ip1=(X##_T *)in0->p,*ip2=(X##_T *)in1->p,*op=(X##_T *)out->p; \
+	long s1=in0->stride,s2=in1->stride,i=0; \
+	X##_V a,b; \
+	X##_T x,y; \
+	if (((s1|s2)&~1)||out->stride!=1) { \
+		jit_op_vector_##name(n,vecdata,in0,in1,out); \
+		return; \
+	} \
+	if (s1&&s2) { \
+		for (;i+X##_W<=n;i+=X##_W) { \
+			a = X##_LOAD(ip1+i); b = X##_LOAD(ip2+i); \
+			X##_STORE(op+i,vexpr); \
+		} \
+	} else if (s1) { \
+		b = X##_SPLAT(*ip2); \
+		for (;i+X##_W<=n;i+=X##_W) { \
+			a = X##_LOAD(ip1+i); \
+			X##_STORE(op+i,vexpr); \
+		} \
+	} else if (s2) { \
+		a = X##_SPLAT(*ip1); \
+		for (;i+X##_W<=n;i+=X##_W) { \
+			b = X##_LOAD(ip2+i); \
+			X##_STORE(op+i,vexpr); \
+		} \
+	} else { \
+		a = X##_SPLAT(*ip1); b = X##_SPLAT(*ip2); \
+		for (;i+X##_W<=n;i+=X##_W) \
+			X##_STORE(op+i,vexpr); \
+	} \
+	for (;i<n;i++) { \
+		x = ip1[i*s1]; y = ip2[i*s2]; \
+		op[i] = (X##_T)(sexpr); \
+	} \
+}
+
+// unary operators read a single input, in0 (or in1 for !pass)
+#define JIT_OP_SIMD_UNARY(name,X,in,vexpr,sexpr) \
+static void JIT_OP_SIMD_FN(name)(long n, void *vecdata, t_jit_op_info *in0, t_jit_op_info *in1, t_jit_op_info *out) \
+{ \
+	X##_T *ip1=(X##_T *)in->p,*op=(X##_T *)out->p; \
+	long s1=in->stride,i=0; \
+	X##_V a; \
+	X##_T x; \
+	if ((s1&~1)||out->stride!=1) { \
+		jit_op_vector_##name(n,vecdata,in0,in1,out); \
+		return; \
+	} \
+	if (s1) { \
+		for (;i+X##_W<=n;i+=X##_W) { \
+			a = X##_LOAD(ip1+i); \
+			X##_STORE(op+i,vexpr); \
+		} \
+	} else { \
+		a = X##_SPLAT(*ip1); \
+		for (;i+X##_W<=n;i+=X##_W) \
+			X##_STORE(op+i,vexpr); \
+	} \
+	for (;i<n;i++) { \
+		x = ip1[i*s1]; \
+		op[i] = (X##_T)(sexpr); \
+	} \
+}
+
+// comparisons and logical ops, shared by all types. results are 0 or 1, or the left input for the pass variants
+#define JIT_OP_SIMD_LOGICAL(type,X) \
+JIT_OP_SIMD_BINARY(and_##type,		X,	X##_MONE(X##_MAND(X##_NE(a,X##_SPLAT(0)),X##_NE(b,X##_SPLAT(0)))),	x&&y) \
+JIT_OP_SIMD_BINARY(or_##type,		X,	X##_MONE(X##_MOR(X##_NE(a,X##_SPLAT(0)),X##_NE(b,X##_SPLAT(0)))),	x||y) \
+JIT_OP_SIMD_UNARY (not_##type,		X,	in0,	X##_MONE(X##_EQ(a,X##_SPLAT(0))),	!x) \
+JIT_OP_SIMD_BINARY(gt_##type,		X,	X##_MONE(X##_GT(a,b)),	x>y) \
+JIT_OP_SIMD_BINARY(gte_##type,		X,	X##_MONE(X##_GE(a,b)),	x>=y) \
+JIT_OP_SIMD_BINARY(lt_##type,		X,	X##_MONE(X##_LT(a,b)),	x<y) \
+JIT_OP_SIMD_BINARY(lte_##type,		X,	X##_MONE(X##_LE(a,b)),	x<=y) \
+JIT_OP_SIMD_BINARY(eq_##type,		X,	X##_MONE(X##_EQ(a,b)),	x==y) \
+JIT_OP_SIMD_BINARY(neq_##type,		X,	X##_MONE(X##_NE(a,b)),	x!=y) \
+JIT_OP_SIMD_BINARY(gtp_##type,		X,	X##_MPASS(X##_GT(a,b),a),	x>y?x:0) \
+JIT_OP_SIMD_BINARY(gtep_##type,		X,	X##_MPASS(X##_GE(a,b),a),	x>=y?x:0) \
+JIT_OP_SIMD_BINARY(ltp_##type,		X,	X##_MPASS(X##_LT(a,b),a),	x<y?x:0) \
+JIT_OP_SIMD_BINARY(ltep_##type,		X,	X##_MPASS(X##_LE(a,b),a),	x<=y?x:0) \
+JIT_OP_SIMD_BINARY(eqp_##type,		X,	X##_MPASS(X##_EQ(a,b),a),	x==y?x:0) \
+JIT_OP_SIMD_BINARY(neqp_##type,		X,	X##_MPASS(X##_NE(a,b),a),	x!=y?x:0)
+
+//char
+JIT_OP_SIMD_UNARY (pass_char,		B,	in0,	a,	x)
+JIT_OP_SIMD_UNARY (flippass_char,	B,	in1,	a,	x)
+JIT_OP_SIMD_BINARY(add_char,		B,	B_ADD(a,b),		x+y)
+JIT_OP_SIMD_BINARY(sub_char,		B,	B_SUB(a,b),		x-y)
+JIT_OP_SIMD_BINARY(adds_char,		B,	B_ADDS(a,b),	x+y>255?255:x+y)
+JIT_OP_SIMD_BINARY(subs_char,		B,	B_SUBS(a,b),	x>y?x-y:0)
+JIT_OP_SIMD_BINARY(min_char,		B,	B_MIN(a,b),		x<y?x:y)
+JIT_OP_SIMD_BINARY(max_char,		B,	B_MAX(a,b),		x>y?x:y)
+JIT_OP_SIMD_BINARY(absdiff_char,	B,	B_ABSDIFF(a,b),	x>y?x-y:y-x)
+JIT_OP_SIMD_BINARY(bitand_char,		B,	B_AND(a,b),		x&y)
+JIT_OP_SIMD_BINARY(bitor_char,		B,	B_OR(a,b),		x|y)
+JIT_OP_SIMD_BINARY(bitxor_char,		B,	B_XOR(a,b),		x^y)
+JIT_OP_SIMD_UNARY (bitnot_char,		B,	in0,	B_NOT(a),		~x)
+JIT_OP_SIMD_LOGICAL(char,B)
+
+//long(wraps like the scalar versions, hence the unsigned casts)
+JIT_OP_SIMD_UNARY (pass_long,		L,	in0,	a,	x)
+JIT_OP_SIMD_UNARY (flippass_long,	L,	in1,	a,	x)
+JIT_OP_SIMD_BINARY(add_long,		L,	L_ADD(a,b),		(unsigned)x+(unsigned)y)
+JIT_OP_SIMD_BINARY(sub_long,		L,	L_SUB(a,b),		(unsigned)x-(unsigned)y)
+JIT_OP_SIMD_BINARY(mult_long,		L,	L_MUL(a,b),		(unsigned)x*(unsigned)y)
+JIT_OP_SIMD_BINARY(min_long,		L,	L_MIN(a,b),		x<y?x:y)
+JIT_OP_SIMD_BINARY(max_long,		L,	L_MAX(a,b),		x>y?x:y)
+JIT_OP_SIMD_UNARY (abs_long,		L,	in0,	L_ABS(a),		x<0?0u-(unsigned)x:(unsigned)x)
+JIT_OP_SIMD_BINARY(absdiff_long,	L,	L_ABS(L_SUB(a,b)),	(L_T)((unsigned)x-(unsigned)y)<0?(unsigned)y-(unsigned)x:(unsigned)x-(unsigned)y)
+JIT_OP_SIMD_BINARY(bitand_long,		L,	L_AND(a,b),		x&y)
+JIT_OP_SIMD_BINARY(bitor_long,		L,	L_OR(a,b),		x|y)
+JIT_OP_SIMD_BINARY(bitxor_long,		L,	L_XOR(a,b),		x^y)
+JIT_OP_SIMD_UNARY (bitnot_long,		L,	in0,	L_NOT(a),		~x)
+JIT_OP_SIMD_LOGICAL(long,L)
+
+//float32
+JIT_OP_SIMD_UNARY (pass_float32,	F,	in0,	a,	x)
+JIT_OP_SIMD_UNARY (flippass_float32,F,	in1,	a,	x)
+JIT_OP_SIMD_BINARY(add_float32,		F,	F_ADD(a,b),		x+y)
+JIT_OP_SIMD_BINARY(sub_float32,		F,	F_SUB(a,b),		x-y)
+JIT_OP_SIMD_BINARY(mult_float32,	F,	F_MUL(a,b),		x*y)
+JIT_OP_SIMD_BINARY(div_float32,		F,	F_DIV(a,b),		x/y)
+JIT_OP_SIMD_BINARY(min_float32,		F,	F_MIN(a,b),		x<y?x:y)
+JIT_OP_SIMD_BINARY(max_float32,		F,	F_MAX(a,b),		x>y?x:y)
+JIT_OP_SIMD_UNARY (abs_float32,		F,	in0,	F_ABS(a),		fabs(x))
+JIT_OP_SIMD_BINARY(avg_float32,		F,	F_MUL(F_ADD(a,b),F_SPLAT(0.5f)),	(x+y)*0.5f)
+JIT_OP_SIMD_BINARY(absdiff_float32,	F,	F_ABS(F_SUB(a,b)),	fabs(x-y))
+JIT_OP_SIMD_UNARY (sqrt_float32,	F,	in0,	F_SQRT(a),		sqrt(x))	// correctly rounded either way
+JIT_OP_SIMD_LOGICAL(float32,F)
+
+//float64
+JIT_OP_SIMD_UNARY (pass_float64,	D,	in0,	a,	x)
+JIT_OP_SIMD_UNARY (flippass_float64,D,	in1,	a,	x)
+JIT_OP_SIMD_BINARY(add_float64,		D,	D_ADD(a,b),		x+y)
+JIT_OP_SIMD_BINARY(sub_float64,		D,	D_SUB(a,b),		x-y)
+JIT_OP_SIMD_BINARY(mult_float64,	D,	D_MUL(a,b),		x*y)
+JIT_OP_SIMD_BINARY(div_float64,		D,	D_DIV(a,b),		x/y)
+JIT_OP_SIMD_BINARY(min_float64,		D,	D_MIN(a,b),		x<y?x:y)
+JIT_OP_SIMD_BINARY(max_float64,		D,	D_MAX(a,b),		x>y?x:y)
+JIT_OP_SIMD_UNARY (abs_float64,		D,	in0,	D_ABS(a),		fabs(x))
+JIT_OP_SIMD_BINARY(avg_float64,		D,	D_MUL(D_ADD(a,b),D_SPLAT(0.5)),	(x+y)*0.5)
+JIT_OP_SIMD_BINARY(absdiff_float64,	D,	D_ABS(D_SUB(a,b)),	fabs(x-y))
+JIT_OP_SIMD_UNARY (sqrt_float64,	D,	in0,	D_SQRT(a),		sqrt(x))
+JIT_OP_SIMD_LOGICAL(float64,D)
+
+#define JIT_OP_SIMD_ENTRY(op,name)	{op, #name, 0L, 0L, (t_jit_op_fn)JIT_OP_SIMD_FN(name)},
+#define JIT_OP_SIMD_ENTRY_LOGICAL(type) \
+	JIT_OP_SIMD_ENTRY("&&",and_##type) JIT_OP_SIMD_ENTRY("||",or_##type) JIT_OP_SIMD_ENTRY("!",not_##type) \
+	JIT_OP_SIMD_ENTRY(">",gt_##type) JIT_OP_SIMD_ENTRY(">=",gte_##type) JIT_OP_SIMD_ENTRY("<",lt_##type) \
+	JIT_OP_SIMD_ENTRY("<=",lte_##type) JIT_OP_SIMD_ENTRY("==",eq_##type) JIT_OP_SIMD_ENTRY("!=",neq_##type) \
+	JIT_OP_SIMD_ENTRY(">p",gtp_##type) JIT_OP_SIMD_ENTRY(">=p",gtep_##type) JIT_OP_SIMD_ENTRY("<p",ltp_##type) \
+	JIT_OP_SIMD_ENTRY("<=p",ltep_##type) JIT_OP_SIMD_ENTRY("==p",eqp_##type) JIT_OP_SIMD_ENTRY("!=p",neqp_##type)
+
+// operator name, kernel name (the type is parsed from its suffix by jit_op_simd_init)
+static t_jit_op_simd_entry JIT_OP_SIMD_FN(table)[] = {
+	JIT_OP_SIMD_ENTRY("pass",pass_char)
+	JIT_OP_SIMD_ENTRY("!pass",flippass_char)
+	JIT_OP_SIMD_ENTRY("+",adds_char)
+	JIT_OP_SIMD_ENTRY("-",subs_char)
+	JIT_OP_SIMD_ENTRY("+m",add_char)
+	JIT_OP_SIMD_ENTRY("-m",sub_char)
+	JIT_OP_SIMD_ENTRY("min",min_char)
+	JIT_OP_SIMD_ENTRY("max",max_char)
+	JIT_OP_SIMD_ENTRY("absdiff",absdiff_char)
+	JIT_OP_SIMD_ENTRY("&",bitand_char)
+	JIT_OP_SIMD_ENTRY("|",bitor_char)
+	JIT_OP_SIMD_ENTRY("^",bitxor_char)
+	JIT_OP_SIMD_ENTRY("~",bitnot_char)
+	JIT_OP_SIMD_ENTRY_LOGICAL(char)
+
+	JIT_OP_SIMD_ENTRY("pass",pass_long)
+	JIT_OP_SIMD_ENTRY("!pass",flippass_long)
+	JIT_OP_SIMD_ENTRY("+",add_long)
+	JIT_OP_SIMD_ENTRY("-",sub_long)
+	JIT_OP_SIMD_ENTRY("*",mult_long)
+	JIT_OP_SIMD_ENTRY("min",min_long)
+	JIT_OP_SIMD_ENTRY("max",max_long)
+	JIT_OP_SIMD_ENTRY("abs",abs_long)
+	JIT_OP_SIMD_ENTRY("absdiff",absdiff_long)
+	JIT_OP_SIMD_ENTRY("&",bitand_long)
+	JIT_OP_SIMD_ENTRY("|",bitor_long)
+	JIT_OP_SIMD_ENTRY("^",bitxor_long)
+	JIT_OP_SIMD_ENTRY("~",bitnot_long)
+	JIT_OP_SIMD_ENTRY_LOGICAL(long)
+
+	JIT_OP_SIMD_ENTRY("pass",pass_float32)
+	JIT_OP_SIMD_ENTRY("!pass",flippass_float32)
+	JIT_OP_SIMD_ENTRY("+",add_float32)
+	JIT_OP_SIMD_ENTRY("-",sub_float32)
+	JIT_OP_SIMD_ENTRY("*",mult_float32)
+	JIT_OP_SIMD_ENTRY("/",div_float32)
+	JIT_OP_SIMD_ENTRY("min",min_float32)
+	JIT_OP_SIMD_ENTRY("max",max_float32)
+	JIT_OP_SIMD_ENTRY("abs",abs_float32)
+	JIT_OP_SIMD_ENTRY("avg",avg_float32)
+	JIT_OP_SIMD_ENTRY("absdiff",absdiff_float32)
+	JIT_OP_SIMD_ENTRY("sqrt",sqrt_float32)
+	JIT_OP_SIMD_ENTRY_LOGICAL(float32)
+
+	JIT_OP_SIMD_ENTRY("pass",pass_float64)
+	JIT_OP_SIMD_ENTRY("!pass",flippass_float64)
+	JIT_OP_SIMD_ENTRY("+",add_float64)
+	JIT_OP_SIMD_ENTRY("-",sub_float64)
+	JIT_OP_SIMD_ENTRY("*",mult_float64)
+	JIT_OP_SIMD_ENTRY("/",div_float64)
+	JIT_OP_SIMD_ENTRY("min",min_float64)
+	JIT_OP_SIMD_ENTRY("max",max_float64)
+	JIT_OP_SIMD_ENTRY("abs",abs_float64)
+	JIT_OP_SIMD_ENTRY("avg",avg_float64)
+	JIT_OP_SIMD_ENTRY("absdiff",absdiff_float64)
+	JIT_OP_SIMD_ENTRY("sqrt",sqrt_float64)
+	JIT_OP_SIMD_ENTRY_LOGICAL(float64)
+
+	{NULL, NULL, 0L, 0L, 0L}
+};
+
+#include "jit.op.simd.math.h"
+
+#undef JIT_OP_SIMD_ENTRY_LOGICAL
+#undef JIT_OP_SIMD_ENTRY
+#undef JIT_OP_SIMD_LOGICAL
+#undef JIT_OP_SIMD_UNARY
+#undef JIT_OP_SIMD_BINARY
+#undef JIT_OP_SIMD_FN
+#undef JIT_OP_SIMD_XCAT
+#undef JIT_OP_SIMD_CAT
+#undef JIT_OP_SIMD_SUFFIX
+
+#undef B_T
+#undef B_V
+#undef B_W
+#undef B_LOAD
+#undef B_STORE
+#undef B_SPLAT
+#undef B_ADD
+#undef B_SUB
+#undef B_ADDS
+#undef B_SUBS
+#undef B_MIN
+#undef B_MAX
+#undef B_ABSDIFF
+#undef B_AND
+#undef B_OR
+#undef B_XOR
+#undef B_NOT
+#undef B_EQ
+#undef B_NE
+#undef B_GT
+#undef B_GE
+#undef B_LT
+#undef B_LE
+#undef B_MAND
+#undef B_MOR
+#undef B_MONE
+#undef B_MPASS
+
+#undef L_T
+#undef L_V
+#undef L_W
+#undef L_LOAD
+#undef L_STORE
+#undef L_SPLAT
+#undef L_ADD
+#undef L_SUB
+#undef L_MUL
+#undef L_MIN
+#undef L_MAX
+#undef L_ABS
+#undef L_AND
+#undef L_OR
+#undef L_XOR
+#undef L_NOT
+#undef L_EQ
+#undef L_NE
+#undef L_GT
+#undef L_GE
+#undef L_LT
+#undef L_LE
+#undef L_MAND
+#undef L_MOR
+#undef L_MONE
+#undef L_MPASS
+
+#undef F_T
+#undef F_V
+#undef F_W
+#undef F_LOAD
+#undef F_STORE
+#undef F_SPLAT
+#undef F_ADD
+#undef F_SUB
+#undef F_MUL
+#undef F_DIV
+#undef F_MIN
+#undef F_MAX
+#undef F_ABS
+#undef F_EQ
+#undef F_NE
+#undef F_GT
+#undef F_GE
+#undef F_LT
+#undef F_LE
+#undef F_MAND
+#undef F_MOR
+#undef F_MONE
+#undef F_MPASS
+#undef F_I
+#undef F_ASI
+#undef F_ASF
+#undef F_ITOM
+#undef F_ICONST
+#undef F_IADD
+#undef F_ISUB
+#undef F_IAND
+#undef F_IOR
+#undef F_IXOR
+#undef F_ISHL
+#undef F_ISRL
+#undef F_SEL
+#undef F_ALL
+#undef F_SQRT
+#undef F_TOD_LO
+#undef F_TOD_HI
+#undef F_FROMD
+
+#undef D_T
+#undef D_V
+#undef D_W
+#undef D_LOAD
+#undef D_STORE
+#undef D_SPLAT
+#undef D_ADD
+#undef D_SUB
+#undef D_MUL
+#undef D_DIV
+#undef D_MIN
+#undef D_MAX
+#undef D_ABS
+#undef D_EQ
+#undef D_NE
+#undef D_GT
+#undef D_GE
+#undef D_LT
+#undef D_LE
+#undef D_MAND
+#undef D_MOR
+#undef D_MONE
+#undef D_MPASS
+#undef D_I
+#undef D_ASI
+#undef D_ASF
+#undef D_ITOM
+#undef D_ICONST
+#undef D_IADD
+#undef D_ISUB
+#undef D_IAND
+#undef D_IOR
+#undef D_IXOR
+#undef D_ISHL
+#undef D_ISRL
+#undef D_SEL
+#undef D_ALL
+#undef D_SQRT
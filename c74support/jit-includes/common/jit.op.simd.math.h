@@ -0,0 +1,364 @@
+/*
+	jit.op.simd.math.h
+
+	polynomial versions of the jit.op transcendental operators, used when the
+	precision attribute is "fast". included from jit.op.simd.kernels.h for each
+	instruction set, and uses the same vector macros plus, for F and D:
+
+	X_I								integer vector of the same width
+	X_ASI(v), X_ASF(i), X_ITOM(i)	reinterpret float as int, int as float, int as mask
+	X_ICONST(c)						broadcast an integer
+	X_IADD, X_ISUB, X_IAND, X_IOR, X_IXOR, X_ISHL(i,n), X_ISRL(i,n)
+	X_SEL(m,a,b)					a where the mask is set, b elsewhere
+	X_ALL(m)						non zero if every lane of the mask is set
+	X_SQRT							correctly rounded square root
+	F_TOD_LO(a), F_TOD_HI(a)		the low and high halves of a float vector as doubles
+	F_FROMD(lo,hi)					and back
+
+	each kernel only evaluates its polynomial where it is known to be accurate
+	(the domain expression). a vector with any lane outside of it, including
+	nans, infinities, zeros or denormals where those matter, is computed with
+	the jit_math_* functions instead, so special cases always match the exact path.
+
+	float32 sin, cos, atan, atan2, pow and hypot are evaluated on the float64
+	cores, which keeps their argument reduction and log/exp round trip well
+	inside float precision. the table gives the largest errors seen, in ulps,
+	against long double libm: every 61st float32 bit pattern, then 4M random
+	bit patterns and 4M values across each polynomial domain, sse2 and avx2.
+
+		op			float32		float64
+		exp			1.0			1.7
+		exp2		1.0			1.7
+		ln			0.9			1.3
+		log2		1.8			1.7
+		log10		2.0			1.8
+		sin, cos	0.5			2.5		(|x| <= 65536)
+		atan		0.5			2.3
+		atan2		0.5			2.7
+		pow			0.5			1 + |y*log2(x)|, as the log/exp round trip is done in double
+		hypot		0.5			1.2
+		sqrt		0.5			0.5		(not here, correctly rounded so always used)
+*/
+
+#define JIT_OP_SIMD_HORNER(X,p,r,c,count) \
+	{ long _j; p = X##_SPLAT(c[0]); for (_j=1;_j<count;_j++) p = X##_ADD(X##_MUL(p,r),X##_SPLAT(c[_j])); }
+
+// -------- float64 cores --------
+
+// e^r for |r| <= ln2/2
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(expm_d)(D_V r)
+{
+	D_V z = D_MUL(r,r);
+	D_V p,q;
+	JIT_OP_SIMD_HORNER(D,p,z,jit_op_simd_exp_p_d,JIT_OP_SIMD_EXP_P_D_COUNT);
+	JIT_OP_SIMD_HORNER(D,q,z,jit_op_simd_exp_q_d,JIT_OP_SIMD_EXP_Q_D_COUNT);
+	p = D_MUL(p,r);
+	p = D_DIV(p,D_SUB(q,p));
+	return D_ADD(D_SPLAT(1.),D_ADD(p,p));
+}
+
+// 2^k for the integer k stored in the low bits of t = k + JIT_OP_SIMD_ROUND_D
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(scale_d)(D_V t)
+{
+	D_I k = D_ISUB(D_ASI(t),D_ASI(D_SPLAT(JIT_OP_SIMD_ROUND_D)));
+	return D_ASF(D_ISHL(D_IADD(k,D_ICONST(1023)),52));
+}
+
+// |x| <= 708
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(exp_d)(D_V x)
+{
+	D_V t = D_ADD(D_MUL(x,D_SPLAT(JIT_OP_SIMD_LOG2E)),D_SPLAT(JIT_OP_SIMD_ROUND_D));
+	D_V k = D_SUB(t,D_SPLAT(JIT_OP_SIMD_ROUND_D));
+	D_V r = D_SUB(D_SUB(x,D_MUL(k,D_SPLAT(JIT_OP_SIMD_LN2_HI))),D_MUL(k,D_SPLAT(JIT_OP_SIMD_LN2_LO)));
+	return D_MUL(JIT_OP_SIMD_FN(expm_d)(r),JIT_OP_SIMD_FN(scale_d)(t));
+}
+
+// |x| <= 1022
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(exp2_d)(D_V x)
+{
+	D_V t = D_ADD(x,D_SPLAT(JIT_OP_SIMD_ROUND_D));
+	D_V r = D_MUL(D_SUB(x,D_SUB(t,D_SPLAT(JIT_OP_SIMD_ROUND_D))),D_SPLAT(JIT_OP_SIMD_LN2));
+	return D_MUL(JIT_OP_SIMD_FN(expm_d)(r),JIT_OP_SIMD_FN(scale_d)(t));
+}
+
+// the unbiased exponent of a positive normal x, as a double. the exponent field
+// ORed into the mantissa of 2^52 gives 2^52+field
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(logb_d)(D_V x)
+{
+	D_V t = D_ASF(D_IOR(D_ISRL(D_ASI(x),52),D_ASI(D_SPLAT(4503599627370496.))));
+	return D_SUB(t,D_SPLAT(4503599627370496.+1023.));
+}
+
+// splits a positive normal x into e + ln(m)/ln2, with m in [sqrt(1/2),sqrt(2)). returns ln(m)
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(logm_d)(D_V x, D_V *e)
+{
+	D_I i = D_ASI(x);
+	D_V m = D_ASF(D_IOR(D_IAND(i,D_ICONST(0x000fffffffffffffLL)),D_ICONST(0x3ff0000000000000LL)));
+	D_V big = D_GT(m,D_SPLAT(JIT_OP_SIMD_SQRT2));
+	D_V f,s,z,p,h;
+
+	*e = D_ADD(JIT_OP_SIMD_FN(logb_d)(x),D_SEL(big,D_SPLAT(1.),D_SPLAT(0.)));
+	f = D_SUB(D_SEL(big,D_MUL(m,D_SPLAT(0.5)),m),D_SPLAT(1.));
+	// ln(1+f) = 2 atanh(s), s = f/(2+f), arranged as in fdlibm so that the leading f is exact
+	s = D_DIV(f,D_ADD(f,D_SPLAT(2.)));
+	z = D_MUL(s,s);
+	JIT_OP_SIMD_HORNER(D,p,z,jit_op_simd_atanh_d,JIT_OP_SIMD_ATANH_D_COUNT);
+	h = D_MUL(D_MUL(f,f),D_SPLAT(0.5));
+	return D_SUB(f,D_SUB(h,D_MUL(s,D_ADD(h,D_MUL(z,p)))));
+}
+
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(log_d)(D_V x)
+{
+	D_V e,l = JIT_OP_SIMD_FN(logm_d)(x,&e);
+	return D_ADD(D_MUL(e,D_SPLAT(JIT_OP_SIMD_LN2_HI)),D_ADD(l,D_MUL(e,D_SPLAT(JIT_OP_SIMD_LN2_LO))));
+}
+
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(log2_d)(D_V x)
+{
+	D_V e,l = JIT_OP_SIMD_FN(logm_d)(x,&e);
+	return D_ADD(e,D_MUL(l,D_SPLAT(JIT_OP_SIMD_LOG2E)));
+}
+
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(log10_d)(D_V x)
+{
+	D_V e,l = JIT_OP_SIMD_FN(logm_d)(x,&e);
+	return D_ADD(D_MUL(e,D_SPLAT(JIT_OP_SIMD_LOG10_2_HI)),D_ADD(D_MUL(l,D_SPLAT(JIT_OP_SIMD_LOG10E)),D_MUL(e,D_SPLAT(JIT_OP_SIMD_LOG10_2_LO))));
+}
+
+// x > 0 normal, |y*log2(x)| <= 1022. the kernels check |y|*(|logb(x)|+1) instead, which is cheaper and never smaller
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(pow_d)(D_V x, D_V y)
+{
+	return JIT_OP_SIMD_FN(exp2_d)(D_MUL(y,JIT_OP_SIMD_FN(log2_d)(x)));
+}
+
+// |x| <= JIT_OP_SIMD_SIN_D_MAX. quadrant is 0 for sin, 1 for cos
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(sincos_d)(D_V x, long quadrant)
+{
+	D_V t = D_ADD(D_MUL(x,D_SPLAT(JIT_OP_SIMD_2_PI)),D_SPLAT(JIT_OP_SIMD_ROUND_D));
+	D_V j = D_SUB(t,D_SPLAT(JIT_OP_SIMD_ROUND_D));
+	D_V r = D_SUB(D_SUB(D_SUB(x,D_MUL(j,D_SPLAT(JIT_OP_SIMD_PIO2_1))),D_MUL(j,D_SPLAT(JIT_OP_SIMD_PIO2_2))),D_MUL(j,D_SPLAT(JIT_OP_SIMD_PIO2_3)));
+	D_V z = D_MUL(r,r);
+	D_V s,c;
+	D_I q = D_IADD(D_ASI(t),D_ICONST(quadrant));	// the low bits of t are the quadrant
+
+	JIT_OP_SIMD_HORNER(D,s,z,jit_op_simd_sin_d,JIT_OP_SIMD_SIN_D_COUNT);
+	s = D_ADD(r,D_MUL(D_MUL(r,z),s));
+	JIT_OP_SIMD_HORNER(D,c,z,jit_op_simd_cos_d,JIT_OP_SIMD_COS_D_COUNT);
+	c = D_ADD(D_SUB(D_SPLAT(1.),D_MUL(z,D_SPLAT(0.5))),D_MUL(D_MUL(z,z),c));
+	s = D_SEL(D_ITOM(D_ISUB(D_ICONST(0),D_IAND(q,D_ICONST(1)))),c,s);
+	return D_ASF(D_IXOR(D_ASI(s),D_ISHL(D_IAND(q,D_ICONST(2)),62)));
+}
+
+// atan2 for finite y and x, not both tiny
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(atan2_d)(D_V y, D_V x)
+{
+	D_V ay = D_ABS(y), ax = D_ABS(x);
+	D_V swap = D_GT(ay,ax);
+	D_V a = D_DIV(D_MIN(ax,ay),D_MAX(ax,ay));
+	D_V big = D_GT(a,D_SPLAT(JIT_OP_SIMD_TAN_PI_8));
+	D_V z,w,s1,s2,r;
+
+	// reduce to |a| <= tan(pi/8) using atan(a) = pi/4 + atan((a-1)/(a+1))
+	a = D_SEL(big,D_DIV(D_SUB(a,D_SPLAT(1.)),D_ADD(a,D_SPLAT(1.))),a);
+	z = D_MUL(a,a);
+	w = D_MUL(z,z);
+	JIT_OP_SIMD_HORNER(D,s1,w,jit_op_simd_atan_even_d,JIT_OP_SIMD_ATAN_EVEN_D_COUNT);
+	JIT_OP_SIMD_HORNER(D,s2,w,jit_op_simd_atan_odd_d,JIT_OP_SIMD_ATAN_ODD_D_COUNT);
+	r = D_SUB(a,D_MUL(a,D_ADD(D_MUL(z,s1),D_MUL(w,s2))));
+	r = D_SEL(big,D_ADD(D_SPLAT(JIT_OP_SIMD_PIO4_HI),D_ADD(r,D_SPLAT(JIT_OP_SIMD_PIO4_LO))),r);
+	r = D_SEL(swap,D_SUB(D_SPLAT(JIT_OP_SIMD_PIO2_HI),D_SUB(r,D_SPLAT(JIT_OP_SIMD_PIO2_LO))),r);
+	r = D_SEL(D_LT(x,D_SPLAT(0.)),D_SUB(D_SPLAT(JIT_OP_SIMD_PI_HI),D_SUB(r,D_SPLAT(JIT_OP_SIMD_PI_LO))),r);
+	return D_ASF(D_IOR(D_ASI(r),D_IAND(D_ASI(y),D_ICONST(0x8000000000000000LL))));
+}
+
+JIT_OP_SIMD_INLINE D_V JIT_OP_SIMD_FN(hypot_d)(D_V x, D_V y)
+{
+	return D_SQRT(D_ADD(D_MUL(x,x),D_MUL(y,y)));
+}
+
+// -------- float32 cores --------
+
+JIT_OP_SIMD_INLINE F_V JIT_OP_SIMD_FN(expm_f)(F_V r)
+{
+	F_V p;
+	JIT_OP_SIMD_HORNER(F,p,r,jit_op_simd_exp_f,JIT_OP_SIMD_EXP_F_COUNT);
+	return F_ADD(F_ADD(F_MUL(F_MUL(r,r),p),r),F_SPLAT(1.f));
+}
+
+JIT_OP_SIMD_INLINE F_V JIT_OP_SIMD_FN(scale_f)(F_V t)
+{
+	F_I k = F_ISUB(F_ASI(t),F_ASI(F_SPLAT(JIT_OP_SIMD_ROUND_F)));
+	return F_ASF(F_ISHL(F_IADD(k,F_ICONST(127)),23));
+}
+
+// |x| <= 87
+JIT_OP_SIMD_INLINE F_V JIT_OP_SIMD_FN(exp_f)(F_V x)
+{
+	F_V t = F_ADD(F_MUL(x,F_SPLAT((float)JIT_OP_SIMD_LOG2E)),F_SPLAT(JIT_OP_SIMD_ROUND_F));
+	F_V k = F_SUB(t,F_SPLAT(JIT_OP_SIMD_ROUND_F));
+	F_V r = F_SUB(F_SUB(x,F_MUL(k,F_SPLAT(JIT_OP_SIMD_LN2_HI_F))),F_MUL(k,F_SPLAT(JIT_OP_SIMD_LN2_LO_F)));
+	return F_MUL(JIT_OP_SIMD_FN(expm_f)(r),JIT_OP_SIMD_FN(scale_f)(t));
+}
+
+// |x| <= 126
+JIT_OP_SIMD_INLINE F_V JIT_OP_SIMD_FN(exp2_f)(F_V x)
+{
+	F_V t = F_ADD(x,F_SPLAT(JIT_OP_SIMD_ROUND_F));
+	F_V r = F_MUL(F_SUB(x,F_SUB(t,F_SPLAT(JIT_OP_SIMD_ROUND_F))),F_SPLAT((float)JIT_OP_SIMD_LN2));
+	return F_MUL(JIT_OP_SIMD_FN(expm_f)(r),JIT_OP_SIMD_FN(scale_f)(t));
+}
+
+JIT_OP_SIMD_INLINE F_V JIT_OP_SIMD_FN(logb_f)(F_V x)
+{
+	F_V t = F_ASF(F_IOR(F_ISRL(F_ASI(x),23),F_ASI(F_SPLAT(8388608.f))));
+	return F_SUB(t,F_SPLAT(8388608.f+127.f));
+}
+
+JIT_OP_SIMD_INLINE F_V JIT_OP_SIMD_FN(logm_f)(F_V x, F_V *e)
+{
+	F_I i = F_ASI(x);
+	F_V m = F_ASF(F_IOR(F_IAND(i,F_ICONST(0x007fffff)),F_ICONST(0x3f800000)));
+	F_V big = F_GT(m,F_SPLAT((float)JIT_OP_SIMD_SQRT2));
+	F_V f,s,z,p,h;
+
+	*e = F_ADD(JIT_OP_SIMD_FN(logb_f)(x),F_SEL(big,F_SPLAT(1.f),F_SPLAT(0.f)));
+	f = F_SUB(F_SEL(big,F_MUL(m,F_SPLAT(0.5f)),m),F_SPLAT(1.f));
+	s = F_DIV(f,F_ADD(f,F_SPLAT(2.f)));
+	z = F_MUL(s,s);
+	JIT_OP_SIMD_HORNER(F,p,z,jit_op_simd_atanh_f,JIT_OP_SIMD_ATANH_F_COUNT);
+	h = F_MUL(F_MUL(f,f),F_SPLAT(0.5f));
+	return F_SUB(f,F_SUB(h,F_MUL(s,F_ADD(h,F_MUL(z,p)))));
+}
+
+JIT_OP_SIMD_INLINE F_V JIT_OP_SIMD_FN(log_f)(F_V x)
+{
+	F_V e,l = JIT_OP_SIMD_FN(logm_f)(x,&e);
+	return F_ADD(F_MUL(e,F_SPLAT(JIT_OP_SIMD_LN2_HI_F)),F_ADD(l,F_MUL(e,F_SPLAT(JIT_OP_SIMD_LN2_LO_F))));
+}
+
+JIT_OP_SIMD_INLINE F_V JIT_OP_SIMD_FN(log2_f)(F_V x)
+{
+	F_V e,l = JIT_OP_SIMD_FN(logm_f)(x,&e);
+	return F_ADD(e,F_MUL(l,F_SPLAT((float)JIT_OP_SIMD_LOG2E)));
+}
+
+JIT_OP_SIMD_INLINE F_V JIT_OP_SIMD_FN(log10_f)(F_V x)
+{
+	F_V e,l = JIT_OP_SIMD_FN(logm_f)(x,&e);
+	return F_ADD(F_MUL(e,F_SPLAT(JIT_OP_SIMD_LOG10_2_HI_F)),F_ADD(F_MUL(l,F_SPLAT((float)JIT_OP_SIMD_LOG10E)),F_MUL(e,F_SPLAT(JIT_OP_SIMD_LOG10_2_LO_F))));
+}
+
+// float32 through the float64 cores
+#define JIT_OP_SIMD_F_VIA_D2(fn,a,b)	F_FROMD(JIT_OP_SIMD_FN(fn)(F_TOD_LO(a),F_TOD_LO(b)),JIT_OP_SIMD_FN(fn)(F_TOD_HI(a),F_TOD_HI(b)))
+#define JIT_OP_SIMD_F_SINCOS(a,q)		F_FROMD(JIT_OP_SIMD_FN(sincos_d)(F_TOD_LO(a),q),JIT_OP_SIMD_FN(sincos_d)(F_TOD_HI(a),q))
+#define JIT_OP_SIMD_F_ATAN(a)			F_FROMD(JIT_OP_SIMD_FN(atan2_d)(F_TOD_LO(a),D_SPLAT(1.)),JIT_OP_SIMD_FN(atan2_d)(F_TOD_HI(a),D_SPLAT(1.)))
+
+// -------- kernels --------
+
+// like JIT_OP_SIMD_UNARY/BINARY, but a vector with any lane outside of the domain goes through sfn
+#define JIT_OP_SIMD_MATH1(name,X,domain,vexpr,sfn) \
+static void JIT_OP_SIMD_FN(name)(long n, void *vecdata, t_jit_op_info *in0, t_jit_op_info *in1, t_jit_op_info *out) \
+{ \
+	X##_T *ip1=(X##_T *)in0->p,*op=(X##_T *)out->p; \
+	long s1=in0->stride,i=0,j; \
+	X##_V a; \
+	if ((s1&~1)||out->stride!=1) { \
+		jit_op_vector_##name(n,vecdata,in0,in1,out); \
+		return; \
+	} \
+	for (;i+X##_W<=n;i+=X##_W) { \
+		a = s1?X##_LOAD(ip1+i):X##_SPLAT(*ip1); \
+		if (X##_ALL(domain)) { \
+			X##_STORE(op+i,vexpr); \
+		} else { \
+			for (j=i;j<i+X##_W;j++) \
+				op[j] = (X##_T)sfn(ip1[j*s1]); \
+		} \
+	} \
+	for (;i<n;i++) \
+		op[i] = (X##_T)sfn(ip1[i*s1]); \
+}
+
+#define JIT_OP_SIMD_MATH2(name,X,domain,vexpr,sfn) \
+static void JIT_OP_SIMD_FN(name)(long n, void *vecdata, t_jit_op_info *in0, t_jit_op_info *in1, t_jit_op_info *out) \
+{ \
+	X##_T *ip1=(X##_T *)in0->p,*ip2=(X##_T *)in1->p,*op=(X##_T *)out->p; \
+	long s1=in0->stride,s2=in1->stride,i=0,j; \
+	X##_V a,b; \
+	if (((s1|s2)&~1)||out->stride!=1) { \
+		jit_op_vector_##name(n,vecdata,in0,in1,out); \
+		return; \
+	} \
+	for (;i+X##_W<=n;i+=X##_W) { \
+		a = s1?X##_LOAD(ip1+i):X##_SPLAT(*ip1); \
+		b = s2?X##_LOAD(ip2+i):X##_SPLAT(*ip2); \
+		if (X##_ALL(domain)) { \
+			X##_STORE(op+i,vexpr); \
+		} else { \
+			for (j=i;j<i+X##_W;j++) \
+				op[j] = (X##_T)sfn(ip1[j*s1],ip2[j*s2]); \
+		} \
+	} \
+	for (;i<n;i++) \
+		op[i] = (X##_T)sfn(ip1[i*s1],ip2[i*s2]); \
+}
+
+#define D_IN(a,lo,hi)		D_MAND(D_GE(a,D_SPLAT(lo)),D_LE(a,D_SPLAT(hi)))
+#define F_IN(a,lo,hi)		F_MAND(F_GE(a,F_SPLAT(lo)),F_LE(a,F_SPLAT(hi)))
+// min/max can't be used to test both inputs at once, since they only pass nans through from one side
+#define D_BOTH_LE(a,b,hi)	D_MAND(D_LE(D_ABS(a),D_SPLAT(hi)),D_LE(D_ABS(b),D_SPLAT(hi)))
+#define F_BOTH_LE(a,b,hi)	F_MAND(F_LE(F_ABS(a),F_SPLAT(hi)),F_LE(F_ABS(b),F_SPLAT(hi)))
+
+JIT_OP_SIMD_MATH1(exp_float64,	D,	D_LE(D_ABS(a),D_SPLAT(708.)),		JIT_OP_SIMD_FN(exp_d)(a),	jit_math_exp)
+JIT_OP_SIMD_MATH1(exp2_float64,	D,	D_LE(D_ABS(a),D_SPLAT(1022.)),		JIT_OP_SIMD_FN(exp2_d)(a),	jit_math_exp2)
+JIT_OP_SIMD_MATH1(log_float64,	D,	D_IN(a,DBL_MIN,DBL_MAX),			JIT_OP_SIMD_FN(log_d)(a),	jit_math_log)
+JIT_OP_SIMD_MATH1(log2_float64,	D,	D_IN(a,DBL_MIN,DBL_MAX),			JIT_OP_SIMD_FN(log2_d)(a),	jit_math_log2)
+JIT_OP_SIMD_MATH1(log10_float64,D,	D_IN(a,DBL_MIN,DBL_MAX),			JIT_OP_SIMD_FN(log10_d)(a),	jit_math_log10)
+JIT_OP_SIMD_MATH1(sin_float64,	D,	D_LE(D_ABS(a),D_SPLAT(JIT_OP_SIMD_SIN_D_MAX)),	JIT_OP_SIMD_FN(sincos_d)(a,0),	jit_math_sin)
+JIT_OP_SIMD_MATH1(cos_float64,	D,	D_LE(D_ABS(a),D_SPLAT(JIT_OP_SIMD_SIN_D_MAX)),	JIT_OP_SIMD_FN(sincos_d)(a,1),	jit_math_cos)
+JIT_OP_SIMD_MATH1(atan_float64,	D,	D_LE(D_ABS(a),D_SPLAT(DBL_MAX)),	JIT_OP_SIMD_FN(atan2_d)(a,D_SPLAT(1.)),	jit_math_atan)
+JIT_OP_SIMD_MATH2(atan2_float64,D,	D_MAND(D_BOTH_LE(a,b,DBL_MAX),D_GE(D_MAX(D_ABS(a),D_ABS(b)),D_SPLAT(DBL_MIN))),
+																		JIT_OP_SIMD_FN(atan2_d)(a,b),	jit_math_atan2)
+JIT_OP_SIMD_MATH2(pow_float64,	D,	D_MAND(D_IN(a,DBL_MIN,DBL_MAX),D_LE(D_MUL(D_ABS(b),D_ADD(D_ABS(JIT_OP_SIMD_FN(logb_d)(a)),D_SPLAT(1.))),D_SPLAT(1022.))),
+																		JIT_OP_SIMD_FN(pow_d)(a,b),	jit_math_pow)
+JIT_OP_SIMD_MATH2(hypot_float64,D,	D_MAND(D_BOTH_LE(a,b,1e150),D_GE(D_MAX(D_ABS(a),D_ABS(b)),D_SPLAT(1e-150))),
+																		JIT_OP_SIMD_FN(hypot_d)(a,b),	jit_math_hypot)
+
+JIT_OP_SIMD_MATH1(exp_float32,	F,	F_LE(F_ABS(a),F_SPLAT(87.f)),		JIT_OP_SIMD_FN(exp_f)(a),	jit_math_exp)
+JIT_OP_SIMD_MATH1(exp2_float32,	F,	F_LE(F_ABS(a),F_SPLAT(126.f)),		JIT_OP_SIMD_FN(exp2_f)(a),	jit_math_exp2)
+JIT_OP_SIMD_MATH1(log_float32,	F,	F_IN(a,FLT_MIN,FLT_MAX),			JIT_OP_SIMD_FN(log_f)(a),	jit_math_log)
+JIT_OP_SIMD_MATH1(log2_float32,	F,	F_IN(a,FLT_MIN,FLT_MAX),			JIT_OP_SIMD_FN(log2_f)(a),	jit_math_log2)
+JIT_OP_SIMD_MATH1(log10_float32,F,	F_IN(a,FLT_MIN,FLT_MAX),			JIT_OP_SIMD_FN(log10_f)(a),	jit_math_log10)
+JIT_OP_SIMD_MATH1(sin_float32,	F,	F_LE(F_ABS(a),F_SPLAT((float)JIT_OP_SIMD_SIN_D_MAX)),	JIT_OP_SIMD_F_SINCOS(a,0),	jit_math_sin)
+JIT_OP_SIMD_MATH1(cos_float32,	F,	F_LE(F_ABS(a),F_SPLAT((float)JIT_OP_SIMD_SIN_D_MAX)),	JIT_OP_SIMD_F_SINCOS(a,1),	jit_math_cos)
+JIT_OP_SIMD_MATH1(atan_float32,	F,	F_LE(F_ABS(a),F_SPLAT(FLT_MAX)),	JIT_OP_SIMD_F_ATAN(a),	jit_math_atan)
+JIT_OP_SIMD_MATH2(atan2_float32,F,	F_MAND(F_BOTH_LE(a,b,FLT_MAX),F_GE(F_MAX(F_ABS(a),F_ABS(b)),F_SPLAT(FLT_MIN))),
+																		JIT_OP_SIMD_F_VIA_D2(atan2_d,a,b),	jit_math_atan2)
+JIT_OP_SIMD_MATH2(pow_float32,	F,	F_MAND(F_IN(a,FLT_MIN,FLT_MAX),F_LE(F_MUL(F_ABS(b),F_ADD(F_ABS(JIT_OP_SIMD_FN(logb_f)(a)),F_SPLAT(1.f))),F_SPLAT(1022.f))),
+																		JIT_OP_SIMD_F_VIA_D2(pow_d,a,b),	jit_math_pow)
+JIT_OP_SIMD_MATH2(hypot_float32,F,	F_BOTH_LE(a,b,FLT_MAX),
+																		JIT_OP_SIMD_F_VIA_D2(hypot_d,a,b),	jit_math_hypot)
+
+#define JIT_OP_SIMD_MATH_ENTRIES(type) \
+	JIT_OP_SIMD_ENTRY("exp",exp_##type) JIT_OP_SIMD_ENTRY("exp2",exp2_##type) JIT_OP_SIMD_ENTRY("ln",log_##type) \
+	JIT_OP_SIMD_ENTRY("log2",log2_##type) JIT_OP_SIMD_ENTRY("log10",log10_##type) JIT_OP_SIMD_ENTRY("sin",sin_##type) \
+	JIT_OP_SIMD_ENTRY("cos",cos_##type) JIT_OP_SIMD_ENTRY("atan",atan_##type) JIT_OP_SIMD_ENTRY("atan2",atan2_##type) \
+	JIT_OP_SIMD_ENTRY("pow",pow_##type) JIT_OP_SIMD_ENTRY("hypot",hypot_##type)
+
+static t_jit_op_simd_entry JIT_OP_SIMD_FN(mathtable)[] = {
+	JIT_OP_SIMD_MATH_ENTRIES(float32)
+	JIT_OP_SIMD_MATH_ENTRIES(float64)
+	{NULL, NULL, 0L, 0L, 0L}
+};
+
+#undef JIT_OP_SIMD_MATH_ENTRIES
+#undef JIT_OP_SIMD_MATH1
+#undef JIT_OP_SIMD_MATH2
+#undef JIT_OP_SIMD_F_VIA_D2
+#undef JIT_OP_SIMD_F_SINCOS
+#undef JIT_OP_SIMD_F_ATAN
+#undef JIT_OP_SIMD_HORNER
+#undef D_IN
+#undef F_IN
+#undef D_BOTH_LE
+#undef F_BOTH_LE
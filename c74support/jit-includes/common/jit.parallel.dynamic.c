@@ -0,0 +1,300 @@
+/*
+	jit.parallel.dynamic.c
+
+	dynamic load balancing and reductions on top of jit_parallel_ndim_calc.
+
+	the parallel utilities hand each worker one fixed slice of the matrix, so when some rows
+	cost more than others (early outs, tolerance branches, etc.) the slowest slice sets the
+	time for the whole calculation. here the outer dimension is cut into
+	JIT_PARALLEL_NDIM_DYNAMIC_CHUNKS pieces instead, and every worker keeps claiming the next
+	unclaimed piece from an atomic counter until there are none left.
+
+	reductions use the same chunks, but fold them into a partial state owned by the worker
+	instead of writing output, and combine the partials on the calling thread at the end.
+
+	add this file to your project to use the jit_parallel_ndim_dynamic_* and 
+	jit_parallel_ndim_reduce* functions.
+*/
+
+#include "jit.common.h"
+#include "ext_atomic.h"
+
+// this file has to reach the static versions even when the project routes them here
+#undef jit_parallel_ndim_simplecalc1
+#undef jit_parallel_ndim_simplecalc2
+#undef jit_parallel_ndim_simplecalc3
+#undef jit_parallel_ndim_simplecalc4
+
+typedef struct _jit_parallel_ndim_dynamic
+{
+	t_jit_parallel_ndim		*paralleldata;	// the caller's request
+	long					simple;			// call fn with the simplecalc argument list
+	long					splitdim;		// dimension being chunked
+	long					chunksize;		// cells of splitdim per chunk
+	long					chunkcount;
+	t_int32_atomic			next;			// next unclaimed chunk
+	t_jit_parallel_ndim_reduce	*reduce;	// reduction callbacks, or NULL
+	t_int32_atomic			slots;			// partials handed out so far
+	void					*partial[JIT_PARALLEL_NDIM_REDUCE_MAX_PARTIALS];
+} t_jit_parallel_ndim_dynamic;
+
+static void jit_parallel_ndim_dynamic_run(t_jit_parallel_ndim *p, long simple, t_jit_parallel_ndim_reduce *r, void *result);
+static void jit_parallel_ndim_dynamic_worker(t_jit_parallel_ndim_worker *w);
+static void jit_parallel_ndim_dynamic_chunk(t_jit_parallel_ndim_dynamic *d, t_jit_parallel_ndim_worker *w, void *state, long offset, long extent);
+
+
+void jit_parallel_ndim_dynamic_calc(t_jit_parallel_ndim *p)
+{
+	if (!p)
+		return;
+	if (!(p->flags&JIT_PARALLEL_NDIM_FLAGS_DYNAMIC)||p->dimcount<1) {
+		jit_parallel_ndim_calc(p);
+		return;
+	}
+	jit_parallel_ndim_dynamic_run(p, false, NULL, NULL);
+}
+
+static void jit_parallel_ndim_dynamic_run(t_jit_parallel_ndim *p, long simple, t_jit_parallel_ndim_reduce *r, void *result)
+{
+	t_jit_parallel_ndim_dynamic d;
+	t_jit_parallel_ndim carrier;
+	long i;
+
+	d.paralleldata = p;
+	d.simple = simple;
+	d.splitdim = (p->dimcount>1) ? 1 : 0;
+	d.chunksize = (p->dim[d.splitdim] + JIT_PARALLEL_NDIM_DYNAMIC_CHUNKS - 1) / JIT_PARALLEL_NDIM_DYNAMIC_CHUNKS;
+	if (d.chunksize<1)
+		d.chunksize = 1;
+	d.chunkcount = (p->dim[d.splitdim] + d.chunksize - 1) / d.chunksize;
+	d.next = 0;
+	d.reduce = r;
+	d.slots = 0;
+
+	// the carrier describes the same matrix, so the parallel utilities make their usual
+	// decision about how many workers to use. each of them then ignores its static slice
+	// and pulls chunks until the counter runs out.
+	carrier = *p;
+	carrier.flags &= ~JIT_PARALLEL_NDIM_FLAGS_DYNAMIC;
+	for (i=0;i<carrier.iocount;i++)
+		carrier.io[i].flags &= ~JIT_PARALLEL_NDIM_FLAGS_DYNAMIC;
+	carrier.data = &d;
+	carrier.fn = (method)jit_parallel_ndim_dynamic_worker;
+
+	jit_parallel_ndim_calc(&carrier);
+
+	if (r) {
+		// combine in slot order on the calling thread
+		if (d.slots>JIT_PARALLEL_NDIM_REDUCE_MAX_PARTIALS)
+			d.slots = JIT_PARALLEL_NDIM_REDUCE_MAX_PARTIALS;
+		for (i=0;i<d.slots;i++) {
+			if (d.partial[i]) {
+				(*r->combine)(r->data, result, d.partial[i]);
+				jit_freebytes(d.partial[i], r->statesize);
+			}
+		}
+	}
+}
+
+static void jit_parallel_ndim_dynamic_worker(t_jit_parallel_ndim_worker *w)
+{
+	t_jit_parallel_ndim_dynamic *d = (t_jit_parallel_ndim_dynamic *)w->paralleldata->data;
+	long chunk,offset,extent,size,slot=-1;
+	void *state=NULL;
+
+	if (d->reduce) {
+		// every worker folds its chunks into a partial of its own. should there ever be more
+		// workers than partials (or no memory for one) the worker leaves the chunks to the others.
+		slot = ATOMIC_INCREMENT(&d->slots)-1;
+		if (slot>=JIT_PARALLEL_NDIM_REDUCE_MAX_PARTIALS)
+			return;
+		d->partial[slot] = state = jit_getbytes(d->reduce->statesize);
+		if (!state)
+			return;
+		(*d->reduce->init)(d->reduce->data, state);
+	}
+
+	size = d->paralleldata->dim[d->splitdim];
+	while ((chunk=ATOMIC_INCREMENT(&d->next)-1)<d->chunkcount) {
+		offset = chunk * d->chunksize;
+		extent = size - offset;
+		if (extent>d->chunksize)
+			extent = d->chunksize;
+		jit_parallel_ndim_dynamic_chunk(d, w, state, offset, extent);
+	}
+}
+
+static void jit_parallel_ndim_dynamic_chunk(t_jit_parallel_ndim_dynamic *d, t_jit_parallel_ndim_worker *w, void *state, long offset, long extent)
+{
+	t_jit_parallel_ndim *p = d->paralleldata;
+	t_jit_parallel_ndim_worker cw;
+	long i,dim[JIT_MATRIX_MAX_DIMCOUNT];
+	char *bp[4];
+
+	if (!d->simple) {
+		// same worker view the static split would have produced, just for this chunk
+		cw.paralleldata = p;
+		cw.workercount = w->workercount;
+		cw.workerid = w->workerid;
+		cw.offset[0] = 0;
+		cw.extent[0] = p->dim[0];
+		cw.offset[1] = 0;
+		cw.extent[1] = (p->dimcount>1) ? p->dim[1] : 1;
+		cw.offset[d->splitdim] = offset;
+		cw.extent[d->splitdim] = extent;
+		(*p->fn)(&cw);
+		return;
+	}
+
+	// calculate_ndim functions may modify dim, so every chunk gets its own copy
+	for (i=0;i<p->dimcount;i++)
+		dim[i] = p->dim[i];
+	dim[d->splitdim] = extent;
+	for (i=0;i<p->iocount;i++) {
+		bp[i] = p->io[i].bp;
+		if (!(p->io[i].flags&JIT_PARALLEL_NDIM_FLAGS_FULL_MATRIX))
+			bp[i] += offset * p->io[i].minfo->dimstride[d->splitdim];
+	}
+
+	if (d->reduce) {
+		(*d->reduce->accumulate)(d->reduce->data, state, offset, p->dimcount, dim, p->planecount, p->io[0].minfo, bp[0]);
+		return;
+	}
+
+	switch (p->iocount) {
+	case 1:
+		(*p->fn)(p->data, p->dimcount, dim, p->planecount, p->io[0].minfo, bp[0]);
+		break;
+	case 2:
+		(*p->fn)(p->data, p->dimcount, dim, p->planecount, p->io[0].minfo, bp[0], p->io[1].minfo, bp[1]);
+		break;
+	case 3:
+		(*p->fn)(p->data, p->dimcount, dim, p->planecount, p->io[0].minfo, bp[0], p->io[1].minfo, bp[1],
+			p->io[2].minfo, bp[2]);
+		break;
+	case 4:
+		(*p->fn)(p->data, p->dimcount, dim, p->planecount, p->io[0].minfo, bp[0], p->io[1].minfo, bp[1],
+			p->io[2].minfo, bp[2], p->io[3].minfo, bp[3]);
+		break;
+	}
+}
+
+// simplecalc front ends. the request is run through the same worker as
+// jit_parallel_ndim_dynamic_calc, which calls fn with the simplecalc argument list.
+
+static void jit_parallel_ndim_dynamic_simplecalc(t_jit_parallel_ndim *p)
+{
+	long i,dynamic=false;
+
+	for (i=0;i<p->iocount;i++) {
+		if (p->io[i].flags&JIT_PARALLEL_NDIM_FLAGS_DYNAMIC) {
+			p->io[i].flags &= ~JIT_PARALLEL_NDIM_FLAGS_DYNAMIC;
+			dynamic = true;
+		}
+	}
+
+	if (!dynamic||p->dimcount<1) {
+		switch (p->iocount) {
+		case 1:
+			jit_parallel_ndim_simplecalc1(p->fn, p->data, p->dimcount, p->dim, p->planecount,
+				p->io[0].minfo, p->io[0].bp, p->io[0].flags);
+			break;
+		case 2:
+			jit_parallel_ndim_simplecalc2(p->fn, p->data, p->dimcount, p->dim, p->planecount,
+				p->io[0].minfo, p->io[0].bp, p->io[1].minfo, p->io[1].bp,
+				p->io[0].flags, p->io[1].flags);
+			break;
+		case 3:
+			jit_parallel_ndim_simplecalc3(p->fn, p->data, p->dimcount, p->dim, p->planecount,
+				p->io[0].minfo, p->io[0].bp, p->io[1].minfo, p->io[1].bp, p->io[2].minfo, p->io[2].bp,
+				p->io[0].flags, p->io[1].flags, p->io[2].flags);
+			break;
+		case 4:
+			jit_parallel_ndim_simplecalc4(p->fn, p->data, p->dimcount, p->dim, p->planecount,
+				p->io[0].minfo, p->io[0].bp, p->io[1].minfo, p->io[1].bp, p->io[2].minfo, p->io[2].bp,
+				p->io[3].minfo, p->io[3].bp,
+				p->io[0].flags, p->io[1].flags, p->io[2].flags, p->io[3].flags);
+			break;
+		}
+		return;
+	}
+
+	jit_parallel_ndim_dynamic_run(p, true, NULL, NULL);
+}
+
+static void jit_parallel_ndim_dynamic_setup(t_jit_parallel_ndim *p, method fn, void *data, long dimcount, long *dim, long planecount)
+{
+	p->flags = 0;
+	p->fn = fn;
+	p->data = data;
+	p->dimcount = dimcount;
+	p->dim = dim;
+	p->planecount = planecount;
+	p->iocount = 0;
+}
+
+static void jit_parallel_ndim_dynamic_setio(t_jit_parallel_ndim *p, t_jit_matrix_info *minfo, char *bp, long flags)
+{
+	p->io[p->iocount].minfo = minfo;
+	p->io[p->iocount].bp = bp;
+	p->io[p->iocount].flags = flags;
+	p->iocount++;
+}
+
+void jit_parallel_ndim_dynamic_simplecalc1(method fn, void *data, long dimcount, long *dim, long planecount, t_jit_matrix_info *minfo1, char *bp1, long flags1)
+{
+	t_jit_parallel_ndim p;
+
+	jit_parallel_ndim_dynamic_setup(&p, fn, data, dimcount, dim, planecount);
+	jit_parallel_ndim_dynamic_setio(&p, minfo1, bp1, flags1);
+	jit_parallel_ndim_dynamic_simplecalc(&p);
+}
+
+void jit_parallel_ndim_dynamic_simplecalc2(method fn, void *data, long dimcount, long *dim, long planecount, t_jit_matrix_info *minfo1, char *bp1,
+	t_jit_matrix_info *minfo2, char *bp2, long flags1, long flags2)
+{
+	t_jit_parallel_ndim p;
+
+	jit_parallel_ndim_dynamic_setup(&p, fn, data, dimcount, dim, planecount);
+	jit_parallel_ndim_dynamic_setio(&p, minfo1, bp1, flags1);
+	jit_parallel_ndim_dynamic_setio(&p, minfo2, bp2, flags2);
+	jit_parallel_ndim_dynamic_simplecalc(&p);
+}
+
+void jit_parallel_ndim_dynamic_simplecalc3(method fn, void *data, long dimcount, long *dim, long planecount, t_jit_matrix_info *minfo1, char *bp1,
+	t_jit_matrix_info *minfo2, char *bp2, t_jit_matrix_info *minfo3, char *bp3, long flags1, long flags2, long flags3)
+{
+	t_jit_parallel_ndim p;
+
+	jit_parallel_ndim_dynamic_setup(&p, fn, data, dimcount, dim, planecount);
+	jit_parallel_ndim_dynamic_setio(&p, minfo1, bp1, flags1);
+	jit_parallel_ndim_dynamic_setio(&p, minfo2, bp2, flags2);
+	jit_parallel_ndim_dynamic_setio(&p, minfo3, bp3, flags3);
+	jit_parallel_ndim_dynamic_simplecalc(&p);
+}
+
+void jit_parallel_ndim_dynamic_simplecalc4(method fn, void *data, long dimcount, long *dim, long planecount, t_jit_matrix_info *minfo1, char *bp1,
+	t_jit_matrix_info *minfo2, char *bp2, t_jit_matrix_info *minfo3, char *bp3, t_jit_matrix_info *minfo4, char *bp4,
+	long flags1, long flags2, long flags3, long flags4)
+{
+	t_jit_parallel_ndim p;
+
+	jit_parallel_ndim_dynamic_setup(&p, fn, data, dimcount, dim, planecount);
+	jit_parallel_ndim_dynamic_setio(&p, minfo1, bp1, flags1);
+	jit_parallel_ndim_dynamic_setio(&p, minfo2, bp2, flags2);
+	jit_parallel_ndim_dynamic_setio(&p, minfo3, bp3, flags3);
+	jit_parallel_ndim_dynamic_setio(&p, minfo4, bp4, flags4);
+	jit_parallel_ndim_dynamic_simplecalc(&p);
+}
+
+void jit_parallel_ndim_reduce1(t_jit_parallel_ndim_reduce *r, void *result, long dimcount, long *dim, long planecount,
+	t_jit_matrix_info *minfo1, char *bp1, long flags1)
+{
+	t_jit_parallel_ndim p;
+
+	if (!r||!result||dimcount<1)
+		return;
+	jit_parallel_ndim_dynamic_setup(&p, NULL, NULL, dimcount, dim, planecount);
+	jit_parallel_ndim_dynamic_setio(&p, minfo1, bp1, flags1&~JIT_PARALLEL_NDIM_FLAGS_DYNAMIC);
+	jit_parallel_ndim_dynamic_run(&p, true, r, result);
+}
@@ -0,0 +1,161 @@
+/*
+	jit.planar.c
+
+	planar (JIT_MATRIX_DATA_PLANAR) matrix support: a per plane view of a matrix in either
+	layout, and converters between a row of interleaved cells and one row per plane.
+
+	4 plane char and 4 byte (long, float32) cells are converted 16 or 4 cells at a time in
+	sse2 (intel) or neon (arm64) registers. with four registers of cells, zipping register
+	i with register i+2 into registers 2i and 2i+1 rotates the bits of an element's
+	register,position index left by one, so the planes come apart after four rounds for char
+	and two for 4 byte elements, and go back together after two. other cell layouts, and
+	the ends of rows, are moved an element at a time.
+
+	add this file to your project to use jit_planar_plane(), jit_planar_deinterleave() and
+	jit_planar_interleave().
+*/
+
+#include "jit.common.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIT_PLANAR_SSE2		1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define JIT_PLANAR_NEON		1
+#include <arm_neon.h>
+#endif
+
+#if JIT_PLANAR_SSE2
+#define V_T					__m128i
+#define V_LOAD(p)			_mm_loadu_si128((__m128i *)(p))
+#define V_STORE(p,v)		_mm_storeu_si128((__m128i *)(p),v)
+#define V_ZIPLO8			_mm_unpacklo_epi8
+#define V_ZIPHI8			_mm_unpackhi_epi8
+#define V_ZIPLO32			_mm_unpacklo_epi32
+#define V_ZIPHI32			_mm_unpackhi_epi32
+#elif JIT_PLANAR_NEON
+#define V_T					uint8x16_t
+#define V_LOAD(p)			vld1q_u8((const uint8_t *)(p))
+#define V_STORE(p,v)		vst1q_u8((uint8_t *)(p),v)
+#define V_ZIPLO8			vzip1q_u8
+#define V_ZIPHI8			vzip2q_u8
+#define V_ZIPLO32(a,b)		vreinterpretq_u8_u32(vzip1q_u32(vreinterpretq_u32_u8(a),vreinterpretq_u32_u8(b)))
+#define V_ZIPHI32(a,b)		vreinterpretq_u8_u32(vzip2q_u32(vreinterpretq_u32_u8(a),vreinterpretq_u32_u8(b)))
+#endif
+
+#if JIT_PLANAR_SSE2 || JIT_PLANAR_NEON
+#define JIT_PLANAR_ZIP(d,s,lo,hi) \
+	d[0] = lo(s[0],s[2]);	d[1] = hi(s[0],s[2]); \
+	d[2] = lo(s[1],s[3]);	d[3] = hi(s[1],s[3]);
+#endif
+
+// plane of a matrix in either layout, described so that plane_bp and plane_minfo can be
+// handed to a calculate_ndim function in place of the whole matrix, with the plane at j=0.
+// planar matrices give a 1 plane matrix. interleaved ones keep their planecount, so the
+// usual strides still step over whole cells, and the data pointer moves to the plane
+void jit_planar_plane(t_jit_matrix_info *minfo, char *bp, long plane, t_jit_matrix_info *plane_minfo, char **plane_bp)
+{
+	long last;
+
+	*plane_minfo = *minfo;
+	plane %= minfo->planecount;
+	if (minfo->flags&JIT_MATRIX_DATA_PLANAR) {
+		last = minfo->dimcount-1;
+		*plane_bp = bp + plane*minfo->dimstride[last]*minfo->dim[last];
+		plane_minfo->planecount = 1;
+		plane_minfo->flags &= ~JIT_MATRIX_DATA_PLANAR;
+	} else {
+		*plane_bp = bp + plane*jit_matrix_info_typesize(minfo);
+	}
+}
+
+// element at a time, for any cell layout. the memcpy sizes are constant in each case, 
+// so they compile to plain loads and stores
+#define JIT_PLANAR_DEINTERLEAVE(size) \
+	for (j=0;j<planecount;j++) { \
+		if (!op[j]) continue; \
+		for (i=k;i<n;i++) \
+			memcpy(op[j]+i*(size),ip+(i*planecount+j)*(size),(size)); \
+	}
+
+#define JIT_PLANAR_INTERLEAVE(size) \
+	for (j=0;j<planecount;j++) { \
+		if (!ip[j]) continue; \
+		for (i=k;i<n;i++) \
+			memcpy(op+(i*planecount+j)*(size),ip[j]+i*(size),(size)); \
+	}
+
+// n interleaved cells from ip into planecount rows of elements
+void jit_planar_deinterleave(long n, long planecount, long typesize, char *ip, char **op)
+{
+	long i,j,k=0;
+#if JIT_PLANAR_SSE2 || JIT_PLANAR_NEON
+	V_T v[4],t[4];
+
+	if ((planecount==4)&&op[0]&&op[1]&&op[2]&&op[3]) {
+		if (typesize==1) {
+			for (;k+16<=n;k+=16) {
+				for (i=0;i<4;i++)
+					v[i] = V_LOAD(ip+k*4+i*16);
+				JIT_PLANAR_ZIP(t,v,V_ZIPLO8,V_ZIPHI8);
+				JIT_PLANAR_ZIP(v,t,V_ZIPLO8,V_ZIPHI8);
+				JIT_PLANAR_ZIP(t,v,V_ZIPLO8,V_ZIPHI8);
+				JIT_PLANAR_ZIP(v,t,V_ZIPLO8,V_ZIPHI8);
+				for (i=0;i<4;i++)
+					V_STORE(op[i]+k,v[i]);
+			}
+		} else if (typesize==4) {
+			for (;k+4<=n;k+=4) {
+				for (i=0;i<4;i++)
+					v[i] = V_LOAD(ip+k*16+i*16);
+				JIT_PLANAR_ZIP(t,v,V_ZIPLO32,V_ZIPHI32);
+				JIT_PLANAR_ZIP(v,t,V_ZIPLO32,V_ZIPHI32);
+				for (i=0;i<4;i++)
+					V_STORE(op[i]+k*4,v[i]);
+			}
+		}
+	}
+#endif
+	switch (typesize) {
+	case 1:		JIT_PLANAR_DEINTERLEAVE(1);		break;
+	case 4:		JIT_PLANAR_DEINTERLEAVE(4);		break;
+	case 8:		JIT_PLANAR_DEINTERLEAVE(8);		break;
+	}
+}
+
+// n cells from planecount rows of elements into interleaved cells at op
+void jit_planar_interleave(long n, long planecount, long typesize, char **ip, char *op)
+{
+	long i,j,k=0;
+#if JIT_PLANAR_SSE2 || JIT_PLANAR_NEON
+	V_T v[4],t[4];
+
+	if ((planecount==4)&&ip[0]&&ip[1]&&ip[2]&&ip[3]) {
+		if (typesize==1) {
+			for (;k+16<=n;k+=16) {
+				for (i=0;i<4;i++)
+					v[i] = V_LOAD(ip[i]+k);
+				JIT_PLANAR_ZIP(t,v,V_ZIPLO8,V_ZIPHI8);
+				JIT_PLANAR_ZIP(v,t,V_ZIPLO8,V_ZIPHI8);
+				for (i=0;i<4;i++)
+					V_STORE(op+k*4+i*16,v[i]);
+			}
+		} else if (typesize==4) {
+			for (;k+4<=n;k+=4) {
+				for (i=0;i<4;i++)
+					v[i] = V_LOAD(ip[i]+k*4);
+				JIT_PLANAR_ZIP(t,v,V_ZIPLO32,V_ZIPHI32);
+				JIT_PLANAR_ZIP(v,t,V_ZIPLO32,V_ZIPHI32);
+				for (i=0;i<4;i++)
+					V_STORE(op+k*16+i*16,v[i]);
+			}
+		}
+	}
+#endif
+	switch (typesize) {
+	case 1:		JIT_PLANAR_INTERLEAVE(1);	break;
+	case 4:		JIT_PLANAR_INTERLEAVE(4);	break;
+	case 8:		JIT_PLANAR_INTERLEAVE(8);	break;
+	}
+}
@@ -0,0 +1,191 @@
+/*
+	jit.transpose.simd.c
+
+	cache blocked transpose of whole matrix cells, for jit.transpose and anything else
+	that has to swap two dimensions.
+
+	walking the source down a column touches a new cache line for every cell, so the
+	work is cut into JIT_TRANSPOSE_SIMD_TILE x JIT_TRANSPOSE_SIMD_TILE blocks that fit
+	in L1 with both their source and destination. inside a block, cells of 1, 4 and 8
+	bytes are transposed 16x16, 4x4 and 2x2 at a time in sse2 (intel) or neon (arm64)
+	registers, and 16 byte cells move as one register. any other cell size, and the
+	edges of the blocks, are copied a cell at a time.
+
+	add this file to your project to use jit_transpose_simd_cells().
+*/
+
+#include "jit.common.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIT_TRANSPOSE_SIMD_SSE2		1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define JIT_TRANSPOSE_SIMD_NEON		1
+#include <arm_neon.h>
+#endif
+
+#define JIT_TRANSPOSE_SIMD_TILE		64		// cells per side of a cache block
+
+#ifdef _MSC_VER
+#define JIT_TRANSPOSE_SIMD_INLINE	static __inline
+#else
+#define JIT_TRANSPOSE_SIMD_INLINE	static inline
+#endif
+
+// V_ZIPLO/V_ZIPHI interleave the low/high halves of two registers, element width 8/32/64
+#if JIT_TRANSPOSE_SIMD_SSE2
+#define V_T					__m128i
+#define V_LOAD(p)			_mm_loadu_si128((__m128i *)(p))
+#define V_STORE(p,v)		_mm_storeu_si128((__m128i *)(p),v)
+#define V_ZIPLO8			_mm_unpacklo_epi8
+#define V_ZIPHI8			_mm_unpackhi_epi8
+#define V_ZIPLO32			_mm_unpacklo_epi32
+#define V_ZIPHI32			_mm_unpackhi_epi32
+#define V_ZIPLO64			_mm_unpacklo_epi64
+#define V_ZIPHI64			_mm_unpackhi_epi64
+#elif JIT_TRANSPOSE_SIMD_NEON
+#define V_T					uint8x16_t
+#define V_LOAD(p)			vld1q_u8((const uint8_t *)(p))
+#define V_STORE(p,v)		vst1q_u8((uint8_t *)(p),v)
+#define V_ZIPLO8			vzip1q_u8
+#define V_ZIPHI8			vzip2q_u8
+#define V_ZIPLO32(a,b)		vreinterpretq_u8_u32(vzip1q_u32(vreinterpretq_u32_u8(a),vreinterpretq_u32_u8(b)))
+#define V_ZIPHI32(a,b)		vreinterpretq_u8_u32(vzip2q_u32(vreinterpretq_u32_u8(a),vreinterpretq_u32_u8(b)))
+#define V_ZIPLO64(a,b)		vreinterpretq_u8_u64(vzip1q_u64(vreinterpretq_u64_u8(a),vreinterpretq_u64_u8(b)))
+#define V_ZIPHI64(a,b)		vreinterpretq_u8_u64(vzip2q_u64(vreinterpretq_u64_u8(a),vreinterpretq_u64_u8(b)))
+#endif
+
+#if JIT_TRANSPOSE_SIMD_SSE2 || JIT_TRANSPOSE_SIMD_NEON
+
+// zipping row i with row i+N/2 into rows 2i and 2i+1 rotates the bits of a cell's
+// row,column index left by one, so log2(N) rounds of it transpose an NxN block.
+
+// 16x16 cells of 1 byte
+#define JIT_TRANSPOSE_SIMD_ZIP8(d,s) \
+	d[0]  = V_ZIPLO8(s[0],s[8]);	d[1]  = V_ZIPHI8(s[0],s[8]); \
+	d[2]  = V_ZIPLO8(s[1],s[9]);	d[3]  = V_ZIPHI8(s[1],s[9]); \
+	d[4]  = V_ZIPLO8(s[2],s[10]);	d[5]  = V_ZIPHI8(s[2],s[10]); \
+	d[6]  = V_ZIPLO8(s[3],s[11]);	d[7]  = V_ZIPHI8(s[3],s[11]); \
+	d[8]  = V_ZIPLO8(s[4],s[12]);	d[9]  = V_ZIPHI8(s[4],s[12]); \
+	d[10] = V_ZIPLO8(s[5],s[13]);	d[11] = V_ZIPHI8(s[5],s[13]); \
+	d[12] = V_ZIPLO8(s[6],s[14]);	d[13] = V_ZIPHI8(s[6],s[14]); \
+	d[14] = V_ZIPLO8(s[7],s[15]);	d[15] = V_ZIPHI8(s[7],s[15]);
+
+JIT_TRANSPOSE_SIMD_INLINE void jit_transpose_simd_block1(char *ip, long istride, char *op, long ostride)
+{
+	V_T v[16],t[16];
+	long i;
+
+	for (i=0;i<16;i++)
+		v[i] = V_LOAD(ip+i*istride);
+	JIT_TRANSPOSE_SIMD_ZIP8(t,v);
+	JIT_TRANSPOSE_SIMD_ZIP8(v,t);
+	JIT_TRANSPOSE_SIMD_ZIP8(t,v);
+	JIT_TRANSPOSE_SIMD_ZIP8(v,t);
+	for (i=0;i<16;i++)
+		V_STORE(op+i*ostride,v[i]);
+}
+
+// 4x4 cells of 4 bytes
+JIT_TRANSPOSE_SIMD_INLINE void jit_transpose_simd_block4(char *ip, long istride, char *op, long ostride)
+{
+	V_T a,b,c,d,t0,t1,t2,t3;
+
+	a = V_LOAD(ip);
+	b = V_LOAD(ip+istride);
+	c = V_LOAD(ip+2*istride);
+	d = V_LOAD(ip+3*istride);
+	t0 = V_ZIPLO32(a,c);
+	t1 = V_ZIPHI32(a,c);
+	t2 = V_ZIPLO32(b,d);
+	t3 = V_ZIPHI32(b,d);
+	V_STORE(op,V_ZIPLO32(t0,t2));
+	V_STORE(op+ostride,V_ZIPHI32(t0,t2));
+	V_STORE(op+2*ostride,V_ZIPLO32(t1,t3));
+	V_STORE(op+3*ostride,V_ZIPHI32(t1,t3));
+}
+
+// 2x2 cells of 8 bytes
+JIT_TRANSPOSE_SIMD_INLINE void jit_transpose_simd_block8(char *ip, long istride, char *op, long ostride)
+{
+	V_T a,b;
+
+	a = V_LOAD(ip);
+	b = V_LOAD(ip+istride);
+	V_STORE(op,V_ZIPLO64(a,b));
+	V_STORE(op+ostride,V_ZIPHI64(a,b));
+}
+
+// 1x1 cells of 16 bytes
+JIT_TRANSPOSE_SIMD_INLINE void jit_transpose_simd_block16(char *ip, long istride, char *op, long ostride)
+{
+	V_STORE(op,V_LOAD(ip));
+}
+
+#endif
+
+// cell at a time, rows r0 to r1 and columns c0 to c1 of the output. the memcpy sizes are
+// constant in each case, so they compile to plain loads and stores
+static void jit_transpose_simd_cellcopy(long r0, long r1, long c0, long c1, long cellsize,
+	char *ip, long istride, char *op, long ostride)
+{
+	long r,c;
+	char *s,*d;
+
+#define JIT_TRANSPOSE_SIMD_CELLCOPY(size) \
+	for (r=r0;r<r1;r++) { \
+		s = ip + c0*istride + r*cellsize; \
+		d = op + r*ostride + c0*cellsize; \
+		for (c=c0;c<c1;c++,s+=istride,d+=(size)) \
+			memcpy(d,s,(size)); \
+	}
+
+	switch (cellsize) {
+	case 1:		JIT_TRANSPOSE_SIMD_CELLCOPY(1);		break;
+	case 2:		JIT_TRANSPOSE_SIMD_CELLCOPY(2);		break;
+	case 3:		JIT_TRANSPOSE_SIMD_CELLCOPY(3);		break;
+	case 4:		JIT_TRANSPOSE_SIMD_CELLCOPY(4);		break;
+	case 8:		JIT_TRANSPOSE_SIMD_CELLCOPY(8);		break;
+	case 12:	JIT_TRANSPOSE_SIMD_CELLCOPY(12);	break;
+	case 16:	JIT_TRANSPOSE_SIMD_CELLCOPY(16);	break;
+	case 24:	JIT_TRANSPOSE_SIMD_CELLCOPY(24);	break;
+	case 32:	JIT_TRANSPOSE_SIMD_CELLCOPY(32);	break;
+	default:	JIT_TRANSPOSE_SIMD_CELLCOPY(cellsize);	break;
+	}
+#undef JIT_TRANSPOSE_SIMD_CELLCOPY
+}
+
+// one cache block, using the n x n register transpose where it fits
+#define JIT_TRANSPOSE_SIMD_TILE_BLOCKS(n,block) \
+	for (r=r0;r+(n)<=r1;r+=(n)) { \
+		for (c=c0;c+(n)<=c1;c+=(n)) \
+			block(ip+c*istride+r*cellsize,istride,op+r*ostride+c*cellsize,ostride); \
+		if (c<c1) \
+			jit_transpose_simd_cellcopy(r,r+(n),c,c1,cellsize,ip,istride,op,ostride); \
+	}
+
+// output cell (r,c) = input cell (c,r), for rows x cols output cells of cellsize bytes.
+// istride and ostride are the byte strides between rows of the input and output.
+void jit_transpose_simd_cells(long rows, long cols, long cellsize, char *ip, long istride, char *op, long ostride)
+{
+	long r0,r1,c0,c1,r,c;
+
+	for (r0=0;r0<rows;r0+=JIT_TRANSPOSE_SIMD_TILE) {
+		r1 = MIN(r0+JIT_TRANSPOSE_SIMD_TILE,rows);
+		for (c0=0;c0<cols;c0+=JIT_TRANSPOSE_SIMD_TILE) {
+			c1 = MIN(c0+JIT_TRANSPOSE_SIMD_TILE,cols);
+			r = r0;
+#if JIT_TRANSPOSE_SIMD_SSE2 || JIT_TRANSPOSE_SIMD_NEON
+			switch (cellsize) {
+			case 1:		JIT_TRANSPOSE_SIMD_TILE_BLOCKS(16,jit_transpose_simd_block1);	break;
+			case 4:		JIT_TRANSPOSE_SIMD_TILE_BLOCKS(4,jit_transpose_simd_block4);	break;
+			case 8:		JIT_TRANSPOSE_SIMD_TILE_BLOCKS(2,jit_transpose_simd_block8);	break;
+			case 16:	JIT_TRANSPOSE_SIMD_TILE_BLOCKS(1,jit_transpose_simd_block16);	break;
+			}
+#endif
+			if (r<r1)
+				jit_transpose_simd_cellcopy(r,r1,c0,c1,cellsize,ip,istride,op,ostride);
+		}
+	}
+}
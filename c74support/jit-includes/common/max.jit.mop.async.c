@@ -0,0 +1,349 @@
+/*
+	max.jit.mop.async.c
+
+	async matrix_calc for max.jit.mop wrapped objects.
+
+	with the async attribute on, every incoming frame is copied into a private set of input
+	matrices and handed to a background thread owned by the object, which calculates it into
+	a private set of output matrices. once a frame is done a clock copies it into the mop
+	outputs and sends it out on the scheduler thread, in the order the frames came in. the
+	scheduler thread never waits for a calculation, so a chain of async objects works on
+	consecutive frames at the same time.
+
+	latency is the number of frames in flight. when all of them are taken, the newest frame
+	that hasn't started yet is replaced by the incoming one; if none is waiting the incoming
+	frame is dropped.
+
+	each frame gets its own copy of every mop input, including those a wrapper fills from
+	its own attributes before the calc (jit.op's val sets input 2), so those stay with the 
+	frame they were set for. the jitter object's attributes are not copied: they apply to 
+	whichever frame is running when they are set, and may take effect part way through it, 
+	as with the parallel utilities.
+
+	add this file to your project to use the max_jit_mop_async_* functions.
+*/
+
+#include "jit.common.h"
+#include "max.jit.mop.h"
+#include "ext_systhread.h"
+
+#define MAX_JIT_MOP_ASYNC_FREE			0
+#define MAX_JIT_MOP_ASYNC_FILLING		1
+#define MAX_JIT_MOP_ASYNC_QUEUED		2
+#define MAX_JIT_MOP_ASYNC_RUNNING		3
+#define MAX_JIT_MOP_ASYNC_DONE			4
+
+typedef struct _max_jit_mop_async_frame
+{
+	long				status;
+	t_jit_err			err;
+	void				*inputs;		// jit_linklist of private input matrices
+	void				*outputs;		// jit_linklist of private output matrices
+} t_max_jit_mop_async_frame;
+
+typedef struct _max_jit_mop_async_state
+{
+	void				*owner;
+	void				*mop;
+	void				*clock;
+	t_systhread			thread;
+	t_systhread_mutex	mutex;
+	t_systhread_cond	cond;
+	long				quit;
+	long				head;			// oldest frame in flight, sent out next
+	long				run;			// next frame the thread calculates
+	long				count;			// frames in flight
+	t_max_jit_mop_async_frame frame[MAX_JIT_MOP_ASYNC_MAX_LATENCY];
+} t_max_jit_mop_async_state;
+
+static long s_max_jit_mop_async_offset = -1;
+
+void max_jit_mop_async_mproc(void *x, void *mop);
+t_jit_err max_jit_mop_async_latency(void *x, void *attr, short argc, t_atom *argv);
+t_max_jit_mop_async_state *max_jit_mop_async_start(void *x);
+void max_jit_mop_async_copyin(t_max_jit_mop_async_frame *f, void *mop);
+void *max_jit_mop_async_threadproc(t_max_jit_mop_async_state *st);
+void max_jit_mop_async_deliver(void *x);
+void max_jit_mop_async_flush(void *x, t_max_jit_mop_async_state *st);
+
+#define max_jit_mop_async_get(x)	((t_max_jit_mop_async *)(((char *)(x)) + s_max_jit_mop_async_offset))
+
+
+t_jit_err max_jit_classex_mop_async(void *mclass, void *jclass, long offset)
+{
+	long attrflags;
+	void *attr;
+
+	s_max_jit_mop_async_offset = offset;
+
+	attrflags = JIT_ATTR_GET_DEFER_LOW | JIT_ATTR_SET_USURP_LOW;
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"async",_jit_sym_char,attrflags,
+		(method)0L,(method)0L,offset+calcoffset(t_max_jit_mop_async,async));
+	max_jit_classex_addattr(mclass,attr);
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"latency",_jit_sym_long,attrflags,
+		(method)0L,(method)max_jit_mop_async_latency,offset+calcoffset(t_max_jit_mop_async,latency));
+	max_jit_classex_addattr(mclass,attr);
+
+	return max_jit_classex_mop_mproc(mclass,jclass,max_jit_mop_async_mproc);
+}
+
+void max_jit_mop_async_init(void *x)
+{
+	t_max_jit_mop_async *a = max_jit_mop_async_get(x);
+
+	a->async = 0;
+	a->latency = 1;
+	a->state = NULL;
+}
+
+t_jit_err max_jit_mop_async_latency(void *x, void *attr, short argc, t_atom *argv)
+{
+	t_max_jit_mop_async *a = max_jit_mop_async_get(x);
+	long v;
+
+	if (argc&&argv) {
+		v = jit_atom_getlong(argv);
+		if (v<1) v = 1;
+		if (v>MAX_JIT_MOP_ASYNC_MAX_LATENCY) v = MAX_JIT_MOP_ASYNC_MAX_LATENCY;
+		a->latency = v;
+	}
+	return JIT_ERR_NONE;
+}
+
+// same as the standard mproc, unless the frame goes to the background thread
+void max_jit_mop_async_mproc(void *x, void *mop)
+{
+	t_jit_err err;
+
+	if (max_jit_mop_async_calc(x,mop))
+		return;
+
+	if (err=(t_jit_err) jit_object_method(
+		max_jit_obex_jitob_get(x),
+		_jit_sym_matrix_calc,
+		jit_object_method(mop,_jit_sym_getinputlist),
+		jit_object_method(mop,_jit_sym_getoutputlist)))
+	{
+		jit_error_code(x,err);
+	} else {
+		max_jit_mop_outputmatrix(x);
+	}
+}
+
+// returns true if the frame was taken (or dropped) asynchronously, false if the caller should calculate it
+long max_jit_mop_async_calc(void *x, void *mop)
+{
+	t_max_jit_mop_async *a = max_jit_mop_async_get(x);
+	t_max_jit_mop_async_state *st = (t_max_jit_mop_async_state *)a->state;
+	t_max_jit_mop_async_frame *f;
+	long last;
+
+	if (!a->async) {
+		// send out what is still in flight first, so frames stay in order
+		if (st)
+			max_jit_mop_async_flush(x,st);
+		return false;
+	}
+	if (!st) {
+		if (!(st=max_jit_mop_async_start(x)))
+			return false;
+		a->state = st;
+	}
+	st->mop = mop;
+
+	systhread_mutex_lock(st->mutex);
+	if (st->count>=a->latency) {
+		last = (st->head + st->count - 1) % MAX_JIT_MOP_ASYNC_MAX_LATENCY;
+		if (st->frame[last].status!=MAX_JIT_MOP_ASYNC_QUEUED) {
+			systhread_mutex_unlock(st->mutex);
+			return true;
+		}
+		f = &st->frame[last];
+	} else {
+		f = &st->frame[(st->head + st->count) % MAX_JIT_MOP_ASYNC_MAX_LATENCY];
+		st->count++;
+	}
+	f->status = MAX_JIT_MOP_ASYNC_FILLING;
+	systhread_mutex_unlock(st->mutex);
+
+	max_jit_mop_async_copyin(f,mop);
+
+	systhread_mutex_lock(st->mutex);
+	f->status = MAX_JIT_MOP_ASYNC_QUEUED;
+	systhread_cond_broadcast(st->cond);
+	systhread_mutex_unlock(st->mutex);
+
+	return true;
+}
+
+t_max_jit_mop_async_state *max_jit_mop_async_start(void *x)
+{
+	t_max_jit_mop_async_state *st;
+
+	if (!(st=(t_max_jit_mop_async_state *)sysmem_newptrclear(sizeof(t_max_jit_mop_async_state))))
+		return NULL;
+	st->owner = x;
+	st->clock = clock_new(x,(method)max_jit_mop_async_deliver);
+	systhread_mutex_new(&st->mutex,0);
+	systhread_cond_new(&st->cond,0);
+	if (systhread_create((method)max_jit_mop_async_threadproc,st,0,0,0,&st->thread)) {
+		jit_object_error((t_object *)x,"could not create async thread");
+		systhread_cond_free(st->cond);
+		systhread_mutex_free(st->mutex);
+		freeobject((t_object *)st->clock);
+		sysmem_freeptr(st);
+		return NULL;
+	}
+	return st;
+}
+
+// snapshot the inputs, scalar inputs included, and size the private outputs like the mop outputs
+void max_jit_mop_async_copyin(t_max_jit_mop_async_frame *f, void *mop)
+{
+	void *list,*src,*dst;
+	t_jit_matrix_info info;
+	long i,n;
+
+	if (!f->inputs)
+		f->inputs = jit_linklist_new();
+	if (!f->outputs)
+		f->outputs = jit_linklist_new();
+
+	list = jit_object_method(mop,_jit_sym_getinputlist);
+	n = jit_linklist_getsize(list);
+	for (i=0;i<n;i++) {
+		src = jit_linklist_getindex(list,i);
+		jit_object_method(src,_jit_sym_getinfo,&info);
+		if (dst=jit_linklist_getindex(f->inputs,i)) {
+			jit_object_method(dst,_jit_sym_setinfo,&info);
+		} else {
+			dst = jit_object_new(_jit_sym_jit_matrix,&info);
+			jit_linklist_append(f->inputs,dst);
+		}
+		jit_object_method(dst,_jit_sym_frommatrix,src,NULL);
+	}
+
+	list = jit_object_method(mop,_jit_sym_getoutputlist);
+	n = jit_linklist_getsize(list);
+	for (i=0;i<n;i++) {
+		src = jit_linklist_getindex(list,i);
+		jit_object_method(src,_jit_sym_getinfo,&info);
+		if (dst=jit_linklist_getindex(f->outputs,i)) {
+			jit_object_method(dst,_jit_sym_setinfo,&info);
+		} else {
+			dst = jit_object_new(_jit_sym_jit_matrix,&info);
+			jit_linklist_append(f->outputs,dst);
+		}
+	}
+}
+
+void *max_jit_mop_async_threadproc(t_max_jit_mop_async_state *st)
+{
+	t_max_jit_mop_async_frame *f;
+	t_jit_err err;
+
+	while (1) {
+		systhread_mutex_lock(st->mutex);
+		while (!st->quit&&st->frame[st->run].status!=MAX_JIT_MOP_ASYNC_QUEUED)
+			systhread_cond_wait(st->cond,st->mutex);
+		if (st->quit) {
+			systhread_mutex_unlock(st->mutex);
+			break;
+		}
+		f = &st->frame[st->run];
+		f->status = MAX_JIT_MOP_ASYNC_RUNNING;
+		st->run = (st->run + 1) % MAX_JIT_MOP_ASYNC_MAX_LATENCY;
+		systhread_mutex_unlock(st->mutex);
+
+		err = (t_jit_err) jit_object_method(max_jit_obex_jitob_get(st->owner),_jit_sym_matrix_calc,
+			f->inputs,f->outputs);
+
+		systhread_mutex_lock(st->mutex);
+		f->err = err;
+		f->status = MAX_JIT_MOP_ASYNC_DONE;
+		systhread_cond_broadcast(st->cond);
+		systhread_mutex_unlock(st->mutex);
+
+		clock_delay(st->clock,0);	// send it out on the next scheduler tick
+	}
+
+	systhread_exit(0);
+	return NULL;
+}
+
+// clock function: send out finished frames, oldest first
+void max_jit_mop_async_deliver(void *x)
+{
+	t_max_jit_mop_async_state *st = (t_max_jit_mop_async_state *)max_jit_mop_async_get(x)->state;
+	t_max_jit_mop_async_frame *f;
+	void *list;
+	long i,n;
+
+	if (!st)
+		return;
+
+	systhread_mutex_lock(st->mutex);
+	while (st->count&&st->frame[st->head].status==MAX_JIT_MOP_ASYNC_DONE) {
+		f = &st->frame[st->head];
+		systhread_mutex_unlock(st->mutex);
+
+		if (f->err) {
+			jit_error_code(x,f->err);
+		} else {
+			list = jit_object_method(st->mop,_jit_sym_getoutputlist);
+			n = jit_linklist_getsize(list);
+			for (i=0;i<n;i++)
+				jit_object_method(jit_linklist_getindex(list,i),_jit_sym_frommatrix,jit_linklist_getindex(f->outputs,i),NULL);
+			max_jit_mop_outputmatrix(x);
+		}
+
+		systhread_mutex_lock(st->mutex);
+		f->status = MAX_JIT_MOP_ASYNC_FREE;
+		st->head = (st->head + 1) % MAX_JIT_MOP_ASYNC_MAX_LATENCY;
+		st->count--;
+	}
+	systhread_mutex_unlock(st->mutex);
+}
+
+void max_jit_mop_async_flush(void *x, t_max_jit_mop_async_state *st)
+{
+	systhread_mutex_lock(st->mutex);
+	while (st->count) {
+		while (st->frame[st->head].status!=MAX_JIT_MOP_ASYNC_DONE)
+			systhread_cond_wait(st->cond,st->mutex);
+		systhread_mutex_unlock(st->mutex);
+		max_jit_mop_async_deliver(x);
+		systhread_mutex_lock(st->mutex);
+	}
+	systhread_mutex_unlock(st->mutex);
+}
+
+// call before max_jit_mop_free. frames still in flight are discarded.
+void max_jit_mop_async_free(void *x)
+{
+	t_max_jit_mop_async *a = max_jit_mop_async_get(x);
+	t_max_jit_mop_async_state *st = (t_max_jit_mop_async_state *)a->state;
+	unsigned int ret;
+	long i;
+
+	if (!st)
+		return;
+
+	systhread_mutex_lock(st->mutex);
+	st->quit = true;
+	systhread_cond_broadcast(st->cond);
+	systhread_mutex_unlock(st->mutex);
+	systhread_join(st->thread,&ret);
+
+	freeobject((t_object *)st->clock);
+	for (i=0;i<MAX_JIT_MOP_ASYNC_MAX_LATENCY;i++) {
+		if (st->frame[i].inputs)
+			jit_object_free(st->frame[i].inputs);
+		if (st->frame[i].outputs)
+			jit_object_free(st->frame[i].outputs);
+	}
+	systhread_cond_free(st->cond);
+	systhread_mutex_free(st->mutex);
+	sysmem_freeptr(st);
+	a->state = NULL;
+}
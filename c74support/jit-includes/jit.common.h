@@ -46,6 +46,7 @@
 #define JIT_MATRIX_DATA_HANDLE		0x00000002	///< data is handle                                                   @ingroup jitter
 #define JIT_MATRIX_DATA_REFERENCE	0x00000004 	///< data is reference to outside memory                              @ingroup jitter
 #define JIT_MATRIX_DATA_PACK_TIGHT	0x00000008 	///< data is tightly packed (doesn't use standard 16 byte alignment)  @ingroup jitter
+#define JIT_MATRIX_DATA_PLANAR		0x00000010 	///< planes are stored one after another (see jit_planar_plane)       @ingroup jitter
 #define JIT_MATRIX_DATA_FLAGS_USE	0x00008000 	/**< necessary if using handle/reference data flags when creating     @ingroup jitter
 												 * jit_matrix, however, it is never stored in matrix */ 
                                                                                                         
@@ -217,6 +218,19 @@ long jit_atom_arg_getsym(t_symbol **c, long idx, long ac, t_atom *av);
 t_jit_err jit_matrix_info_default(t_jit_matrix_info *info);
 long jit_matrix_info_typesize(t_jit_matrix_info *minfo); 
 
+//planar layout (JIT_MATRIX_DATA_PLANAR, see common/jit.planar.c). jit_matrix only allocates interleaved
+//cells, so planar data is reference data. each plane is laid out like a 1 plane matrix with the same dim
+//and dimstride, and plane p starts p*dimstride[dimcount-1]*dim[dimcount-1] bytes after the data pointer.
+//jit_planar_plane describes one plane of either layout as a matrix that calculate_ndim functions can walk
+//with j%planecount == 0. the converters move n cells between a row of interleaved cells and planecount
+//plane rows. NULL plane pointers are skipped
+void jit_planar_plane(t_jit_matrix_info *minfo, char *bp, long plane, t_jit_matrix_info *plane_minfo, char **plane_bp);
+void jit_planar_deinterleave(long n, long planecount, long typesize, char *ip, char **op);
+void jit_planar_interleave(long n, long planecount, long typesize, char **ip, char *op);
+
+//cache blocked transpose of whole cells: output cell (r,c) = input cell (c,r) (see common/jit.transpose.simd.c)
+void jit_transpose_simd_cells(long rows, long cols, long cellsize, char *ip, long istride, char *op, long ostride);
+
 //mop utils
 t_jit_err jit_mop_single_type(void *x, t_symbol *s);
 t_jit_err jit_mop_single_planecount(void *x, long c);
@@ -46,6 +46,19 @@ t_jit_op_fn jit_op_sym2fn(t_symbol *opsym, t_symbol *type);
 t_jit_op_fn_object *jit_op_fn_lookup(t_symbol *opsym);
 t_jit_err jit_op_fn_store(t_symbol *opsym, t_jit_op_fn_object *x);
 
+//sse2/avx2/neon versions of the vector operators, where the library only has altivec ones.
+//jit_op_simd_sym2fn returns NULL for operators it doesn't vectorize (see common/jit.op.simd.c)
+#define JIT_OP_SIMD_NONE	0
+#define JIT_OP_SIMD_SSE2	1
+#define JIT_OP_SIMD_AVX2	2
+#define JIT_OP_SIMD_NEON	3
+
+long jit_op_simd_init(void);
+long jit_op_simd_capability(void);
+t_jit_op_fn jit_op_simd_sym2fn(t_symbol *opsym, t_symbol *type);
+//polynomial versions of the float transcendental ops, for the precision attribute's fast mode
+t_jit_op_fn jit_op_simd_math_sym2fn(t_symbol *opsym, t_symbol *type);
+
 //note vecdata is unused by the following functions.
 
 //arith
@@ -31,6 +31,23 @@
 
 //outputmode: 0=no output, 1=calc, 2=input(no calc), 3=output(no calc)
 
+#define MAX_JIT_MOP_ASYNC_MAX_LATENCY			8                     ///< most frames an async mop keeps in flight @ingroup jitter
+
+/** 
+	Async matrix_calc state, embedded in the max wrapper struct (see max.jit.mop.async.c). 
+	With the async attribute on, frames are calculated on a background thread into private 
+	output matrices and sent out on a later scheduler tick, with up to latency frames in flight.
+	Inputs are copied with each frame. Attributes of the jitter object are not, so they apply 
+	to whichever frame is running.
+	@ingroup jitter
+*/
+typedef struct _max_jit_mop_async
+{
+	char			async;		///< async attribute
+	long			latency;	///< latency attribute, frames in flight
+	void			*state;		///< private, NULL until the first async frame
+} t_max_jit_mop_async;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -77,6 +94,15 @@ t_jit_err max_jit_mop_variable_addinputs(void *x, long c);
 t_jit_err max_jit_mop_variable_addoutputs(void *x, long c);
 
 t_jit_err max_jit_mop_setup_simple(void *x, void *o, long argc, t_atom *argv);
+
+// async matrix_calc (max.jit.mop.async.c). offset is calcoffset() of the t_max_jit_mop_async member.
+// max_jit_classex_mop_async adds the async and latency attributes and an mproc which calls 
+// max_jit_mop_async_calc. classes with a custom mproc install it afterwards, call 
+// max_jit_mop_async_calc themselves and skip their own calc when it returns true.
+t_jit_err max_jit_classex_mop_async(void *mclass, void *jclass, long offset);
+void max_jit_mop_async_init(void *x);
+long max_jit_mop_async_calc(void *x, void *mop);
+void max_jit_mop_async_free(void *x);
 /* max_jit_mop_setup_simple is equivalent to :
 
 	max_jit_obex_jitob_set(x,o);
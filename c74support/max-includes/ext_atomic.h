@@ -14,6 +14,10 @@ typedef volatile int32_t t_int32_atomic;
 #define ATOMIC_DECREMENT(pv) OSAtomicDecrement32((int32_t *)pv)
 #define ATOMIC_DECREMENT_BARRIER(pv) OSAtomicDecrement32Barrier((int32_t *)pv)
 
+#define ATOMIC_COMPARE_SWAP32(oldvalue, newvalue, pv) OSAtomicCompareAndSwap32Barrier((int32_t)(oldvalue), (int32_t)(newvalue), (int32_t *)pv)
+
+#define ATOMIC_BARRIER() OSMemoryBarrier()
+
 #else // WIN_VERSION
 
 #include <intrin.h>
@@ -21,6 +25,7 @@ typedef volatile long t_int32_atomic;
 
 #pragma intrinsic (_InterlockedIncrement)
 #pragma intrinsic (_InterlockedDecrement)
+#pragma intrinsic (_InterlockedCompareExchange)
 
 /**	Use this routine for incrementing a global counter using a threadsafe and multiprocessor safe method.
 	@ingroup	threading
@@ -41,6 +46,22 @@ typedef volatile long t_int32_atomic;
 #define ATOMIC_DECREMENT(pv)			  (_InterlockedDecrement(pv))
 #define ATOMIC_DECREMENT_BARRIER(pv)      (_InterlockedDecrement(pv))
 
+
+/**	Use this routine to set a 32 bit value, only if it still holds an expected value, using a threadsafe and multiprocessor safe method.
+	@ingroup	threading
+	@param	oldvalue	the value expected.
+	@param	newvalue	the value to store.
+	@param	pv			pointer to the (int) value.
+	@return				non-zero if the value was stored.
+*/
+#define ATOMIC_COMPARE_SWAP32(oldvalue, newvalue, pv) (_InterlockedCompareExchange((pv), (newvalue), (oldvalue))==(oldvalue))
+
+
+/**	Use this routine to order memory accesses, for example before reading data published by another thread.
+	@ingroup	threading
+*/
+#define ATOMIC_BARRIER()				  MemoryBarrier()
+
 #endif // WIN_VERSION
 
 
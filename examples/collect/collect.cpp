@@ -1,8 +1,9 @@
 /**
 	@file
 	collect - collect numbers and operate on them.
-			- demonstrates use of C++ and the STL in a Max external
-			- also demonstrates use of a mutex for thread safety
+			- demonstrates use of C++ in a Max external
+			- also demonstrates a lock-free buffer which many threads may push into at once
+			- up to 1M values are collected between bangs, any more are dropped with a warning
 			- on Windows, demonstrate project setup for static linking to the Microsoft Runtime
 
 	@ingroup	examples
@@ -16,9 +17,7 @@
 #include "ext_strings.h"
 #include "ext_common.h"
 #include "ext_systhread.h"
-
-#include <vector>
-using namespace std;
+#include "ext_atomic.h"
 
 // a wrapper for cpost() only called for debug builds on Windows
 // to see these console posts, run the DbgView program (part of the SysInternals package distributed by Microsoft)
@@ -37,36 +36,168 @@ using namespace std;
 	#define T_EXPORT __attribute__((visibility("default")))
 #endif
 
-// a c++ class representing a number, and types for a vector of those numbers
-class number {
+#define COLLECT_CHUNK_SIZE		1024	// values per chunk
+#define COLLECT_MAX_CHUNKS		1024	// chunks per buffer, so up to 1M values may be collected between bangs
+
+
+// a c++ class representing an append-only buffer of numbers, stored in fixed size chunks.
+// any number of threads may append at once: each one claims a slot with a compare and swap,
+// and the chunks are never moved, so nobody has to lock. chunks are kept when the buffer
+// is reset, so once a buffer has grown to its working size appending never allocates.
+class collectBuffer {
 	private:
-		double value;
+		double * volatile	chunk[COLLECT_MAX_CHUNKS];
+		t_int32_atomic		count;		// slots claimed, never past the capacity
+		t_int32_atomic		overflow;	// values dropped because the buffer was full
+
+		static double		failed[1];	// marks a chunk which could not be allocated
+
 	public:
-		number(double& newValue)
+		t_int32_atomic		writers;	// threads currently appending, see collect_push()
+
+		collectBuffer()
 		{
-			value = newValue;
+			long i;
+			for (i=0; i<COLLECT_MAX_CHUNKS; i++)
+				chunk[i] = NULL;
+			count = 0;
+			overflow = 0;
+			writers = 0;
 		}
 
-		void setValue(const double& newValue)
+		~collectBuffer()
 		{
-			value = newValue;
+			long i;
+			for (i=0; i<COLLECT_MAX_CHUNKS; i++) {
+				if (chunk[i] && chunk[i] != failed)
+					sysmem_freeptr(chunk[i]);
+			}
 		}
 
-		void getValue(double& retrievedValue)
+		// increments *pv unless it has reached limit, returns the old value or -1 if it had.
+		// a plain atomic increment would keep counting once the buffer is full and wrap after 2^31 pushes
+		static long claim(t_int32_atomic *pv, long limit)
 		{
-			retrievedValue = value;
+			long n;
+
+			do {
+				n = *pv;
+				if (n >= limit)
+					return -1;
+			} while (!ATOMIC_COMPARE_SWAP32(n, n + 1, pv));
+			return n;
+		}
+
+		void append(const double& value)
+		{
+			long index = claim(&count, COLLECT_CHUNK_SIZE * COLLECT_MAX_CHUNKS);
+			long c;
+			double *values;
+
+			if (index < 0) {
+				claim(&overflow, 0x7fffffff);	// full, counted as dropped
+				return;
+			}
+			c = index / COLLECT_CHUNK_SIZE;
+			values = chunk[c];
+			if (!values) {
+				// whoever claims the first slot of a chunk allocates it, the rest of that
+				// chunk's writers wait the few moments it takes for the pointer to appear
+				if (index % COLLECT_CHUNK_SIZE == 0) {
+					values = (double *)sysmem_newptr(COLLECT_CHUNK_SIZE * sizeof(double));
+					if (!values)
+						values = failed;
+					ATOMIC_BARRIER();
+					chunk[c] = values;
+				}
+				else {
+					while (!(values = chunk[c]))
+						systhread_sleep(0);
+				}
+			}
+			if (values != failed)
+				values[index % COLLECT_CHUNK_SIZE] = value;
+		}
+
+		// the following may only be called while no thread is appending
+
+		// slots claimed, including any in chunks which could not be allocated
+		long size()
+		{
+			return count;
+		}
+
+		// values written to chunks which could not be allocated
+		long lost()
+		{
+			long n = size();
+			long c, len;
+			long ac = 0;
+
+			for (c=0; n > 0; c++, n -= len) {
+				len = n < COLLECT_CHUNK_SIZE ? n : COLLECT_CHUNK_SIZE;
+				if (chunk[c] == failed)
+					ac += len;
+			}
+			return ac;
+		}
+
+		// values getAtoms() will return
+		long stored()
+		{
+			return size() - lost();
+		}
+
+		// values past the capacity, or lost to a failed allocation
+		long dropped()
+		{
+			long n = lost();
+			return overflow < 0x7fffffff - n ? overflow + n : 0x7fffffff;
+		}
+
+		// convert the contents to atoms in one pass over each chunk, returns the number written
+		long getAtoms(t_atom *av)
+		{
+			long n = size();
+			long c, i, len;
+			long ac = 0;
+			double *values;
+
+			for (c=0; n > 0; c++, n -= len) {
+				len = n < COLLECT_CHUNK_SIZE ? n : COLLECT_CHUNK_SIZE;
+				values = chunk[c];
+				if (values == failed)
+					continue;
+				for (i=0; i<len; i++)
+					atom_setfloat(av+ac+i, values[i]);
+				ac += len;
+			}
+			return ac;
+		}
+
+		void reset()
+		{
+			long c;
+			for (c=0; c<COLLECT_MAX_CHUNKS; c++) {
+				if (chunk[c] == failed)
+					chunk[c] = NULL;	// try again next time
+			}
+			count = 0;
+			overflow = 0;
 		}
 };
-typedef std::vector<number>		numberVector;
-typedef numberVector::iterator	numberIterator;
+double collectBuffer::failed[1];
 
 
 // max object instance data
 typedef struct _collect {
 	t_object			c_box;
-	numberVector		*c_vector;	// note: you must store this as a pointer and not directly as a member of the object's struct
+	collectBuffer		*c_buffer[2];	// note: you must store these as pointers and not directly as members of the object's struct
+	t_int32_atomic		c_active;		// index of the buffer being appended to
+	t_atom				*c_arena;		// reused for the output of each bang
+	long				c_arenasize;
 	void				*c_outlet;
-	t_systhread_mutex	c_mutex;
+	t_systhread_mutex	c_mutex;		// serializes bang and clear, never taken while appending
 } t_collect;
 
 
@@ -80,6 +211,11 @@ void	collect_int(t_collect *x, long value);
 void	collect_float(t_collect *x, double value);
 void	collect_list(t_collect *x, t_symbol *msg, long argc, t_atom *argv);
 void	collect_clear(t_collect *x);
+void	collect_bench(t_collect *x, double seconds);
+void	collect_push(t_collect *x, double value);
+collectBuffer*	collect_swap(t_collect *x);
+long	collect_drain(t_collect *x, t_atom **av);
+void	collect_release(t_collect *x, t_atom *av);
 
 
 // globals
@@ -105,6 +241,7 @@ int T_EXPORT main(void)
 	class_addmethod(c, (method)collect_list,	"list",			A_GIMME,0);
 	class_addmethod(c, (method)collect_clear,	"clear",		0);
 	class_addmethod(c, (method)collect_count,	"count",		0);
+	class_addmethod(c, (method)collect_bench,	"bench",		A_DEFFLOAT, 0);
 	class_addmethod(c, (method)collect_assist,	"assist",		A_CANT, 0);
 	class_addmethod(c, (method)stdinletinfo,	"inletinfo",	A_CANT, 0);
 
@@ -126,8 +263,11 @@ void *collect_new(t_symbol *s, long argc, t_atom *argv)
 	if (x) {
 		systhread_mutex_new(&x->c_mutex, 0);
 		x->c_outlet = outlet_new(x, NULL);
-		x->c_vector = new numberVector;
-		x->c_vector->reserve(10);
+		x->c_buffer[0] = new collectBuffer;
+		x->c_buffer[1] = new collectBuffer;
+		x->c_active = 0;
+		x->c_arena = NULL;
+		x->c_arenasize = 0;
 		collect_list(x, _sym_list, argc, argv);
 	}
 	return(x);
@@ -137,7 +277,109 @@ void *collect_new(t_symbol *s, long argc, t_atom *argv)
 void collect_free(t_collect *x)
 {
 	systhread_mutex_free(x->c_mutex);
-	delete x->c_vector;
+	delete x->c_buffer[0];
+	delete x->c_buffer[1];
+	if (x->c_arena)
+		sysmem_freeptr(x->c_arena);
+}
+
+
+/************************************************************************************/
+// Lock-free appending
+
+// pushes come from any thread. a push announces itself on the active buffer's writer count,
+// and then checks that the buffer is still the active one. bang swaps the active buffer
+// before waiting for the old one's writers to leave, so either the push sees the swap and
+// moves over to the new buffer, or bang sees the push and waits for it to finish.
+void collect_push(t_collect *x, double value)
+{
+	collectBuffer	*buffer;
+	long			active;
+
+	for (;;) {
+		active = x->c_active;
+		buffer = x->c_buffer[active];
+		ATOMIC_INCREMENT_BARRIER(&buffer->writers);
+		if (x->c_active == active)
+			break;
+		ATOMIC_DECREMENT_BARRIER(&buffer->writers);
+	}
+	buffer->append(value);
+	ATOMIC_DECREMENT_BARRIER(&buffer->writers);
+}
+
+
+// must be called with c_mutex held. returns the previously active buffer, which nobody
+// is appending to anymore and which the caller should reset when done reading
+collectBuffer *collect_swap(t_collect *x)
+{
+	long			active = x->c_active;
+	collectBuffer	*buffer = x->c_buffer[active];
+
+	ATOMIC_COMPARE_SWAP32(active, !active, &x->c_active);
+	while (buffer->writers)
+		systhread_sleep(0);	// writers are only inside collect_push() for a handful of instructions
+	ATOMIC_BARRIER();
+	return buffer;
+}
+
+
+// swap out the collected values and convert them to atoms in the arena, which is handed
+// over to the caller until collect_release() so that a bang from downstream of our outlet
+// can't overwrite it while it is being output
+long collect_drain(t_collect *x, t_atom **av)
+{
+	collectBuffer	*buffer;
+	long			ac = 0;
+	long			size;
+
+	*av = NULL;
+	systhread_mutex_lock(x->c_mutex);
+	buffer = collect_swap(x);
+	size = buffer->stored();
+	DPOST("size=%ld\n", size);
+	if (size > x->c_arenasize) {
+		// grow in whole chunks so that slowly increasing input doesn't resize on every bang
+		long newsize = (size + COLLECT_CHUNK_SIZE - 1) / COLLECT_CHUNK_SIZE * COLLECT_CHUNK_SIZE;
+		t_atom *arena;
+
+		if (x->c_arena)
+			arena = (t_atom *)sysmem_resizeptr(x->c_arena, newsize * sizeof(t_atom));
+		else
+			arena = (t_atom *)sysmem_newptr(newsize * sizeof(t_atom));
+		if (arena) {
+			x->c_arena = arena;
+			x->c_arenasize = newsize;
+		}
+	}
+	if (size && size <= x->c_arenasize) {
+		ac = buffer->getAtoms(x->c_arena);
+		*av = x->c_arena;
+		x->c_arena = NULL;
+		x->c_arenasize = 0;
+	}
+	if (buffer->dropped())
+		object_warn((t_object *)x, "dropped %ld values, more than %ld were collected between bangs or memory ran out",
+					buffer->dropped(), (long)(COLLECT_CHUNK_SIZE * COLLECT_MAX_CHUNKS));
+	buffer->reset();
+	systhread_mutex_unlock(x->c_mutex);
+	return ac;
+}
+
+
+void collect_release(t_collect *x, t_atom *av)
+{
+	if (!av)
+		return;
+	systhread_mutex_lock(x->c_mutex);
+	if (!x->c_arena) {
+		x->c_arena = av;
+		x->c_arenasize = sysmem_ptrsize(av) / sizeof(t_atom);
+		av = NULL;
+	}
+	systhread_mutex_unlock(x->c_mutex);
+	if (av)
+		sysmem_freeptr(av);	// a nested bang made another arena in the meantime
 }
 
 
@@ -155,61 +397,39 @@ void collect_assist(t_collect *x, void *b, long msg, long arg, char *dst)
 
 void collect_bang(t_collect *x)
 {
-	numberIterator iter, begin, end;
-	int i = 0;
 	long ac = 0;
 	t_atom *av = NULL;
-	double value;
 
 	DPOST("head\n");
-	systhread_mutex_lock(x->c_mutex);
-	ac = x->c_vector->size();
+	ac = collect_drain(x, &av);
 
 	DPOST("ac=%ld\n", ac);
 	if (ac)
-		av = new t_atom[ac];
-
-	if (ac && av) {
-		DPOST("assigning begin and end\n");
-		begin = x->c_vector->begin();
-		end = x->c_vector->end();
-
-		DPOST("assigning iter\n");
-		iter = begin;
+		outlet_anything(x->c_outlet, _sym_list, ac, av); // don't want to call outlets in mutexes
 
-		DPOST("entering for\n", ac);
-		for (;;) {
-			DPOST("i=%i\n", i);
-			(*iter).getValue(value);
-			atom_setfloat(av+i, value);
-
-			DPOST("incrementing\n");
-			i++;
-			iter++;
-
-			DPOST("comparing\n");
-			if (iter == end)
-				break;
-		}
-		systhread_mutex_unlock(x->c_mutex);	// must unlock before calling _clear() or we will deadlock
-
-		DPOST("about to clear\n", ac);
-		collect_clear(x);
-
-		DPOST("about to outlet\n", ac);
-		outlet_anything(x->c_outlet, _sym_list, ac, av); // don't want to call outlets in mutexes either
-
-		DPOST("about to delete\n", ac);
-		delete[] av;
-	}
-	else
-		systhread_mutex_unlock(x->c_mutex);
+	collect_release(x, av);
 }
 
 
+// the same handshake as collect_swap(), without swapping. a push raises the writer count
+// before it claims a slot, so if no writer is inside the buffer after the count is read,
+// every slot it counted has been written
 void collect_count(t_collect *x)
 {
-	outlet_int(x->c_outlet, x->c_vector->size());
+	collectBuffer	*buffer;
+	long			n;
+
+	systhread_mutex_lock(x->c_mutex);
+	buffer = x->c_buffer[x->c_active];
+	for (;;) {
+		n = buffer->stored();
+		ATOMIC_BARRIER();
+		if (!buffer->writers)
+			break;
+		systhread_sleep(0);
+	}
+	systhread_mutex_unlock(x->c_mutex);
+	outlet_int(x->c_outlet, n);
 }
 
 
@@ -221,27 +441,109 @@ void collect_int(t_collect *x, long value)
 
 void collect_float(t_collect *x, double value)
 {
-	systhread_mutex_lock(x->c_mutex);
-	x->c_vector->push_back(value);
-	systhread_mutex_unlock(x->c_mutex);
+	collect_push(x, value);
 }
 
 
 void collect_list(t_collect *x, t_symbol *msg, long argc, t_atom *argv)
 {
-	systhread_mutex_lock(x->c_mutex);
-	for (int i=0; i<argc; i++) {
-		double value = atom_getfloat(argv+i);
-		x->c_vector->push_back(value);
-	}
-	systhread_mutex_unlock(x->c_mutex);
+	for (int i=0; i<argc; i++)
+		collect_push(x, atom_getfloat(argv+i));
 }
 
 
 void collect_clear(t_collect *x)
 {
 	systhread_mutex_lock(x->c_mutex);
-	x->c_vector->clear();
+	collect_swap(x)->reset();
 	systhread_mutex_unlock(x->c_mutex);
 }
 
+
+/************************************************************************************/
+// Benchmark
+
+typedef struct _collect_bench {
+	t_collect		*x;
+	double			seconds;
+	long			pushes;
+	double			pushtime;		// total time spent inside collect_push()
+	double			maxbatch;		// longest time for one batch of pushes
+	t_int32_atomic	done;
+} t_collect_bench;
+
+#define COLLECT_BENCH_BATCH		1000	// pushes per millisecond, or 1M pushes per second
+
+
+void *collect_benchthread(t_collect_bench *b)
+{
+	double start = systimer_gettime();
+	double next = start;
+	double t, elapsed;
+	long i;
+
+	while (next - start < b->seconds * 1000.) {
+		while (systimer_gettime() < next)
+			;
+		t = systimer_gettime();
+		for (i=0; i<COLLECT_BENCH_BATCH; i++)
+			collect_push(b->x, b->pushes + i);
+		elapsed = systimer_gettime() - t;
+		b->pushes += COLLECT_BENCH_BATCH;
+		b->pushtime += elapsed;
+		if (elapsed > b->maxbatch)
+			b->maxbatch = elapsed;
+		next += 1.;
+	}
+	ATOMIC_INCREMENT_BARRIER(&b->done);
+	systhread_exit(0);
+	return NULL;
+}
+
+
+// push 1M values per second from a second thread while this thread drains the buffer
+// every few milliseconds, the same way a metro banging the object would
+void collect_bench(t_collect *x, double seconds)
+{
+	t_collect_bench	b;
+	t_systhread		thread = NULL;
+	unsigned int	ret;
+	long			drains = 0, collected = 0, ac;
+	double			t, elapsed, draintime = 0, maxdrain = 0;
+	t_atom			*av;
+
+	if (seconds <= 0)
+		seconds = 1.;
+	collect_clear(x);
+	b.x = x;
+	b.seconds = seconds;
+	b.pushes = 0;
+	b.pushtime = 0;
+	b.maxbatch = 0;
+	b.done = 0;
+	if (systhread_create((method)collect_benchthread, &b, 0, 0, 0, &thread)) {
+		object_error((t_object *)x, "bench thread could not be created");
+		return;
+	}
+	do {
+		systhread_sleep(5);
+		t = systimer_gettime();
+		ac = collect_drain(x, &av);
+		collect_release(x, av);
+		elapsed = systimer_gettime() - t;
+		collected += ac;
+		draintime += elapsed;
+		if (elapsed > maxdrain)
+			maxdrain = elapsed;
+		drains++;
+	} while (!b.done);
+	systhread_join(thread, &ret);
+	ac = collect_drain(x, &av);
+	collect_release(x, av);
+	collected += ac;
+
+	post("collect bench: %ld pushes in %f s, %f ns per push, max %f ms per %ld pushes",
+		 b.pushes, seconds, b.pushes ? b.pushtime * 1000000. / b.pushes : 0., b.maxbatch, (long)COLLECT_BENCH_BATCH);
+	post("collect bench: %ld drains, mean %f ms max %f ms, %ld of %ld values collected",
+		 drains, draintime / drains, maxdrain, collected, b.pushes);
+}
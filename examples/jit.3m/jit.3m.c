@@ -4,33 +4,36 @@
 */
 
 #include "jit.common.h"
-#include "ext_systhread.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIT_3M_SSE2		1
+#include <emmintrin.h>
+#endif
+
+//vectors summed in 16 bit (char) or float (float32) lanes before they are added to doubles
+#define JIT_3M_BLOCK	64
 
 typedef struct _jit_3m_vecdata_char
 {
 	long				min[JIT_MATRIX_MAX_PLANECOUNT];
-	long 				mean[JIT_MATRIX_MAX_PLANECOUNT];
 	long 				max[JIT_MATRIX_MAX_PLANECOUNT];
 } t_jit_3m_vecdata_char;
 
 typedef struct _jit_3m_vecdata_long
 {
 	long				min[JIT_MATRIX_MAX_PLANECOUNT];
-	double 				mean[JIT_MATRIX_MAX_PLANECOUNT];
 	long				max[JIT_MATRIX_MAX_PLANECOUNT];
 } t_jit_3m_vecdata_long;
 
 typedef struct _jit_3m_vecdata_float32
 {
 	float				min[JIT_MATRIX_MAX_PLANECOUNT];
-	float 				mean[JIT_MATRIX_MAX_PLANECOUNT];
 	float				max[JIT_MATRIX_MAX_PLANECOUNT];
 } t_jit_3m_vecdata_float32;
 
 typedef struct _jit_3m_vecdata_float64
 {
 	double				min[JIT_MATRIX_MAX_PLANECOUNT];
-	double 				mean[JIT_MATRIX_MAX_PLANECOUNT];
 	double				max[JIT_MATRIX_MAX_PLANECOUNT];
 } t_jit_3m_vecdata_float64;
 
@@ -40,6 +43,10 @@ typedef struct _jit_3m_vecdata
 	t_jit_3m_vecdata_long 		v_long;
 	t_jit_3m_vecdata_float32 	v_float32;
 	t_jit_3m_vecdata_float64 	v_float64;
+	//cells so far, and for each plane their mean and sum of squared differences from it
+	double						count;
+	double						mean[JIT_MATRIX_MAX_PLANECOUNT];
+	double						m2[JIT_MATRIX_MAX_PLANECOUNT];
 } t_jit_3m_vecdata;
 
 typedef struct _jit_3m 
@@ -49,10 +56,18 @@ typedef struct _jit_3m
 	t_atom		min[JIT_MATRIX_MAX_PLANECOUNT];
 	t_atom		mean[JIT_MATRIX_MAX_PLANECOUNT];
 	t_atom		max[JIT_MATRIX_MAX_PLANECOUNT];
+	t_atom		variance[JIT_MATRIX_MAX_PLANECOUNT];
+	t_atom		stddev[JIT_MATRIX_MAX_PLANECOUNT];
 	t_jit_3m_vecdata vd;
-	t_systhread_mutex mutex;
 } t_jit_3m;
 
+//shared by the reduction callbacks
+typedef struct _jit_3m_reduce
+{
+	t_jit_matrix_info	*minfo;
+	char				*bp;
+} t_jit_3m_reduce;
+
 t_jit_err jit_3m_init(void); 
 t_jit_err jit_3m_matrix_calc(t_jit_3m *x, void *inputs, void *outputs);
 
@@ -62,13 +77,24 @@ t_jit_3m *jit_3m_new(void);
 void jit_3m_free(t_jit_3m *x);
 void jit_3m_precalc(t_jit_3m_vecdata *vecdata, t_jit_matrix_info *in1_minfo, char *bip1); 
 void jit_3m_postcalc(t_jit_3m *x, t_jit_3m_vecdata *vecdata, t_jit_matrix_info *in1_minfo); 
-void jit_3m_mean(t_jit_3m_vecdata *vecdata, t_jit_matrix_info *in1_minfo); 
-void jit_3m_calculate_ndim(t_jit_3m *x, long dimcount, long *dim, long planecount, 
+void jit_3m_merge(double count, double *mean, double *m2, double n, double nmean, double nm2);
+void jit_3m_reduce_init(t_jit_3m_reduce *r, t_jit_3m_vecdata *vecdata);
+void jit_3m_reduce_accumulate(t_jit_3m_reduce *r, t_jit_3m_vecdata *vecdata, long offset, long dimcount, long *dim, 
+	long planecount, t_jit_matrix_info *in1_minfo, char *bip1);
+void jit_3m_reduce_combine(t_jit_3m_reduce *r, t_jit_3m_vecdata *result, t_jit_3m_vecdata *vecdata);
+void jit_3m_calculate_ndim(t_jit_3m_vecdata *vecdata, long dimcount, long *dim, long planecount, 
 	t_jit_matrix_info *in1_minfo, char *bip1);
-void jit_3m_vector_char(long n, t_jit_op_info *in1, long *min, long *mean, long *max); 
-void jit_3m_vector_long(long n, t_jit_op_info *in1, long *min, double *mean, long *max);
-void jit_3m_vector_float32(long n, t_jit_op_info *in1, float *min, float *mean, float *max);
-void jit_3m_vector_float64(long n, t_jit_op_info *in1, double *min, double *mean, double *max);;
+void jit_3m_vector_char(long n, t_jit_op_info *in1, long *min, long *max, double *mean, double *m2); 
+void jit_3m_vector_long(long n, t_jit_op_info *in1, long *min, long *max, double *mean, double *m2);
+void jit_3m_vector_float32(long n, t_jit_op_info *in1, float *min, float *max, double *mean, double *m2);
+void jit_3m_vector_float64(long n, t_jit_op_info *in1, double *min, double *max, double *mean, double *m2);
+#if JIT_3M_SSE2
+void jit_3m_vector_lanes(long lanes, long n, long planecount, double *shift, double *s, double *q, double *mean, double *m2);
+void jit_3m_vector_char_sse2(long n, long planecount, uchar *ip, long *min, long *max, double *mean, double *m2); 
+void jit_3m_vector_long_sse2(long n, long planecount, long *ip, long *min, long *max, double *mean, double *m2);
+void jit_3m_vector_float32_sse2(long n, long planecount, float *ip, float *min, float *max, double *mean, double *m2);
+void jit_3m_vector_float64_sse2(long n, long planecount, double *ip, double *min, double *max, double *mean, double *m2);
+#endif
 
 t_jit_err jit_3m_init(void) 
 {
@@ -94,6 +120,13 @@ t_jit_err jit_3m_init(void)
 	attr = jit_object_new(_jit_sym_jit_attr_offset_array,"max",_jit_sym_atom,JIT_MATRIX_MAX_PLANECOUNT,attrflags,
 		(method)0L,(method)0L,calcoffset(t_jit_3m,planecount),calcoffset(t_jit_3m,max));
 	jit_class_addattr(_jit_3m_class,attr);
+	//population variance and standard deviation
+	attr = jit_object_new(_jit_sym_jit_attr_offset_array,"variance",_jit_sym_atom,JIT_MATRIX_MAX_PLANECOUNT,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_3m,planecount),calcoffset(t_jit_3m,variance));
+	jit_class_addattr(_jit_3m_class,attr);
+	attr = jit_object_new(_jit_sym_jit_attr_offset_array,"stddev",_jit_sym_atom,JIT_MATRIX_MAX_PLANECOUNT,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_3m,planecount),calcoffset(t_jit_3m,stddev));
+	jit_class_addattr(_jit_3m_class,attr);
 	
 	jit_class_register(_jit_3m_class);
 
@@ -108,6 +141,8 @@ t_jit_err jit_3m_matrix_calc(t_jit_3m *x, void *inputs, void *outputs)
 	char *in_bp;
 	long i,dimcount,dim[JIT_MATRIX_MAX_DIMCOUNT];
 	void *in_matrix;
+	t_jit_3m_reduce r;
+	t_jit_parallel_ndim_reduce reduce;
 	
 	in_matrix 	= jit_object_method(inputs,_jit_sym_getindex,0);
 
@@ -126,12 +161,18 @@ t_jit_err jit_3m_matrix_calc(t_jit_3m *x, void *inputs, void *outputs)
 			dim[i] = in_minfo.dim[i];
 		}		
 		
-		//calculate
+		//calculate. every worker gathers min/max and the mean and sum of squared differences 
+		//for its own rows, which are combined into x->vd once all of them are done
+		r.minfo = &in_minfo;
+		r.bp = in_bp;
+		reduce.data = &r;
+		reduce.statesize = sizeof(t_jit_3m_vecdata);
+		reduce.init = (method)jit_3m_reduce_init;
+		reduce.accumulate = (method)jit_3m_reduce_accumulate;
+		reduce.combine = (method)jit_3m_reduce_combine;
 		jit_3m_precalc(&x->vd, &in_minfo, in_bp);
-		jit_parallel_ndim_simplecalc1((method)jit_3m_calculate_ndim, 
-			x, dimcount, dim, in_minfo.planecount, &in_minfo, in_bp,
+		jit_parallel_ndim_reduce1(&reduce, &x->vd, dimcount, dim, in_minfo.planecount, &in_minfo, in_bp,
 			0 /* flags1 */);
-		jit_3m_mean(&x->vd, &in_minfo);
 		jit_3m_postcalc(x, &x->vd, &in_minfo);
 		
 	} else {
@@ -147,29 +188,30 @@ void jit_3m_precalc(t_jit_3m_vecdata *vecdata, t_jit_matrix_info *in1_minfo, cha
 {
 	long i;
 	
+	vecdata->count = 0;
+	for (i=0;i<in1_minfo->planecount;i++) {
+		vecdata->mean[i] = 0;
+		vecdata->m2[i] = 0;
+	}
 	if (in1_minfo->type==_jit_sym_char) {
 		for (i=0;i<in1_minfo->planecount;i++) {
 			vecdata->v_char.min[i]  = ((uchar *)bip1)[i];
 			vecdata->v_char.max[i]  = ((uchar *)bip1)[i];
-			vecdata->v_char.mean[i] = 0;
 		}
 	} else if (in1_minfo->type==_jit_sym_long) {
 		for (i=0;i<in1_minfo->planecount;i++) {
 			vecdata->v_long.min[i]  = ((long *)bip1)[i];
 			vecdata->v_long.max[i]  = ((long *)bip1)[i];
-			vecdata->v_long.mean[i] = 0;
 		}
 	} else if (in1_minfo->type==_jit_sym_float32) {
 		for (i=0;i<in1_minfo->planecount;i++) {
 			vecdata->v_float32.min[i]  = ((float *)bip1)[i];
 			vecdata->v_float32.max[i]  = ((float *)bip1)[i];
-			vecdata->v_float32.mean[i] = 0;
 		}
 	} else if (in1_minfo->type==_jit_sym_float64) {
 		for (i=0;i<in1_minfo->planecount;i++) {
 			vecdata->v_float64.min[i]  = ((double *)bip1)[i];
 			vecdata->v_float64.max[i]  = ((double *)bip1)[i];
-			vecdata->v_float64.mean[i] = 0;
 		}
 	} 
 }
@@ -179,71 +221,108 @@ void jit_3m_postcalc(t_jit_3m *x, t_jit_3m_vecdata *vecdata, t_jit_matrix_info *
 	long i;
 	
 	x->planecount = in1_minfo->planecount;
+	for (i=0;i<x->planecount;i++) {
+		jit_atom_setfloat(&(x->mean[i]),vecdata->mean[i]);
+		jit_atom_setfloat(&(x->variance[i]),vecdata->m2[i]/vecdata->count);
+		jit_atom_setfloat(&(x->stddev[i]),jit_math_sqrt(vecdata->m2[i]/vecdata->count));
+	}
 
 	if (in1_minfo->type==_jit_sym_char) { 
 		for (i=0;i<x->planecount;i++) {
 			jit_atom_setlong(&(x->min[i]),vecdata->v_char.min[i]);
-			jit_atom_setfloat(&(x->mean[i]),vecdata->v_long.mean[i]); //(hack) use v_long's float mean
 			jit_atom_setlong(&(x->max[i]),vecdata->v_char.max[i]);
 		}
 	} else if (in1_minfo->type==_jit_sym_long) { 
 		for (i=0;i<x->planecount;i++) {
 			jit_atom_setlong(&(x->min[i]),vecdata->v_long.min[i]);
-			jit_atom_setfloat(&(x->mean[i]),vecdata->v_long.mean[i]);
 			jit_atom_setlong(&(x->max[i]),vecdata->v_long.max[i]);
 		}
 	} else if (in1_minfo->type==_jit_sym_float32) { 
 		for (i=0;i<x->planecount;i++) {
 			jit_atom_setfloat(&(x->min[i]),vecdata->v_float32.min[i]);
-			jit_atom_setfloat(&(x->mean[i]),vecdata->v_float32.mean[i]);
 			jit_atom_setfloat(&(x->max[i]),vecdata->v_float32.max[i]);
 		}
 	} else if (in1_minfo->type==_jit_sym_float64) { 
 		for (i=0;i<x->planecount;i++) {
 			jit_atom_setfloat(&(x->min[i]),vecdata->v_float64.min[i]);
-			jit_atom_setfloat(&(x->mean[i]),vecdata->v_float64.mean[i]);
 			jit_atom_setfloat(&(x->max[i]),vecdata->v_float64.max[i]);
 		}
 	}
 }
 
-void jit_3m_mean(t_jit_3m_vecdata *vecdata, t_jit_matrix_info *in1_minfo) 
+//adds n cells with mean nmean and sum of squared differences nm2 to count cells with 
+//mean *mean and sum of squared differences *m2 (chan, golub and leveque)
+void jit_3m_merge(double count, double *mean, double *m2, double n, double nmean, double nm2) 
 {
-	long count=1;
-	long i;
+	double delta,total;
 	
-	for (i=0;i<in1_minfo->dimcount;i++) {
-		count *= in1_minfo->dim[i];
-	}
-			
-	if (in1_minfo->type==_jit_sym_char) {
-		for (i=0;i<in1_minfo->planecount;i++) {
-			vecdata->v_long.mean[i] = ((double)(vecdata->v_char.mean[i]))/(double)count; //(hack) use v_long's float mean
+	if (n<=0) return;
+	total = count + n;
+	delta = nmean - *mean;
+	*mean += delta*n/total;
+	*m2 += nm2 + delta*delta*count*n/total;
+}
+
+
+void jit_3m_reduce_init(t_jit_3m_reduce *r, t_jit_3m_vecdata *vecdata)
+{
+	//min and max are seeded from the first cell, as for the result itself
+	jit_3m_precalc(vecdata,r->minfo,r->bp);
+}
+
+void jit_3m_reduce_accumulate(t_jit_3m_reduce *r, t_jit_3m_vecdata *vecdata, long offset, long dimcount, long *dim, 
+	long planecount, t_jit_matrix_info *in1_minfo, char *bip1)
+{
+	jit_3m_calculate_ndim(vecdata,dimcount,dim,planecount,in1_minfo,bip1);
+}
+
+//called on the matrix_calc thread only, so no need to protect the result
+void jit_3m_reduce_combine(t_jit_3m_reduce *r, t_jit_3m_vecdata *result, t_jit_3m_vecdata *vecdata)
+{
+	long j,planecount=r->minfo->planecount;
+	
+	if (r->minfo->type==_jit_sym_char) {
+		for (j=0;j<planecount;j++) {
+			if (vecdata->v_char.min[j]<result->v_char.min[j])
+				result->v_char.min[j] = vecdata->v_char.min[j];
+			if (vecdata->v_char.max[j]>result->v_char.max[j])
+				result->v_char.max[j] = vecdata->v_char.max[j];
 		}
-	} else if (in1_minfo->type==_jit_sym_long) {
-		for (i=0;i<in1_minfo->planecount;i++) {
-			vecdata->v_long.mean[i] = ((double)(vecdata->v_long.mean[i]))/(double)count;
+	} else if (r->minfo->type==_jit_sym_long) {
+		for (j=0;j<planecount;j++) {
+			if (vecdata->v_long.min[j]<result->v_long.min[j])
+				result->v_long.min[j] = vecdata->v_long.min[j];
+			if (vecdata->v_long.max[j]>result->v_long.max[j])
+				result->v_long.max[j] = vecdata->v_long.max[j];
 		}
-	} else if (in1_minfo->type==_jit_sym_float32) {
-		for (i=0;i<in1_minfo->planecount;i++) {
-			vecdata->v_float32.mean[i] = ((double)(vecdata->v_float32.mean[i]))/(double)count;
+	} else if (r->minfo->type==_jit_sym_float32) {
+		for (j=0;j<planecount;j++) {
+			if (vecdata->v_float32.min[j]<result->v_float32.min[j])
+				result->v_float32.min[j] = vecdata->v_float32.min[j];
+			if (vecdata->v_float32.max[j]>result->v_float32.max[j])
+				result->v_float32.max[j] = vecdata->v_float32.max[j];
 		}
-	} else if (in1_minfo->type==_jit_sym_float64) {
-		for (i=0;i<in1_minfo->planecount;i++) {
-			vecdata->v_float64.mean[i] = ((double)(vecdata->v_float64.mean[i]))/(double)count;
+	} else if (r->minfo->type==_jit_sym_float64) {
+		for (j=0;j<planecount;j++) {
+			if (vecdata->v_float64.min[j]<result->v_float64.min[j])
+				result->v_float64.min[j] = vecdata->v_float64.min[j];
+			if (vecdata->v_float64.max[j]>result->v_float64.max[j])
+				result->v_float64.max[j] = vecdata->v_float64.max[j];
 		}
 	} 
+	for (j=0;j<planecount;j++) 
+		jit_3m_merge(result->count,&result->mean[j],&result->m2[j],vecdata->count,vecdata->mean[j],vecdata->m2[j]);
+	result->count += vecdata->count;
 }
 
-
 //recursive function to handle higher dimension matrices, by processing 2D sections at a time 
-void jit_3m_calculate_ndim(t_jit_3m *x, long dimcount, long *dim, long planecount, 
+void jit_3m_calculate_ndim(t_jit_3m_vecdata *vecdata, long dimcount, long *dim, long planecount, 
 	t_jit_matrix_info *in1_minfo, char *bip1)
 {
-	long i,j,n;
+	long i,j,n,simd;
 	char *ip1;
 	t_jit_op_info in1_opinfo;
-	t_jit_3m_vecdata vecdata;
+	double mean[JIT_MATRIX_MAX_PLANECOUNT],m2[JIT_MATRIX_MAX_PLANECOUNT];
 		
 	if (dimcount<1) return; //safety
 	
@@ -251,172 +330,412 @@ void jit_3m_calculate_ndim(t_jit_3m *x, long dimcount, long *dim, long planecoun
 	case 1:
 		dim[1] = 1;
 	case 2:
-		jit_3m_precalc(&vecdata,in1_minfo,bip1); //parallel moved thread local
 		n = dim[0];
 		in1_opinfo.stride = in1_minfo->dim[0]>1?planecount:0;
-		if (in1_minfo->type==_jit_sym_char) {
-			for (i=0;i<dim[1];i++){
+		//each row gives a mean and sum of squared differences for every plane, which are 
+		//merged into the running ones. rows of 1, 2 or 4 planes are read all planes at once
+#if JIT_3M_SSE2
+		simd = (planecount==1||planecount==2||planecount==4)&&in1_opinfo.stride;
+#else
+		simd = 0;
+#endif
+		for (i=0;i<dim[1];i++){
+			ip1 = bip1 + i*in1_minfo->dimstride[1];
+			if (in1_minfo->type==_jit_sym_char) {
+#if JIT_3M_SSE2
+				if (simd) {
+					jit_3m_vector_char_sse2(n,planecount,(uchar *)ip1,vecdata->v_char.min,vecdata->v_char.max,mean,m2);
+				} else 
+#endif
 				for (j=0;j<planecount;j++) {
-					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + j;
-					jit_3m_vector_char(n,&in1_opinfo,&(vecdata.v_char.min[j]),
-						&(vecdata.v_char.mean[j]),&(vecdata.v_char.max[j]));
+					in1_opinfo.p = ip1 + j;
+					jit_3m_vector_char(n,&in1_opinfo,&(vecdata->v_char.min[j]),
+						&(vecdata->v_char.max[j]),&mean[j],&m2[j]);
 				}
-			}
-			//parallel: protect access to global vecdata write
-			systhread_mutex_lock(x->mutex);
-			for (j=0;j<planecount;j++) {
-				if (vecdata.v_char.min[j]<x->vd.v_char.min[j])
-					x->vd.v_char.min[j] = vecdata.v_char.min[j];
-				if (vecdata.v_char.max[j]>x->vd.v_char.max[j])
-					x->vd.v_char.max[j] = vecdata.v_char.max[j];
-				x->vd.v_char.mean[j] += vecdata.v_char.mean[j];
-			}
-			systhread_mutex_unlock(x->mutex);
-		} else if (in1_minfo->type==_jit_sym_long) {
-			for (i=0;i<dim[1];i++){
+			} else if (in1_minfo->type==_jit_sym_long) {
+#if JIT_3M_SSE2
+				if (simd) {
+					jit_3m_vector_long_sse2(n,planecount,(long *)ip1,vecdata->v_long.min,vecdata->v_long.max,mean,m2);
+				} else 
+#endif
 				for (j=0;j<planecount;j++) {
-					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + j*4;
-					jit_3m_vector_long(n,&in1_opinfo,&(vecdata.v_long.min[j]),
-						&(vecdata.v_long.mean[j]),&(vecdata.v_long.max[j]));
+					in1_opinfo.p = ip1 + j*4;
+					jit_3m_vector_long(n,&in1_opinfo,&(vecdata->v_long.min[j]),
+						&(vecdata->v_long.max[j]),&mean[j],&m2[j]);
 				}
-			}
-			//parallel: protect access to global vecdata write
-			systhread_mutex_lock(x->mutex);
-			for (j=0;j<planecount;j++) {
-				if (vecdata.v_long.min[j]<x->vd.v_long.min[j])
-					x->vd.v_long.min[j] = vecdata.v_long.min[j];
-				if (vecdata.v_long.max[j]>x->vd.v_long.max[j])
-					x->vd.v_long.max[j] = vecdata.v_long.max[j];
-				x->vd.v_long.mean[j] += vecdata.v_long.mean[j];
-			}
-			systhread_mutex_unlock(x->mutex);
-		} else if (in1_minfo->type==_jit_sym_float32) {
-			for (i=0;i<dim[1];i++){
+			} else if (in1_minfo->type==_jit_sym_float32) {
+#if JIT_3M_SSE2
+				if (simd) {
+					jit_3m_vector_float32_sse2(n,planecount,(float *)ip1,vecdata->v_float32.min,vecdata->v_float32.max,mean,m2);
+				} else 
+#endif
 				for (j=0;j<planecount;j++) {
-					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + j*4;
-					jit_3m_vector_float32(n,&in1_opinfo,&(vecdata.v_float32.min[j]),
-						&(vecdata.v_float32.mean[j]),&(vecdata.v_float32.max[j]));
+					in1_opinfo.p = ip1 + j*4;
+					jit_3m_vector_float32(n,&in1_opinfo,&(vecdata->v_float32.min[j]),
+						&(vecdata->v_float32.max[j]),&mean[j],&m2[j]);
 				}
-			}
-			//parallel: protect access to global vecdata write
-			systhread_mutex_lock(x->mutex);
-			for (j=0;j<planecount;j++) {
-				if (vecdata.v_float32.min[j]<x->vd.v_float32.min[j])
-					x->vd.v_float32.min[j] = vecdata.v_float32.min[j];
-				if (vecdata.v_float32.max[j]>x->vd.v_float32.max[j])
-					x->vd.v_float32.max[j] = vecdata.v_float32.max[j];
-				x->vd.v_float32.mean[j] += vecdata.v_float32.mean[j];
-			}
-			systhread_mutex_unlock(x->mutex);
-		} else if (in1_minfo->type==_jit_sym_float64) {
-			for (i=0;i<dim[1];i++){
+			} else if (in1_minfo->type==_jit_sym_float64) {
+#if JIT_3M_SSE2
+				if (simd) {
+					jit_3m_vector_float64_sse2(n,planecount,(double *)ip1,vecdata->v_float64.min,vecdata->v_float64.max,mean,m2);
+				} else 
+#endif
 				for (j=0;j<planecount;j++) {
-					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + j*8;
-					jit_3m_vector_float64(n,&in1_opinfo,&(vecdata.v_float64.min[j]),
-						&(vecdata.v_float64.mean[j]),&(vecdata.v_float64.max[j]));
+					in1_opinfo.p = ip1 + j*8;
+					jit_3m_vector_float64(n,&in1_opinfo,&(vecdata->v_float64.min[j]),
+						&(vecdata->v_float64.max[j]),&mean[j],&m2[j]);
 				}
+			} else {
+				continue;
 			}
-			//parallel: protect access to global vecdata write
-			systhread_mutex_lock(x->mutex);
-			for (j=0;j<planecount;j++) {
-				if (vecdata.v_float64.min[j]<x->vd.v_float64.min[j])
-					x->vd.v_float64.min[j] = vecdata.v_float64.min[j];
-				if (vecdata.v_float64.max[j]>x->vd.v_float64.max[j])
-					x->vd.v_float64.max[j] = vecdata.v_float64.max[j];
-				x->vd.v_float64.mean[j] += vecdata.v_float64.mean[j];
-			}
-			systhread_mutex_unlock(x->mutex);
-		} 
+			for (j=0;j<planecount;j++) 
+				jit_3m_merge(vecdata->count,&vecdata->mean[j],&vecdata->m2[j],n,mean[j],m2[j]);
+			vecdata->count += n;
+		}
 		break;
 	default:
 		for	(i=0;i<dim[dimcount-1];i++) {
 			ip1 = bip1 + i*in1_minfo->dimstride[dimcount-1];
-			jit_3m_calculate_ndim(x,dimcount-1,dim,planecount,in1_minfo,ip1);
+			jit_3m_calculate_ndim(vecdata,dimcount-1,dim,planecount,in1_minfo,ip1);
 		}
 	}
 }
 
+//the vector functions return the mean and sum of squared differences of their n values. 
+//sums are taken of the differences from the first value, which keeps them small
+
 //outmatrix is guaranteed to be no smaller than 256 elements so no need to test ip1 for 0-maxsize
-void jit_3m_vector_char(long n, t_jit_op_info *in1, long *min, long *mean, long *max) 
+void jit_3m_vector_char(long n, t_jit_op_info *in1, long *min, long *max, double *mean, double *m2) 
 {
 	uchar *ip1;
 	long tmp;
-	long is1;
+	long is1,count=n;
+	double shift,d,sum=0,sumsq=0;
 		
 	ip1 = ((uchar *)in1->p);
 	is1 = in1->stride; 
+	shift = *ip1;
 	
 	++n;
 	while (--n) {
 		tmp = *ip1;
 		if (tmp<(*min)) *min = tmp;
 		if (tmp>(*max)) *max = tmp;
-		*mean += tmp;
+		d = tmp - shift;
+		sum += d;
+		sumsq += d*d;
 		ip1 += is1;
 	}
+	*mean = shift + sum/count;
+	*m2 = MAX(sumsq - sum*sum/count,0);
 }
 
-void jit_3m_vector_long(long n, t_jit_op_info *in1, long *min, double *mean, long *max) 
+void jit_3m_vector_long(long n, t_jit_op_info *in1, long *min, long *max, double *mean, double *m2) 
 {
 	long *ip1,tmp;
-	long is1;
+	long is1,count=n;
+	double shift,d,sum=0,sumsq=0;
 		
 	ip1 = ((long *)in1->p);
 	is1 = in1->stride; 
+	shift = *ip1;
 	
 	++n;
 	while (--n) {
 		tmp = *ip1;
 		if (tmp<(*min)) *min = tmp;
 		if (tmp>(*max)) *max = tmp;
-		*mean += tmp;
+		d = tmp - shift;
+		sum += d;
+		sumsq += d*d;
 		ip1 += is1;
 	}
+	*mean = shift + sum/count;
+	*m2 = MAX(sumsq - sum*sum/count,0);
 }
 
-void jit_3m_vector_float32(long n, t_jit_op_info *in1, float *min, float *mean, float *max) 
+void jit_3m_vector_float32(long n, t_jit_op_info *in1, float *min, float *max, double *mean, double *m2) 
 {
 	float *ip1,tmp;
-	long is1;
+	long is1,count=n;
+	double shift,d,sum=0,sumsq=0;
 		
 	ip1 = ((float *)in1->p);
 	is1 = in1->stride; 
+	shift = *ip1;
 	
 	++n;
 	while (--n) {
 		tmp = *ip1;
 		if (tmp<(*min)) *min = tmp;
 		if (tmp>(*max)) *max = tmp;
-		*mean += tmp;
+		d = tmp - shift;
+		sum += d;
+		sumsq += d*d;
 		ip1 += is1;
 	}
+	*mean = shift + sum/count;
+	*m2 = MAX(sumsq - sum*sum/count,0);
 }
 
-void jit_3m_vector_float64(long n, t_jit_op_info *in1, double *min, double *mean, double *max) 
+void jit_3m_vector_float64(long n, t_jit_op_info *in1, double *min, double *max, double *mean, double *m2) 
 {
 	double *ip1,tmp;
-	long is1;
+	long is1,count=n;
+	double shift,d,sum=0,sumsq=0;
 		
 	ip1 = ((double *)in1->p);
 	is1 = in1->stride; 
+	shift = *ip1;
 	
 	++n;
 	while (--n) {
 		tmp = *ip1;
 		if (tmp<(*min)) *min = tmp;
 		if (tmp>(*max)) *max = tmp;
-		*mean += tmp;
+		d = tmp - shift;
+		sum += d;
+		sumsq += d*d;
 		ip1 += is1;
 	}
+	*mean = shift + sum/count;
+	*m2 = MAX(sumsq - sum*sum/count,0);
+}
+
+#if JIT_3M_SSE2
+
+//the sse2 functions take n cells of 1, 2 or 4 planes, read as a run of values where the value
+//in lane k of every vector belongs to plane k%planecount. each lane has its own sums, which
+//are added up by plane here. the sums are of the differences from shift
+void jit_3m_vector_lanes(long lanes, long n, long planecount, double *shift, double *s, double *q, double *mean, double *m2)
+{
+	long j,k;
+	
+	for (j=0;j<planecount;j++) {
+		for (k=j+planecount;k<lanes;k+=planecount) {
+			s[j] += s[k];
+			q[j] += q[k];
+		}
+		mean[j] = shift[j] + s[j]/n;
+		m2[j] = MAX(q[j] - s[j]*s[j]/n,0);
+	}
 }
 
+//sums are exact: bytes are added in 16 bit lanes and their squares in 32 bit lanes, 
+//JIT_3M_BLOCK vectors at a time, then moved to doubles
+void jit_3m_vector_char_sse2(long n, long planecount, uchar *ip, long *min, long *max, double *mean, double *m2) 
+{
+	__m128i v,lo,hi,vmin,vmax,sum,sqe,sqo,even,zero;
+	long i,j,k,len=n*planecount;
+	double s[8],q[8],shift[4]={0,0,0,0};
+	union {__m128i v; uchar c[16]; unsigned short w[8]; unsigned int l[4];} t;
+	
+	zero = _mm_setzero_si128();
+	even = _mm_set1_epi32(0xFFFF);
+	vmin = _mm_set1_epi8((char)0xFF);
+	vmax = zero;
+	for (k=0;k<8;k++) 
+		s[k] = q[k] = 0;
+	for (i=0;i+16<=len;) {
+		sum = sqe = sqo = zero;
+		for (j=0;j<JIT_3M_BLOCK&&i+16<=len;j++,i+=16) {
+			v = _mm_loadu_si128((__m128i *)(ip+i));
+			vmin = _mm_min_epu8(vmin,v);
+			vmax = _mm_max_epu8(vmax,v);
+			lo = _mm_unpacklo_epi8(v,zero);
+			hi = _mm_unpackhi_epi8(v,zero);
+			sum = _mm_add_epi16(sum,_mm_add_epi16(lo,hi));
+			sqe = _mm_add_epi32(sqe,_mm_add_epi32(_mm_madd_epi16(_mm_and_si128(lo,even),lo),_mm_madd_epi16(_mm_and_si128(hi,even),hi)));
+			sqo = _mm_add_epi32(sqo,_mm_add_epi32(_mm_madd_epi16(_mm_andnot_si128(even,lo),lo),_mm_madd_epi16(_mm_andnot_si128(even,hi),hi)));
+		}
+		//16 bit lane k holds bytes k and k+8, so 8 lanes of sums and squares
+		t.v = sum;
+		for (k=0;k<8;k++) 
+			s[k] += t.w[k];
+		t.v = sqe;
+		for (k=0;k<4;k++) 
+			q[2*k] += t.l[k];
+		t.v = sqo;
+		for (k=0;k<4;k++) 
+			q[2*k+1] += t.l[k];
+	}
+	for (;i<len;i++) {
+		k = i&15;
+		s[k&7] += ip[i];
+		q[k&7] += ip[i]*ip[i];
+		if (ip[i]<min[k%planecount]) min[k%planecount] = ip[i];
+		if (ip[i]>max[k%planecount]) max[k%planecount] = ip[i];
+	}
+	t.v = vmin;
+	for (k=0;k<16;k++) 
+		if (t.c[k]<min[k%planecount]) min[k%planecount] = t.c[k];
+	t.v = vmax;
+	for (k=0;k<16;k++) 
+		if (t.c[k]>max[k%planecount]) max[k%planecount] = t.c[k];
+	jit_3m_vector_lanes(8,n,planecount,shift,s,q,mean,m2);
+}
+
+//sse2 has no 32 bit min or max, so they are made from compares
+void jit_3m_vector_long_sse2(long n, long planecount, long *ip, long *min, long *max, double *mean, double *m2)
+{
+	__m128i v,m,vmin,vmax;
+	__m128d d0,d1,sh0,sh1,s0,s1,q0,q1;
+	long i,k,len=n*planecount;
+	double s[4],q[4],shift[4],d;
+	union {__m128i v; int l[4];} t;
+	
+	for (k=0;k<4;k++) {
+		shift[k] = ip[k%planecount];
+		t.l[k] = ip[k%planecount];
+	}
+	vmin = vmax = t.v;
+	sh0 = _mm_loadu_pd(shift);
+	sh1 = _mm_loadu_pd(shift+2);
+	s0 = s1 = q0 = q1 = _mm_setzero_pd();
+	for (i=0;i+4<=len;i+=4) {
+		v = _mm_loadu_si128((__m128i *)(ip+i));
+		m = _mm_cmplt_epi32(v,vmin);
+		vmin = _mm_or_si128(_mm_and_si128(m,v),_mm_andnot_si128(m,vmin));
+		m = _mm_cmpgt_epi32(v,vmax);
+		vmax = _mm_or_si128(_mm_and_si128(m,v),_mm_andnot_si128(m,vmax));
+		d0 = _mm_sub_pd(_mm_cvtepi32_pd(v),sh0);
+		d1 = _mm_sub_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(v,_MM_SHUFFLE(1,0,3,2))),sh1);
+		s0 = _mm_add_pd(s0,d0);
+		s1 = _mm_add_pd(s1,d1);
+		q0 = _mm_add_pd(q0,_mm_mul_pd(d0,d0));
+		q1 = _mm_add_pd(q1,_mm_mul_pd(d1,d1));
+	}
+	_mm_storeu_pd(s,s0);
+	_mm_storeu_pd(s+2,s1);
+	_mm_storeu_pd(q,q0);
+	_mm_storeu_pd(q+2,q1);
+	t.v = vmin;
+	for (k=0;k<4;k++) 
+		if (t.l[k]<min[k%planecount]) min[k%planecount] = t.l[k];
+	t.v = vmax;
+	for (k=0;k<4;k++) 
+		if (t.l[k]>max[k%planecount]) max[k%planecount] = t.l[k];
+	for (;i<len;i++) {
+		k = i&3;
+		if (ip[i]<min[k%planecount]) min[k%planecount] = ip[i];
+		if (ip[i]>max[k%planecount]) max[k%planecount] = ip[i];
+		d = ip[i] - shift[k];
+		s[k] += d;
+		q[k] += d*d;
+	}
+	jit_3m_vector_lanes(4,n,planecount,shift,s,q,mean,m2);
+}
+
+//the differences are summed in float lanes for JIT_3M_BLOCK vectors, then added to 
+//doubles, so that large matrices keep their precision
+void jit_3m_vector_float32_sse2(long n, long planecount, float *ip, float *min, float *max, double *mean, double *m2)
+{
+	__m128 v,d,vmin,vmax,sh,sum,sumsq;
+	__m128d s0,s1,q0,q1;
+	long i,j,k,len=n*planecount;
+	double s[4],q[4],shift[4],dd;
+	union {__m128 v; float f[4];} t;
+	
+	for (k=0;k<4;k++) {
+		shift[k] = ip[k%planecount];
+		t.f[k] = ip[k%planecount];
+	}
+	sh = vmin = vmax = t.v;
+	s0 = s1 = q0 = q1 = _mm_setzero_pd();
+	for (i=0;i+4<=len;) {
+		sum = sumsq = _mm_setzero_ps();
+		for (j=0;j<JIT_3M_BLOCK&&i+4<=len;j++,i+=4) {
+			v = _mm_loadu_ps(ip+i);
+			//the second operand is kept if either is a nan, as with the scalar compare
+			vmin = _mm_min_ps(v,vmin);
+			vmax = _mm_max_ps(v,vmax);
+			d = _mm_sub_ps(v,sh);
+			sum = _mm_add_ps(sum,d);
+			sumsq = _mm_add_ps(sumsq,_mm_mul_ps(d,d));
+		}
+		s0 = _mm_add_pd(s0,_mm_cvtps_pd(sum));
+		s1 = _mm_add_pd(s1,_mm_cvtps_pd(_mm_movehl_ps(sum,sum)));
+		q0 = _mm_add_pd(q0,_mm_cvtps_pd(sumsq));
+		q1 = _mm_add_pd(q1,_mm_cvtps_pd(_mm_movehl_ps(sumsq,sumsq)));
+	}
+	_mm_storeu_pd(s,s0);
+	_mm_storeu_pd(s+2,s1);
+	_mm_storeu_pd(q,q0);
+	_mm_storeu_pd(q+2,q1);
+	t.v = vmin;
+	for (k=0;k<4;k++) 
+		if (t.f[k]<min[k%planecount]) min[k%planecount] = t.f[k];
+	t.v = vmax;
+	for (k=0;k<4;k++) 
+		if (t.f[k]>max[k%planecount]) max[k%planecount] = t.f[k];
+	for (;i<len;i++) {
+		k = i&3;
+		if (ip[i]<min[k%planecount]) min[k%planecount] = ip[i];
+		if (ip[i]>max[k%planecount]) max[k%planecount] = ip[i];
+		dd = ip[i] - shift[k];
+		s[k] += dd;
+		q[k] += dd*dd;
+	}
+	jit_3m_vector_lanes(4,n,planecount,shift,s,q,mean,m2);
+}
+
+//two vectors of two lanes at a time
+void jit_3m_vector_float64_sse2(long n, long planecount, double *ip, double *min, double *max, double *mean, double *m2)
+{
+	__m128d v0,v1,d0,d1,min0,min1,max0,max1,sh0,sh1,s0,s1,q0,q1;
+	long i,k,len=n*planecount;
+	double s[4],q[4],shift[4],t[4],d;
+	
+	for (k=0;k<4;k++) 
+		shift[k] = ip[k%planecount];
+	sh0 = min0 = max0 = _mm_loadu_pd(shift);
+	sh1 = min1 = max1 = _mm_loadu_pd(shift+2);
+	s0 = s1 = q0 = q1 = _mm_setzero_pd();
+	for (i=0;i+4<=len;i+=4) {
+		v0 = _mm_loadu_pd(ip+i);
+		v1 = _mm_loadu_pd(ip+i+2);
+		min0 = _mm_min_pd(v0,min0);
+		min1 = _mm_min_pd(v1,min1);
+		max0 = _mm_max_pd(v0,max0);
+		max1 = _mm_max_pd(v1,max1);
+		d0 = _mm_sub_pd(v0,sh0);
+		d1 = _mm_sub_pd(v1,sh1);
+		s0 = _mm_add_pd(s0,d0);
+		s1 = _mm_add_pd(s1,d1);
+		q0 = _mm_add_pd(q0,_mm_mul_pd(d0,d0));
+		q1 = _mm_add_pd(q1,_mm_mul_pd(d1,d1));
+	}
+	_mm_storeu_pd(s,s0);
+	_mm_storeu_pd(s+2,s1);
+	_mm_storeu_pd(q,q0);
+	_mm_storeu_pd(q+2,q1);
+	_mm_storeu_pd(t,min0);
+	_mm_storeu_pd(t+2,min1);
+	for (k=0;k<4;k++) 
+		if (t[k]<min[k%planecount]) min[k%planecount] = t[k];
+	_mm_storeu_pd(t,max0);
+	_mm_storeu_pd(t+2,max1);
+	for (k=0;k<4;k++) 
+		if (t[k]>max[k%planecount]) max[k%planecount] = t[k];
+	for (;i<len;i++) {
+		k = i&3;
+		if (ip[i]<min[k%planecount]) min[k%planecount] = ip[i];
+		if (ip[i]>max[k%planecount]) max[k%planecount] = ip[i];
+		d = ip[i] - shift[k];
+		s[k] += d;
+		q[k] += d*d;
+	}
+	jit_3m_vector_lanes(4,n,planecount,shift,s,q,mean,m2);
+}
+
+#endif
+
 t_jit_3m *jit_3m_new(void)
 {
 	t_jit_3m *x;
 		
 	if (x=(t_jit_3m *)jit_object_alloc(_jit_3m_class)) {
 		x->planecount = 0;
-		systhread_mutex_new(&x->mutex,0);
 	} else {
 		x = NULL;
 	}	
@@ -425,5 +744,5 @@ t_jit_3m *jit_3m_new(void)
 
 void jit_3m_free(t_jit_3m *x)
 {
-	systhread_mutex_free(x->mutex);
+	//nada
 }
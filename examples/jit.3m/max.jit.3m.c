@@ -13,6 +13,8 @@ typedef struct _max_jit_3m
 	void 				*minout;
 	void 				*meanout;
 	void 				*maxout;	
+	void 				*varianceout;
+	void 				*stddevout;
 	t_atom				*av;
 } t_max_jit_3m;
 
@@ -25,7 +27,7 @@ void max_jit_3m_bang(t_max_jit_3m *x);
 void max_jit_3m_mproc(t_max_jit_3m *x, void *mop);
 void *max_jit_3m_class;
 
-t_symbol *ps_getmin,*ps_getmean,*ps_getmax;
+t_symbol *ps_getmin,*ps_getmean,*ps_getmax,*ps_getvariance,*ps_getstddev;
 		 	
 void main(void)
 {	
@@ -46,6 +48,8 @@ void main(void)
 	ps_getmin	= gensym("getmin");
 	ps_getmean	= gensym("getmean");
 	ps_getmax	= gensym("getmax");
+	ps_getvariance	= gensym("getvariance");
+	ps_getstddev	= gensym("getstddev");
 }
 
 void max_jit_3m_bang(t_max_jit_3m *x)
@@ -57,6 +61,18 @@ void max_jit_3m_bang(t_max_jit_3m *x)
 		o=max_jit_obex_jitob_get(x);
 		//passing in memory to attr function. be sure object knows how to handle this
 		ac=JIT_MATRIX_MAX_PLANECOUNT;
+		jit_object_method(o,ps_getstddev,&ac,&(x->av));
+		if (ac>1)
+			outlet_anything(x->stddevout,_jit_sym_list,ac,x->av);
+		else
+			outlet_float(x->stddevout,jit_atom_getfloat(x->av));
+		ac=JIT_MATRIX_MAX_PLANECOUNT;
+		jit_object_method(o,ps_getvariance,&ac,&(x->av));
+		if (ac>1)
+			outlet_anything(x->varianceout,_jit_sym_list,ac,x->av);
+		else
+			outlet_float(x->varianceout,jit_atom_getfloat(x->av));
+		ac=JIT_MATRIX_MAX_PLANECOUNT;
 		jit_object_method(o,ps_getmax,&ac,&(x->av));
 		if (ac>1)
 			outlet_anything(x->maxout,_jit_sym_list,ac,x->av);
@@ -121,6 +137,12 @@ void max_jit_3m_assist(t_max_jit_3m *x, void *b, long m, long a, char *s)
 			sprintf(s,"(list) max");
 			break; 			
 		case 3:
+			sprintf(s,"(list) variance");
+			break; 			
+		case 4:
+			sprintf(s,"(list) standard deviation");
+			break; 			
+		case 5:
 			sprintf(s,"dumpout");
 			break; 			
 		}
@@ -146,6 +168,8 @@ void *max_jit_3m_new(t_symbol *s, long argc, t_atom *argv)
 		if (o=jit_object_new(gensym("jit_3m"))) {
 			max_jit_mop_setup_simple(x,o,argc,argv);			
 			//add additional non-matrix outputs
+			x->stddevout 	= outlet_new(x,0L);
+			x->varianceout 	= outlet_new(x,0L);
 			x->maxout 	= outlet_new(x,0L);	
 			x->meanout 	= outlet_new(x,0L); 
 			x->minout 	= outlet_new(x,0L);
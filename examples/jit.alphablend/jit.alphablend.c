@@ -5,28 +5,89 @@
 
 #include "jit.common.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIT_ALPHABLEND_SSE2		1
+#include <emmintrin.h>
+#endif
+
+#define JIT_ALPHABLEND_OPCOUNT	13
+
 typedef struct _jit_alphablend 
 {
 	t_object				ob;
 	long					mode;
+	t_symbol				*op;
+	long					premultiplied;
 } t_jit_alphablend;
 
+//porter-duff operators, input 1 (A) composited onto input 2 (B) with alpha in plane 0:
+//out = A*Fa + B*Fb, where Fa = fa[0] + fa[1]*alpha_B and Fb = fb[0] + fb[1]*alpha_A
+typedef struct _jit_alphablend_opdef
+{
+	char					*name;
+	long					fa[2];
+	long					fb[2];
+} t_jit_alphablend_opdef;
+
+typedef struct _jit_alphablend_vecdata t_jit_alphablend_vecdata;
+typedef void (*t_jit_alphablend_rowfn)(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+
+struct _jit_alphablend_vecdata
+{
+	t_jit_alphablend_rowfn	rowfn;
+	long					mode;
+	long					fa[2],fb[2];	//char factors, 255 is 1
+	float					ffa[2],ffb[2];
+	double					dfa[2],dfb[2];
+	long					acopy;			//out is A wherever A is opaque
+};
+
 void *_jit_alphablend_class;
 
+static t_jit_alphablend_opdef s_jit_alphablend_ops[JIT_ALPHABLEND_OPCOUNT] = {
+	{"clear",	{0,0},	{0,0}},
+	{"src",		{1,0},	{0,0}},
+	{"dst",		{0,0},	{1,0}},
+	{"over",	{1,0},	{1,-1}},
+	{"dstover",	{1,-1},	{1,0}},
+	{"in",		{0,1},	{0,0}},
+	{"dstin",	{0,0},	{0,1}},
+	{"out",		{1,-1},	{0,0}},
+	{"dstout",	{0,0},	{1,-1}},
+	{"atop",	{0,1},	{1,-1}},
+	{"dstatop",	{1,-1},	{0,1}},
+	{"xor",		{1,-1},	{1,-1}},
+	{"plus",	{1,0},	{1,0}},
+};
+static t_symbol *s_jit_alphablend_opsym[JIT_ALPHABLEND_OPCOUNT];
+static t_symbol *ps_blend;
+
 t_jit_err jit_alphablend_init(void);
 t_jit_alphablend *jit_alphablend_new(void);
 void jit_alphablend_free(t_jit_alphablend *x);
 t_jit_err jit_alphablend_matrix_calc(t_jit_alphablend *x, void *inputs, void *outputs);
+void jit_alphablend_getvecdata(t_jit_alphablend *x, t_symbol *type, t_jit_alphablend_vecdata *v);
 
-void jit_alphablend_calculate_ndim(t_jit_alphablend *x, long dimcount, long *dim, long planecount, t_jit_matrix_info *in1_minfo, char *bip1, 
+void jit_alphablend_calculate_ndim(t_jit_alphablend_vecdata *v, long dimcount, long *dim, long planecount, t_jit_matrix_info *in1_minfo, char *bip1,
 	t_jit_matrix_info *in2_minfo, char *bip2, t_jit_matrix_info *out_minfo, char *bop);
 
+void jit_alphablend_blend_char(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+void jit_alphablend_blend_float32(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+void jit_alphablend_blend_float64(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+void jit_alphablend_composite_char(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+void jit_alphablend_composite_char_straight(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+void jit_alphablend_composite_float32(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+void jit_alphablend_composite_float32_straight(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+void jit_alphablend_composite_float64(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+void jit_alphablend_composite_float64_straight(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op);
+
 t_jit_err jit_alphablend_init(void) 
 {
 	long attrflags=0;
 	t_jit_object *attr,*mop,*o;
 	t_symbol *atsym;
 	t_atom a[3];
+	long i;
 	
 	atsym = gensym("jit_attr_offset");
 	
@@ -52,7 +113,19 @@ t_jit_err jit_alphablend_init(void)
 	attr = jit_object_new(atsym,"mode",_jit_sym_long,attrflags,
 		(method)0L,(method)0L,calcoffset(t_jit_alphablend,mode));
 	jit_class_addattr(_jit_alphablend_class,attr);
+	//blend, or one of the porter-duff operators
+	attr = jit_object_new(atsym,"op",_jit_sym_symbol,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_alphablend,op));
+	jit_class_addattr(_jit_alphablend_class,attr);
+	//color planes of the inputs and output are multiplied by alpha (operators only)
+	attr = jit_object_new(atsym,"premultiplied",_jit_sym_long,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_alphablend,premultiplied));
+	jit_class_addattr(_jit_alphablend_class,attr);
 	//add methods
+
+	ps_blend = gensym("blend");
+	for (i=0;i<JIT_ALPHABLEND_OPCOUNT;i++)
+		s_jit_alphablend_opsym[i] = gensym(s_jit_alphablend_ops[i].name);
 	
 	jit_class_register(_jit_alphablend_class);
 
@@ -67,6 +140,7 @@ t_jit_err jit_alphablend_matrix_calc(t_jit_alphablend *x, void *inputs, void *ou
 	char *in1_bp,*in2_bp,*out_bp;
 	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
 	void *in1_matrix,*in2_matrix,*out_matrix;
+	t_jit_alphablend_vecdata vecdata;
 	
 	in1_matrix 	= jit_object_method(inputs,_jit_sym_getindex,0);
 	in2_matrix 	= jit_object_method(inputs,_jit_sym_getindex,1);
@@ -113,8 +187,9 @@ t_jit_err jit_alphablend_matrix_calc(t_jit_alphablend *x, void *inputs, void *ou
 			}
 		}
 				
+		jit_alphablend_getvecdata(x,in1_minfo.type,&vecdata);
 		jit_parallel_ndim_simplecalc3((method)jit_alphablend_calculate_ndim,
-			x, dimcount, dim, planecount, &in1_minfo, in1_bp, &in2_minfo, in2_bp, &out_minfo, out_bp, 
+			&vecdata, dimcount, dim, planecount, &in1_minfo, in1_bp, &in2_minfo, in2_bp, &out_minfo, out_bp,
 			0 /* flags1 */, 0 /* flags2 */, 0 /* flags3 */);
 	} else {
 		return JIT_ERR_INVALID_PTR;
@@ -127,20 +202,50 @@ out:
 	return err;
 }
 
+//picks the row function and works out the operator's factors for the type
+void jit_alphablend_getvecdata(t_jit_alphablend *x, t_symbol *type, t_jit_alphablend_vecdata *v)
+{
+	t_jit_alphablend_opdef *def=NULL;
+	long i;
+
+	v->mode = x->mode;
+	for (i=0;i<JIT_ALPHABLEND_OPCOUNT;i++) {
+		if (x->op==s_jit_alphablend_opsym[i])
+			def = s_jit_alphablend_ops + i;
+	}
+	if (!def) {
+		//blend
+		if (type==_jit_sym_char)
+			v->rowfn = jit_alphablend_blend_char;
+		else if (type==_jit_sym_float32)
+			v->rowfn = jit_alphablend_blend_float32;
+		else
+			v->rowfn = jit_alphablend_blend_float64;
+		return;
+	}
+
+	for (i=0;i<2;i++) {
+		v->fa[i] = def->fa[i]*(i?1:255);
+		v->fb[i] = def->fb[i]*(i?1:255);
+		v->ffa[i] = v->dfa[i] = def->fa[i];
+		v->ffb[i] = v->dfb[i] = def->fb[i];
+	}
+	//Fa is 1 and Fb is 0 wherever alpha_A is 1
+	v->acopy = (def->fa[0]==1)&&(def->fa[1]==0)&&(def->fb[0]+def->fb[1]==0);
 
-void jit_alphablend_calculate_ndim(t_jit_alphablend *x, long dimcount, long *dim, long planecount, t_jit_matrix_info *in1_minfo, char *bip1, 
+	if (type==_jit_sym_char)
+		v->rowfn = x->premultiplied?jit_alphablend_composite_char:jit_alphablend_composite_char_straight;
+	else if (type==_jit_sym_float32)
+		v->rowfn = x->premultiplied?jit_alphablend_composite_float32:jit_alphablend_composite_float32_straight;
+	else
+		v->rowfn = x->premultiplied?jit_alphablend_composite_float64:jit_alphablend_composite_float64_straight;
+}
+
+void jit_alphablend_calculate_ndim(t_jit_alphablend_vecdata *v, long dimcount, long *dim, long planecount, t_jit_matrix_info *in1_minfo, char *bip1,
 	t_jit_matrix_info *in2_minfo, char *bip2, t_jit_matrix_info *out_minfo, char *bop)
 {
-	long i,j,k;
-	uchar *cip1,*cip2,*cop;
-	float *fip1,*fip2,*fop;
-	double *dip1,*dip2,*dop;
-	long calpha,calpha_inv;
-	float falpha,falpha_inv;
-	float dalpha,dalpha_inv;
-	float default_alpha = 1.0;
-	uchar cdefault_alpha = (uchar)(default_alpha * 255.);
-	long height,width;
+	long i;
+	char *ip1,*ip2,*op;
 		
 	if (dimcount<1) return; //safety
 	
@@ -148,247 +253,366 @@ void jit_alphablend_calculate_ndim(t_jit_alphablend *x, long dimcount, long *dim
 	case 1:
 		dim[1]=1;
 	case 2:				
-		width  = dim[0];
-		height = dim[1];
-		if (in1_minfo->type==_jit_sym_char) {
-			switch(planecount) {
-			case 4:
-				for (i=0;i<height;i++){
-					cip1 = (uchar *) bip1 + i*in1_minfo->dimstride[1];
-					cip2 = (uchar *) bip2 + i*in2_minfo->dimstride[1];
-					cop  = (uchar *) bop  + i*out_minfo->dimstride[1];
-					
-					switch (x->mode) {
-					case 1:	//inverse
-						for (j=0;j<width;j++) {
-							calpha_inv 	= (long)(*cip1++);
-							calpha		= 256 - calpha_inv;
-							*cop++		= cdefault_alpha;
-							cip2++; //ignore other alpha channels
-							*cop++ = (((long)(*cip1++)*calpha)+((long)(*cip2++)*calpha_inv))>>8L;
-							*cop++ = (((long)(*cip1++)*calpha)+((long)(*cip2++)*calpha_inv))>>8L;
-							*cop++ = (((long)(*cip1++)*calpha)+((long)(*cip2++)*calpha_inv))>>8L;
-						}
-						break;				
-					default:	
-						for (j=0;j<width;j++) {
-							calpha 		= (long)(*cip1++);
-							calpha_inv	= 256 - calpha;
-							*cop++		= cdefault_alpha;
-							cip2++; //ignore other alpha channels
-							*cop++ = (((long)(*cip1++)*calpha)+((long)(*cip2++)*calpha_inv))>>8L;
-							*cop++ = (((long)(*cip1++)*calpha)+((long)(*cip2++)*calpha_inv))>>8L;
-							*cop++ = (((long)(*cip1++)*calpha)+((long)(*cip2++)*calpha_inv))>>8L;
-						}
-						break;
-					}
-				}
-				break;
-			default:
-				for (i=0;i<height;i++){
-					cip1 = (uchar *) bip1 + i*in1_minfo->dimstride[1];
-					cip2 = (uchar *) bip2 + i*in2_minfo->dimstride[1];
-					cop  = (uchar *) bop  + i*out_minfo->dimstride[1];
-					
-					switch (x->mode) {
-					case 1:	//inverse
-						for (j=0;j<width;j++) {
-							calpha_inv 	= (long)(*cip1);
-							calpha		= 256 - calpha_inv;
-							cop[0]		= cdefault_alpha;
-							for (k = 1; k < planecount; k++) {
-								cop[k] = (((long)(cip1[k])*calpha)+((long)(cip2[k])*calpha_inv))>>8L;
-							}
-							cop += planecount;
-							cip1 += planecount;
-							cip2 += planecount;
-						}
-						break;				
-					default:	
-						for (j=0;j<width;j++) {
-							calpha 		= (long)(*cip1);
-							calpha_inv	= 256 - calpha;
-							cop[0] = cdefault_alpha;
-							for (k = 1; k < planecount; k++) {
-								cop[k] = (((long)(cip1[k])*calpha)+((long)(cip2[k])*calpha_inv))>>8L;
-							}
-							cop += planecount;
-							cip1 += planecount;
-							cip2 += planecount;
-						}
-						break;
-					}
-				}
-				break;
-			}
-		} else if (in1_minfo->type==_jit_sym_float32) {
-			switch (planecount) {
-			case 4:
-				for (i=0;i<height;i++){
-					fip1 = (float *) (bip1 + i*in1_minfo->dimstride[1]);
-					fip2 = (float *) (bip2 + i*in2_minfo->dimstride[1]);
-					fop  = (float *) (bop  + i*out_minfo->dimstride[1]);
-					
-					switch (x->mode) {
-					case 1:	//inverse
-						for (j=0;j<width;j++) {
-							falpha_inv 	= *fip1++;
-							CLIP(falpha_inv,0.,1.);
-							falpha		= 1. - falpha_inv;
-							*fop++		= default_alpha;
-							fip2++; //ignore other alpha channels
-							*fop++ = ((*fip1++)*falpha)+((*fip2++)*falpha_inv);
-							*fop++ = ((*fip1++)*falpha)+((*fip2++)*falpha_inv);
-							*fop++ = ((*fip1++)*falpha)+((*fip2++)*falpha_inv);
-						}
-						break;				
-					default:	
-						for (j=0;j<width;j++) {
-							falpha 		= *fip1++;
-							CLIP(falpha,0.,1.);
-							falpha_inv	= 1. - falpha;
-							*fop++		= default_alpha;
-							fip2++; //ignore other alpha channels
-							*fop++ = ((*fip1++)*falpha)+((*fip2++)*falpha_inv);
-							*fop++ = ((*fip1++)*falpha)+((*fip2++)*falpha_inv);
-							*fop++ = ((*fip1++)*falpha)+((*fip2++)*falpha_inv);
-						}
-						break;
-					}
-				}
-				break;
-			default:
-				for (i=0;i<height;i++){
-					fip1 = (float *) (bip1 + i*in1_minfo->dimstride[1]);
-					fip2 = (float *) (bip2 + i*in2_minfo->dimstride[1]);
-					fop  = (float *) (bop  + i*out_minfo->dimstride[1]);
-					
-					switch (x->mode) {
-					case 1:	//inverse
-						for (j=0;j<width;j++) {
-							falpha_inv 	= *fip1;
-							CLIP(falpha_inv,0.,1.);
-							falpha		= 1. - falpha_inv;
-							fop[0]		= default_alpha;
-							for (k = 1; k < planecount; k++) {
-								fop[k] = ((fip1[k])*falpha)+((fip2[k])*falpha_inv);
-							}
-							fop += planecount;
-							fip1 += planecount;
-							fip2 += planecount;
-						}
-						break;				
-					default:	
-						for (j=0;j<width;j++) {
-							falpha 		= *fip1;
-							CLIP(falpha,0.,1.);
-							falpha_inv	= 1. - falpha;
-							fop[0]		= default_alpha;
-							for (k = 1; k < planecount; k++) {
-								fop[k] = ((fip1[k])*falpha)+((fip2[k])*falpha_inv);
-							}
-							fop += planecount;
-							fip1 += planecount;
-							fip2 += planecount;
-						}
-						break;
-					}
-				}
-				break;
-			}
-		} else if (in1_minfo->type==_jit_sym_float64) {
-			switch (planecount) {
-			case 4:
-				for (i=0;i<height;i++){
-					dip1 = (double *) (bip1 + i*in1_minfo->dimstride[1]);
-					dip2 = (double *) (bip2 + i*in2_minfo->dimstride[1]);
-					dop  = (double *) (bop  + i*out_minfo->dimstride[1]);
-					
-					switch (x->mode) {
-					case 1:	//inverse
-						for (j=0;j<width;j++) {
-							dalpha_inv 	= *dip1++;
-							CLIP(dalpha_inv,0.,1.);
-							dalpha		= 1. - dalpha_inv;
-							*dop++		= default_alpha;
-							dip2++; //ignore other alpha channels
-							*dop++ = ((*dip1++)*dalpha)+((*dip2++)*dalpha_inv);
-							*dop++ = ((*dip1++)*dalpha)+((*dip2++)*dalpha_inv);
-							*dop++ = ((*dip1++)*dalpha)+((*dip2++)*dalpha_inv);
-						}
-						break;				
-					default:	
-						for (j=0;j<width;j++) {
-							dalpha 		= *dip1++;
-							CLIP(dalpha,0.,1.);
-							dalpha_inv	= 1. - dalpha;
-							*dop++		= default_alpha;
-							dip2++; //ignore other alpha channels
-							*dop++ = ((*dip1++)*dalpha)+((*dip2++)*dalpha_inv);
-							*dop++ = ((*dip1++)*dalpha)+((*dip2++)*dalpha_inv);
-							*dop++ = ((*dip1++)*dalpha)+((*dip2++)*dalpha_inv);
-						}
-						break;
-					}
-				}
-				break;
-			default:
-				for (i=0;i<height;i++){
-					dip1 = (double *) (bip1 + i*in1_minfo->dimstride[1]);
-					dip2 = (double *) (bip2 + i*in2_minfo->dimstride[1]);
-					dop  = (double *) (bop  + i*out_minfo->dimstride[1]);
-					
-					switch (x->mode) {
-					case 1:	//inverse
-						for (j=0;j<width;j++) {
-							dalpha_inv 	= *dip1;
-							CLIP(dalpha_inv,0.,1.);
-							dalpha		= 1. - dalpha_inv;
-							dop[0] 		= default_alpha;
-							for (k = 1; k < planecount; k++) {
-								dop[k] = ((dip1[k])*dalpha)+((dip2[k])*dalpha_inv);
-							}
-							dop += planecount;
-							dip1 += planecount;
-							dip2 += planecount;
-						}
-						break;				
-					default:	
-						for (j=0;j<width;j++) {
-							dalpha 		= *dip1;
-							CLIP(dalpha,0.,1.);
-							dalpha_inv	= 1. - dalpha;
-							dop[0] 		= default_alpha;
-							for (k = 1; k < planecount; k++) {
-								dop[k] = ((dip1[k])*dalpha)+((dip2[k])*dalpha_inv);
-							}
-							dop += planecount;
-							dip1 += planecount;
-							dip2 += planecount;
-						}
-						break;
-					}
-				}
-				break;
-			}
+		for (i=0;i<dim[1];i++){
+			ip1 = bip1 + i*in1_minfo->dimstride[1];
+			ip2 = bip2 + i*in2_minfo->dimstride[1];
+			op  = bop  + i*out_minfo->dimstride[1];
+			(*v->rowfn)(v,dim[0],planecount,ip1,ip2,op);
 		}
 		break;
 	default:
 		for	(i=0;i<dim[dimcount-1];i++) {
-			cip1 = (uchar *) bip1 + i*in1_minfo->dimstride[dimcount-1];
-			cip2 = (uchar *) bip2 + i*in2_minfo->dimstride[dimcount-1];
-			cop  = (uchar *) bop  + i*out_minfo->dimstride[dimcount-1];
-			jit_alphablend_calculate_ndim(x,dimcount-1,dim,planecount,in1_minfo,(char *)cip1,in2_minfo,(char *)cip2,out_minfo,(char *)cop);
+			ip1 = bip1 + i*in1_minfo->dimstride[dimcount-1];
+			ip2 = bip2 + i*in2_minfo->dimstride[dimcount-1];
+			op  = bop  + i*out_minfo->dimstride[dimcount-1];
+			jit_alphablend_calculate_ndim(v,dimcount-1,dim,planecount,in1_minfo,ip1,in2_minfo,ip2,out_minfo,op);
+		}
+	}
+}
+
+#if JIT_ALPHABLEND_SSE2
+//alpha (byte 0 of each 4 byte cell) of 2 cells unpacked to 16 bits, copied to all 4 lanes of its cell
+#define JIT_ALPHABLEND_SPLAT16(v) _mm_shufflehi_epi16(_mm_shufflelo_epi16(v,0),0)
+
+//round(a*b/255) in 16 bit lanes, a and b 0-255
+#define JIT_ALPHABLEND_MUL255(t,a,b) \
+	t = _mm_add_epi16(_mm_mullo_epi16(a,b),_mm_set1_epi16(128)); \
+	t = _mm_srli_epi16(_mm_add_epi16(t,_mm_srli_epi16(t,8)),8);
+#endif
+
+// mode 0: out = (A*alpha + B*(256-alpha))>>8, mode 1: alpha is inverted. alpha is plane 0 of A,
+// and the output alpha plane is 255. four planes go 4 cells at a time in sse2 registers
+void jit_alphablend_blend_char(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op)
+{
+	uchar *cip1=(uchar *)ip1,*cip2=(uchar *)ip2,*cop=(uchar *)op;
+	long j=0,k,calpha,calpha_inv;
+#if JIT_ALPHABLEND_SSE2
+	__m128i a,b,alo,ahi,blo,bhi,w,wlo,whi,zero,mask,c256;
+
+	if (planecount==4) {
+		zero = _mm_setzero_si128();
+		mask = _mm_set1_epi32(0xff);
+		c256 = _mm_set1_epi16(256);
+		for (;j+4<=n;j+=4) {
+			a = _mm_loadu_si128((__m128i *)(cip1+j*4));
+			b = _mm_loadu_si128((__m128i *)(cip2+j*4));
+			alo = _mm_unpacklo_epi8(a,zero);
+			ahi = _mm_unpackhi_epi8(a,zero);
+			blo = _mm_unpacklo_epi8(b,zero);
+			bhi = _mm_unpackhi_epi8(b,zero);
+			wlo = JIT_ALPHABLEND_SPLAT16(alo);
+			whi = JIT_ALPHABLEND_SPLAT16(ahi);
+			if (v->mode==1) {
+				wlo = _mm_sub_epi16(c256,wlo);
+				whi = _mm_sub_epi16(c256,whi);
+			}
+			//at most 255*256, so the sums fit unsigned 16 bit lanes
+			w = _mm_sub_epi16(c256,wlo);
+			alo = _mm_add_epi16(_mm_mullo_epi16(alo,wlo),_mm_mullo_epi16(blo,w));
+			w = _mm_sub_epi16(c256,whi);
+			ahi = _mm_add_epi16(_mm_mullo_epi16(ahi,whi),_mm_mullo_epi16(bhi,w));
+			a = _mm_packus_epi16(_mm_srli_epi16(alo,8),_mm_srli_epi16(ahi,8));
+			_mm_storeu_si128((__m128i *)(cop+j*4),_mm_or_si128(a,mask));
+		}
+	}
+#endif
+	cip1 += j*planecount;
+	cip2 += j*planecount;
+	cop  += j*planecount;
+	for (;j<n;j++) {
+		if (v->mode==1) {	//inverse
+			calpha_inv 	= (long)(*cip1);
+			calpha		= 256 - calpha_inv;
+		} else {
+			calpha 		= (long)(*cip1);
+			calpha_inv	= 256 - calpha;
+		}
+		cop[0] = 255;
+		for (k = 1; k < planecount; k++) {
+			cop[k] = (((long)(cip1[k])*calpha)+((long)(cip2[k])*calpha_inv))>>8L;
 		}
+		cop += planecount;
+		cip1 += planecount;
+		cip2 += planecount;
 	}
 }
 
+// as above with alpha clipped to 0-1 and an output alpha of 1
+void jit_alphablend_blend_float32(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op)
+{
+	float *fip1=(float *)ip1,*fip2=(float *)ip2,*fop=(float *)op;
+	float falpha,falpha_inv;
+	long j=0,k;
+#if JIT_ALPHABLEND_SSE2
+	__m128 a,b,w,winv,zero,one,mask;
+
+	if (planecount==4) {
+		zero = _mm_setzero_ps();
+		one  = _mm_set1_ps(1.f);
+		mask = _mm_castsi128_ps(_mm_set_epi32(-1,-1,-1,0));
+		for (;j<n;j++,fip1+=4,fip2+=4,fop+=4) {
+			a = _mm_loadu_ps(fip1);
+			b = _mm_loadu_ps(fip2);
+			//argument order keeps NaN alpha as NaN, like CLIP
+			w = _mm_shuffle_ps(a,a,0);
+			w = _mm_max_ps(zero,_mm_min_ps(one,w));
+			winv = _mm_sub_ps(one,w);
+			if (v->mode==1) {
+				b = _mm_mul_ps(b,w);
+				a = _mm_mul_ps(a,winv);
+			} else {
+				a = _mm_mul_ps(a,w);
+				b = _mm_mul_ps(b,winv);
+			}
+			a = _mm_and_ps(_mm_add_ps(a,b),mask);
+			_mm_storeu_ps(fop,_mm_or_ps(a,_mm_andnot_ps(mask,one)));
+		}
+	}
+#endif
+	for (;j<n;j++) {
+		if (v->mode==1) {	//inverse
+			falpha_inv 	= *fip1;
+			CLIP(falpha_inv,0.,1.);
+			falpha		= 1. - falpha_inv;
+		} else {
+			falpha 		= *fip1;
+			CLIP(falpha,0.,1.);
+			falpha_inv	= 1. - falpha;
+		}
+		fop[0] = 1.;
+		for (k = 1; k < planecount; k++) {
+			fop[k] = ((fip1[k])*falpha)+((fip2[k])*falpha_inv);
+		}
+		fop += planecount;
+		fip1 += planecount;
+		fip2 += planecount;
+	}
+}
+
+void jit_alphablend_blend_float64(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op)
+{
+	double *dip1=(double *)ip1,*dip2=(double *)ip2,*dop=(double *)op;
+	float dalpha,dalpha_inv;
+	long j,k;
+
+	for (j=0;j<n;j++) {
+		if (v->mode==1) {	//inverse
+			dalpha_inv 	= *dip1;
+			CLIP(dalpha_inv,0.,1.);
+			dalpha		= 1. - dalpha_inv;
+		} else {
+			dalpha 		= *dip1;
+			CLIP(dalpha,0.,1.);
+			dalpha_inv	= 1. - dalpha;
+		}
+		dop[0] = 1.;
+		for (k = 1; k < planecount; k++) {
+			dop[k] = ((dip1[k])*dalpha)+((dip2[k])*dalpha_inv);
+		}
+		dop += planecount;
+		dip1 += planecount;
+		dip2 += planecount;
+	}
+}
+
+// premultiplied char: every plane, alpha included, is round(A*Fa/255) + round(B*Fb/255),
+// saturated. where A is opaque and the operator gives A, or A is all zero, the result is
+// copied without the arithmetic. four planes go 4 cells at a time in sse2 registers
+void jit_alphablend_composite_char(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op)
+{
+	uchar *cip1=(uchar *)ip1,*cip2=(uchar *)ip2,*cop=(uchar *)op;
+	long j=0,k,fa,fb;
+#if JIT_ALPHABLEND_SSE2
+	__m128i a,b,al,bl,lo,hi,t,r,wa,wb,zero,mask,fa0,fa1,fb0,fb1;
+
+	if (planecount==4) {
+		zero = _mm_setzero_si128();
+		mask = _mm_set1_epi32(0xff);
+		fa0 = _mm_set1_epi16((short)v->fa[0]);
+		fa1 = _mm_set1_epi16((short)v->fa[1]);
+		fb0 = _mm_set1_epi16((short)v->fb[0]);
+		fb1 = _mm_set1_epi16((short)v->fb[1]);
+		for (;j+4<=n;j+=4) {
+			a = _mm_loadu_si128((__m128i *)(cip1+j*4));
+			if (v->acopy&&(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(a,mask),mask))==0xffff)) {
+				_mm_storeu_si128((__m128i *)(cop+j*4),a);
+				continue;
+			}
+			b = _mm_loadu_si128((__m128i *)(cip2+j*4));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(a,zero))==0xffff) {
+				_mm_storeu_si128((__m128i *)(cop+j*4),v->fb[0]?b:zero);
+				continue;
+			}
+			//cells 0,1 then 2,3
+			al = _mm_unpacklo_epi8(a,zero);
+			bl = _mm_unpacklo_epi8(b,zero);
+			wa = _mm_add_epi16(fa0,_mm_mullo_epi16(fa1,JIT_ALPHABLEND_SPLAT16(bl)));
+			wb = _mm_add_epi16(fb0,_mm_mullo_epi16(fb1,JIT_ALPHABLEND_SPLAT16(al)));
+			JIT_ALPHABLEND_MUL255(t,al,wa);
+			JIT_ALPHABLEND_MUL255(r,bl,wb);
+			lo = _mm_add_epi16(t,r);
+			al = _mm_unpackhi_epi8(a,zero);
+			bl = _mm_unpackhi_epi8(b,zero);
+			wa = _mm_add_epi16(fa0,_mm_mullo_epi16(fa1,JIT_ALPHABLEND_SPLAT16(bl)));
+			wb = _mm_add_epi16(fb0,_mm_mullo_epi16(fb1,JIT_ALPHABLEND_SPLAT16(al)));
+			JIT_ALPHABLEND_MUL255(t,al,wa);
+			JIT_ALPHABLEND_MUL255(r,bl,wb);
+			hi = _mm_add_epi16(t,r);
+			_mm_storeu_si128((__m128i *)(cop+j*4),_mm_packus_epi16(lo,hi));
+		}
+	}
+#endif
+	cip1 += j*planecount;
+	cip2 += j*planecount;
+	cop  += j*planecount;
+	for (;j<n;j++,cop+=planecount,cip1+=planecount,cip2+=planecount) {
+		if (v->acopy&&(cip1[0]==255)) {
+			for (k=0;k<planecount;k++)
+				cop[k] = cip1[k];
+			continue;
+		}
+		for (k=0;(k<planecount)&&!cip1[k];k++)
+			;
+		if (k==planecount) {
+			for (k=0;k<planecount;k++)
+				cop[k] = v->fb[0]?cip2[k]:0;
+			continue;
+		}
+		fa = v->fa[0] + v->fa[1]*cip2[0];
+		fb = v->fb[0] + v->fb[1]*cip1[0];
+		for (k=0;k<planecount;k++) {
+			long t1 = cip1[k]*fa + 128, t2 = cip2[k]*fb + 128;
+			t1 = ((t1 + (t1>>8))>>8) + ((t2 + (t2>>8))>>8);
+			cop[k] = (t1>255)?255:t1;
+		}
+	}
+}
+
+// straight char: colors are weighted by alpha*F and divided by the output alpha, so
+// out = (A*alpha_A*Fa + B*alpha_B*Fb)/(alpha_A*Fa + alpha_B*Fb), rounded. an opaque A
+// that the operator keeps, and a transparent A, give A or B exactly without dividing
+void jit_alphablend_composite_char_straight(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op)
+{
+	uchar *cip1=(uchar *)ip1,*cip2=(uchar *)ip2,*cop=(uchar *)op;
+	long j,k,wa,wb,ao,c;
+
+	for (j=0;j<n;j++,cop+=planecount,cip1+=planecount,cip2+=planecount) {
+		if (v->acopy&&(cip1[0]==255)) {
+			for (k=0;k<planecount;k++)
+				cop[k] = cip1[k];
+			continue;
+		}
+		if (!cip1[0]) {
+			for (k=0;k<planecount;k++)
+				cop[k] = (v->fb[0]&&cip2[0])?cip2[k]:0;
+			continue;
+		}
+		wa = cip1[0]*(v->fa[0] + v->fa[1]*cip2[0]);
+		wb = cip2[0]*(v->fb[0] + v->fb[1]*cip1[0]);
+		ao = wa + wb;
+		c = (ao + 127)/255;
+		cop[0] = (c>255)?255:c;
+		for (k=1;k<planecount;k++) {
+			c = ao?(cip1[k]*wa + cip2[k]*wb + ao/2)/ao:0;
+			cop[k] = (c>255)?255:c;
+		}
+	}
+}
+
+// float: every plane of premultiplied data is A*Fa + B*Fb, with the alphas in the
+// factors clipped to 0-1. straight data is weighted and divided by the output alpha
+#define JIT_ALPHABLEND_COMPOSITE_FLOAT(p1,p2,po,va,vb) \
+	for (;j<n;j++,po+=planecount,p1+=planecount,p2+=planecount) { \
+		aa = p1[0]; \
+		ab = p2[0]; \
+		CLIP(aa,0.,1.); \
+		CLIP(ab,0.,1.); \
+		fa = v->va[0] + v->va[1]*ab; \
+		fb = v->vb[0] + v->vb[1]*aa; \
+		for (k=0;k<planecount;k++) \
+			po[k] = p1[k]*fa + p2[k]*fb; \
+	}
+
+#define JIT_ALPHABLEND_COMPOSITE_FLOAT_STRAIGHT(p1,p2,po,va,vb) \
+	for (j=0;j<n;j++,po+=planecount,p1+=planecount,p2+=planecount) { \
+		aa = p1[0]; \
+		ab = p2[0]; \
+		CLIP(aa,0.,1.); \
+		CLIP(ab,0.,1.); \
+		fa = aa*(v->va[0] + v->va[1]*ab); \
+		fb = ab*(v->vb[0] + v->vb[1]*aa); \
+		ao = fa + fb; \
+		po[0] = ao; \
+		for (k=1;k<planecount;k++) \
+			po[k] = (ao>0)?(p1[k]*fa + p2[k]*fb)/ao:0; \
+	}
+
+void jit_alphablend_composite_float32(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op)
+{
+	float *fip1=(float *)ip1,*fip2=(float *)ip2,*fop=(float *)op;
+	float aa,ab,fa,fb;
+	long j=0,k;
+#if JIT_ALPHABLEND_SSE2
+	__m128 a,b,wa,wb,zero,one,fa0,fa1,fb0,fb1;
+
+	if (planecount==4) {
+		zero = _mm_setzero_ps();
+		one  = _mm_set1_ps(1.f);
+		fa0 = _mm_set1_ps(v->ffa[0]);
+		fa1 = _mm_set1_ps(v->ffa[1]);
+		fb0 = _mm_set1_ps(v->ffb[0]);
+		fb1 = _mm_set1_ps(v->ffb[1]);
+		for (;j<n;j++,fip1+=4,fip2+=4,fop+=4) {
+			a = _mm_loadu_ps(fip1);
+			b = _mm_loadu_ps(fip2);
+			wa = _mm_shuffle_ps(b,b,0);
+			wb = _mm_shuffle_ps(a,a,0);
+			wa = _mm_max_ps(zero,_mm_min_ps(one,wa));
+			wb = _mm_max_ps(zero,_mm_min_ps(one,wb));
+			wa = _mm_add_ps(fa0,_mm_mul_ps(fa1,wa));
+			wb = _mm_add_ps(fb0,_mm_mul_ps(fb1,wb));
+			_mm_storeu_ps(fop,_mm_add_ps(_mm_mul_ps(a,wa),_mm_mul_ps(b,wb)));
+		}
+	}
+#endif
+	JIT_ALPHABLEND_COMPOSITE_FLOAT(fip1,fip2,fop,ffa,ffb);
+}
+
+void jit_alphablend_composite_float32_straight(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op)
+{
+	float *fip1=(float *)ip1,*fip2=(float *)ip2,*fop=(float *)op;
+	float aa,ab,fa,fb,ao;
+	long j,k;
+
+	JIT_ALPHABLEND_COMPOSITE_FLOAT_STRAIGHT(fip1,fip2,fop,ffa,ffb);
+}
+
+void jit_alphablend_composite_float64(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op)
+{
+	double *dip1=(double *)ip1,*dip2=(double *)ip2,*dop=(double *)op;
+	double aa,ab,fa,fb;
+	long j=0,k;
+
+	JIT_ALPHABLEND_COMPOSITE_FLOAT(dip1,dip2,dop,dfa,dfb);
+}
+
+void jit_alphablend_composite_float64_straight(t_jit_alphablend_vecdata *v, long n, long planecount, char *ip1, char *ip2, char *op)
+{
+	double *dip1=(double *)ip1,*dip2=(double *)ip2,*dop=(double *)op;
+	double aa,ab,fa,fb,ao;
+	long j,k;
+
+	JIT_ALPHABLEND_COMPOSITE_FLOAT_STRAIGHT(dip1,dip2,dop,dfa,dfb);
+}
+
 t_jit_alphablend *jit_alphablend_new(void)
 {
 	t_jit_alphablend *x;
 		
 	if (x=(t_jit_alphablend *)jit_object_alloc(_jit_alphablend_class)) {
 		x->mode = 0;
+		x->op = ps_blend;
+		x->premultiplied = 0;
 	} else {
 		x = NULL;
 	}	
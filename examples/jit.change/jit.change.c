@@ -1,5 +1,13 @@
 #include "jit.common.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIT_CHANGE_SSE2		1
+#include <emmintrin.h>
+#endif
+
+#define JIT_CHANGE_WORDBITS			((long)(sizeof(unsigned long)*8))
+#define JIT_CHANGE_MAX_DIRTYRECT	16384
+
 /* 
 	jit.change
 	Copyright 2001-2005 - Cycling '74
@@ -36,8 +44,38 @@ typedef struct _jit_change
 	long					thresh;
 	long					change;
 	char					mode;
+	char					dirty;
+	long					tilesizecount;
+	long					tilesize[2];
+	long					dirtyrectcount;
+	long					*dirtyrect;		//x y width height of each dirty rectangle, in cells. allocated once, 
+											//since the getter reads it from the main thread during a calc
+	long					*runs;			//rectangle open in each tile column, this row and the last
+	long					runssize;
 } t_jit_change;
 
+//shared by the dirty tile reduction callbacks
+typedef struct _jit_change_dirty
+{
+	t_symbol				*type;
+	long					cellsize;
+	long					simd;			//cellsize divides 16
+	long					cellbits;		//first byte of each cell in 16
+	long					thresh;
+	long					tilesize[2];
+	long					tilecount[2];	//tiles across and down
+	t_jit_matrix_info		*in_minfo;
+	t_jit_matrix_info		*out_minfo;
+	char					*out_bp;
+} t_jit_change_dirty;
+
+//per worker: changed cells counted so far, which stops at thresh+1, and a bit per dirty tile
+typedef struct _jit_change_tiles
+{
+	long					changed;
+	unsigned long			bits[1];
+} t_jit_change_tiles;
+
 typedef union _jit_change_vecdata
 {
 	t_jit_change_vecdata_char 		v_char;
@@ -65,6 +103,22 @@ t_jit_err jit_change_vector_long		(long n, t_jit_change_vecdata_long *vecdata, t
 t_jit_err jit_change_vector_float32		(long n, t_jit_change_vecdata_float32 *vecdata, t_jit_op_info *in, t_jit_op_info *out); 
 t_jit_err jit_change_vector_float64		(long n, t_jit_change_vecdata_float64 *vecdata, t_jit_op_info *in, t_jit_op_info *out);
 
+t_jit_err jit_change_dirty(t_jit_change *x, long dimcount, long *dim, long planecount, 
+	t_jit_matrix_info *in_minfo, char *in_bp, t_jit_matrix_info *out_minfo, char *out_bp);
+void jit_change_dirty_init(t_jit_change_dirty *d, t_jit_change_tiles *tiles);
+void jit_change_dirty_accumulate(t_jit_change_dirty *d, t_jit_change_tiles *tiles, long offset, long dimcount, 
+	long *dim, long planecount, t_jit_matrix_info *in_minfo, char *bip);
+void jit_change_dirty_combine(t_jit_change_dirty *d, t_jit_change_tiles *result, t_jit_change_tiles *tiles);
+void jit_change_dirty_ndim(t_jit_change_dirty *d, t_jit_change_tiles *tiles, long dimcount, long *dim, long row, 
+	char *bip, char *bop);
+void jit_change_dirty_row(t_jit_change_dirty *d, t_jit_change_tiles *tiles, long n, long col, long row, 
+	char *ip, char *op);
+long jit_change_cells(t_jit_change_dirty *d, char *ip, char *op, long n, long limit);
+long jit_change_cell(t_jit_change_dirty *d, char *ip, char *op);
+void jit_change_dirtyrects(t_jit_change *x, t_jit_change_dirty *d, t_jit_change_tiles *tiles, long width, long height);
+long jit_change_addrect(t_jit_change *x, long left, long top, long width, long height);
+t_jit_err jit_change_getdirtyrect(t_jit_change *x, void *attr, long *ac, t_atom **av);
+
 t_jit_err jit_change_init(void);
 //t_symbol *ps_change;
 
@@ -90,10 +144,20 @@ t_jit_err jit_change_init(void)
 	attr = jit_object_new(_jit_sym_jit_attr_offset,"mode",_jit_sym_char,attrflags,
 		(method)0L,(method)0L,calcoffset(t_jit_change,mode));
 	jit_class_addattr(_jit_change_class,attr);
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"dirty",_jit_sym_char,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_change,dirty));
+	jit_class_addattr(_jit_change_class,attr);
+	attr = jit_object_new(_jit_sym_jit_attr_offset_array,"tilesize",_jit_sym_long,2,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_change,tilesizecount),calcoffset(t_jit_change,tilesize));
+	jit_class_addattr(_jit_change_class,attr);
 	attrflags = JIT_ATTR_GET_OPAQUE_USER | JIT_ATTR_SET_OPAQUE_USER;
 	attr = jit_object_new(_jit_sym_jit_attr_offset,"change",_jit_sym_long,attrflags,
 		(method)0L,(method)0L,calcoffset(t_jit_change,change));
 	jit_class_addattr(_jit_change_class,attr);
+	attrflags = JIT_ATTR_GET_DEFER_LOW | JIT_ATTR_SET_OPAQUE_USER;
+	attr = jit_object_new(_jit_sym_jit_attr_offset_array,"dirtyrect",_jit_sym_long,JIT_CHANGE_MAX_DIRTYRECT*4,attrflags,
+		(method)jit_change_getdirtyrect,(method)0L,calcoffset(t_jit_change,dirtyrectcount),calcoffset(t_jit_change,dirtyrect));
+	jit_class_addattr(_jit_change_class,attr);
 	//add methods
 		
 	jit_class_register(_jit_change_class);
@@ -193,8 +257,11 @@ t_jit_err jit_change_matrix_calc(t_jit_change *x, void *inputs, void *outputs)
 			goto out;
 		}
 		
+		x->dirtyrectcount = 0;
 		if (x->thresh < 0) {
 			x->change = 1;
+			if (x->dirty) 
+				jit_change_addrect(x,0,0,in_minfo.dim[0],(in_minfo.dimcount>1)?in_minfo.dim[1]:1);
 			goto out;
 		}
 
@@ -204,6 +271,12 @@ t_jit_err jit_change_matrix_calc(t_jit_change *x, void *inputs, void *outputs)
 		for (i=0;i<dimcount;i++) {
 			dim[i] = MIN(in_minfo.dim[i],out_minfo.dim[i]);
 		}		
+		
+		//dirty tracking has to see every tile, so it can't stop at the first change
+		if (x->dirty) {
+			err = jit_change_dirty(x, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp);
+			goto out;
+		}
 				
 		if (in_minfo.type == _jit_sym_char)
 			jit_change_getvecdata_char(x,&vecdata.v_char,planecount);
@@ -555,6 +628,315 @@ t_jit_err jit_change_vector_float64(long n, t_jit_change_vecdata_float64 *vecdat
 	return 0; 
 }
 
+//compare the matrices tile by tile across workers, then join the dirty tiles into rectangles
+t_jit_err jit_change_dirty(t_jit_change *x, long dimcount, long *dim, long planecount, 
+	t_jit_matrix_info *in_minfo, char *in_bp, t_jit_matrix_info *out_minfo, char *out_bp)
+{
+	t_jit_change_dirty d;
+	t_jit_change_tiles *tiles;
+	t_jit_parallel_ndim_reduce reduce;
+	long width,height,words,statesize;
+	
+	width = dim[0];
+	height = (dimcount>1) ? dim[1] : 1;
+	d.type = in_minfo->type;
+	d.cellsize = in_minfo->dimstride[0];
+	d.thresh = x->thresh;
+	d.tilesize[0] = MAX(x->tilesize[0],1);
+	d.tilesize[1] = MAX(x->tilesize[1],1);
+	d.tilecount[0] = (width+d.tilesize[0]-1)/d.tilesize[0];
+	d.tilecount[1] = (height+d.tilesize[1]-1)/d.tilesize[1];
+	d.in_minfo = in_minfo;
+	d.out_minfo = out_minfo;
+	d.out_bp = out_bp;
+	switch (d.cellsize) {
+	case 1:		d.cellbits = 0xFFFF;	break;
+	case 2:		d.cellbits = 0x5555;	break;
+	case 4:		d.cellbits = 0x1111;	break;
+	case 8:		d.cellbits = 0x0101;	break;
+	case 16:	d.cellbits = 0x0001;	break;
+	default:	d.cellbits = 0;			break;
+	}
+	d.simd = (d.cellbits!=0);
+	
+	words = (d.tilecount[0]*d.tilecount[1]+JIT_CHANGE_WORDBITS-1)/JIT_CHANGE_WORDBITS;
+	statesize = sizeof(t_jit_change_tiles) + (MAX(words,1)-1)*sizeof(unsigned long);
+	if (!(tiles = jit_getbytes(statesize))) 
+		return JIT_ERR_OUT_OF_MEM;
+	reduce.data = &d;
+	reduce.statesize = statesize;
+	reduce.init = (method)jit_change_dirty_init;
+	reduce.accumulate = (method)jit_change_dirty_accumulate;
+	reduce.combine = (method)jit_change_dirty_combine;
+	jit_change_dirty_init(&d,tiles);
+	jit_parallel_ndim_reduce1(&reduce, tiles, dimcount, dim, planecount, in_minfo, in_bp, 
+		0 /* flags1 */);
+	
+	if (x->mode==1) {
+		if (tiles->changed<=d.thresh) 
+			x->change = 1;
+	} else {
+		if (tiles->changed>d.thresh) 
+			x->change = 1;
+	}
+	jit_change_dirtyrects(x,&d,tiles,width,height);
+	jit_freebytes(tiles,statesize);
+	
+	return JIT_ERR_NONE;
+}
+
+void jit_change_dirty_init(t_jit_change_dirty *d, t_jit_change_tiles *tiles)
+{
+	long i,words;
+	
+	words = (d->tilecount[0]*d->tilecount[1]+JIT_CHANGE_WORDBITS-1)/JIT_CHANGE_WORDBITS;
+	tiles->changed = 0;
+	for (i=0;i<words;i++) 
+		tiles->bits[i] = 0;
+}
+
+void jit_change_dirty_accumulate(t_jit_change_dirty *d, t_jit_change_tiles *tiles, long offset, long dimcount, 
+	long *dim, long planecount, t_jit_matrix_info *in_minfo, char *bip)
+{
+	//chunks are split along dim[1], or dim[0] for 1D matrices
+	if (dimcount>1) {
+		jit_change_dirty_ndim(d,tiles,dimcount,dim,offset,bip,d->out_bp+offset*d->out_minfo->dimstride[1]);
+	} else {
+		jit_change_dirty_row(d,tiles,dim[0],offset,0,bip,d->out_bp+offset*d->out_minfo->dimstride[0]);
+	}
+}
+
+void jit_change_dirty_combine(t_jit_change_dirty *d, t_jit_change_tiles *result, t_jit_change_tiles *tiles)
+{
+	long i,words;
+	
+	words = (d->tilecount[0]*d->tilecount[1]+JIT_CHANGE_WORDBITS-1)/JIT_CHANGE_WORDBITS;
+	result->changed = MIN(result->changed+tiles->changed,d->thresh+1);
+	for (i=0;i<words;i++) 
+		result->bits[i] |= tiles->bits[i];
+}
+
+//sections of higher dimensions all fall into the tiles of the first two
+void jit_change_dirty_ndim(t_jit_change_dirty *d, t_jit_change_tiles *tiles, long dimcount, long *dim, long row, 
+	char *bip, char *bop)
+{
+	long i;
+	
+	if (dimcount<=2) {
+		for (i=0;i<dim[1];i++) {
+			jit_change_dirty_row(d,tiles,dim[0],0,row+i,bip+i*d->in_minfo->dimstride[1],
+				bop+i*d->out_minfo->dimstride[1]);
+		}
+	} else {
+		for (i=0;i<dim[dimcount-1];i++) {
+			jit_change_dirty_ndim(d,tiles,dimcount-1,dim,row,bip+i*d->in_minfo->dimstride[dimcount-1],
+				bop+i*d->out_minfo->dimstride[dimcount-1]);
+		}
+	}
+}
+
+//n cells of a row starting at column col. once this worker has counted past thresh, tiles already
+//marked dirty are skipped and the rest only need one changed cell each
+void jit_change_dirty_row(t_jit_change_dirty *d, t_jit_change_tiles *tiles, long n, long col, long row, 
+	char *ip, char *op)
+{
+	long j,e,tile,limit,c;
+	unsigned long *word,bit;
+	
+	for (j=0;j<n;j=e) {
+		e = ((col+j)/d->tilesize[0]+1)*d->tilesize[0] - col;
+		if (e>n) e = n;
+		tile = (row/d->tilesize[1])*d->tilecount[0] + (col+j)/d->tilesize[0];
+		word = tiles->bits + tile/JIT_CHANGE_WORDBITS;
+		bit = 1UL<<(tile%JIT_CHANGE_WORDBITS);
+		if (tiles->changed>d->thresh) {
+			if (*word&bit) 
+				continue;
+			limit = 1;
+		} else {
+			limit = d->thresh + 1 - tiles->changed;
+		}
+		if (c=jit_change_cells(d,ip+j*d->cellsize,op+j*d->cellsize,e-j,limit)) {
+			*word |= bit;
+			tiles->changed += c;
+		}
+	}
+}
+
+#if JIT_CHANGE_SSE2
+
+//16 bytes of each matrix as a mask m with a bit per byte of a value that differs. floats are 
+//compared as floats, so that nan never equals itself and -0 equals 0, as in the vector functions
+#define JIT_CHANGE_DIFF_BYTES(m,a,b) \
+	m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)(a)),_mm_loadu_si128((__m128i *)(b)))) ^ 0xFFFF;
+#define JIT_CHANGE_DIFF_FLOAT32(m,a,b) \
+	m = _mm_movemask_epi8(_mm_castps_si128(_mm_cmpneq_ps(_mm_loadu_ps((float *)(a)),_mm_loadu_ps((float *)(b)))));
+#define JIT_CHANGE_DIFF_FLOAT64(m,a,b) \
+	m = _mm_movemask_epi8(_mm_castpd_si128(_mm_cmpneq_pd(_mm_loadu_pd((double *)(a)),_mm_loadu_pd((double *)(b)))));
+
+//count the changed cells 16 bytes at a time, or just find one when that is all that's needed
+#define JIT_CHANGE_BLOCKS(DIFF) \
+	for (k=0;k+16<=bytes;k+=16) { \
+		DIFF(m,ip+k,op+k); \
+		if (m) { \
+			if (limit==1) \
+				return 1; \
+			for (j=1;j<cs;j<<=1) \
+				m |= m>>j; \
+			for (m&=d->cellbits;m;m&=m-1) \
+				count++; \
+			if (count>=limit) \
+				return limit; \
+		} \
+	}
+
+#endif
+
+//changed cells in n cells of a row, counting no further than limit
+long jit_change_cells(t_jit_change_dirty *d, char *ip, char *op, long n, long limit)
+{
+	long j,k,m,cs=d->cellsize,bytes=n*cs,count=0;
+	
+#if JIT_CHANGE_SSE2
+	if (d->simd) {
+		if (d->type==_jit_sym_float32) {
+			JIT_CHANGE_BLOCKS(JIT_CHANGE_DIFF_FLOAT32);
+		} else if (d->type==_jit_sym_float64) {
+			JIT_CHANGE_BLOCKS(JIT_CHANGE_DIFF_FLOAT64);
+		} else {
+			JIT_CHANGE_BLOCKS(JIT_CHANGE_DIFF_BYTES);
+		}
+		ip += k;
+		op += k;
+		n -= k/cs;
+	}
+#endif
+	for (j=0;j<n;j++,ip+=cs,op+=cs) {
+		if (jit_change_cell(d,ip,op)) {
+			if (++count>=limit) 
+				return count;
+		}
+	}
+	return count;
+}
+
+//does any plane of the cell differ
+long jit_change_cell(t_jit_change_dirty *d, char *ip, char *op)
+{
+	long k;
+	
+	if (d->type==_jit_sym_float32) {
+		for (k=0;k<d->cellsize/sizeof(float);k++) 
+			if (((float *)ip)[k]!=((float *)op)[k]) return 1;
+	} else if (d->type==_jit_sym_float64) {
+		for (k=0;k<d->cellsize/sizeof(double);k++) 
+			if (((double *)ip)[k]!=((double *)op)[k]) return 1;
+	} else {
+		for (k=0;k<d->cellsize;k++) 
+			if (ip[k]!=op[k]) return 1;
+	}
+	return 0;
+}
+
+//runs of dirty tiles along each row of tiles become rectangles, and a run that spans the same 
+//columns as one in the row above extends that rectangle downwards
+void jit_change_dirtyrects(t_jit_change *x, t_jit_change_dirty *d, t_jit_change_tiles *tiles, long width, long height)
+{
+	long tx,ty,left,tile,i,*last,*cur,*t,*r;
+	
+	if (x->runssize<2*d->tilecount[0]) {
+		if (x->runs) 
+			jit_freebytes(x->runs,x->runssize*sizeof(long));
+		x->runssize = 2*d->tilecount[0];
+		if (!(x->runs = jit_getbytes(x->runssize*sizeof(long)))) {
+			x->runssize = 0;
+			return;
+		}
+	}
+	last = x->runs;
+	cur = x->runs + d->tilecount[0];
+	for (tx=0;tx<d->tilecount[0];tx++) 
+		last[tx] = 0;
+	for (ty=0;ty<d->tilecount[1];ty++) {
+		for (tx=0;tx<d->tilecount[0];) {
+			tile = ty*d->tilecount[0] + tx;
+			cur[tx] = 0;
+			if (!(tiles->bits[tile/JIT_CHANGE_WORDBITS]&(1UL<<(tile%JIT_CHANGE_WORDBITS)))) {
+				tx++;
+				continue;
+			}
+			left = tx;
+			do {
+				cur[tx++] = 0;
+				tile++;
+			} while ((tx<d->tilecount[0])&&(tiles->bits[tile/JIT_CHANGE_WORDBITS]&(1UL<<(tile%JIT_CHANGE_WORDBITS))));
+			//runs are kept as 1 + the index of their rectangle's first long
+			if ((i=last[left])) {
+				r = x->dirtyrect + i - 1;
+				//only extend the rectangle above if it spans the same columns
+				if (r[2]!=MIN(tx*d->tilesize[0],width)-r[0])
+					i = 0;
+			}
+			if (i) {
+				r[3] = MIN((ty+1)*d->tilesize[1],height) - r[1];
+			} else {
+				i = x->dirtyrectcount + 1;
+				if (!jit_change_addrect(x,left*d->tilesize[0],ty*d->tilesize[1],
+					MIN(tx*d->tilesize[0],width)-left*d->tilesize[0],MIN((ty+1)*d->tilesize[1],height)-ty*d->tilesize[1])) {
+					//too many rectangles, so report the whole matrix instead
+					x->dirtyrectcount = 0;
+					jit_change_addrect(x,0,0,width,height);
+					return;
+				}
+			}
+			cur[left] = i;
+		}
+		t = last; last = cur; cur = t;
+	}
+}
+
+//returns 0 if there is no room left
+long jit_change_addrect(t_jit_change *x, long left, long top, long width, long height)
+{
+	long *r;
+	
+	if (x->dirtyrectcount+4>JIT_CHANGE_MAX_DIRTYRECT*4) 
+		return 0;
+	r = x->dirtyrect + x->dirtyrectcount;
+	r[0] = left;
+	r[1] = top;
+	r[2] = width;
+	r[3] = height;
+	x->dirtyrectcount += 4;
+	return 1;
+}
+
+t_jit_err jit_change_getdirtyrect(t_jit_change *x, void *attr, long *ac, t_atom **av)
+{
+	long i;
+	
+	if ((*ac)&&(*av)) {
+		//memory passed in, use it
+	} else {
+		//otherwise allocate memory
+		*ac = x->dirtyrectcount;
+		if (!(*ac)) {
+			*av = NULL;
+			return JIT_ERR_NONE;
+		}
+		if (!(*av = jit_getbytes(sizeof(t_atom)*(*ac)))) {
+			*ac = 0;
+			return JIT_ERR_OUT_OF_MEM;
+		}
+	}
+	*ac = MIN(*ac,x->dirtyrectcount);
+	for (i=0;i<(*ac);i++) {
+		jit_atom_setlong((*av)+i,x->dirtyrect[i]);
+	}
+	
+	return JIT_ERR_NONE;
+}
+
 t_jit_change *jit_change_new(void)
 {
 	t_jit_change *x;
@@ -564,6 +946,16 @@ t_jit_change *jit_change_new(void)
 		x->thresh = 0;
 		x->change = 0;
 		x->mode = 0;
+		x->dirty = 0;
+		x->tilesizecount = 2;
+		x->tilesize[0] = x->tilesize[1] = 16;
+		x->dirtyrectcount = 0;
+		x->runs = NULL;
+		x->runssize = 0;
+		if (!(x->dirtyrect=jit_getbytes(JIT_CHANGE_MAX_DIRTYRECT*4*sizeof(long)))) {
+			jit_object_free(x);
+			x = NULL;
+		}
 	} else {
 		x = NULL;
 	}	
@@ -572,5 +964,8 @@ t_jit_change *jit_change_new(void)
 
 void jit_change_free(t_jit_change *x)
 {
-	//nada
+	if (x->dirtyrect) 
+		jit_freebytes(x->dirtyrect,JIT_CHANGE_MAX_DIRTYRECT*4*sizeof(long));
+	if (x->runs) 
+		jit_freebytes(x->runs,x->runssize*sizeof(long));
 }
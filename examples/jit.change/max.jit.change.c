@@ -20,7 +20,7 @@ void max_jit_change_mproc(t_max_jit_change *x, void *mop);
 void max_jit_change_free(t_max_jit_change *x);
 void *max_jit_change_class;
 
-t_symbol *ps_change;
+t_symbol *ps_change, *ps_dirty, *ps_getdirtyrect, *ps_dirtyrect;
 
 void main(void)
 {	
@@ -45,6 +45,9 @@ void main(void)
     addmess((method)max_jit_mop_assist, "assist", A_CANT,0);
     
     ps_change = gensym("change");
+    ps_dirty = gensym("dirty");
+    ps_getdirtyrect = gensym("getdirtyrect");
+    ps_dirtyrect = gensym("dirtyrect");
 }
 
 void max_jit_change_mproc(t_max_jit_change *x, void *mop)
@@ -65,6 +68,15 @@ void max_jit_change_mproc(t_max_jit_change *x, void *mop)
 			p=jit_object_method(jit_object_method(mop,_jit_sym_getinputlist),_jit_sym_getindex,0);;
 			r=jit_object_method(jit_object_method(mop,_jit_sym_getoutputlist),_jit_sym_getindex,0);;
 			jit_object_method(r,_jit_sym_frommatrix,p,NULL);
+			if (jit_attr_getlong(o,ps_dirty)) { // x y width height of each changed region, ahead of the matrix
+				long ac=0;
+				t_atom *av=NULL;
+				
+				jit_object_method(o,ps_getdirtyrect,&ac,&av);
+				max_jit_obex_dumpout(x, ps_dirtyrect, ac, av);
+				if (av) 
+					jit_freebytes(av,sizeof(t_atom)*ac);
+			}
 			max_jit_mop_outputmatrix(x);
 			if (x->report) { // matrices are _not_ equal
 				t_atom a;
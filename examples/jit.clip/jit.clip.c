@@ -4,6 +4,7 @@
 */
 
 #include "jit.common.h"
+#include "common/jit.charlut.h"
 
 typedef struct _jit_clip_vecdata
 {
@@ -13,6 +14,7 @@ typedef struct _jit_clip_vecdata
 	long				lmax;
 	long				cmin;
 	long				cmax;
+	t_jit_charlut		*lut;
 } t_jit_clip_vecdata;
 
 typedef struct _jit_clip 
@@ -20,6 +22,9 @@ typedef struct _jit_clip
 	t_object				ob;
 	double					min;
 	double					max;
+	t_jit_charlut			lut;		//char results
+	long					lutcmin;	//char range the table was built from
+	long					lutcmax;
 } t_jit_clip;
 
 void *_jit_clip_class;
@@ -29,6 +34,7 @@ t_jit_clip *jit_clip_new(void);
 void jit_clip_free(t_jit_clip *x);
 t_jit_err jit_clip_getvecdata(t_jit_clip *x, t_jit_clip_vecdata *vd);
 t_jit_err jit_clip_matrix_calc(t_jit_clip *x, void *inputs, void *outputs);
+void jit_clip_charlut(t_jit_clip *x, t_jit_clip_vecdata *vecdata);
 
 void jit_clip_calculate_ndim(t_jit_clip_vecdata *vecdata, long dim, long *dimsize, long planecount, t_jit_matrix_info *in_minfo, char *bip, 
 	t_jit_matrix_info *out_minfo, char *bop);
@@ -64,6 +70,29 @@ t_jit_err jit_clip_init(void)
 	return JIT_ERR_NONE;
 }
 
+//run every char value through the vector function once, whenever the range has 
+//changed since the table was built
+void jit_clip_charlut(t_jit_clip *x, t_jit_clip_vecdata *vecdata)
+{
+	long i;
+	t_jit_op_info in_opinfo,out_opinfo;
+	t_jit_charlut *lut=&x->lut;
+	
+	if (lut->valid&&(vecdata->cmin==x->lutcmin)&&(vecdata->cmax==x->lutcmax))
+		return;
+	
+	for (i=0;i<256;i++) 
+		lut->table[1][i] = i;
+	in_opinfo.p = lut->table[1];
+	out_opinfo.p = lut->table[0];
+	in_opinfo.stride = out_opinfo.stride = 1;
+	jit_clip_vector_char(256,vecdata,&in_opinfo,&out_opinfo);
+	x->lutcmin = vecdata->cmin;
+	x->lutcmax = vecdata->cmax;
+	lut->tablecount = 1;
+	lut->valid = 1;
+}
+
 t_jit_err jit_clip_getvecdata(t_jit_clip *x, t_jit_clip_vecdata *vd)
 {
 	if (x&&vd) {
@@ -127,6 +156,9 @@ t_jit_err jit_clip_matrix_calc(t_jit_clip *x, void *inputs, void *outputs)
 		}
 				
 		jit_clip_getvecdata(x,&vecdata);
+		if (in_minfo.type==_jit_sym_char) 
+			jit_clip_charlut(x,&vecdata);
+		vecdata.lut = &x->lut;
 		jit_parallel_ndim_simplecalc2((method)jit_clip_calculate_ndim,
 			&vecdata, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp,
 			0 /* flags1 */, 0 /* flags2 */);
@@ -172,7 +204,7 @@ void jit_clip_calculate_ndim(t_jit_clip_vecdata *vecdata, long dimcount, long *d
 				for (j=0;j<planecount;j++) {
 					in_opinfo.p  = bip + i*in_minfo->dimstride[1] + j%in_minfo->planecount;
 					out_opinfo.p = bop + i*out_minfo->dimstride[1] + j%out_minfo->planecount;
-					jit_clip_vector_char(n,vecdata,&in_opinfo,&out_opinfo);
+					jit_charlut_vector(n,vecdata->lut,&in_opinfo,&out_opinfo);
 				}
 			}
 		} else if (in_minfo->type==_jit_sym_long) {
@@ -329,6 +361,7 @@ t_jit_clip *jit_clip_new(void)
 	if (x=(t_jit_clip *)jit_object_alloc(_jit_clip_class)) {
 		x->min = 0.;
 		x->max = 1.;
+		x->lut.valid = 0;
 	} else {
 		x = NULL;
 	}	
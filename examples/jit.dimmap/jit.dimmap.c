@@ -4,6 +4,7 @@
 */
 
 #include "jit.common.h"
+#include <string.h>
 
 typedef struct _jit_dimmap 
 {
@@ -22,7 +23,8 @@ void jit_dimmap_free(t_jit_dimmap *x);
 t_jit_err jit_dimmap_matrix_calc(t_jit_dimmap *x, void *inputs, void *outputs);
 t_jit_err jit_dimmap_map(t_jit_dimmap *x, void *attr, long argc, t_atom *argv);
 
-void jit_dimmap_calculate_ndim(long dim, long *dimsize, long planecount, void *vecdata, t_jit_matrix_info *in_minfo, char *bip, 
+t_jit_err jit_dimmap_direct(t_jit_dimmap *x, t_jit_matrix_info *in_minfo, char *in_bp, void *out_matrix);
+void jit_dimmap_calculate_ndim(void *vecdata, long dim, long *dimsize, long planecount, t_jit_matrix_info *in_minfo, char *bip, 
 	t_jit_matrix_info *out_minfo, char *bop);
 
 t_jit_err jit_dimmap_init(void) 
@@ -106,6 +108,11 @@ t_jit_err jit_dimmap_matrix_calc(t_jit_dimmap *x, void *inputs, void *outputs)
 		jit_object_method(in_matrix,_jit_sym_getdata,&in_bp);
 		
 		if (!in_bp) { err = JIT_ERR_INVALID_INPUT; goto out; }
+		
+		//copy straight into the output when it can hold the input's cells as they are
+		if ((err=jit_dimmap_direct(x,&in_minfo,in_bp,out_matrix))!=JIT_ERR_MISMATCH_TYPE)
+			goto out;
+		err = JIT_ERR_NONE;
 
 		tmp_minfo = in_minfo;
 		tmp_minfo.flags = JIT_MATRIX_DATA_REFERENCE|JIT_MATRIX_DATA_FLAGS_USE;
@@ -159,6 +166,129 @@ out:
 
 }
 
+//sets up the output and copies into it directly, visiting the input in output order. returns 
+//JIT_ERR_MISMATCH_TYPE without touching the data if the output ends up with a different type, 
+//planecount or cell layout, so that frommatrix can convert instead
+t_jit_err jit_dimmap_direct(t_jit_dimmap *x, t_jit_matrix_info *in_minfo, char *in_bp, void *out_matrix)
+{
+	t_jit_err err=JIT_ERR_NONE;
+	long i,k,tmp,out_savelock,cellsize,dim[JIT_MATRIX_MAX_DIMCOUNT];
+	t_jit_matrix_info view_minfo,out_minfo;
+	char *view_bp,*out_bp;
+
+	//the input as it would look with the output's dimension order. inverted dimensions
+	//start at their last cell and step backwards
+	view_minfo = *in_minfo;
+	view_bp = in_bp;
+	view_minfo.dimcount = x->mapcount;
+	for (i=0;i<x->mapcount;i++) {
+		if ((x->map[i]>=in_minfo->dimcount)||(x->map[i]<0)) {
+			view_minfo.dim[i] 		= 1;
+			view_minfo.dimstride[i] = 0;
+		} else {
+			view_minfo.dim[i] 		= in_minfo->dim[x->map[i]];
+			view_minfo.dimstride[i] = (view_minfo.dim[i]>1) ? in_minfo->dimstride[x->map[i]] : 0;
+			if ((i<x->invertcount)&&x->invert[i]) {
+				view_bp += (view_minfo.dim[i]-1)*view_minfo.dimstride[i];
+				view_minfo.dimstride[i] = -view_minfo.dimstride[i];
+			}
+		}
+	}
+	
+	out_savelock = (long) jit_object_method(out_matrix,_jit_sym_lock,1);
+	out_minfo = view_minfo;
+	out_minfo.flags = 0;
+	err = (t_jit_err) jit_object_method(out_matrix,_jit_sym_setinfo,&out_minfo);
+	if (err) goto out;
+	jit_object_method(out_matrix,_jit_sym_getinfo,&out_minfo);
+	jit_object_method(out_matrix,_jit_sym_getdata,&out_bp);
+	if (!out_bp) { err = JIT_ERR_INVALID_OUTPUT; goto out; }
+	
+	cellsize = jit_matrix_info_typesize(in_minfo)*in_minfo->planecount;
+	if ((out_minfo.type!=in_minfo->type)||(out_minfo.planecount!=in_minfo->planecount)||
+		(out_minfo.dimcount!=view_minfo.dimcount)||(out_minfo.dimstride[0]!=cellsize)) 
+	{
+		err = JIT_ERR_MISMATCH_TYPE;
+		goto out;
+	}
+	for (i=0;i<out_minfo.dimcount;i++) {
+		dim[i] = MIN(out_minfo.dim[i],view_minfo.dim[i]);
+	}
+	
+	//output rows are contiguous. if input rows are not, bring the output dimension that 
+	//walks the input contiguously next to them, so that each 2d section is a transpose
+	//of whole cells. jit_parallel then splits that dimension across processors
+	if ((view_minfo.dimstride[0]!=cellsize)&&(dim[0]>1)) {
+		for (k=1;k<out_minfo.dimcount;k++) {
+			if ((view_minfo.dimstride[k]==cellsize)&&(dim[k]>1)) {
+				tmp = dim[1]; dim[1] = dim[k]; dim[k] = tmp;
+				tmp = view_minfo.dim[1]; view_minfo.dim[1] = view_minfo.dim[k]; view_minfo.dim[k] = tmp;
+				tmp = view_minfo.dimstride[1]; view_minfo.dimstride[1] = view_minfo.dimstride[k]; view_minfo.dimstride[k] = tmp;
+				tmp = out_minfo.dim[1]; out_minfo.dim[1] = out_minfo.dim[k]; out_minfo.dim[k] = tmp;
+				tmp = out_minfo.dimstride[1]; out_minfo.dimstride[1] = out_minfo.dimstride[k]; out_minfo.dimstride[k] = tmp;
+				break;
+			}
+		}
+	}
+	
+	jit_parallel_ndim_simplecalc2((method)jit_dimmap_calculate_ndim,
+		NULL, out_minfo.dimcount, dim, out_minfo.planecount, &view_minfo, view_bp, &out_minfo, out_bp,
+		0 /* flags1 */, 0 /* flags2 */);
+
+out:
+	jit_object_method(out_matrix,_jit_sym_lock,out_savelock);
+	return err;
+}
+
+//in_minfo is the input seen in output order (see jit_dimmap_direct), so both sides step 
+//through the same dimensions, with the input's strides possibly negative. cells are whole
+void jit_dimmap_calculate_ndim(void *vecdata, long dimcount, long *dim, long planecount, t_jit_matrix_info *in_minfo, char *bip, 
+	t_jit_matrix_info *out_minfo, char *bop)
+{
+	long i,j,n,cellsize,is,os;
+	char *ip,*op;
+		
+	if (dimcount<1) return; //safety
+	
+	switch(dimcount) {
+	case 1:
+		dim[1] = 1;
+	case 2:
+		n = dim[0];
+		cellsize = out_minfo->dimstride[0];
+		is = in_minfo->dimstride[0];
+		if (is==cellsize) {
+			//rows line up
+			for (i=0;i<dim[1];i++) 
+				memcpy(bop + i*out_minfo->dimstride[1],bip + i*in_minfo->dimstride[1],n*cellsize);
+		} else if ((in_minfo->dimstride[1]==cellsize)&&(n>1)) {
+			//swapped dimensions, in cache sized blocks
+			jit_transpose_simd_cells(dim[1],n,cellsize,bip,is,bop,out_minfo->dimstride[1]);
+		} else {
+			//anything else, a cell at a time
+			os = cellsize;
+			for (i=0;i<dim[1];i++) {
+				ip = bip + i*in_minfo->dimstride[1];
+				op = bop + i*out_minfo->dimstride[1];
+				switch (cellsize) {
+				case 1:	for (j=0;j<n;j++,ip+=is,op+=os) *op = *ip;				break;
+				case 4:	for (j=0;j<n;j++,ip+=is,op+=os) memcpy(op,ip,4);		break;
+				case 8:	for (j=0;j<n;j++,ip+=is,op+=os) memcpy(op,ip,8);		break;
+				case 16:for (j=0;j<n;j++,ip+=is,op+=os) memcpy(op,ip,16);		break;
+				default:for (j=0;j<n;j++,ip+=is,op+=os) memcpy(op,ip,cellsize);	break;
+				}
+			}
+		}
+		break;
+	default:
+		for	(i=0;i<dim[dimcount-1];i++) {
+			ip = bip + i*in_minfo->dimstride[dimcount-1];
+			op = bop + i*out_minfo->dimstride[dimcount-1];
+			jit_dimmap_calculate_ndim(vecdata,dimcount-1,dim,planecount,in_minfo,ip,out_minfo,op);
+		}
+	}
+}
+
 t_jit_dimmap *jit_dimmap_new(void)
 {
 	t_jit_dimmap *x;
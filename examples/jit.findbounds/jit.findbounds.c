@@ -5,6 +5,11 @@
 
 #include "jit.common.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIT_FINDBOUNDS_SSE2		1
+#include <emmintrin.h>
+#endif
+
 typedef struct _jit_findbounds_vecdata_char
 {
 	long				boundmin[JIT_MATRIX_MAX_DIMCOUNT];
@@ -58,6 +63,29 @@ typedef struct _jit_findbounds
 	long		boundmax[JIT_MATRIX_MAX_DIMCOUNT];
 } t_jit_findbounds;
 
+//shared by the reduction callbacks
+typedef struct _jit_findbounds_reduce
+{
+	t_jit_findbounds			*x;
+	t_jit_findbounds_vecdata	*seed;		//thresholds, bounds unset
+	long						dimcount;
+	long						splitdim;	//dimension the chunk offsets refer to
+} t_jit_findbounds_reduce;
+
+//thresholds for scanning a row, laid out for the vector compares
+typedef struct _jit_findbounds_scan
+{
+	t_symbol					*type;
+	long						planecount;
+	long						simd;		//planecount 1, 2 or 4
+	t_jit_findbounds_vecdata	*vecdata;
+#if JIT_FINDBOUNDS_SSE2
+	__m128i						imin,imax;	//char, long
+	__m128						fmin,fmax;	//float32
+	__m128d						dmin[2],dmax[2];	//float64, even and odd vectors
+#endif
+} t_jit_findbounds_scan;
+
 t_jit_err jit_findbounds_init(void); 
 t_jit_err jit_findbounds_matrix_calc(t_jit_findbounds *x, void *inputs, void *outputs);
 
@@ -67,20 +95,19 @@ t_jit_findbounds *jit_findbounds_new(void);
 void jit_findbounds_free(t_jit_findbounds *x);
 void jit_findbounds_precalc(t_jit_findbounds *x, t_jit_findbounds_vecdata *vecdata, t_jit_matrix_info *in_minfo);
 void jit_findbounds_postcalc(t_jit_findbounds *x, t_jit_findbounds_vecdata *vecdata, t_jit_matrix_info *in_minfo);
+void jit_findbounds_merge(t_jit_findbounds_vecdata *dst, t_jit_findbounds_vecdata *src, long dimcount, long splitdim, long offset);
+void jit_findbounds_reduce_init(t_jit_findbounds_reduce *r, t_jit_findbounds_vecdata *vecdata);
+void jit_findbounds_reduce_accumulate(t_jit_findbounds_reduce *r, t_jit_findbounds_vecdata *vecdata, long offset, long dimcount, 
+	long *dim, long planecount, t_jit_matrix_info *in_minfo, char *bip);
+void jit_findbounds_reduce_combine(t_jit_findbounds_reduce *r, t_jit_findbounds_vecdata *result, t_jit_findbounds_vecdata *vecdata);
 long jit_findbounds_calculate_ndim(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
 	t_jit_matrix_info *in_minfo, char *bip);
-long jit_findbounds_calc2d_char_plane0(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip); 
-long jit_findbounds_calc2d_char_plane4(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip); 
-long jit_findbounds_calc2d_char(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip); 
-long jit_findbounds_calc2d_long(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip);
-long jit_findbounds_calc2d_float32(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip);
-long jit_findbounds_calc2d_float64(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
+long jit_findbounds_calc2d(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
 	t_jit_matrix_info *in_minfo, char *bip);
+void jit_findbounds_scan_init(t_jit_findbounds_scan *s, t_jit_findbounds_vecdata *vecdata, t_jit_matrix_info *in_minfo);
+long jit_findbounds_hit(t_jit_findbounds_scan *s, char *ip, long j);
+long jit_findbounds_first(t_jit_findbounds_scan *s, char *ip, long a, long b);
+long jit_findbounds_last(t_jit_findbounds_scan *s, char *ip, long a, long b);
 
 t_jit_err jit_findbounds_init(void) 
 {
@@ -125,6 +152,8 @@ t_jit_err jit_findbounds_matrix_calc(t_jit_findbounds *x, void *inputs, void *ou
 	long i,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
 	t_jit_findbounds_vecdata vd;
 	void *in_matrix;
+	t_jit_findbounds_reduce r;
+	t_jit_parallel_ndim_reduce reduce;
 	
 	in_matrix 	= jit_object_method(inputs,_jit_sym_getindex,0);
 	
@@ -142,9 +171,24 @@ t_jit_err jit_findbounds_matrix_calc(t_jit_findbounds *x, void *inputs, void *ou
 			dim[i] = in_minfo.dim[i];
 		}		
 		
-		//calculate
+		//calculate. 1D and 2D input is searched in chunks across workers and the bounds 
+		//merged afterwards. higher dimensions keep the serial path.
 		jit_findbounds_precalc(x, &vd, &in_minfo);
-		jit_findbounds_calculate_ndim(x, in_minfo.dimcount, dim, &vd, &in_minfo, in_bp);
+		if (in_minfo.dimcount<=2) {
+			r.x = x;
+			r.seed = &vd;
+			r.dimcount = in_minfo.dimcount;
+			r.splitdim = (in_minfo.dimcount>1) ? 1 : 0;
+			reduce.data = &r;
+			reduce.statesize = sizeof(t_jit_findbounds_vecdata);
+			reduce.init = (method)jit_findbounds_reduce_init;
+			reduce.accumulate = (method)jit_findbounds_reduce_accumulate;
+			reduce.combine = (method)jit_findbounds_reduce_combine;
+			jit_parallel_ndim_reduce1(&reduce, &vd, in_minfo.dimcount, dim, in_minfo.planecount, &in_minfo, in_bp, 
+				0 /* flags1 */);
+		} else {
+			jit_findbounds_calculate_ndim(x, in_minfo.dimcount, dim, &vd, &in_minfo, in_bp);
+		}
 		jit_findbounds_postcalc(x, &vd, &in_minfo);
 	} else {
 		return JIT_ERR_INVALID_PTR;
@@ -197,6 +241,43 @@ void jit_findbounds_postcalc(t_jit_findbounds *x, t_jit_findbounds_vecdata *vecd
 	}
 }
 
+//widen dst by the bounds found in src, whose splitdim coordinates start at offset (exploiting the union)
+void jit_findbounds_merge(t_jit_findbounds_vecdata *dst, t_jit_findbounds_vecdata *src, long dimcount, long splitdim, long offset)
+{
+	long i,min,max;
+	
+	for (i=0;i<dimcount;i++) {
+		if (src->v_char.boundmin[i]==-1)
+			continue;
+		min = src->v_char.boundmin[i] + ((i==splitdim) ? offset : 0);
+		max = src->v_char.boundmax[i] + ((i==splitdim) ? offset : 0);
+		if ((dst->v_char.boundmin[i]==-1)||(min<dst->v_char.boundmin[i]))
+			dst->v_char.boundmin[i] = min;
+		if ((dst->v_char.boundmax[i]==-1)||(max>dst->v_char.boundmax[i]))
+			dst->v_char.boundmax[i] = max;
+	}
+}
+
+void jit_findbounds_reduce_init(t_jit_findbounds_reduce *r, t_jit_findbounds_vecdata *vecdata)
+{
+	*vecdata = *r->seed;
+}
+
+void jit_findbounds_reduce_accumulate(t_jit_findbounds_reduce *r, t_jit_findbounds_vecdata *vecdata, long offset, long dimcount, 
+	long *dim, long planecount, t_jit_matrix_info *in_minfo, char *bip)
+{
+	t_jit_findbounds_vecdata chunk;
+	
+	//the 2D search overwrites the bounds, so run it on a fresh copy and merge what it finds
+	chunk = *r->seed;
+	if (jit_findbounds_calculate_ndim(r->x,dimcount,dim,&chunk,in_minfo,bip))
+		jit_findbounds_merge(vecdata,&chunk,r->dimcount,r->splitdim,offset);
+}
+
+void jit_findbounds_reduce_combine(t_jit_findbounds_reduce *r, t_jit_findbounds_vecdata *result, t_jit_findbounds_vecdata *vecdata)
+{
+	jit_findbounds_merge(result,vecdata,r->dimcount,r->splitdim,0);
+}
 
 //recursive function to handle higher dimension matrices, by processing 2D sections at a time 
 long jit_findbounds_calculate_ndim(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
@@ -205,6 +286,7 @@ long jit_findbounds_calculate_ndim(t_jit_findbounds *x, long dimcount, long *dim
 	long i,n;
 	long boundmin,boundmax,inrange0=FALSE,inrange=FALSE;
 	uchar *ip;
+	t_jit_findbounds_vecdata slice,section;
 	
 	if (dimcount<1) return FALSE; //safety
 	
@@ -212,37 +294,29 @@ long jit_findbounds_calculate_ndim(t_jit_findbounds *x, long dimcount, long *dim
 	case 1:
 		dim[1] = 1;
 	case 2:
-		if (in_minfo->type==_jit_sym_char) {
-			switch(in_minfo->planecount) {
-			case 0:
-				inrange = jit_findbounds_calc2d_char_plane0(x,dimcount,dim,vecdata,in_minfo,bip);
-				break;
-			case 4:
-				inrange = jit_findbounds_calc2d_char_plane4(x,dimcount,dim,vecdata,in_minfo,bip);
-				break;
-			default:
-				inrange = jit_findbounds_calc2d_char(x,dimcount,dim,vecdata,in_minfo,bip);
-				break;
-			}	
-		} else if (in_minfo->type==_jit_sym_long) {
-			inrange = jit_findbounds_calc2d_long(x,dimcount,dim,vecdata,in_minfo,bip);
-		} else if (in_minfo->type==_jit_sym_float32) {
-			inrange = jit_findbounds_calc2d_float32(x,dimcount,dim,vecdata,in_minfo,bip);
-		} else if (in_minfo->type==_jit_sym_float64) {
-			inrange = jit_findbounds_calc2d_float64(x,dimcount,dim,vecdata,in_minfo,bip);
+		if ((in_minfo->type==_jit_sym_char)||(in_minfo->type==_jit_sym_long)||
+			(in_minfo->type==_jit_sym_float32)||(in_minfo->type==_jit_sym_float64)) 
+		{
+			inrange = jit_findbounds_calc2d(x,dimcount,dim,vecdata,in_minfo,bip);
 		} 
 		break;
 	default:
+		//each section is searched on a copy with its bounds unset, and merged in
+		slice = *vecdata;
+		for (i=0;i<dimcount-1;i++) 
+			slice.v_char.boundmin[i] = slice.v_char.boundmax[i] = -1;
 		for	(i=0;i<dim[dimcount-1];i++) {
 			ip = bip + i*in_minfo->dimstride[dimcount-1];
-			inrange0 = jit_findbounds_calculate_ndim(x,dimcount-1,dim,vecdata,in_minfo,ip);
+			section = slice;
+			inrange0 = jit_findbounds_calculate_ndim(x,dimcount-1,dim,&section,in_minfo,ip);
 			//exploiting the union
 			if (inrange0) {
 				inrange = TRUE;
+				jit_findbounds_merge(vecdata,&section,dimcount-1,-1,0);
 				if ((vecdata->v_char.boundmin[dimcount-1]==-1)||
 					(i<vecdata->v_char.boundmin[dimcount-1])) 
 					vecdata->v_char.boundmin[dimcount-1] = i;
-				else if (i>vecdata->v_char.boundmax[dimcount-1]) 
+				if (i>vecdata->v_char.boundmax[dimcount-1]) 
 					vecdata->v_char.boundmax[dimcount-1] = i;
 			}
 		}
@@ -251,303 +325,253 @@ long jit_findbounds_calculate_ndim(t_jit_findbounds *x, long dimcount, long *dim
 	return inrange;
 }
 
-long jit_findbounds_calc2d_char_plane0(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
+//the bounds are found from the outside in. the first row with a hit is searched for from the 
+//top and the last from the bottom, then the rows between them only need the cells to the left
+//and right of the columns found so far. the inside of the box is never read
+long jit_findbounds_calc2d(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
 	t_jit_matrix_info *in_minfo, char *bip) 
 {
-	long i,j,n,cmin,cmax;
-	long min0,min1,max0,max1,inrange0,inrange1,inrange2;
-	uchar *ip;
-	
-	inrange2 = FALSE;
+	long i,j,n,top,bottom,min0,max0;
+	char *ip;
+	t_jit_findbounds_scan s;
 	
 	n = dim[0];
-	cmin = vecdata->v_char.min[0];
-	cmax = vecdata->v_char.max[0];
-	min0 = min1 = 0x7FFFFFFF;
-	max0 = max1 = -1;
-	for (i=0;i<dim[1];i++) {
-		ip = bip + i*in_minfo->dimstride[1];
-		inrange1 = FALSE;
-		for (j=0;j<n;j++) {
-			inrange0 = TRUE;
-			if (*ip<cmin) inrange0 = FALSE;
-			else if (*ip>cmax) inrange0 = FALSE;
-			ip++;
-			if (inrange0) {
-				inrange1 = TRUE;
-				if (j<min0) min0 = j;
-				if (j>max0) max0 = j;
-			}
+	jit_findbounds_scan_init(&s,vecdata,in_minfo);
+	min0 = max0 = -1;
+	for (top=0;top<dim[1];top++) {
+		ip = bip + top*in_minfo->dimstride[1];
+		if ((min0=jit_findbounds_first(&s,ip,0,n))>=0) {
+			max0 = jit_findbounds_last(&s,ip,min0,n);
+			break;
 		}
-		if (inrange1) {
-			inrange2 = TRUE; 
-			if (i<min1) min1 = i;
-			if (i>max1) max1 = i;
+	}
+	if (min0<0) 
+		return FALSE;
+	for (bottom=dim[1]-1;bottom>top;bottom--) {
+		ip = bip + bottom*in_minfo->dimstride[1];
+		if ((j=jit_findbounds_first(&s,ip,0,n))>=0) {
+			if (j<min0) min0 = j;
+			j = jit_findbounds_last(&s,ip,j,n);
+			if (j>max0) max0 = j;
+			break;
 		}
 	}
-	if (min0<0x7FFFFFFF) vecdata->v_char.boundmin[0] = min0;
-	if (min1<0x7FFFFFFF) vecdata->v_char.boundmin[1] = min1;
-	if (max0>-1) vecdata->v_char.boundmax[0] = max0;
-	else vecdata->v_char.boundmax[0] = vecdata->v_char.boundmin[0];
-	if (max1>-1) vecdata->v_char.boundmax[1] = max1;
-	else vecdata->v_char.boundmax[1] = vecdata->v_char.boundmin[1];
+	for (i=top+1;i<bottom;i++) {
+		ip = bip + i*in_minfo->dimstride[1];
+		if (min0>0&&(j=jit_findbounds_first(&s,ip,0,min0))>=0) 
+			min0 = j;
+		if (max0<n-1&&(j=jit_findbounds_last(&s,ip,max0+1,n))>=0) 
+			max0 = j;
+	}
+	//exploiting the union
+	vecdata->v_char.boundmin[0] = min0;
+	vecdata->v_char.boundmax[0] = max0;
+	vecdata->v_char.boundmin[1] = top;
+	vecdata->v_char.boundmax[1] = bottom;
 	
-	return inrange2;
+	return TRUE;
 }
 
-long jit_findbounds_calc2d_char_plane4(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip) 
+void jit_findbounds_scan_init(t_jit_findbounds_scan *s, t_jit_findbounds_vecdata *vecdata, t_jit_matrix_info *in_minfo)
 {
-	long i,j,n,cmin0,cmax0,cmin1,cmax1,cmin2,cmax2,cmin3,cmax3;
-	long min0,min1,max0,max1,inrange0,inrange1,inrange2;
-	uchar *ip;
-	
-	inrange2 = FALSE;
+	long k,pc;
+#if JIT_FINDBOUNDS_SSE2
+	union {__m128i v; uchar c[16]; int l[4];} b0,b1;
+	union {__m128 v; float f[4];} f0,f1;
+	union {__m128d v; double f[2];} d0,d1;
+#endif
 	
-	n = dim[0];
-	cmin0 = vecdata->v_char.min[0];
-	cmax0 = vecdata->v_char.max[0];
-	cmin1 = vecdata->v_char.min[1];
-	cmax1 = vecdata->v_char.max[1];
-	cmin2 = vecdata->v_char.min[2];
-	cmax2 = vecdata->v_char.max[2];
-	cmin3 = vecdata->v_char.min[3];
-	cmax3 = vecdata->v_char.max[3];
-	min0 = min1 = 0x7FFFFFFF;
-	max0 = max1 = -1;
-	for (i=0;i<dim[1];i++) {
-		ip = bip + i*in_minfo->dimstride[1];
-		inrange1 = FALSE;
-		for (j=0;j<n;j++) {
-			inrange0 = TRUE;
-			if (*ip<cmin0) inrange0 = FALSE;
-			else if (*ip>cmax0) inrange0 = FALSE;
-			ip++;
-			if (*ip<cmin1) inrange0 = FALSE;
-			else if (*ip>cmax1) inrange0 = FALSE;
-			ip++;
-			if (*ip<cmin2) inrange0 = FALSE;
-			else if (*ip>cmax2) inrange0 = FALSE;
-			ip++;
-			if (*ip<cmin3) inrange0 = FALSE;
-			else if (*ip>cmax3) inrange0 = FALSE;
-			ip++;
-			if (inrange0) {
-				inrange1 = TRUE;
-				if (j<min0) min0 = j;
-				if (j>max0) max0 = j;
-			}
+	s->planecount = pc = MAX(in_minfo->planecount,1);
+	s->type = in_minfo->type;
+	s->vecdata = vecdata;
+	s->simd = FALSE;
+#if JIT_FINDBOUNDS_SSE2
+	s->simd = (pc==1)||(pc==2)||(pc==4);
+	if (!s->simd) 
+		return;
+	//lane k of each vector holds the threshold of plane k%planecount
+	if (s->type==_jit_sym_char) {
+		for (k=0;k<16;k++) {
+			b0.c[k] = (uchar)vecdata->v_char.min[k%pc];
+			b1.c[k] = (uchar)vecdata->v_char.max[k%pc];
+		}
+		s->imin = b0.v;
+		s->imax = b1.v;
+	} else if (s->type==_jit_sym_long) {
+		for (k=0;k<4;k++) {
+			b0.l[k] = vecdata->v_long.min[k%pc];
+			b1.l[k] = vecdata->v_long.max[k%pc];
+		}
+		s->imin = b0.v;
+		s->imax = b1.v;
+	} else if (s->type==_jit_sym_float32) {
+		for (k=0;k<4;k++) {
+			f0.f[k] = vecdata->v_float32.min[k%pc];
+			f1.f[k] = vecdata->v_float32.max[k%pc];
 		}
-		if (inrange1) {
-			inrange2 = TRUE; 
-			if (i<min1) min1 = i;
-			if (i>max1) max1 = i;
+		s->fmin = f0.v;
+		s->fmax = f1.v;
+	} else if (s->type==_jit_sym_float64) {
+		//two lane vectors alternate between planes 0,1 and 2,3 for 4 planes
+		for (k=0;k<2;k++) {
+			d0.f[k] = vecdata->v_float64.min[k%pc];
+			d1.f[k] = vecdata->v_float64.max[k%pc];
 		}
+		s->dmin[0] = d0.v;
+		s->dmax[0] = d1.v;
+		for (k=0;k<2;k++) {
+			d0.f[k] = vecdata->v_float64.min[(k+2)%pc];
+			d1.f[k] = vecdata->v_float64.max[(k+2)%pc];
+		}
+		s->dmin[1] = d0.v;
+		s->dmax[1] = d1.v;
 	}
-	if (min0<0x7FFFFFFF) vecdata->v_char.boundmin[0] = min0;
-	if (min1<0x7FFFFFFF) vecdata->v_char.boundmin[1] = min1;
-	if (max0>-1) vecdata->v_char.boundmax[0] = max0;
-	else vecdata->v_char.boundmax[0] = vecdata->v_char.boundmin[0];
-	if (max1>-1) vecdata->v_char.boundmax[1] = max1;
-	else vecdata->v_char.boundmax[1] = vecdata->v_char.boundmin[1];
-	
-	return inrange2;
+#endif
 }
 
-
-long jit_findbounds_calc2d_char(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip) 
+//is cell j of the row a hit on every plane
+long jit_findbounds_hit(t_jit_findbounds_scan *s, char *ip, long j)
 {
-	long i,j,k,planecount,n;
-	long min0,min1,max0,max1,inrange0,inrange1,inrange2;
-	uchar *ip;
-	long *cmin,*cmax;
-	
+	long k,pc=s->planecount;
+	t_jit_findbounds_vecdata *vd=s->vecdata;
 	
-	inrange2 = FALSE;
-	
-	n = dim[0];
-	planecount = in_minfo->planecount;
-	min0 = min1 = 0x7FFFFFFF;
-	max0 = max1 = -1;
-	cmin = vecdata->v_char.min;
-	cmax = vecdata->v_char.max;
-	for (i=0;i<dim[1];i++) {
-		ip = bip + i*in_minfo->dimstride[1];
-		inrange1 = FALSE;
-		for (j=0;j<n;j++) {
-			inrange0 = TRUE;
-			for (k=0;k<planecount;k++) {
-				if (*ip<cmin[k]) inrange0 = FALSE;
-				else if (*ip>cmax[k]) inrange0 = FALSE;
-				ip++;
-			}
-			if (inrange0) {
-				inrange1 = TRUE;
-				if (j<min0) min0 = j;
-				if (j>max0) max0 = j;
-			}
-		}
-		if (inrange1) {
-			inrange2 = TRUE; 
-			if (i<min1) min1 = i;
-			if (i>max1) max1 = i;
-		}
+	if (s->type==_jit_sym_char) {
+		uchar *p=((uchar *)ip) + j*pc;
+		for (k=0;k<pc;k++) 
+			if (p[k]<vd->v_char.min[k]||p[k]>vd->v_char.max[k]) return FALSE;
+	} else if (s->type==_jit_sym_long) {
+		long *p=((long *)ip) + j*pc;
+		for (k=0;k<pc;k++) 
+			if (p[k]<vd->v_long.min[k]||p[k]>vd->v_long.max[k]) return FALSE;
+	} else if (s->type==_jit_sym_float32) {
+		float *p=((float *)ip) + j*pc;
+		for (k=0;k<pc;k++) 
+			if (p[k]<vd->v_float32.min[k]||p[k]>vd->v_float32.max[k]) return FALSE;
+	} else {
+		double *p=((double *)ip) + j*pc;
+		for (k=0;k<pc;k++) 
+			if (p[k]<vd->v_float64.min[k]||p[k]>vd->v_float64.max[k]) return FALSE;
 	}
-	if (min0<0x7FFFFFFF) vecdata->v_char.boundmin[0] = min0;
-	if (min1<0x7FFFFFFF) vecdata->v_char.boundmin[1] = min1;
-	if (max0>-1) vecdata->v_char.boundmax[0] = max0;
-	else vecdata->v_char.boundmax[0] = vecdata->v_char.boundmin[0];
-	if (max1>-1) vecdata->v_char.boundmax[1] = max1;
-	else vecdata->v_char.boundmax[1] = vecdata->v_char.boundmin[1];
-	
-	return inrange2;
+	return TRUE;
 }
 
+#if JIT_FINDBOUNDS_SSE2
 
-long jit_findbounds_calc2d_long(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip) 
-{
-	long i,j,k,planecount,n;
-	long min0,min1,max0,max1,inrange0,inrange1,inrange2;
-	long *ip;
-	long *cmin,*cmax;
-	
-	
-	inrange2 = FALSE;
-	
-	n = dim[0];
-	planecount = in_minfo->planecount;
-	min0 = min1 = 0x7FFFFFFF;
-	max0 = max1 = -1;
-	cmin = vecdata->v_long.min;
-	cmax = vecdata->v_long.max;
-	for (i=0;i<dim[1];i++) {
-		ip = bip + i*in_minfo->dimstride[1];
-		inrange1 = FALSE;
-		for (j=0;j<n;j++) {
-			inrange0 = TRUE;
-			for (k=0;k<planecount;k++) {
-				if (*ip<cmin[k]) inrange0 = FALSE;
-				else if (*ip>cmax[k]) inrange0 = FALSE;
-				ip++;
-			}
-			if (inrange0) {
-				inrange1 = TRUE;
-				if (j<min0) min0 = j;
-				if (j>max0) max0 = j;
-			}
-		}
-		if (inrange1) {
-			inrange2 = TRUE; 
-			if (i<min1) min1 = i;
-			if (i>max1) max1 = i;
-		}
-	}
-	if (min0<0x7FFFFFFF) vecdata->v_long.boundmin[0] = min0;
-	if (min1<0x7FFFFFFF) vecdata->v_long.boundmin[1] = min1;
-	if (max0>-1) vecdata->v_long.boundmax[0] = max0;
-	else vecdata->v_long.boundmax[0] = vecdata->v_long.boundmin[0];
-	if (max1>-1) vecdata->v_long.boundmax[1] = max1;
-	else vecdata->v_long.boundmax[1] = vecdata->v_long.boundmin[1];
-	
-	return inrange2;
+//16 values at p as a mask m with a bit for each value that is a hit. values outside the 
+//thresholds are found with compares, so nans are hits just as they are in jit_findbounds_hit
+#define JIT_FINDBOUNDS_MASK_CHAR(m,s,p) { \
+	__m128i v = _mm_loadu_si128((__m128i *)(p)); \
+	m = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v,(s)->imin),v), \
+		_mm_cmpeq_epi8(_mm_min_epu8(v,(s)->imax),v))); \
+}
+#define JIT_FINDBOUNDS_MASK_LONG(m,s,p) { \
+	__m128i v; long q; \
+	for (q=0,m=0;q<4;q++) { \
+		v = _mm_loadu_si128((__m128i *)(p)+q); \
+		v = _mm_or_si128(_mm_cmplt_epi32(v,(s)->imin),_mm_cmpgt_epi32(v,(s)->imax)); \
+		m |= _mm_movemask_ps(_mm_castsi128_ps(v))<<(4*q); \
+	} \
+	m ^= 0xFFFF; \
+}
+#define JIT_FINDBOUNDS_MASK_FLOAT32(m,s,p) { \
+	__m128 v; long q; \
+	for (q=0,m=0;q<4;q++) { \
+		v = _mm_loadu_ps(((float *)(p))+4*q); \
+		m |= _mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(v,(s)->fmin),_mm_cmpgt_ps(v,(s)->fmax)))<<(4*q); \
+	} \
+	m ^= 0xFFFF; \
+}
+#define JIT_FINDBOUNDS_MASK_FLOAT64(m,s,p) { \
+	__m128d v; long q; \
+	for (q=0,m=0;q<8;q++) { \
+		v = _mm_loadu_pd(((double *)(p))+2*q); \
+		m |= _mm_movemask_pd(_mm_or_pd(_mm_cmplt_pd(v,(s)->dmin[q&1]),_mm_cmpgt_pd(v,(s)->dmax[q&1])))<<(2*q); \
+	} \
+	m ^= 0xFFFF; \
 }
 
-long jit_findbounds_calc2d_float32(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip) 
+//keep a bit at the first value of each cell whose planes are all hits
+#define JIT_FINDBOUNDS_CELLS(m,pc) \
+	if (pc==2) { \
+		m &= (m>>1)&0x5555; \
+	} else if (pc==4) { \
+		m &= m>>1; \
+		m &= (m>>2)&0x1111; \
+	}
+
+//16 values at a time forwards from cell a, or backwards from cell b, returning the first hit. 
+//the cells left over for the scalar loop are narrowed to a to b-1
+#define JIT_FINDBOUNDS_FIRST(MASK,size) \
+	for (e=a*pc;e+16<=b*pc;e+=16) { \
+		MASK(m,s,ip+e*(size)); \
+		JIT_FINDBOUNDS_CELLS(m,pc); \
+		if (m) { \
+			for (j=0;!(m&(1<<j));j++) \
+				; \
+			return (e+j)/pc; \
+		} \
+	} \
+	a = e/pc;
+#define JIT_FINDBOUNDS_LAST(MASK,size) \
+	for (e=b*pc-16;e>=a*pc;e-=16) { \
+		MASK(m,s,ip+e*(size)); \
+		JIT_FINDBOUNDS_CELLS(m,pc); \
+		if (m) { \
+			for (j=15;!(m&(1<<j));j--) \
+				; \
+			return (e+j)/pc; \
+		} \
+	} \
+	b = (e+16)/pc;
+
+#endif
+
+//first cell in a to b-1 that is a hit, or -1
+long jit_findbounds_first(t_jit_findbounds_scan *s, char *ip, long a, long b)
 {
-	long i,j,k,planecount,n;
-	long min0,min1,max0,max1,inrange0,inrange1,inrange2;
-	float *ip;
-	float *cmin,*cmax;
+	long j,e,m,pc=s->planecount;
 	
-	inrange2 = FALSE;
-	
-	n = dim[0];
-	planecount = in_minfo->planecount;
-	min0 = min1 = 0x7FFFFFFF;
-	max0 = max1 = -1;
-	cmin = vecdata->v_float32.min;
-	cmax = vecdata->v_float32.max;
-	for (i=0;i<dim[1];i++) {
-		ip = bip + i*in_minfo->dimstride[1];
-		inrange1 = FALSE;
-		for (j=0;j<n;j++) {
-			inrange0 = TRUE;
-			for (k=0;k<planecount;k++) {
-				if (*ip<cmin[k]) inrange0 = FALSE;
-				else if (*ip>cmax[k]) inrange0 = FALSE;
-				ip++;
-			}
-			if (inrange0) {
-				inrange1 = TRUE;
-				if (j<min0) min0 = j;
-				if (j>max0) max0 = j;
-			}
-		}
-		if (inrange1) {
-			inrange2 = TRUE; 
-			if (i<min1) min1 = i;
-			if (i>max1) max1 = i;
+#if JIT_FINDBOUNDS_SSE2
+	if (s->simd) {
+		if (s->type==_jit_sym_char) {
+			JIT_FINDBOUNDS_FIRST(JIT_FINDBOUNDS_MASK_CHAR,1);
+		} else if (s->type==_jit_sym_long) {
+			JIT_FINDBOUNDS_FIRST(JIT_FINDBOUNDS_MASK_LONG,4);
+		} else if (s->type==_jit_sym_float32) {
+			JIT_FINDBOUNDS_FIRST(JIT_FINDBOUNDS_MASK_FLOAT32,4);
+		} else {
+			JIT_FINDBOUNDS_FIRST(JIT_FINDBOUNDS_MASK_FLOAT64,8);
 		}
 	}
-	if (min0<0x7FFFFFFF) vecdata->v_float32.boundmin[0] = min0;
-	if (min1<0x7FFFFFFF) vecdata->v_float32.boundmin[1] = min1;
-	if (max0>-1) vecdata->v_float32.boundmax[0] = max0;
-	else vecdata->v_float32.boundmax[0] = vecdata->v_float32.boundmin[0];
-	if (max1>-1) vecdata->v_float32.boundmax[1] = max1;
-	else vecdata->v_float32.boundmax[1] = vecdata->v_float32.boundmin[1];
-	
-	return inrange2;
+#endif
+	for (j=a;j<b;j++) 
+		if (jit_findbounds_hit(s,ip,j)) 
+			return j;
+	return -1;
 }
 
-long jit_findbounds_calc2d_float64(t_jit_findbounds *x, long dimcount, long *dim, t_jit_findbounds_vecdata *vecdata, 
-	t_jit_matrix_info *in_minfo, char *bip) 
+//last cell in a to b-1 that is a hit, or -1
+long jit_findbounds_last(t_jit_findbounds_scan *s, char *ip, long a, long b)
 {
-	long i,j,k,planecount,n;
-	long min0,min1,max0,max1,inrange0,inrange1,inrange2;
-	double *ip;
-	double *cmin,*cmax;
+	long j,e,m,pc=s->planecount;
 	
-	inrange2 = FALSE;
-	
-	n = dim[0];
-	planecount = in_minfo->planecount;
-	min0 = min1 = 0x7FFFFFFF;
-	max0 = max1 = -1;
-	cmin = vecdata->v_float64.min;
-	cmax = vecdata->v_float64.max;
-	for (i=0;i<dim[1];i++) {
-		ip = bip + i*in_minfo->dimstride[1];
-		inrange1 = FALSE;
-		for (j=0;j<n;j++) {
-			inrange0 = TRUE;
-			for (k=0;k<planecount;k++) {
-				if (*ip<cmin[k]) inrange0 = FALSE;
-				else if (*ip>cmax[k]) inrange0 = FALSE;
-				ip++;
-			}
-			if (inrange0) {
-				inrange1 = TRUE;
-				if (j<min0) min0 = j;
-				if (j>max0) max0 = j;
-			}
-		}
-		if (inrange1) {
-			inrange2 = TRUE; 
-			if (i<min1) min1 = i;
-			if (i>max1) max1 = i;
+#if JIT_FINDBOUNDS_SSE2
+	if (s->simd) {
+		if (s->type==_jit_sym_char) {
+			JIT_FINDBOUNDS_LAST(JIT_FINDBOUNDS_MASK_CHAR,1);
+		} else if (s->type==_jit_sym_long) {
+			JIT_FINDBOUNDS_LAST(JIT_FINDBOUNDS_MASK_LONG,4);
+		} else if (s->type==_jit_sym_float32) {
+			JIT_FINDBOUNDS_LAST(JIT_FINDBOUNDS_MASK_FLOAT32,4);
+		} else {
+			JIT_FINDBOUNDS_LAST(JIT_FINDBOUNDS_MASK_FLOAT64,8);
 		}
 	}
-	if (min0<0x7FFFFFFF) vecdata->v_float64.boundmin[0] = min0;
-	if (min1<0x7FFFFFFF) vecdata->v_float64.boundmin[1] = min1;
-	if (max0>-1) vecdata->v_float64.boundmax[0] = max0;
-	else vecdata->v_float64.boundmax[0] = vecdata->v_float64.boundmin[0];
-	if (max1>-1) vecdata->v_float64.boundmax[1] = max1;
-	else vecdata->v_float64.boundmax[1] = vecdata->v_float64.boundmin[1];
-	
-	return inrange2;
+#endif
+	for (j=b-1;j>=a;j--) 
+		if (jit_findbounds_hit(s,ip,j)) 
+			return j;
+	return -1;
 }
 
 t_jit_findbounds *jit_findbounds_new(void)
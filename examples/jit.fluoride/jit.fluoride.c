@@ -11,6 +11,10 @@
  * black (0).  values outside of a tolerance boundary are passed.  jit.fluoride can work
  * in an input matrix in either greyscale (mode 0) or color (mode 1).
  *
+ * everything but the color mode's fade depends only on the luminance index, so that is worked out
+ * once for each of the 256 indices before the matrix is run through, and the cells are computed
+ * with table lookups instead of branching.
+ *
  */
 
 #include "jit.common.h"
@@ -22,12 +26,24 @@ typedef struct _jit_fluoride
 	double					glow[3], lum, tol;
 } t_jit_fluoride;
 
+// per luminance index. the color planes come out as CLIP((long)(base + (long)(in*perc)),0,255),
+// which reproduces the fade (and gives in, or the above-lum value, with perc 1 or 0)
+typedef struct _jit_fluoride_vecdata
+{
+	long					mode;
+	float					lum[3][256];	//each plane's share of the index
+	float					perc[256];
+	double					base[3][256];
+	uchar					grey[256][4];	//planes 1-3 of the b/w output
+} t_jit_fluoride_vecdata;
+
 void *_jit_fluoride_class;
 
 t_jit_fluoride *jit_fluoride_new(void);
 void jit_fluoride_free(t_jit_fluoride *x);
 t_jit_err jit_fluoride_matrix_calc(t_jit_fluoride *x, void *inputs, void *outputs);
-void jit_fluoride_calculate_ndim(t_jit_fluoride *x, long dimcount, long *dim, long planecount, 
+void jit_fluoride_getvecdata(t_jit_fluoride *x, t_jit_fluoride_vecdata *v);
+void jit_fluoride_calculate_ndim(t_jit_fluoride_vecdata *v, long dimcount, long *dim, long planecount, 
 	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop);
 t_jit_err jit_fluoride_init(void);
 
@@ -87,6 +103,7 @@ t_jit_err jit_fluoride_matrix_calc(t_jit_fluoride *x, void *inputs, void *output
 	char *in_bp,*out_bp;
 	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
 	void *in_matrix, *out_matrix;
+	t_jit_fluoride_vecdata vecdata;
 	
 	in_matrix = jit_object_method(inputs, _jit_sym_getindex, 0);
 	out_matrix = jit_object_method(outputs, _jit_sym_getindex, 0);
@@ -125,8 +142,9 @@ t_jit_err jit_fluoride_matrix_calc(t_jit_fluoride *x, void *inputs, void *output
 		}		
 				
 		//calculate
+		jit_fluoride_getvecdata(x,&vecdata);
 		jit_parallel_ndim_simplecalc2((method)jit_fluoride_calculate_ndim,
-			x, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp,
+			&vecdata, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp,
 			0 /* flags1 */, 0 /* flags2 */);
 
 	} else {
@@ -139,18 +157,12 @@ out:
 	return err;
 }
 
-//
-//recursive functions to handle higher dimension matrices, by processing 2D sections at a time
-//
-
-// jit_fluoride_calculate_ndim() -- when x->dimmode==-1, sorts both dimensions together
-void jit_fluoride_calculate_ndim(t_jit_fluoride *x, long dimcount, long *dim, long planecount, 
-	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop)
+// the tables, from the same expressions the cells used to be computed with
+void jit_fluoride_getvecdata(t_jit_fluoride *x, t_jit_fluoride_vecdata *v)
 {
-	long i,j,width,height, index;
-	long glow[3], outpix, lum, tol, bw, tmax, temp, mode;
+	long k, index;
+	long glow[3], outpix, lum, tol, bw, tmax, temp;
 	float indperc;
-	uchar *ip,*op;
 	
 	glow[0] = x->glow[0]*255.;
 	glow[1] = x->glow[1]*255.;
@@ -159,7 +171,51 @@ void jit_fluoride_calculate_ndim(t_jit_fluoride *x, long dimcount, long *dim, lo
 	tol = x->tol*255.;
 	bw = MAX(1,lum-tol);
 	tmax = MIN(255,(lum+tol));
-	mode = CLIP(x->mode,0,1);
+	v->mode = CLIP(x->mode,0,1);
+
+	for (index=0;index<256;index++) {
+		v->lum[0][index] = (float)(index*.299);
+		v->lum[1][index] = (float)(index*.587);
+		v->lum[2][index] = (float)(index*.114);
+		v->grey[index][0] = 0;
+		if(index<bw) {
+			v->perc[index] = 1.f;
+			for (k=0;k<3;k++) {
+				v->base[k][index] = 0.;
+				v->grey[index][k+1] = index;
+			}
+		}
+		else if(index<(lum+1)) {
+			indperc=((float)(lum-index)*(1./tol));
+			outpix = (float)(index)*(indperc);
+			v->perc[index] = indperc;
+			for (k=0;k<3;k++) {
+				v->base[k][index] = ((float)(glow[k])*(1.-indperc));
+				temp = v->base[k][index]+outpix;
+				v->grey[index][k+1] = CLIP(temp,0,255);
+			}
+		}
+		else {
+			indperc=((float)(255-index)*(1./(tmax-lum)));
+			v->perc[index] = 0.f;
+			for (k=0;k<3;k++) {
+				temp = ((float)(glow[k])*indperc);
+				v->base[k][index] = v->grey[index][k+1] = CLIP(temp,0,255);
+			}
+		}
+	}
+}
+
+//
+//recursive functions to handle higher dimension matrices, by processing 2D sections at a time
+//
+
+void jit_fluoride_calculate_ndim(t_jit_fluoride_vecdata *v, long dimcount, long *dim, long planecount, 
+	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop)
+{
+	long i,j,k,width,height,index,temp;
+	float perc;
+	uchar *ip,*op,*grey;
 
 	if (dimcount<1) return; //safety
 	
@@ -170,105 +226,46 @@ void jit_fluoride_calculate_ndim(t_jit_fluoride *x, long dimcount, long *dim, lo
 				
 		width  = dim[0];
 		height = dim[1];
-		switch(mode) {
+		switch(v->mode) {
 		case 1: // color		
 			for (i=0;i<height;i++){
-			ip = bip + i*in_minfo->dimstride[1];
-			op = bop + i*out_minfo->dimstride[1];
+				ip = (uchar *)bip + i*in_minfo->dimstride[1];
+				op = (uchar *)bop + i*out_minfo->dimstride[1];
 			
-				for (j=0;j<width;j++) {
-					index = (float)(*(ip+1)*.299)+(float)(*(ip+2)*.587)+(float)(*(ip+3)*.114);
-					if(index<bw) {
-						*op++ = *ip;
-						*op++ = *(ip+1);
-						*op++ = *(ip+2);
-						*op++ = *(ip+3);
-						goto ick1;
-					}
-					if(index<(lum+1)) {
-						indperc=((float)(lum-index)*(1./tol));
-						*op++ = *ip;
-						outpix = (float)(*(ip+1))*(indperc);
-						temp = ((float)(glow[0])*(1.-indperc))+outpix;
-						*op++ = CLIP(temp,0,255);
-						outpix = (float)(*(ip+2))*(indperc);
-						temp = ((float)(glow[1])*(1.-indperc))+outpix;
-						*op++ = CLIP(temp,0,255);
-						outpix = (float)(*(ip+3))*(indperc);
-						temp = ((float)(glow[2])*(1.-indperc))+outpix;
-						*op++ = CLIP(temp,0,255);
-					}
-					else {
-						indperc=((float)(255-index)*(1./(tmax-lum)));
-						*op++ = *ip;
-						temp = ((float)(glow[0])*indperc);
-						*op++ = CLIP(temp,0,255);
-						temp = ((float)(glow[1])*indperc);
-						*op++ = CLIP(temp,0,255);
-						temp = ((float)(glow[2])*indperc);
-						*op++ = CLIP(temp,0,255);
-						
-					}
-					
-					ick1:
-					;
-					ip+=4;
-
+				for (j=0;j<width;j++,ip+=4,op+=4) {
+					index = v->lum[0][ip[1]]+v->lum[1][ip[2]]+v->lum[2][ip[3]];
+					perc = v->perc[index];
+					op[0] = ip[0];
+					for (k=0;k<3;k++) {
+						temp = v->base[k][index]+(long)((float)(ip[k+1])*perc);
+						op[k+1] = CLIP(temp,0,255);
 					}
 				}
-		break;
+			}
+			break;
 		case 0: // b/w
 		default:			
 			for (i=0;i<height;i++){
-			ip = bip + i*in_minfo->dimstride[1];
-			op = bop + i*out_minfo->dimstride[1];
+				ip = (uchar *)bip + i*in_minfo->dimstride[1];
+				op = (uchar *)bop + i*out_minfo->dimstride[1];
 			
-				for (j=0;j<width;j++) {
-					index = (float)(*(ip+1)*.299)+(float)(*(ip+2)*.587)+(float)(*(ip+3)*.114);
-					if(index<bw) {
-						*op++ = *ip;
-						*op++ = index;
-						*op++ = index;
-						*op++ = index;
-						goto ick;
-					}
-					if(index<(lum+1)) {
-						indperc=((float)(lum-index)*(1./tol));
-						outpix = (float)(index)*(indperc);
-						*op++ = *ip;
-						temp = ((float)(glow[0])*(1.-indperc))+outpix;
-						*op++ = CLIP(temp,0,255);
-						temp = ((float)(glow[1])*(1.-indperc))+outpix;
-						*op++ = CLIP(temp,0,255);
-						temp = ((float)(glow[2])*(1.-indperc))+outpix;
-						*op++ = CLIP(temp,0,255);
-					}
-					else {
-						indperc=((float)(255-index)*(1./(tmax-lum)));
-						*op++ = *ip;
-						temp = ((float)(glow[0])*indperc);
-						*op++ = CLIP(temp,0,255);
-						temp = ((float)(glow[1])*indperc);
-						*op++ = CLIP(temp,0,255);
-						temp = ((float)(glow[2])*indperc);
-						*op++ = CLIP(temp,0,255);
-						
-					}
-					
-					ick:
-					;
-					ip+=4;
-
-					}
+				for (j=0;j<width;j++,ip+=4,op+=4) {
+					index = v->lum[0][ip[1]]+v->lum[1][ip[2]]+v->lum[2][ip[3]];
+					grey = v->grey[index];
+					op[0] = ip[0];
+					op[1] = grey[1];
+					op[2] = grey[2];
+					op[3] = grey[3];
 				}
+			}
+			break;
+		}	
 		break;
-			}	
-	break;
 	default:
 		for	(i=0;i<dim[dimcount-1];i++) {
-			ip = bip + i*in_minfo->dimstride[dimcount-1];
-			op = bop + i*out_minfo->dimstride[dimcount-1];
-			jit_fluoride_calculate_ndim(x,dimcount-1,dim,planecount,in_minfo,ip,out_minfo,op);
+			ip = (uchar *)bip + i*in_minfo->dimstride[dimcount-1];
+			op = (uchar *)bop + i*out_minfo->dimstride[dimcount-1];
+			jit_fluoride_calculate_ndim(v,dimcount-1,dim,planecount,in_minfo,(char *)ip,out_minfo,(char *)op);
 		}
 	}
 }
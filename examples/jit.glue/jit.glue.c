@@ -4,6 +4,9 @@
 */
 
 #include "jit.common.h"
+#include <string.h>
+
+#define JIT_GLUE_MAX_TILES		64		//most rows or columns
 
 typedef struct _jit_glue 
 {
@@ -21,6 +24,8 @@ t_jit_glue *jit_glue_new(void);
 void jit_glue_free(t_jit_glue *x);
 t_jit_err jit_glue_matrix_calc(t_jit_glue *x, void *inputs, void *outputs);
 t_jit_err jit_glue_init(void);
+void jit_glue_calculate_ndim(t_jit_glue *x, long dimcount, long *dim, long planecount, 
+	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop);
 
 
 t_jit_err jit_glue_init(void) 
@@ -42,11 +47,11 @@ t_jit_err jit_glue_init(void)
 	attrflags = JIT_ATTR_GET_DEFER_LOW | JIT_ATTR_SET_USURP_LOW;
 	attr = jit_object_new(_jit_sym_jit_attr_offset,"rows",_jit_sym_long,attrflags,
 		(method)0,(method)0,calcoffset(t_jit_glue,rows));
-	jit_attr_addfilterset_clip(attr,1,16,1,1);
+	jit_attr_addfilterset_clip(attr,1,JIT_GLUE_MAX_TILES,1,1);
 	jit_class_addattr(_jit_glue_class,attr);
 	attr = jit_object_new(_jit_sym_jit_attr_offset,"columns",_jit_sym_long,attrflags,
 		(method)0,(method)0,calcoffset(t_jit_glue,cols));
-	jit_attr_addfilterset_clip(attr,1,16,1,1);
+	jit_attr_addfilterset_clip(attr,1,JIT_GLUE_MAX_TILES,1,1);
 	jit_class_addattr(_jit_glue_class,attr);
 
 	attrflags = JIT_ATTR_GET_OPAQUE_USER | JIT_ATTR_SET_OPAQUE_USER;
@@ -110,9 +115,9 @@ t_jit_err jit_glue_matrix_calc(t_jit_glue *x, void *inputs, void *outputs)
 		//get dimensions/planecount
 
 		if (rows<1) rows=1;
-		if (rows>16) rows=16;
+		if (rows>JIT_GLUE_MAX_TILES) rows=JIT_GLUE_MAX_TILES;
 		if (cols<1) cols=1;
-		if (cols>16) cols=16;
+		if (cols>JIT_GLUE_MAX_TILES) cols=JIT_GLUE_MAX_TILES;
 
 		if (n>=(rows*cols)) goto out;
 		
@@ -125,7 +130,25 @@ t_jit_err jit_glue_matrix_calc(t_jit_glue *x, void *inputs, void *outputs)
 			jit_atom_setlong(&a[0], dim[0]);
 			jit_atom_setlong(&a[1], dim[1]);	
 			jit_object_method(out_matrix, _jit_sym_dim, 2, a);
+			
+			// resizing may have moved the data
+			jit_object_method(out_matrix,_jit_sym_getinfo,&out_minfo);
+			jit_object_method(out_matrix,_jit_sym_getdata,&out_bp);
+			if (!out_bp) { err=JIT_ERR_INVALID_OUTPUT; goto out;}
+		}
 		
+		// cells are the same size on both sides, so copy the tile straight 
+		// into place a row at a time, with rows split across processors
+		if ((in_minfo.dimstride[0]==out_minfo.dimstride[0])&&
+			(out_minfo.dim[0]>=dim[0])&&(out_minfo.dim[1]>=dim[1])) 
+		{
+			dim[0] = in_minfo.dim[0];
+			dim[1] = in_minfo.dim[1];
+			out_bp += dim[0]*(n%cols)*out_minfo.dimstride[0] + dim[1]*(n/cols)*out_minfo.dimstride[1];
+			jit_parallel_ndim_simplecalc2((method)jit_glue_calculate_ndim,
+				x, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp,
+				0 /* flags1 */, 0 /* flags2 */);
+			goto out;
 		}
 		
 		setmem(&conv,sizeof(t_matrix_conv_info),0);
@@ -160,6 +183,25 @@ out:
 }
 
 
+//rows that already hold the same data are left alone, so tiles from sources 
+//that have not changed since the last frame cost a read instead of a write
+void jit_glue_calculate_ndim(t_jit_glue *x, long dimcount, long *dim, long planecount, 
+	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop)
+{
+	long i,n;
+	char *ip,*op;
+
+	if (dimcount<2) return; //safety
+	
+	n = dim[0]*in_minfo->dimstride[0];
+	for (i=0;i<dim[1];i++) {
+		ip = bip + i*in_minfo->dimstride[1];
+		op = bop + i*out_minfo->dimstride[1];
+		if (memcmp(op,ip,n))
+			memcpy(op,ip,n);
+	}
+}
+
 t_jit_glue *jit_glue_new(void)
 {
 	t_jit_glue *x;
@@ -5,25 +5,58 @@
 
 #include "jit.common.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIT_HISTOGRAM_SSE2		1
+#include <emmintrin.h>
+#endif
+
+//each worker counts into this many sub-histograms in turn, so that runs of the same value 
+//don't have to wait for the previous increment of the same bin to be stored
+#define JIT_HISTOGRAM_SUBS		4
+//float input is binned this many cells at a time before counting
+#define JIT_HISTOGRAM_BLOCK		64
+
 typedef struct _jit_histogram 
 {
 	t_object	ob;
 	long		normval;
+	//float input
+	long		bins;
+	double		min;
+	double		max;
 	//flags
 	char		autoclear;
 	char		normalize;
 } t_jit_histogram;
 
+//shared by the reduction callbacks
+typedef struct _jit_histogram_reduce
+{
+	t_jit_histogram		*x;
+	t_jit_matrix_info	*out_minfo;
+	long				size;		//longs in one row of the output
+	long				bincount;	//output dim[0]
+	double				scale;		//bins per unit, for float input
+} t_jit_histogram_reduce;
+
 void *_jit_histogram_class;
 
 t_jit_err jit_histogram_init(void); 
 t_jit_histogram *jit_histogram_new(void);
 void jit_histogram_free(t_jit_histogram *x);
 t_jit_err jit_histogram_matrix_calc(t_jit_histogram *x, void *inputs, void *outputs);
-void jit_histogram_calculate_ndim(t_jit_histogram *x, long dimcount, long *dim, long planecount, 
+void jit_histogram_calculate_ndim(t_jit_histogram_reduce *r, long subsize, long dimcount, long *dim, long planecount, 
 	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop);
-void jit_histogram_vector_char(long n, long maxsize, t_jit_op_info *in1, t_jit_op_info *out); 
-void jit_histogram_vector_long(long n, long maxsize, t_jit_op_info *in1, t_jit_op_info *out);
+void jit_histogram_reduce_init(t_jit_histogram_reduce *r, long *bins);
+void jit_histogram_reduce_accumulate(t_jit_histogram_reduce *r, long *bins, long offset, long dimcount, long *dim, 
+	long planecount, t_jit_matrix_info *in_minfo, char *bip);
+void jit_histogram_reduce_combine(t_jit_histogram_reduce *r, long *result, long *bins);
+void jit_histogram_vector_char(long n, t_jit_histogram_reduce *r, t_jit_op_info *in1, t_jit_op_info *out, long subsize); 
+void jit_histogram_vector_long(long n, t_jit_histogram_reduce *r, t_jit_op_info *in1, t_jit_op_info *out, long subsize);
+void jit_histogram_vector_float32(long n, t_jit_histogram_reduce *r, t_jit_op_info *in1, t_jit_op_info *out, long subsize);
+void jit_histogram_vector_float64(long n, t_jit_histogram_reduce *r, t_jit_op_info *in1, t_jit_op_info *out, long subsize);
+void jit_histogram_count(long n, int *idx, long *op, long os, long subsize);
+void jit_histogram_merge(t_jit_matrix_info *out_minfo, char *bop, long *bins, long clear, long normalize, long normval);
 void jit_histogram_normalize( t_jit_matrix_info *out_minfo, char *bop, long normval); 
 void jit_histogram_normalize2(t_jit_matrix_info *out_minfo, char *bop, long normval); 
 
@@ -60,6 +93,17 @@ t_jit_err jit_histogram_init(void)
 	attr = jit_object_new(_jit_sym_jit_attr_offset,"normalize",_jit_sym_char,attrflags,
 		(method)0L,(method)0L,calcoffset(t_jit_histogram,normalize));
 	jit_class_addattr(_jit_histogram_class,attr);
+	//float32/float64 input: values from min to max are counted into bins bins (0 = output dim).
+	//the max wrapper sizes the output to match before each float calc
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"bins",_jit_sym_long,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_histogram,bins));
+	jit_class_addattr(_jit_histogram_class,attr);
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"min",_jit_sym_float64,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_histogram,min));
+	jit_class_addattr(_jit_histogram_class,attr);
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"max",_jit_sym_float64,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_histogram,max));
+	jit_class_addattr(_jit_histogram_class,attr);
 	
 	jit_class_register(_jit_histogram_class);
 
@@ -72,8 +116,11 @@ t_jit_err jit_histogram_matrix_calc(t_jit_histogram *x, void *inputs, void *outp
 	long in_savelock,out_savelock;
 	t_jit_matrix_info in_minfo,out_minfo;
 	char *in_bp,*out_bp;
-	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
+	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT],isfloat;
 	void *in_matrix,*out_matrix;
+	t_jit_histogram_reduce r;
+	t_jit_parallel_ndim_reduce reduce;
+	long *bins;
 	
 	in_matrix 	= jit_object_method(inputs,_jit_sym_getindex,0);
 	out_matrix 	= jit_object_method(outputs,_jit_sym_getindex,0);
@@ -93,13 +140,14 @@ t_jit_err jit_histogram_matrix_calc(t_jit_histogram *x, void *inputs, void *outp
 		if (!out_bp) { err=JIT_ERR_INVALID_OUTPUT; goto out;}
 		
 		//compatible types?
-		if (((in_minfo.type!=_jit_sym_char)&&(in_minfo.type!=_jit_sym_long))||(out_minfo.type!=_jit_sym_long)) { 
+		isfloat = (in_minfo.type==_jit_sym_float32)||(in_minfo.type==_jit_sym_float64);
+		if (((in_minfo.type!=_jit_sym_char)&&(in_minfo.type!=_jit_sym_long)&&!isfloat)||(out_minfo.type!=_jit_sym_long)) { 
 			err=JIT_ERR_MISMATCH_TYPE; 
 			goto out;
 		}		
 
-		//compatible dimensions?
-		if (out_minfo.dim[0]<256) {
+		//compatible dimensions? char and long values are their own bins
+		if ((out_minfo.dim[0]<256)&&!isfloat) {
 			err=JIT_ERR_MISMATCH_DIM; 
 			goto out;
 		}			
@@ -112,13 +160,36 @@ t_jit_err jit_histogram_matrix_calc(t_jit_histogram *x, void *inputs, void *outp
 			dim[i] = in_minfo.dim[i];
 		}		
 		
-		if (x->autoclear) jit_object_method(out_matrix,gensym("clear"));		
-		//calculate
-		jit_histogram_calculate_ndim(x, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp);
-		switch (x->normalize)  {
-		case 0: 	break;
-		case 2:		jit_histogram_normalize2(&out_minfo, out_bp, x->normval);	break;		
-		default:	jit_histogram_normalize(&out_minfo, out_bp, x->normval);	break;		
+		r.x = x;
+		r.out_minfo = &out_minfo;
+		r.size = out_minfo.dim[0]*out_minfo.planecount;
+		r.bincount = out_minfo.dim[0];
+		r.scale = (x->max>x->min) ? (double)r.bincount/(x->max-x->min) : 0;
+		
+		//calculate. 1D and 2D input is counted into private bins per worker, which are 
+		//summed into one set of bins, and then merged into the output together with 
+		//normalization. higher dimensions keep the serial path.
+		if ((dimcount<=2)&&(out_minfo.dimcount==1||out_minfo.dim[1]==1)) {
+			if (!(bins=(long *)jit_getbytes(r.size*sizeof(long)))) { err=JIT_ERR_OUT_OF_MEM; goto out;}
+			for (i=0;i<r.size;i++)
+				bins[i] = 0;
+			reduce.data = &r;
+			reduce.statesize = r.size*JIT_HISTOGRAM_SUBS*sizeof(long);
+			reduce.init = (method)jit_histogram_reduce_init;
+			reduce.accumulate = (method)jit_histogram_reduce_accumulate;
+			reduce.combine = (method)jit_histogram_reduce_combine;
+			jit_parallel_ndim_reduce1(&reduce, bins, dimcount, dim, planecount, &in_minfo, in_bp, 
+				0 /* flags1 */);
+			jit_histogram_merge(&out_minfo, out_bp, bins, x->autoclear, x->normalize, x->normval);
+			jit_freebytes(bins,r.size*sizeof(long));
+		} else {
+			if (x->autoclear) jit_object_method(out_matrix,gensym("clear"));		
+			jit_histogram_calculate_ndim(&r, 0, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp);
+			switch (x->normalize)  {
+			case 0: 	break;
+			case 2:		jit_histogram_normalize2(&out_minfo, out_bp, x->normval);	break;		
+			default:	jit_histogram_normalize(&out_minfo, out_bp, x->normval);	break;		
+			}
 		}
 	} else {
 		return JIT_ERR_INVALID_PTR;
@@ -130,11 +201,12 @@ out:
 	return err;
 }
 
-//recursive function to handle higher dimension matrices, by processing 2D sections at a time 
-void jit_histogram_calculate_ndim(t_jit_histogram *x, long dimcount, long *dim, long planecount, 
+//recursive function to handle higher dimension matrices, by processing 2D sections at a time. 
+//subsize is the distance in longs between sub-histograms, or 0 to count straight into bop.
+void jit_histogram_calculate_ndim(t_jit_histogram_reduce *r, long subsize, long dimcount, long *dim, long planecount, 
 	t_jit_matrix_info *in1_minfo, char *bip1, t_jit_matrix_info *out_minfo, char *bop)
 {
-	long i,j,n,maxsize;
+	long i,j,n;
 	uchar *ip1,*op;
 	t_jit_op_info in1_opinfo,out_opinfo;
 	
@@ -145,7 +217,6 @@ void jit_histogram_calculate_ndim(t_jit_histogram *x, long dimcount, long *dim,
 		dim[1] = 1;
 	case 2:
 		n = dim[0];
-		maxsize = out_minfo->dim[0];
 		in1_opinfo.stride = in1_minfo->dim[0]>1?in1_minfo->planecount:0;
 		out_opinfo.stride = out_minfo->dim[0]>1?out_minfo->planecount:0;
 		if (in1_minfo->type==_jit_sym_char) {
@@ -153,7 +224,7 @@ void jit_histogram_calculate_ndim(t_jit_histogram *x, long dimcount, long *dim,
 				for (j=0;j<planecount;j++) {
 					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + j%in1_minfo->planecount;
 					out_opinfo.p = bop  + (j%out_minfo->planecount)*4; //out always long
-					jit_histogram_vector_char(n,maxsize,&in1_opinfo,&out_opinfo);
+					jit_histogram_vector_char(n,r,&in1_opinfo,&out_opinfo,subsize);
 				}
 			}
 		} else if (in1_minfo->type==_jit_sym_long) {
@@ -161,7 +232,23 @@ void jit_histogram_calculate_ndim(t_jit_histogram *x, long dimcount, long *dim,
 				for (j=0;j<planecount;j++) {
 					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + (j%in1_minfo->planecount)*4;
 					out_opinfo.p = bop  + j*4;
-					jit_histogram_vector_long(n,maxsize,&in1_opinfo,&out_opinfo);
+					jit_histogram_vector_long(n,r,&in1_opinfo,&out_opinfo,subsize);
+				}
+			}
+		} else if (in1_minfo->type==_jit_sym_float32) {
+			for (i=0;i<dim[1];i++){
+				for (j=0;j<planecount;j++) {
+					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + (j%in1_minfo->planecount)*4;
+					out_opinfo.p = bop  + j*4;
+					jit_histogram_vector_float32(n,r,&in1_opinfo,&out_opinfo,subsize);
+				}
+			}
+		} else if (in1_minfo->type==_jit_sym_float64) {
+			for (i=0;i<dim[1];i++){
+				for (j=0;j<planecount;j++) {
+					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + (j%in1_minfo->planecount)*8;
+					out_opinfo.p = bop  + j*4;
+					jit_histogram_vector_float64(n,r,&in1_opinfo,&out_opinfo,subsize);
 				}
 			}
 		} 
@@ -170,37 +257,86 @@ void jit_histogram_calculate_ndim(t_jit_histogram *x, long dimcount, long *dim,
 		for	(i=0;i<dim[dimcount-1];i++) {
 			ip1 = bip1 + i*in1_minfo->dimstride[dimcount-1];
 			op = bop + i*out_minfo->dimstride[dimcount-1];
-			jit_histogram_calculate_ndim(x,dimcount-1,dim,planecount,in1_minfo,ip1,out_minfo,op);
+			jit_histogram_calculate_ndim(r,subsize,dimcount-1,dim,planecount,in1_minfo,ip1,out_minfo,op);
 		}
 	}
 }
 
+//the state is JIT_HISTOGRAM_SUBS sub-histograms, each laid out like the first row of the output
+void jit_histogram_reduce_init(t_jit_histogram_reduce *r, long *bins)
+{
+	long i;
+	
+	for (i=0;i<r->size*JIT_HISTOGRAM_SUBS;i++)
+		bins[i] = 0;
+}
+
+void jit_histogram_reduce_accumulate(t_jit_histogram_reduce *r, long *bins, long offset, long dimcount, long *dim, 
+	long planecount, t_jit_matrix_info *in_minfo, char *bip)
+{
+	jit_histogram_calculate_ndim(r,r->size,dimcount,dim,planecount,in_minfo,bip,r->out_minfo,(char *)bins);
+}
+
+void jit_histogram_reduce_combine(t_jit_histogram_reduce *r, long *result, long *bins)
+{
+	long i,k;
+	
+	for (k=0;k<JIT_HISTOGRAM_SUBS;k++,bins+=r->size) {
+		for (i=0;i<r->size;i++)
+			result[i] += bins[i];
+	}
+}
+
 //outmatrix is guaranteed to be no smaller than 256 elements so no need to test ip1 for 0-maxsize
-void jit_histogram_vector_char(long n, long maxsize, t_jit_op_info *in1, t_jit_op_info *out) 
+void jit_histogram_vector_char(long n, t_jit_histogram_reduce *r, t_jit_op_info *in1, t_jit_op_info *out, long subsize) 
 {
 	uchar *ip1;
-	long *op,is1,os;
+	long *op,*op1,*op2,*op3,is1,os;
 		
 	ip1 = ((uchar *)in1->p);
 	op  = ((long *)out->p);
 	is1 = in1->stride; 
 	os  = out->stride; 
 	
+	if (subsize) {
+		op1 = op + subsize;
+		op2 = op1 + subsize;
+		op3 = op2 + subsize;
+		for (;n>=4;n-=4) {
+			op [ip1[0]*os] += 1;
+			op1[ip1[is1]*os] += 1;
+			op2[ip1[2*is1]*os] += 1;
+			op3[ip1[3*is1]*os] += 1;
+			ip1 += 4*is1;
+		}
+	}
 	++n;
 	while (--n) {
 		op[(*ip1)*os] += 1; ip1 += is1;
 	}
 }
 
-void jit_histogram_vector_long(long n, long maxsize, t_jit_op_info *in1, t_jit_op_info *out) 
+void jit_histogram_vector_long(long n, t_jit_histogram_reduce *r, t_jit_op_info *in1, t_jit_op_info *out, long subsize) 
 {
-	long *ip1,*op,is1,os,c;
+	long *ip1,*op,*op1,*op2,*op3,is1,os,c,maxsize=r->bincount;
 		
 	ip1 = ((long *)in1->p);
 	op  = ((long *)out->p);
 	is1 = in1->stride; 
 	os  = out->stride; 
 	
+	if (subsize) {
+		op1 = op + subsize;
+		op2 = op1 + subsize;
+		op3 = op2 + subsize;
+		for (;n>=4;n-=4) {
+			c = ip1[0];		if ((c>=0)&&(c<maxsize)) op [c*os] += 1; 
+			c = ip1[is1];	if ((c>=0)&&(c<maxsize)) op1[c*os] += 1; 
+			c = ip1[2*is1];	if ((c>=0)&&(c<maxsize)) op2[c*os] += 1; 
+			c = ip1[3*is1];	if ((c>=0)&&(c<maxsize)) op3[c*os] += 1; 
+			ip1 += 4*is1;
+		}
+	}
 	++n;
 	while (--n) {
 		c = *ip1;
@@ -209,6 +345,185 @@ void jit_histogram_vector_long(long n, long maxsize, t_jit_op_info *in1, t_jit_o
 	}
 }
 
+//float values from min to max (inclusive) go to bins 0 to bincount-1, anything else 
+//(including nan) is not counted. bin numbers are worked out a block at a time, four 
+//(float32) or two (float64) at once with sse2, into idx, where -1 marks a skipped cell.
+void jit_histogram_vector_float32(long n, t_jit_histogram_reduce *r, t_jit_op_info *in1, t_jit_op_info *out, long subsize) 
+{
+	float *ip1,v,t,min,max,scale;
+	long *op,is1,os,i,m,last;
+	int idx[JIT_HISTOGRAM_BLOCK];
+#if JIT_HISTOGRAM_SSE2
+	__m128 vv,vmin,vmax,vscale,ok;
+	__m128i vb,vlast,over;
+#endif
+		
+	ip1 = ((float *)in1->p);
+	op  = ((long *)out->p);
+	is1 = in1->stride; 
+	os  = out->stride; 
+	min = r->x->min;
+	max = r->x->max;
+	scale = r->scale;
+	last = r->bincount-1;
+	if (last<0) return;
+#if JIT_HISTOGRAM_SSE2
+	vmin = _mm_set1_ps(min);
+	vmax = _mm_set1_ps(max);
+	vscale = _mm_set1_ps(scale);
+	vlast = _mm_set1_epi32(last);
+#endif
+	
+	while (n>0) {
+		m = MIN(n,JIT_HISTOGRAM_BLOCK);
+		i = 0;
+#if JIT_HISTOGRAM_SSE2
+		for (;i+4<=m;i+=4) {
+			vv = _mm_setr_ps(ip1[i*is1],ip1[(i+1)*is1],ip1[(i+2)*is1],ip1[(i+3)*is1]);
+			ok = _mm_and_ps(_mm_cmpge_ps(vv,vmin),_mm_cmple_ps(vv,vmax));
+			vb = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(vv,vmin),vscale));
+			over = _mm_cmpgt_epi32(vb,vlast);
+			vb = _mm_or_si128(_mm_and_si128(over,vlast),_mm_andnot_si128(over,vb));
+			vb = _mm_or_si128(_mm_and_si128(_mm_castps_si128(ok),vb),_mm_andnot_si128(_mm_castps_si128(ok),_mm_set1_epi32(-1)));
+			_mm_storeu_si128((__m128i *)(idx+i),vb);
+		}
+#endif
+		for (;i<m;i++) {
+			v = ip1[i*is1];
+			t = (v-min)*scale;
+			idx[i] = ((v>=min)&&(v<=max)) ? MIN((long)t,last) : -1;
+		}
+		jit_histogram_count(m,idx,op,os,subsize);
+		ip1 += m*is1;
+		n -= m;
+	}
+}
+
+void jit_histogram_vector_float64(long n, t_jit_histogram_reduce *r, t_jit_op_info *in1, t_jit_op_info *out, long subsize) 
+{
+	double *ip1,v,t,min,max,scale;
+	long *op,is1,os,i,m,last;
+	int idx[JIT_HISTOGRAM_BLOCK];
+#if JIT_HISTOGRAM_SSE2
+	__m128d vv,vmin,vmax,vscale,ok;
+	__m128i vb,vlast,over,vok;
+#endif
+		
+	ip1 = ((double *)in1->p);
+	op  = ((long *)out->p);
+	is1 = in1->stride; 
+	os  = out->stride; 
+	min = r->x->min;
+	max = r->x->max;
+	scale = r->scale;
+	last = r->bincount-1;
+	if (last<0) return;
+#if JIT_HISTOGRAM_SSE2
+	vmin = _mm_set1_pd(min);
+	vmax = _mm_set1_pd(max);
+	vscale = _mm_set1_pd(scale);
+	vlast = _mm_set1_epi32(last);
+#endif
+	
+	while (n>0) {
+		m = MIN(n,JIT_HISTOGRAM_BLOCK);
+		i = 0;
+#if JIT_HISTOGRAM_SSE2
+		for (;i+2<=m;i+=2) {
+			vv = _mm_setr_pd(ip1[i*is1],ip1[(i+1)*is1]);
+			ok = _mm_and_pd(_mm_cmpge_pd(vv,vmin),_mm_cmple_pd(vv,vmax));
+			//the two 64 bit masks narrowed to the two low 32 bit lanes, like the cvttpd result
+			vok = _mm_shuffle_epi32(_mm_castpd_si128(ok),_MM_SHUFFLE(3,3,2,0));
+			vb = _mm_cvttpd_epi32(_mm_mul_pd(_mm_sub_pd(vv,vmin),vscale));
+			over = _mm_cmpgt_epi32(vb,vlast);
+			vb = _mm_or_si128(_mm_and_si128(over,vlast),_mm_andnot_si128(over,vb));
+			vb = _mm_or_si128(_mm_and_si128(vok,vb),_mm_andnot_si128(vok,_mm_set1_epi32(-1)));
+			_mm_storel_epi64((__m128i *)(idx+i),vb);
+		}
+#endif
+		for (;i<m;i++) {
+			v = ip1[i*is1];
+			t = (v-min)*scale;
+			idx[i] = ((v>=min)&&(v<=max)) ? MIN((long)t,last) : -1;
+		}
+		jit_histogram_count(m,idx,op,os,subsize);
+		ip1 += m*is1;
+		n -= m;
+	}
+}
+
+void jit_histogram_count(long n, int *idx, long *op, long os, long subsize) 
+{
+	long *op1,*op2,*op3;
+	
+	if (subsize) {
+		op1 = op + subsize;
+		op2 = op1 + subsize;
+		op3 = op2 + subsize;
+		for (;n>=4;n-=4,idx+=4) {
+			if (idx[0]>=0) op [idx[0]*os] += 1;
+			if (idx[1]>=0) op1[idx[1]*os] += 1;
+			if (idx[2]>=0) op2[idx[2]*os] += 1;
+			if (idx[3]>=0) op3[idx[3]*os] += 1;
+		}
+	}
+	++n;
+	while (--n) {
+		if (*idx>=0) op[(*idx)*os] += 1; 
+		idx++;
+	}
+}
+
+//adds bins (laid out like the first row of the output) to the output, or replaces it when 
+//clear is set, and finds the maximums for normalize on the way so that it only needs one 
+//more pass. normalize 1 scales each plane to normval, 2 all planes together.
+void jit_histogram_merge(t_jit_matrix_info *out_minfo, char *bop, long *bins, long clear, long normalize, long normval) 
+{
+	long i,j,n,*op,os,max[JIT_MATRIX_MAX_PLANECOUNT],all=0;
+	double scale;
+	
+	os = out_minfo->planecount; 
+	n = out_minfo->dim[0]*os;
+	op = (long *)bop;
+	normval = ABS(normval);
+	for (j=0;j<os;j++)
+		max[j] = 0;
+	
+	if (clear) {
+		for (i=0;i<n;i+=os) {
+			for (j=0;j<os;j++) {
+				op[i+j] = bins[i+j];
+				max[j] = MAX(max[j],ABS(op[i+j]));
+			}
+		}
+	} else {
+		for (i=0;i<n;i+=os) {
+			for (j=0;j<os;j++) {
+				op[i+j] += bins[i+j];
+				max[j] = MAX(max[j],ABS(op[i+j]));
+			}
+		}
+	}
+	if (!normalize)
+		return;
+	if (normalize==2) {
+		for (j=0;j<os;j++)
+			all = MAX(all,max[j]);
+		for (j=0;j<os;j++)
+			max[j] = all;
+	}
+	for (j=0;j<os;j++) {
+		if (max[j]&&normval) {
+			scale = (double)normval/(double)max[j];
+			for (i=j;i<n;i+=os)
+				op[i] = (long)(((double)op[i])*scale);
+		} else {
+			for (i=j;i<n;i+=os)
+				op[i] = 0;
+		}
+	}
+}
+
 void jit_histogram_normalize(t_jit_matrix_info *out_minfo, char *bop, long normval) 
 {
 	long j,n,in,*op,os,max;
@@ -261,7 +576,9 @@ t_jit_histogram *jit_histogram_new(void)
 	t_jit_histogram *x;
 		
 	if (x=(t_jit_histogram *)jit_object_alloc(_jit_histogram_class)) {
-
+		x->bins = 0;
+		x->min = 0.;
+		x->max = 1.;
 	} else {
 		x = NULL;
 	}	
@@ -16,6 +16,7 @@ t_jit_err jit_histogram_init(void);
 
 void *max_jit_histogram_new(t_symbol *s, long argc, t_atom *argv);
 void max_jit_histogram_free(t_max_jit_histogram *x);
+void max_jit_histogram_mproc(t_max_jit_histogram *x, void *mop);
 void *max_jit_histogram_class;
 		 	
 void main(void)
@@ -29,10 +30,44 @@ void main(void)
 	p = max_jit_classex_setup(calcoffset(t_max_jit_histogram,obex));
 	q = jit_class_findbyname(gensym("jit_histogram"));    
     max_jit_classex_mop_wrap(p,q,0); 		
+    max_jit_classex_mop_mproc(p,q,max_jit_histogram_mproc); 	//custom mproc, sizes the output for float input
     max_jit_classex_standard_wrap(p,q,0); 	
     addmess((method)max_jit_mop_assist, "assist", A_CANT,0);
 }
 
+void max_jit_histogram_mproc(t_max_jit_histogram *x, void *mop)
+{
+	t_jit_err err;
+	t_jit_matrix_info info;
+	void *o;
+	long bins;
+	
+	//float input is counted into bins bins, so the output dim follows the bins attribute
+	o = max_jit_mop_getinput(x,1);
+	jit_object_method(o,_jit_sym_getinfo,&info);
+	if ((info.type==_jit_sym_float32)||(info.type==_jit_sym_float64)) {
+		bins = jit_attr_getlong(max_jit_obex_jitob_get(x),gensym("bins"));
+		o = max_jit_mop_getoutput(x,1);
+		jit_object_method(o,_jit_sym_getinfo,&info);
+		if ((bins>0)&&((info.dimcount!=1)||(info.dim[0]!=bins))) {
+			info.dimcount = 1;
+			info.dim[0] = bins;
+			jit_object_method(o,_jit_sym_setinfo,&info);
+		}
+	}
+	
+	if (err=(t_jit_err) jit_object_method(
+		max_jit_obex_jitob_get(x),
+		_jit_sym_matrix_calc,
+		jit_object_method(mop,_jit_sym_getinputlist),
+		jit_object_method(mop,_jit_sym_getoutputlist))) 
+	{
+		jit_error_code(x,err); 
+	} else {
+		max_jit_mop_outputmatrix(x);
+	}
+}
+
 void max_jit_histogram_free(t_max_jit_histogram *x)
 {
 	max_jit_mop_free(x);
@@ -13,39 +13,84 @@
  * jit.keyscreen takes a color and a tolerance range for the keying.  it can work by cell or by plane (set via 
  * the 'mode' attribute).
  *
+ * with 'soft' above 0 the key fades out over that distance past the tolerance instead of stopping dead,
+ * and the mask is mixed onto the target by how far inside the key each cell is.  the second outlet gets
+ * a 1 plane float32 alpha matte of the key, 1 where the mask shows and 0 where the target does.  the
+ * matte is optional: when no second output matrix is passed it is not calculated.
+ *
  */
  
 #include "jit.common.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIT_KEYSCREEN_SSE2		1
+#include <emmintrin.h>
+#endif
+
 typedef struct _jit_keyscreen 
 {
 	t_object				ob;
 	long					key, target, mask,mode;
 	float					alpha, red, green, blue, alphatol, redtol, greentol, bluetol;
+	float					soft;
 } t_jit_keyscreen;
 
+typedef struct _jit_keyscreen_vecdata t_jit_keyscreen_vecdata;
+typedef void (*t_jit_keyscreen_rowfn)(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op);
+typedef void (*t_jit_keyscreen_mattefn)(t_jit_keyscreen_vecdata *v, long n, uchar *kp, float *op);
+
+struct _jit_keyscreen_vecdata
+{
+	t_jit_keyscreen_rowfn	rowfn;
+	t_jit_keyscreen_mattefn	mattefn;
+	uchar					lo[16],hi[16];		//key range of each plane, clipped to 0-255 and repeated for 4 cells
+	uchar					nlo[16],nhi[16];	//the key range and the soft edge past it
+	float					flo[4],fhi[4];		//unclipped, for the soft edge
+	float					soft;				//edge width, 255 is 1
+};
+
 void *_jit_keyscreen_class;
 
 t_jit_keyscreen *jit_keyscreen_new(void);
 void jit_keyscreen_free(t_jit_keyscreen *x);
 t_jit_err jit_keyscreen_matrix_calc(t_jit_keyscreen *x, void *inputs, void *outputs);
-void jit_keyscreen_calculate_ndim(t_jit_keyscreen *x, long dimcount, long *dim, long planecount, 
-	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *in2_minfo, char *bip2, t_jit_matrix_info *in3_minfo, char *bip3, t_jit_matrix_info *out_minfo, char *bop);
+void jit_keyscreen_getvecdata(t_jit_keyscreen *x, t_jit_keyscreen_vecdata *v);
+static void jit_keyscreen_byterange(long lo, long hi, uchar *blo, uchar *bhi);
+void jit_keyscreen_calculate_ndim(t_jit_keyscreen_vecdata *v, long dimcount, long *dim, long planecount,
+	t_jit_matrix_info *key_minfo, char *bkp, t_jit_matrix_info *target_minfo, char *btp, t_jit_matrix_info *mask_minfo, char *bmp, t_jit_matrix_info *out_minfo, char *bop);
+void jit_keyscreen_matte_ndim(t_jit_keyscreen_vecdata *v, long dimcount, long *dim, long planecount,
+	t_jit_matrix_info *key_minfo, char *bkp, t_jit_matrix_info *out_minfo, char *bop);
+void jit_keyscreen_cell(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op);
+void jit_keyscreen_plane(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op);
+void jit_keyscreen_cell_soft(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op);
+void jit_keyscreen_plane_soft(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op);
+void jit_keyscreen_matte(t_jit_keyscreen_vecdata *v, long n, uchar *kp, float *op);
+void jit_keyscreen_matte_soft(t_jit_keyscreen_vecdata *v, long n, uchar *kp, float *op);
 t_jit_err jit_keyscreen_init(void);
 
 
 t_jit_err jit_keyscreen_init(void) 
 {
 	long attrflags=0;
-	t_jit_object *attr, *mop;
+	t_jit_object *attr, *mop, *o;
+	t_atom a;
 	
 	_jit_keyscreen_class = jit_class_new("jit_keyscreen",(method)jit_keyscreen_new,(method)jit_keyscreen_free,
 		sizeof(t_jit_keyscreen),0L);
 
 	//add mop
-	mop = jit_object_new(_jit_sym_jit_mop,3,1);
+	mop = jit_object_new(_jit_sym_jit_mop,3,2);
 	jit_mop_single_type(mop,_jit_sym_char);
 	jit_mop_single_planecount(mop,4);
+	//the matte is 1 plane float32
+	o = jit_object_method(mop,_jit_sym_getoutput,2);
+	jit_attr_setlong(o,_jit_sym_typelink,0);
+	jit_attr_setlong(o,_jit_sym_planelink,0);
+	jit_atom_setsym(&a,_jit_sym_float32);
+	jit_object_method(o,_jit_sym_types,1,&a);
+	jit_atom_setlong(&a,1);
+	jit_object_method(o,_jit_sym_minplanecount,1,&a);
+	jit_object_method(o,_jit_sym_maxplanecount,1,&a);
 	jit_class_addadornment(_jit_keyscreen_class,mop);
 
 	//add methods
@@ -98,6 +143,11 @@ t_jit_err jit_keyscreen_init(void)
 		(method)0L,(method)0L,calcoffset(t_jit_keyscreen,bluetol));
 	jit_class_addattr(_jit_keyscreen_class,attr);
 
+	// soft -- width of the edge past the tolerances over which the key fades out
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"soft",_jit_sym_float32,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_keyscreen,soft));
+	jit_class_addattr(_jit_keyscreen_class,attr);
+
 		
 	jit_class_register(_jit_keyscreen_class);
 
@@ -108,16 +158,20 @@ t_jit_err jit_keyscreen_init(void)
 t_jit_err jit_keyscreen_matrix_calc(t_jit_keyscreen *x, void *inputs, void *outputs)
 {
 	t_jit_err err=JIT_ERR_NONE;
-	long in_savelock,in2_savelock,in3_savelock,out_savelock;
-	t_jit_matrix_info in_minfo,in2_minfo,in3_minfo,out_minfo;
-	char *in_bp,*in2_bp,*in3_bp,*out_bp;
-	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
-	void *in_matrix, *in2_matrix, *in3_matrix, *out_matrix;
+	long in_savelock,in2_savelock,in3_savelock,out_savelock,out2_savelock=0;
+	t_jit_matrix_info in_minfo,in2_minfo,in3_minfo,out_minfo,out2_minfo;
+	t_jit_matrix_info *key_minfo,*target_minfo,*mask_minfo;
+	char *in_bp,*in2_bp,*in3_bp,*out_bp,*out2_bp,*key_bp,*target_bp,*mask_bp;
+	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT],matte_dimcount,matte_dim[JIT_MATRIX_MAX_DIMCOUNT];
+	void *in_matrix, *in2_matrix, *in3_matrix, *out_matrix, *out2_matrix;
+	t_jit_keyscreen_vecdata vecdata;
 
 	in_matrix = jit_object_method(inputs, _jit_sym_getindex, 0);
 	in2_matrix = jit_object_method(inputs, _jit_sym_getindex, 1);
 	in3_matrix = jit_object_method(inputs, _jit_sym_getindex, 2);
 	out_matrix = jit_object_method(outputs,_jit_sym_getindex, 0);
+	//the matte output is optional
+	out2_matrix = jit_object_method(outputs,_jit_sym_getindex, 1);
 
 	if (x&&in_matrix&&in2_matrix&&in3_matrix&&out_matrix) {
 		
@@ -125,18 +179,25 @@ t_jit_err jit_keyscreen_matrix_calc(t_jit_keyscreen *x, void *inputs, void *outp
 		in2_savelock = (long) jit_object_method(in2_matrix,_jit_sym_lock,1);
 		in3_savelock = (long) jit_object_method(in3_matrix,_jit_sym_lock,1);
 		out_savelock = (long) jit_object_method(out_matrix,_jit_sym_lock,1);
+		if (out2_matrix)
+			out2_savelock = (long) jit_object_method(out2_matrix,_jit_sym_lock,1);
 		
 		jit_object_method(in_matrix,_jit_sym_getinfo,&in_minfo);
 		jit_object_method(in2_matrix,_jit_sym_getinfo,&in2_minfo);
 		jit_object_method(in3_matrix,_jit_sym_getinfo,&in3_minfo);
 		jit_object_method(out_matrix,_jit_sym_getinfo,&out_minfo);
+		if (out2_matrix)
+			jit_object_method(out2_matrix,_jit_sym_getinfo,&out2_minfo);
 		
 		jit_object_method(in_matrix,_jit_sym_getdata,&in_bp);
 		jit_object_method(in2_matrix,_jit_sym_getdata,&in2_bp);
 		jit_object_method(in3_matrix,_jit_sym_getdata,&in3_bp);
 		jit_object_method(out_matrix,_jit_sym_getdata,&out_bp);
+		if (out2_matrix)
+			jit_object_method(out2_matrix,_jit_sym_getdata,&out2_bp);
 		
 		if (!in_bp||!in2_bp||!in3_bp||!out_bp) { err=JIT_ERR_GENERIC; goto out;}
+		if (out2_matrix&&!out2_bp) { err=JIT_ERR_GENERIC; goto out;}
 		
 		//compatible types?
 		if ((in_minfo.type!=_jit_sym_char)||(in_minfo.type!=out_minfo.type)) { 
@@ -178,6 +239,26 @@ t_jit_err jit_keyscreen_matrix_calc(t_jit_keyscreen *x, void *inputs, void *outp
 			goto out;
 		}		
 
+		//compatible matte?
+		if (out2_matrix) {
+			if (out2_minfo.type!=_jit_sym_float32) {
+				err=JIT_ERR_MISMATCH_TYPE;
+				goto out;
+			}
+			if (out2_minfo.planecount!=1) {
+				err=JIT_ERR_MISMATCH_PLANE;
+				goto out;
+			}
+		}
+
+		// map the inputs to key, target and mask
+		key_minfo = (x->key==1) ? &in3_minfo : (x->key==2) ? &in2_minfo : &in_minfo;
+		key_bp = (x->key==1) ? in3_bp : (x->key==2) ? in2_bp : in_bp;
+		target_minfo = (x->target==0) ? &in_minfo : (x->target==2) ? &in2_minfo : &in3_minfo;
+		target_bp = (x->target==0) ? in_bp : (x->target==2) ? in2_bp : in3_bp;
+		mask_minfo = (x->mask==0) ? &in_minfo : (x->mask==1) ? &in3_minfo : &in2_minfo;
+		mask_bp = (x->mask==0) ? in_bp : (x->mask==1) ? in3_bp : in2_bp;
+
 		//get dimensions/planecount
 		dimcount   = out_minfo.dimcount;
 		planecount = out_minfo.planecount;			
@@ -187,17 +268,29 @@ t_jit_err jit_keyscreen_matrix_calc(t_jit_keyscreen *x, void *inputs, void *outp
 			dim[i] = MIN(dim[i],in3_minfo.dim[i]);
 		}		
 				
-		//calculate
+		//calculate. every cell costs the same, so the usual static split is balanced
+		jit_keyscreen_getvecdata(x,&vecdata);
 		jit_parallel_ndim_simplecalc4((method)jit_keyscreen_calculate_ndim,
-			x, dimcount, dim, planecount, &in_minfo, in_bp, &in2_minfo, in2_bp, 
-			&in3_minfo, in3_bp, &out_minfo, out_bp,
+			&vecdata, dimcount, dim, planecount, key_minfo, key_bp, target_minfo, target_bp,
+			mask_minfo, mask_bp, &out_minfo, out_bp,
 			0 /* flags1 */, 0 /* flags2 */, 0 /* flags2 */, 0 /* flags4 */);
+		if (out2_matrix) {
+			matte_dimcount = MIN(out2_minfo.dimcount,key_minfo->dimcount);
+			for (i=0;i<matte_dimcount;i++) {
+				matte_dim[i] = MIN(key_minfo->dim[i],out2_minfo.dim[i]);
+			}
+			jit_parallel_ndim_simplecalc2((method)jit_keyscreen_matte_ndim,
+				&vecdata, matte_dimcount, matte_dim, 1, key_minfo, key_bp, &out2_minfo, out2_bp,
+				0 /* flags1 */, 0 /* flags2 */);
+		}
 
 	} else {
 		return JIT_ERR_INVALID_PTR;
 	}
 	
 out:
+	if (out2_matrix)
+		jit_object_method(out2_matrix,_jit_sym_lock,out2_savelock);
 	jit_object_method(out_matrix,_jit_sym_lock,out_savelock);
 	jit_object_method(in_matrix,_jit_sym_lock,in_savelock);
 	jit_object_method(in2_matrix,_jit_sym_lock,in2_savelock);
@@ -205,43 +298,69 @@ out:
 	return err;
 }
 
-//recursive function to handle higher dimension matrices, by processing 2D sections at a time 
-void jit_keyscreen_calculate_ndim(t_jit_keyscreen *x, long dimcount, long *dim, long planecount, 
-	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *in2_minfo, char *bip2, 
-	t_jit_matrix_info *in3_minfo, char *bip3, t_jit_matrix_info *out_minfo, char *bop)
+// get all the struct variables scaled into integers as before, and pick the row functions for the mode
+void jit_keyscreen_getvecdata(t_jit_keyscreen *x, t_jit_keyscreen_vecdata *v)
 {
-	long i,j,i1,j1,width,height, rowoffset, coloffset, rowstep, colstep;
-	uchar *ip,*ip2,*ip3,*op,*src3,*src2,*src,*dst,*ksrc,*tsrc,*msrc;
-	long kstride,tstride,mstride,ostride;
-	long alpha, red, green, blue, af, rf, gf, bf, mode, key, target, mask, check=0;
-	long aMf, aPf, rMf, rPf, gMf, gPf, bMf, bPf;
-
-	// get all the struct variables into locals and scale them into integers
-
-	mode = x->mode;
-
-	alpha = x->alpha*255.;
-	red = x->red*255.;
-	green = x->green*255.;
-	blue = x->blue*255.;
-	af = x->alphatol*255.;
-	rf = x->redtol*255.;
-	gf = x->greentol*255.;
-	bf = x->bluetol*255.;
-
-	key = x->key;
-	target = x->target;
-	mask = x->mask;
-	
-	aMf = alpha - af;
-	aPf = alpha + af;
-	rMf = red - rf;
-	rPf = red + rf;
-	gMf = green - gf;
-	gPf = green + gf;
-	bMf = blue - bf;
-	bPf = blue + bf;
+	long i,lo,hi,w,c[4],tol[4];
+
+	c[0] = x->alpha*255.;
+	c[1] = x->red*255.;
+	c[2] = x->green*255.;
+	c[3] = x->blue*255.;
+	tol[0] = x->alphatol*255.;
+	tol[1] = x->redtol*255.;
+	tol[2] = x->greentol*255.;
+	tol[3] = x->bluetol*255.;
+
+	// key values are whole numbers, so an edge up to 1 wide keys the same as none
+	if (x->soft*255.>1.) {
+		// far wider than any distance, and keeps the arithmetic finite
+		v->soft = MIN(x->soft*255.,65536.);
+		v->rowfn = (x->mode==1) ? jit_keyscreen_plane_soft : jit_keyscreen_cell_soft;
+		v->mattefn = jit_keyscreen_matte_soft;
+	} else {
+		v->soft = 0;
+		v->rowfn = (x->mode==1) ? jit_keyscreen_plane : jit_keyscreen_cell;
+		v->mattefn = jit_keyscreen_matte;
+	}
+	// values less than the edge width past the range, the only ones that don't key fully one way
+	w = ceil(v->soft);
+
+	for (i=0;i<4;i++) {
+		lo = c[i] - tol[i];
+		hi = c[i] + tol[i];
+		v->flo[i] = lo;
+		v->fhi[i] = hi;
+		jit_keyscreen_byterange(lo,hi,v->lo+i,v->hi+i);
+		jit_keyscreen_byterange(lo-w+1,hi+w-1,v->nlo+i,v->nhi+i);
+	}
+}
 
+// lo-hi as bytes in every fourth entry of 16. a range entirely outside 0-255 matches nothing,
+// and neither does 255-0
+static void jit_keyscreen_byterange(long lo, long hi, uchar *blo, uchar *bhi)
+{
+	long j;
+
+	if ((lo>255)||(hi<0)) {
+		lo = 255;
+		hi = 0;
+	}
+	CLIP(lo,0,255);
+	CLIP(hi,0,255);
+	for (j=0;j<16;j+=4) {
+		blo[j] = lo;
+		bhi[j] = hi;
+	}
+}
+
+//recursive function to handle higher dimension matrices, by processing 2D sections at a time 
+void jit_keyscreen_calculate_ndim(t_jit_keyscreen_vecdata *v, long dimcount, long *dim, long planecount,
+	t_jit_matrix_info *key_minfo, char *bkp, t_jit_matrix_info *target_minfo, char *btp,
+	t_jit_matrix_info *mask_minfo, char *bmp, t_jit_matrix_info *out_minfo, char *bop)
+{
+	long i;
+	char *kp,*tp,*mp,*op;
 				
 	if (dimcount<1) return; //safety
 	
@@ -249,67 +368,288 @@ void jit_keyscreen_calculate_ndim(t_jit_keyscreen *x, long dimcount, long *dim,
 	case 1:
 		dim[1]=1;
 	case 2:
-		width  = dim[0];
-		height = dim[1];
+		for (i=0;i<dim[1];i++){
+			kp = bkp + i*key_minfo->dimstride[1];
+			tp = btp + i*target_minfo->dimstride[1];
+			mp = bmp + i*mask_minfo->dimstride[1];
+			op = bop + i*out_minfo->dimstride[1];
+			(*v->rowfn)(v,dim[0],(uchar *)kp,(uchar *)tp,(uchar *)mp,(uchar *)op);
+		}
+		break;
+	default:
+		for	(i=0;i<dim[dimcount-1];i++) {
+			kp = bkp + i*key_minfo->dimstride[dimcount-1];
+			tp = btp + i*target_minfo->dimstride[dimcount-1];
+			mp = bmp + i*mask_minfo->dimstride[dimcount-1];
+			op = bop + i*out_minfo->dimstride[dimcount-1];
+			jit_keyscreen_calculate_ndim(v,dimcount-1,dim,planecount,key_minfo,kp,target_minfo,tp,mask_minfo,mp,out_minfo,op);
+		}
+	}
+}
 
-		// map the input sources to the right pointers and rowstrides
-		
-		ksrc = (key==1) ? bip3 : (key==2) ? bip2 : bip;
-		tsrc = (target==0) ? bip : (target==2) ? bip2 : bip3;
-		msrc = (mask==0) ? bip : (mask==1) ? bip3 : bip2;
-
-		kstride = (key==1) ? in3_minfo->dimstride[1] : (key==2) ? in2_minfo->dimstride[1] : in_minfo->dimstride[1];
-		tstride = (target==0) ? in_minfo->dimstride[1] : (target==2) ? in2_minfo->dimstride[1] : in3_minfo->dimstride[1];
-		mstride = (mask==1) ? in_minfo->dimstride[1] : (mask==1) ? in3_minfo->dimstride[1] : in2_minfo->dimstride[1];
-
-		ostride=out_minfo->dimstride[1];
-
-			// which mode of keying?	
-			switch(mode) {
-			case(1): 	// plane-by-plane
-				for (i=0;i<height;i++){
-					ip = ksrc + i*kstride;
-					ip2 = tsrc + i*tstride;
-					ip3 = msrc + i*mstride;
-					op = bop + i*ostride;
-						
-					for (j=0;j<width;j++,ip+=4,ip2+=4,ip3+=4) { // to key or not to key
-						*op++ = (*(ip)>=aMf&&*(ip)<=aPf) ? *ip3 : *ip2;
-						*op++ = (*(ip+1)>=rMf&&*(ip+1)<=rPf) ? *(ip3+1) : *(ip2+1);
-						*op++ = (*(ip+2)>=gMf&&*(ip+2)<=gPf) ? *(ip3+2) : *(ip2+2);
-						*op++ = (*(ip+3)>=bMf&&*(ip+3)<=bPf) ? *(ip3+3) : *(ip2+3);						
-					}
-				}
-			break;
-			case(0): // cell-by-cell
-			default:
-				for (i=0;i<height;i++){
-					ip = ksrc + i * kstride;
-					ip2 = tsrc + i * tstride;
-					ip3 = msrc + i * mstride;
-					op = bop + i*ostride;
-						
-					for (j=0;j<width;j++, ip+=4, ip2+=4,ip3+=4) {			
-
-						// see if any of the planes fail any of the criteria, and key accordingly
-						*((long *)op)++ = (*ip<aMf) ? *((long *)ip2) : (*ip>aPf) ? *((long *)ip2) : (*(ip+1)<rMf) ? *((long *)ip2) : (*(ip+1)>rPf) ? *((long *)ip2) : (*(ip+2)<gMf) ? *((long *)ip2) : (*(ip+2)>gPf) ? *((long *)ip2) : (*(ip+3)<bMf) ? *((long *)ip2) : (*(ip+3)>bPf) ? *((long *)ip2) : *((long *)ip3);
-						
-					}
-				}
-			break;
-			}
+void jit_keyscreen_matte_ndim(t_jit_keyscreen_vecdata *v, long dimcount, long *dim, long planecount,
+	t_jit_matrix_info *key_minfo, char *bkp, t_jit_matrix_info *out_minfo, char *bop)
+{
+	long i;
+	char *kp,*op;
+
+	if (dimcount<1) return; //safety
+
+	switch(dimcount) {
+	case 1:
+		dim[1]=1;
+	case 2:
+		for (i=0;i<dim[1];i++){
+			kp = bkp + i*key_minfo->dimstride[1];
+			op = bop + i*out_minfo->dimstride[1];
+			(*v->mattefn)(v,dim[0],(uchar *)kp,(float *)op);
+		}
 		break;
 	default:
 		for	(i=0;i<dim[dimcount-1];i++) {
-			ip = bip + i * in_minfo->dimstride[dimcount-1];
-			ip2 = bip2 + i * in2_minfo->dimstride[dimcount-1];
-			ip3 = bip3 + i * in3_minfo->dimstride[dimcount-1];
-			op = bop + i * out_minfo->dimstride[dimcount-1];
-			jit_keyscreen_calculate_ndim(x,dimcount-1,dim,planecount,in_minfo,ip,in2_minfo,ip2,in3_minfo,ip3,out_minfo,op);
+			kp = bkp + i*key_minfo->dimstride[dimcount-1];
+			op = bop + i*out_minfo->dimstride[dimcount-1];
+			jit_keyscreen_matte_ndim(v,dimcount-1,dim,planecount,key_minfo,kp,out_minfo,op);
 		}
 	}
 }
 
+#if JIT_KEYSCREEN_SSE2
+//0xff in each byte of k inside its plane's range
+#define JIT_KEYSCREEN_INSIDE(k,lo,hi) \
+	_mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(k,lo),k),_mm_cmpeq_epi8(_mm_min_epu8(k,hi),k))
+
+//how far inside the key each plane of a cell of key values k is, (w - distance past the range)/w
+//clipped to 0, so exactly 1 in range and exactly 0 from w past it
+#define JIT_KEYSCREEN_DEGREE(k,lo,hi,w,zero) \
+	_mm_div_ps(_mm_max_ps(_mm_sub_ps(w,_mm_max_ps(_mm_max_ps(_mm_sub_ps(lo,k),_mm_sub_ps(k,hi)),zero)),zero),w)
+
+//smallest of the 4 lanes, in every lane
+#define JIT_KEYSCREEN_MIN4(d) \
+	d = _mm_min_ps(d,_mm_shuffle_ps(d,d,_MM_SHUFFLE(2,3,0,1))); \
+	d = _mm_min_ps(d,_mm_shuffle_ps(d,d,_MM_SHUFFLE(1,0,3,2)));
+
+//cell c (0-3) of 16 key bytes unpacked to 16 bits in w[2], as floats
+#define JIT_KEYSCREEN_CELL(w,c,zero) \
+	_mm_cvtepi32_ps(((c)&1) ? _mm_unpackhi_epi16(w[(c)>>1],zero) : _mm_unpacklo_epi16(w[(c)>>1],zero))
+#endif
+
+#define JIT_KEYSCREEN_DEGREE1(v,p,k) \
+	(MAX((v)->soft - MAX(MAX((v)->flo[p]-(k),(k)-(v)->fhi[p]),0.f),0.f)/(v)->soft)
+
+// cell by cell: the whole cell of the mask replaces the target wherever every plane of the key
+// is in range. 4 cells at a time, selected with a mask instead of a branch
+void jit_keyscreen_cell(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op)
+{
+	long j=0,p,in;
+#if JIT_KEYSCREEN_SSE2
+	__m128i k,s,lo,hi,ones;
+
+	lo = _mm_loadu_si128((__m128i *)v->lo);
+	hi = _mm_loadu_si128((__m128i *)v->hi);
+	ones = _mm_set1_epi32(-1);
+	for (;j+4<=n;j+=4) {
+		k = _mm_loadu_si128((__m128i *)(kp+j*4));
+		s = _mm_cmpeq_epi32(JIT_KEYSCREEN_INSIDE(k,lo,hi),ones);
+		k = _mm_or_si128(_mm_and_si128(s,_mm_loadu_si128((__m128i *)(mp+j*4))),
+			_mm_andnot_si128(s,_mm_loadu_si128((__m128i *)(tp+j*4))));
+		_mm_storeu_si128((__m128i *)(op+j*4),k);
+	}
+#endif
+	for (;j<n;j++) {
+		in = 1;
+		for (p=0;p<4;p++)
+			in &= (kp[j*4+p]>=v->lo[p])&(kp[j*4+p]<=v->hi[p]);
+		in = -in;
+		for (p=0;p<4;p++)
+			op[j*4+p] = (mp[j*4+p]&in)|(tp[j*4+p]&~in);
+	}
+}
+
+// plane by plane: each plane is keyed on its own
+void jit_keyscreen_plane(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op)
+{
+	long j=0,p,in;
+#if JIT_KEYSCREEN_SSE2
+	__m128i k,s,lo,hi;
+
+	lo = _mm_loadu_si128((__m128i *)v->lo);
+	hi = _mm_loadu_si128((__m128i *)v->hi);
+	for (;j+4<=n;j+=4) {
+		k = _mm_loadu_si128((__m128i *)(kp+j*4));
+		s = JIT_KEYSCREEN_INSIDE(k,lo,hi);
+		k = _mm_or_si128(_mm_and_si128(s,_mm_loadu_si128((__m128i *)(mp+j*4))),
+			_mm_andnot_si128(s,_mm_loadu_si128((__m128i *)(tp+j*4))));
+		_mm_storeu_si128((__m128i *)(op+j*4),k);
+	}
+#endif
+	for (j*=4;j<n*4;j++) {
+		p = j&3;
+		in = -((kp[j]>=v->lo[p])&(kp[j]<=v->hi[p]));
+		op[j] = (mp[j]&in)|(tp[j]&~in);
+	}
+}
+
+// soft edge: out = target + (mask - target)*d, d going from 1 inside the key to 0 soft past it.
+// by cell d is the smallest of the planes' degrees, by plane each plane has its own. 4 cells
+// that are all either inside the key or past the edge are selected as in the hard key
+static void jit_keyscreen_soft(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op, long cell)
+{
+	long j=0,p;
+	float d[4],e;
+#if JIT_KEYSCREEN_SSE2
+	__m128i zero,k,t,m,in,near,blo,bhi,nlo,nhi,ones,kw[2],tw[2],mw[2],o[4];
+	__m128 lo,hi,w,fzero,half,dv,tc;
+	long c;
+
+	zero = _mm_setzero_si128();
+	ones = _mm_set1_epi32(-1);
+	blo = _mm_loadu_si128((__m128i *)v->lo);
+	bhi = _mm_loadu_si128((__m128i *)v->hi);
+	nlo = _mm_loadu_si128((__m128i *)v->nlo);
+	nhi = _mm_loadu_si128((__m128i *)v->nhi);
+	lo = _mm_loadu_ps(v->flo);
+	hi = _mm_loadu_ps(v->fhi);
+	w = _mm_set1_ps(v->soft);
+	fzero = _mm_setzero_ps();
+	half = _mm_set1_ps(0.5f);
+	for (;j+4<=n;j+=4) {
+		k = _mm_loadu_si128((__m128i *)(kp+j*4));
+		t = _mm_loadu_si128((__m128i *)(tp+j*4));
+		m = _mm_loadu_si128((__m128i *)(mp+j*4));
+		in = JIT_KEYSCREEN_INSIDE(k,blo,bhi);
+		near = JIT_KEYSCREEN_INSIDE(k,nlo,nhi);
+		if (cell) {
+			in = _mm_cmpeq_epi32(in,ones);
+			near = _mm_cmpeq_epi32(near,ones);
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(in,near))==0xffff) {
+			_mm_storeu_si128((__m128i *)(op+j*4),_mm_or_si128(_mm_and_si128(in,m),_mm_andnot_si128(in,t)));
+			continue;
+		}
+		kw[0] = _mm_unpacklo_epi8(k,zero);
+		kw[1] = _mm_unpackhi_epi8(k,zero);
+		tw[0] = _mm_unpacklo_epi8(t,zero);
+		tw[1] = _mm_unpackhi_epi8(t,zero);
+		mw[0] = _mm_unpacklo_epi8(m,zero);
+		mw[1] = _mm_unpackhi_epi8(m,zero);
+		for (c=0;c<4;c++) {
+			dv = JIT_KEYSCREEN_CELL(kw,c,zero);
+			dv = JIT_KEYSCREEN_DEGREE(dv,lo,hi,w,fzero);
+			if (cell) {
+				JIT_KEYSCREEN_MIN4(dv);
+			}
+			tc = JIT_KEYSCREEN_CELL(tw,c,zero);
+			dv = _mm_mul_ps(_mm_sub_ps(JIT_KEYSCREEN_CELL(mw,c,zero),tc),dv);
+			o[c] = _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(tc,dv),half));
+		}
+		k = _mm_packus_epi16(_mm_packs_epi32(o[0],o[1]),_mm_packs_epi32(o[2],o[3]));
+		_mm_storeu_si128((__m128i *)(op+j*4),k);
+	}
+#endif
+	kp += j*4;
+	tp += j*4;
+	mp += j*4;
+	op += j*4;
+	for (;j<n;j++) {
+		for (p=0;p<4;p++)
+			d[p] = JIT_KEYSCREEN_DEGREE1(v,p,(float)kp[p]);
+		if (cell) {
+			e = MIN(MIN(d[0],d[1]),MIN(d[2],d[3]));
+			d[0] = d[1] = d[2] = d[3] = e;
+		}
+		for (p=0;p<4;p++)
+			op[p] = (long)((float)tp[p] + (float)(mp[p]-tp[p])*d[p] + 0.5f);
+		kp += 4;
+		tp += 4;
+		mp += 4;
+		op += 4;
+	}
+}
+
+void jit_keyscreen_cell_soft(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op)
+{
+	jit_keyscreen_soft(v,n,kp,tp,mp,op,1);
+}
+
+void jit_keyscreen_plane_soft(t_jit_keyscreen_vecdata *v, long n, uchar *kp, uchar *tp, uchar *mp, uchar *op)
+{
+	jit_keyscreen_soft(v,n,kp,tp,mp,op,0);
+}
+
+// matte: 1 where every plane of the key is in range, otherwise 0
+void jit_keyscreen_matte(t_jit_keyscreen_vecdata *v, long n, uchar *kp, float *op)
+{
+	long j=0,p,in;
+#if JIT_KEYSCREEN_SSE2
+	__m128i k,lo,hi,ones;
+	__m128 one;
+
+	lo = _mm_loadu_si128((__m128i *)v->lo);
+	hi = _mm_loadu_si128((__m128i *)v->hi);
+	ones = _mm_set1_epi32(-1);
+	one = _mm_set1_ps(1.f);
+	for (;j+4<=n;j+=4) {
+		k = _mm_loadu_si128((__m128i *)(kp+j*4));
+		k = _mm_cmpeq_epi32(JIT_KEYSCREEN_INSIDE(k,lo,hi),ones);
+		_mm_storeu_ps(op+j,_mm_and_ps(_mm_castsi128_ps(k),one));
+	}
+#endif
+	for (;j<n;j++) {
+		in = 1;
+		for (p=0;p<4;p++)
+			in &= (kp[j*4+p]>=v->lo[p])&(kp[j*4+p]<=v->hi[p]);
+		op[j] = in;
+	}
+}
+
+// soft matte: how far inside the key the whole cell is
+void jit_keyscreen_matte_soft(t_jit_keyscreen_vecdata *v, long n, uchar *kp, float *op)
+{
+	long j=0,p;
+	float e;
+#if JIT_KEYSCREEN_SSE2
+	__m128i zero,k,in,near,blo,bhi,nlo,nhi,ones,kw[2];
+	__m128 lo,hi,w,one,fzero,d0,d1,d2,d3;
+
+	zero = _mm_setzero_si128();
+	ones = _mm_set1_epi32(-1);
+	blo = _mm_loadu_si128((__m128i *)v->lo);
+	bhi = _mm_loadu_si128((__m128i *)v->hi);
+	nlo = _mm_loadu_si128((__m128i *)v->nlo);
+	nhi = _mm_loadu_si128((__m128i *)v->nhi);
+	lo = _mm_loadu_ps(v->flo);
+	hi = _mm_loadu_ps(v->fhi);
+	w = _mm_set1_ps(v->soft);
+	one = _mm_set1_ps(1.f);
+	fzero = _mm_setzero_ps();
+	for (;j+4<=n;j+=4) {
+		k = _mm_loadu_si128((__m128i *)(kp+j*4));
+		in = _mm_cmpeq_epi32(JIT_KEYSCREEN_INSIDE(k,blo,bhi),ones);
+		near = _mm_cmpeq_epi32(JIT_KEYSCREEN_INSIDE(k,nlo,nhi),ones);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(in,near))==0xffff) {
+			_mm_storeu_ps(op+j,_mm_and_ps(_mm_castsi128_ps(in),one));
+			continue;
+		}
+		kw[0] = _mm_unpacklo_epi8(k,zero);
+		kw[1] = _mm_unpackhi_epi8(k,zero);
+		d0 = JIT_KEYSCREEN_DEGREE(JIT_KEYSCREEN_CELL(kw,0,zero),lo,hi,w,fzero);
+		d1 = JIT_KEYSCREEN_DEGREE(JIT_KEYSCREEN_CELL(kw,1,zero),lo,hi,w,fzero);
+		d2 = JIT_KEYSCREEN_DEGREE(JIT_KEYSCREEN_CELL(kw,2,zero),lo,hi,w,fzero);
+		d3 = JIT_KEYSCREEN_DEGREE(JIT_KEYSCREEN_CELL(kw,3,zero),lo,hi,w,fzero);
+		//one cell per lane, then the smallest plane of each
+		_MM_TRANSPOSE4_PS(d0,d1,d2,d3);
+		_mm_storeu_ps(op+j,_mm_min_ps(_mm_min_ps(d0,d1),_mm_min_ps(d2,d3)));
+	}
+#endif
+	for (;j<n;j++) {
+		e = 1.f;
+		for (p=0;p<4;p++)
+			e = MIN(e,JIT_KEYSCREEN_DEGREE1(v,p,(float)kp[j*4+p]));
+		op[j] = e;
+	}
+}
+
 t_jit_keyscreen *jit_keyscreen_new(void)
 {
 	t_jit_keyscreen *x;
@@ -317,6 +657,7 @@ t_jit_keyscreen *jit_keyscreen_new(void)
 		
 	if (x=(t_jit_keyscreen *)jit_object_alloc(_jit_keyscreen_class)) {
 		x->alpha = x->red = x->green = x->blue = x->alphatol = x->redtol = x->greentol = x->bluetol = 0.;
+		x->soft = 0.;
 		x->mode = 0;
 		x->key = 0;
 		x->target = 1;
@@ -333,5 +674,3 @@ void jit_keyscreen_free(t_jit_keyscreen *x)
 {
 	//nada
 }
-
-
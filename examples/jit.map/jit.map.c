@@ -4,6 +4,7 @@
 */
 
 #include "jit.common.h"
+#include "common/jit.charlut.h"
 #include "jit.fixmath.h"
 
 typedef struct _jit_map_vecdata
@@ -19,6 +20,7 @@ typedef struct _jit_map_vecdata
 	long				lmax;
 	long				cmin;
 	long				cmax;
+	t_jit_charlut		*lut;
 } t_jit_map_vecdata;
 
 typedef struct _jit_map 
@@ -26,6 +28,12 @@ typedef struct _jit_map
 	t_object				ob;
 	double					map[4];
 	long					clip;
+	t_jit_charlut			lut;		//char results
+	long					lutclip;	//char parameters the table was built from
+	long					lutcscale;
+	long					lutcbias;
+	long					lutcmin;
+	long					lutcmax;
 } t_jit_map;
 
 void *_jit_map_class;
@@ -35,6 +43,7 @@ t_jit_map *jit_map_new(void);
 void jit_map_free(t_jit_map *x);
 t_jit_err jit_map_getvecdata(t_jit_map *x, t_jit_map_vecdata *vd);
 t_jit_err jit_map_matrix_calc(t_jit_map *x, void *inputs, void *outputs);
+void jit_map_charlut(t_jit_map *x, t_jit_map_vecdata *vecdata);
 
 void jit_map_calculate_ndim(t_jit_map_vecdata *vecdata, long dim, long *dimsize, long planecount, t_jit_matrix_info *in_minfo, char *bip, 
 	t_jit_matrix_info *out_minfo, char *bop);
@@ -74,6 +83,36 @@ t_jit_err jit_map_init(void)
 	return JIT_ERR_NONE;
 }
 
+//run every char value through the fixed point vector function once, whenever the
+//parameters have changed since the table was built
+void jit_map_charlut(t_jit_map *x, t_jit_map_vecdata *vecdata)
+{
+	long i;
+	t_jit_op_info in_opinfo,out_opinfo;
+	t_jit_charlut *lut=&x->lut;
+	
+	if (lut->valid&&(vecdata->clip==x->lutclip)&&(vecdata->cscale==x->lutcscale)&&(vecdata->cbias==x->lutcbias)&&
+		(vecdata->cmin==x->lutcmin)&&(vecdata->cmax==x->lutcmax))
+		return;
+	
+	for (i=0;i<256;i++) 
+		lut->table[1][i] = i;
+	in_opinfo.p = lut->table[1];
+	out_opinfo.p = lut->table[0];
+	in_opinfo.stride = out_opinfo.stride = 1;
+	if (vecdata->clip)
+		jit_map_vector_char_clip(256,vecdata,&in_opinfo,&out_opinfo);
+	else 
+		jit_map_vector_char(256,vecdata,&in_opinfo,&out_opinfo);
+	x->lutclip = vecdata->clip;
+	x->lutcscale = vecdata->cscale;
+	x->lutcbias = vecdata->cbias;
+	x->lutcmin = vecdata->cmin;
+	x->lutcmax = vecdata->cmax;
+	lut->tablecount = 1;
+	lut->valid = 1;
+}
+
 t_jit_err jit_map_getvecdata(t_jit_map *x, t_jit_map_vecdata *vd)
 {
 	if (x&&vd) {
@@ -101,8 +140,8 @@ t_jit_err jit_map_matrix_calc(t_jit_map *x, void *inputs, void *outputs)
 {
 	t_jit_err err=JIT_ERR_NONE;
 	long in_savelock,in2_savelock,out_savelock;
-	t_jit_matrix_info in_minfo,out_minfo;
-	char *in_bp,*out_bp;
+	t_jit_matrix_info in_minfo,out_minfo,in_pinfo,out_pinfo;
+	char *in_bp,*out_bp,*in_pbp,*out_pbp;
 	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
 	t_jit_map_vecdata	vecdata;
 	void *in_matrix,*out_matrix;
@@ -143,9 +182,23 @@ t_jit_err jit_map_matrix_calc(t_jit_map *x, void *inputs, void *outputs)
 		}
 				
 		jit_map_getvecdata(x,&vecdata);
-		jit_parallel_ndim_simplecalc2((method)jit_map_calculate_ndim,
-			&vecdata, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp,
-			0 /* flags1 */, 0 /* flags2 */);
+		if (in_minfo.type==_jit_sym_char) 
+			jit_map_charlut(x,&vecdata);
+		vecdata.lut = &x->lut;
+		if ((in_minfo.flags|out_minfo.flags)&JIT_MATRIX_DATA_PLANAR) {
+			//a plane at a time, each plane of a planar matrix is contiguous
+			for (i=0;i<planecount;i++) {
+				jit_planar_plane(&in_minfo,in_bp,i,&in_pinfo,&in_pbp);
+				jit_planar_plane(&out_minfo,out_bp,i,&out_pinfo,&out_pbp);
+				jit_parallel_ndim_simplecalc2((method)jit_map_calculate_ndim,
+					&vecdata, dimcount, dim, 1, &in_pinfo, in_pbp, &out_pinfo, out_pbp,
+					0 /* flags1 */, 0 /* flags2 */);
+			}
+		} else {
+			jit_parallel_ndim_simplecalc2((method)jit_map_calculate_ndim,
+				&vecdata, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp,
+				0 /* flags1 */, 0 /* flags2 */);
+		}
 	} else {
 		return JIT_ERR_INVALID_PTR;
 	}
@@ -187,10 +240,7 @@ void jit_map_calculate_ndim(t_jit_map_vecdata *vecdata, long dimcount, long *dim
 				for (j=0;j<planecount;j++) {
 					in_opinfo.p  = bip + i*in_minfo->dimstride[1] + j%in_minfo->planecount;
 					out_opinfo.p = bop + i*out_minfo->dimstride[1] + j%out_minfo->planecount;
-					if (vecdata->clip)
-						jit_map_vector_char_clip(n,vecdata,&in_opinfo,&out_opinfo);
-					else 
-						jit_map_vector_char(n,vecdata,&in_opinfo,&out_opinfo);	
+					jit_charlut_vector(n,vecdata->lut,&in_opinfo,&out_opinfo);
 				}
 			}
 		} else if (in_minfo->type==_jit_sym_long) {
@@ -467,6 +517,7 @@ t_jit_map *jit_map_new(void)
 		x->map[2] = 0.;
 		x->map[3] = 1.;
 		x->clip = 1;
+		x->lut.valid = 0;
 	} else {
 		x = NULL;
 	}	
@@ -10,6 +10,7 @@ typedef struct _max_jit_map
 {
 	t_object		ob;
 	void			*obex;
+	t_max_jit_mop_async	async;
 } t_max_jit_map;
 
 t_jit_err jit_map_init(void); 
@@ -29,12 +30,14 @@ void main(void)
 	p = max_jit_classex_setup(calcoffset(t_max_jit_map,obex));
 	q = jit_class_findbyname(gensym("jit_map"));    
     max_jit_classex_mop_wrap(p,q,0); 		//name/type/dim/planecount/bang/outputmatrix/etc
+    max_jit_classex_mop_async(p,q,calcoffset(t_max_jit_map,async)); 	//async/latency attributes
     max_jit_classex_standard_wrap(p,q,0); 	//getattributes/dumpout/maxjitclassaddmethods/etc
     addmess((method)max_jit_mop_assist, "assist", A_CANT,0);  //standard mop assist fn
 }
 
 void max_jit_map_free(t_max_jit_map *x)
 {
+	max_jit_mop_async_free(x);
 	max_jit_mop_free(x);
 	jit_object_free(max_jit_obex_jitob_get(x));
 	max_jit_obex_free(x);
@@ -48,6 +51,7 @@ void *max_jit_map_new(t_symbol *s, long argc, t_atom *argv)
 	if (x=(t_max_jit_map *)max_jit_obex_new(max_jit_map_class,gensym("jit_map"))) {
 		if (o=jit_object_new(gensym("jit_map"))) {
 			max_jit_mop_setup_simple(x,o,argc,argv);			
+			max_jit_mop_async_init(x);
 			max_jit_attr_args(x,argc,argv);
 		} else {
 			jit_object_error((t_object *)x,"jit.map: could not allocate object");
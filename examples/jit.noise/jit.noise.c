@@ -5,21 +5,52 @@
 
 #include "jit.common.h"
 
-#define jflone 	0x3f800000
-#define jflmsk  0x007fffff
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIT_NOISE_SSE2		1
+#include <emmintrin.h>
+#endif
+
+//every value is a function of the seed and of its position in the matrix, using the
+//philox4x32-10 counter based generator. a row can be filled without running through
+//the rows before it, so the output is the same however the matrix is split into threads.
+#define JIT_NOISE_PHILOX_M0		0xD2511F53
+#define JIT_NOISE_PHILOX_M1		0xCD9E8D57
+#define JIT_NOISE_PHILOX_W0		0x9E3779B9
+#define JIT_NOISE_PHILOX_W1		0xBB67AE85
+//philox blocks (4 words each) generated at a time
+#define JIT_NOISE_BLOCKS		64
+
+#define JIT_NOISE_DIST_UNIFORM		0
+#define JIT_NOISE_DIST_GAUSSIAN		1
+#define JIT_NOISE_DIST_EXPONENTIAL	2
+
+#define JIT_NOISE_TWOPI			6.28318530717958647692
+
+#ifdef _MSC_VER
+typedef unsigned __int64 t_jit_noise_index;
+#else
+typedef unsigned long long t_jit_noise_index;
+#endif
 
 typedef struct _jit_noise_vecdata
 {
-	long			randlast;
+	unsigned int		key[2];
+	long				dist;
+	char				*bp;		//start of the whole output matrix, to find where each row lies
+	t_jit_matrix_info	*minfo;
 } t_jit_noise_vecdata;
 
 typedef struct _jit_noise 
 {
 	t_object		ob;
+	long			seed;		//0 = new seed every frame
+	t_symbol		*dist;
 } t_jit_noise;
 
 void *_jit_noise_class;
 
+t_symbol *ps_uniform,*ps_gaussian,*ps_exponential;
+
 t_jit_err jit_noise_init(void); 
 t_jit_noise *jit_noise_new(void);
 void jit_noise_free(t_jit_noise *x);
@@ -27,14 +58,17 @@ t_jit_err jit_noise_getvecdata(t_jit_noise *x, t_jit_noise_vecdata *vd);
 t_jit_err jit_noise_matrix_calc(t_jit_noise *x, void *inputs, void *outputs);
 
 void jit_noise_calculate_ndim(t_jit_noise_vecdata *vecdata, long dim, long *dimsize, long planecount, t_jit_matrix_info *out_minfo, char *bop);
-void jit_noise_vector_char		(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out); 
-void jit_noise_vector_long		(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out); 
-void jit_noise_vector_float32	(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out);
-void jit_noise_vector_float64	(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out); 
+t_jit_noise_index jit_noise_cellindex(t_jit_matrix_info *minfo, long offset);
+void jit_noise_philox(long count, t_jit_noise_index block, unsigned int *key, unsigned int *w);
+void jit_noise_vector_char		(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out, t_jit_noise_index e);
+void jit_noise_vector_long		(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out, t_jit_noise_index e);
+void jit_noise_vector_float32	(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out, t_jit_noise_index e);
+void jit_noise_vector_float64	(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out, t_jit_noise_index e);
 
 t_jit_err jit_noise_init(void) 
 {
-	void *mop;
+	long attrflags=0;
+	void *mop,*attr;
 	
 	_jit_noise_class = jit_class_new("jit_noise",(method)jit_noise_new,(method)jit_noise_free,
 		sizeof(t_jit_noise),0L); 
@@ -44,16 +78,36 @@ t_jit_err jit_noise_init(void)
 	jit_class_addadornment(_jit_noise_class,mop);
 	//add methods
 	jit_class_addmethod(_jit_noise_class, (method)jit_noise_matrix_calc, 		"matrix_calc", 		A_CANT, 0L);
+	//add attributes
+	attrflags = JIT_ATTR_GET_DEFER_LOW | JIT_ATTR_SET_USURP_LOW;
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"seed",_jit_sym_long,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_noise,seed));
+	jit_class_addattr(_jit_noise_class,attr);
+	//uniform, gaussian or exponential
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"dist",_jit_sym_symbol,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_noise,dist));
+	jit_class_addattr(_jit_noise_class,attr);
 
 	jit_class_register(_jit_noise_class);
 
+	ps_uniform		= gensym("uniform");
+	ps_gaussian		= gensym("gaussian");
+	ps_exponential	= gensym("exponential");
+
 	return JIT_ERR_NONE;
 }
 
 t_jit_err jit_noise_getvecdata(t_jit_noise *x, t_jit_noise_vecdata *vd)
 {
 	if (x&&vd) {
-		vd->randlast 	= jit_rand();
+		vd->key[0] 	= x->seed ? x->seed : jit_rand();
+		vd->key[1] 	= 0;
+		if (x->dist==ps_gaussian)
+			vd->dist = JIT_NOISE_DIST_GAUSSIAN;
+		else if (x->dist==ps_exponential)
+			vd->dist = JIT_NOISE_DIST_EXPONENTIAL;
+		else
+			vd->dist = JIT_NOISE_DIST_UNIFORM;
 		return JIT_ERR_NONE;
 	} else {
 		return JIT_ERR_INVALID_PTR;
@@ -90,6 +144,8 @@ t_jit_err jit_noise_matrix_calc(t_jit_noise *x, void *inputs, void *outputs)
 		}
 				
 		jit_noise_getvecdata(x,&vecdata);
+		vecdata.bp = out_bp;
+		vecdata.minfo = &out_minfo;
 		jit_parallel_ndim_simplecalc1((method)jit_noise_calculate_ndim,
 			&vecdata, dimcount, dim, planecount, &out_minfo, out_bp,
 			0 /* flags1 */);
@@ -108,6 +164,7 @@ void jit_noise_calculate_ndim(t_jit_noise_vecdata *vecdata, long dimcount, long
 	long i,n;
 	char *op;
 	t_jit_op_info out_opinfo;
+	t_jit_noise_index e;
 		
 	if (dimcount<1) return; //safety
 	
@@ -119,31 +176,18 @@ void jit_noise_calculate_ndim(t_jit_noise_vecdata *vecdata, long dimcount, long
 		n = dim[0];
 		out_opinfo.stride = 1;
 		n *= planecount;
-		planecount = 1;
-		if (out_minfo->type==_jit_sym_char) {
-			for (i=0;i<dim[1];i++){
-				vecdata->randlast 	= jit_rand(); 
-				out_opinfo.p = bop + i*out_minfo->dimstride[1];
-				jit_noise_vector_char(n,vecdata,&out_opinfo);
-			}
-		} else if (out_minfo->type==_jit_sym_long) {
-			for (i=0;i<dim[1];i++){
-				vecdata->randlast 	= jit_rand(); 
-				out_opinfo.p = bop + i*out_minfo->dimstride[1];
-				jit_noise_vector_long(n,vecdata,&out_opinfo);
-			}
-		} else if (out_minfo->type==_jit_sym_float32) {
-			for (i=0;i<dim[1];i++){
-				vecdata->randlast 	= jit_rand(); 
-				out_opinfo.p = bop + i*out_minfo->dimstride[1];
-				jit_noise_vector_float32(n,vecdata,&out_opinfo);
-			}
-		} else if (out_minfo->type==_jit_sym_float64) {
-			for (i=0;i<dim[1];i++){
-				vecdata->randlast 	= jit_rand(); 
-				out_opinfo.p = bop + i*out_minfo->dimstride[1];
-				jit_noise_vector_float64(n,vecdata,&out_opinfo);
-			}
+		for (i=0;i<dim[1];i++){
+			out_opinfo.p = op = bop + i*out_minfo->dimstride[1];
+			//the first value of the row is numbered by its place in the whole matrix
+			e = jit_noise_cellindex(vecdata->minfo,op-vecdata->bp) * planecount;
+			if (out_minfo->type==_jit_sym_char)
+				jit_noise_vector_char(n,vecdata,&out_opinfo,e);
+			else if (out_minfo->type==_jit_sym_long)
+				jit_noise_vector_long(n,vecdata,&out_opinfo,e);
+			else if (out_minfo->type==_jit_sym_float32)
+				jit_noise_vector_float32(n,vecdata,&out_opinfo,e);
+			else if (out_minfo->type==_jit_sym_float64)
+				jit_noise_vector_float64(n,vecdata,&out_opinfo,e);
 		}
 		break;
 	default:
@@ -154,115 +198,279 @@ void jit_noise_calculate_ndim(t_jit_noise_vecdata *vecdata, long dimcount, long
 	}
 }
 
-void jit_noise_vector_char(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out) 
+//index of the cell at this byte offset, counting along dim 0 first
+t_jit_noise_index jit_noise_cellindex(t_jit_matrix_info *minfo, long offset)
+{
+	t_jit_noise_index index=0;
+	long i,c;
+
+	for (i=minfo->dimcount-1;i>0;i--) {
+		c = offset/minfo->dimstride[i];
+		offset -= c*minfo->dimstride[i];
+		index = (index + c) * minfo->dim[i-1];
+	}
+	return index + offset/minfo->dimstride[0];
+}
+
+//w[4*i..4*i+3] = philox4x32-10 of the counter block+i
+#define JIT_NOISE_PHILOX_ROUND(c0,c1,c2,c3,k0,k1) \
+	p0 = (t_jit_noise_index)JIT_NOISE_PHILOX_M0 * c0; \
+	p1 = (t_jit_noise_index)JIT_NOISE_PHILOX_M1 * c2; \
+	c0 = (unsigned int)(p1>>32) ^ c1 ^ k0; \
+	c1 = (unsigned int)p1; \
+	c2 = (unsigned int)(p0>>32) ^ c3 ^ k1; \
+	c3 = (unsigned int)p0;
+
+
+void jit_noise_philox(long count, t_jit_noise_index block, unsigned int *key, unsigned int *w)
+{
+	unsigned int c0,c1,c2,c3,k0,k1;
+	t_jit_noise_index p0,p1;
+	long r;
+#if JIT_NOISE_SSE2
+	__m128i a0,a1,a2,a3,b0,b1,b2,b3,pa,pb,k0v[10],k1v[10],m0,m1,lo;
+
+	//four counters at a time, each in the low half of a 64 bit lane so that
+	//_mm_mul_epu32 gives the whole product. the high halves are ignored.
+	if (count>=4) {
+		m0 = _mm_set1_epi32(JIT_NOISE_PHILOX_M0);
+		m1 = _mm_set1_epi32(JIT_NOISE_PHILOX_M1);
+		lo = _mm_set_epi32(0,0xFFFFFFFF,0,0xFFFFFFFF);
+		k0 = key[0];
+		k1 = key[1];
+		for (r=0;r<10;r++) {
+			k0v[r] = _mm_set1_epi32(k0);
+			k1v[r] = _mm_set1_epi32(k1);
+			k0 += JIT_NOISE_PHILOX_W0;
+			k1 += JIT_NOISE_PHILOX_W1;
+		}
+	}
+	for (;count>=4;count-=4,block+=4,w+=16) {
+		a0 = _mm_set_epi32(0,(unsigned int)(block+1),0,(unsigned int)block);
+		a1 = _mm_set_epi32(0,(unsigned int)((block+1)>>32),0,(unsigned int)(block>>32));
+		b0 = _mm_set_epi32(0,(unsigned int)(block+3),0,(unsigned int)(block+2));
+		b1 = _mm_set_epi32(0,(unsigned int)((block+3)>>32),0,(unsigned int)((block+2)>>32));
+		a2 = a3 = b2 = b3 = _mm_setzero_si128();
+		for (r=0;r<10;r++) {
+			pa = _mm_mul_epu32(a0,m0);
+			pb = _mm_mul_epu32(b0,m0);
+			a0 = _mm_mul_epu32(a2,m1);
+			b0 = _mm_mul_epu32(b2,m1);
+			a2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(pa,32),a3),k1v[r]);
+			b2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(pb,32),b3),k1v[r]);
+			a3 = pa;
+			b3 = pb;
+			pa = a0;
+			pb = b0;
+			a0 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(pa,32),a1),k0v[r]);
+			b0 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(pb,32),b1),k0v[r]);
+			a1 = pa;
+			b1 = pb;
+		}
+		//words 0,1 and 2,3 of each counter side by side, then one counter per store
+		a0 = _mm_or_si128(_mm_and_si128(a0,lo),_mm_slli_epi64(a1,32));
+		a2 = _mm_or_si128(_mm_and_si128(a2,lo),_mm_slli_epi64(a3,32));
+		b0 = _mm_or_si128(_mm_and_si128(b0,lo),_mm_slli_epi64(b1,32));
+		b2 = _mm_or_si128(_mm_and_si128(b2,lo),_mm_slli_epi64(b3,32));
+		_mm_storeu_si128((__m128i *)w,_mm_unpacklo_epi64(a0,a2));
+		_mm_storeu_si128((__m128i *)(w+4),_mm_unpackhi_epi64(a0,a2));
+		_mm_storeu_si128((__m128i *)(w+8),_mm_unpacklo_epi64(b0,b2));
+		_mm_storeu_si128((__m128i *)(w+12),_mm_unpackhi_epi64(b0,b2));
+	}
+#endif
+	for (;count>0;count--,block++,w+=4) {
+		c0 = (unsigned int)block;
+		c1 = (unsigned int)(block>>32);
+		c2 = c3 = 0;
+		k0 = key[0];
+		k1 = key[1];
+		for (r=0;r<10;r++) {
+			JIT_NOISE_PHILOX_ROUND(c0,c1,c2,c3,k0,k1);
+			k0 += JIT_NOISE_PHILOX_W0;
+			k1 += JIT_NOISE_PHILOX_W1;
+		}
+		w[0] = c0; w[1] = c1; w[2] = c2; w[3] = c3;
+	}
+}
+
+//uniform 24 bit float in [0,1) or (0,1]
+#define JIT_NOISE_U24(w)		((float)((w)>>8)*(1.f/16777216.f))
+#define JIT_NOISE_U24NZ(w)		((float)(((w)>>8)+1)*(1.f/16777216.f))
+//uniform 53 bit double in [0,1) or (0,1]
+#define JIT_NOISE_U53(w0,w1)	(((double)((w0)>>5)*67108864.+(double)((w1)>>6))*(1./9007199254740992.))
+#define JIT_NOISE_U53NZ(w0,w1)	(((double)((w0)>>5)*67108864.+(double)((w1)>>6)+1.)*(1./9007199254740992.))
+
+//each vector function fills n values numbered from e. a philox block gives 16 uniform
+//chars, 4 longs or float32s, or 2 float64s. gaussian values come in box-muller pairs.
+//gaussian and exponential chars and longs are made from float32 values, scaled so that
+//4 deviations either side of the mean, or 8 times the exponential mean, fill the range.
+
+void jit_noise_vector_char(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out, t_jit_noise_index e)
 {
+	unsigned int w[JIT_NOISE_BLOCKS*4];
+	float tmp[JIT_NOISE_BLOCKS*4];
+	t_jit_op_info tmpinfo;
 	uchar *op;
-	long os;
-	unsigned long  idum=vecdata->randlast;
+	long os,i,m,skip,blocks;
+	float f;
 	
 	op  = ((uchar *)out->p);
 	os  = out->stride; 
 	
-	if (os==1) {
-		++n;--op;
-		while (--n) {
-			idum  = 1664525L * idum + 1013904223L;
-			*++op = (idum>>16L); //shift right to remove low order correlation
+	if (vecdata->dist==JIT_NOISE_DIST_UNIFORM) {
+		while (n>0) {
+			skip = (long)(e&15);
+			blocks = MIN(JIT_NOISE_BLOCKS,(skip+n+15)>>4);
+			jit_noise_philox(blocks,e>>4,vecdata->key,w);
+			m = MIN(n,blocks*16-skip);
+			for (i=skip;i<skip+m;i++,op+=os)
+				*op = (uchar)(w[i>>2]>>((i&3)<<3));
+			e += m; n -= m;
 		}		
-		vecdata->randlast = idum;
 	} else {
-		while (n--) {
-			idum = 1664525L * idum + 1013904223L;
-			*op = (idum>>16L);
-			op+=os;
+		tmpinfo.p = tmp;
+		tmpinfo.stride = 1;
+		while (n>0) {
+			m = MIN(n,JIT_NOISE_BLOCKS*4);
+			jit_noise_vector_float32(m,vecdata,&tmpinfo,e);
+			if (vecdata->dist==JIT_NOISE_DIST_GAUSSIAN) {
+				for (i=0;i<m;i++,op+=os) {
+					f = 128.f + 32.f*tmp[i];
+					*op = (f<0.f) ? 0 : ((f>=255.f) ? 255 : (uchar)f);
+				}
+			} else {
+				for (i=0;i<m;i++,op+=os) {
+					f = 32.f*tmp[i];
+					*op = (f>=255.f) ? 255 : (uchar)f;
+				}
+			}
+			e += m; n -= m;
 		}
-		vecdata->randlast = idum;
 	}
 }
 
-void jit_noise_vector_long(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out) 
+void jit_noise_vector_long(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out, t_jit_noise_index e)
 {
+	unsigned int w[JIT_NOISE_BLOCKS*4];
+	float tmp[JIT_NOISE_BLOCKS*4];
+	t_jit_op_info tmpinfo;
 	long *op;
-	long os;
-	unsigned long  idum=vecdata->randlast,idum2;
+	long os,i,m,skip,blocks;
+	double d;
 	
 	op  = ((long *)out->p);
 	os  = out->stride; 
 	
-	if (os==1) {
-		++n;--op;
-		idum2 = idum;
-		while (--n) {
-			idum  = 1664525L * idum2 + 1013904223L;
-			idum2 = 1664525L * idum + 1013904223L;
-			*++op = (idum2&0xFFFF0000)|(idum>>16L); //shift right to remove low order correlation
+	if (vecdata->dist==JIT_NOISE_DIST_UNIFORM) {
+		while (n>0) {
+			skip = (long)(e&3);
+			blocks = MIN(JIT_NOISE_BLOCKS,(skip+n+3)>>2);
+			jit_noise_philox(blocks,e>>2,vecdata->key,w);
+			m = MIN(n,blocks*4-skip);
+			for (i=skip;i<skip+m;i++,op+=os)
+				*op = (long)w[i];
+			e += m; n -= m;
 		}		
-		vecdata->randlast = idum2;
 	} else {
-		idum2 = idum;
-		while (n--) {
-			idum = 1664525L * idum2 + 1013904223L;
-			idum2 = 1664525L * idum + 1013904223L;
-			*op = (idum2&0xFFFF0000)|(idum>>16L);
-			op+=os;
+		tmpinfo.p = tmp;
+		tmpinfo.stride = 1;
+		while (n>0) {
+			m = MIN(n,JIT_NOISE_BLOCKS*4);
+			jit_noise_vector_float32(m,vecdata,&tmpinfo,e);
+			for (i=0;i<m;i++,op+=os) {
+				d = tmp[i] * ((vecdata->dist==JIT_NOISE_DIST_GAUSSIAN) ? 536870912. : 268435456.);
+				*op = (d>=2147483647.) ? 2147483647L : ((d<=-2147483648.) ? (-2147483647L-1) : (long)d);
+			}
+			e += m; n -= m;
 		}
-		vecdata->randlast = idum2;
 	}
 }
 
-void jit_noise_vector_float32(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out) 
+void jit_noise_vector_float32(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out, t_jit_noise_index e)
 {
+	unsigned int w[JIT_NOISE_BLOCKS*4];
 	float *op;
-	long os;
-	unsigned long  idum=vecdata->randlast,itemp;
+	long os,i,m,skip,blocks;
+	double r,a;
 	
 	op  = ((float *)out->p);
 	os  = out->stride; 
 	
-	if (os==1) {
-		++n;--op;
-		while (--n) {
-			idum = 1664525L * idum + 1013904223L;
-			itemp = jflone | (jflmsk & idum);
-			*++op = ((*(float *)&itemp) - 1.0); 
+	while (n>0) {
+		skip = (long)(e&3);
+		blocks = MIN(JIT_NOISE_BLOCKS,(skip+n+3)>>2);
+		jit_noise_philox(blocks,e>>2,vecdata->key,w);
+		m = MIN(n,blocks*4-skip);
+		switch (vecdata->dist) {
+		case JIT_NOISE_DIST_GAUSSIAN:
+			//values 2i and 2i+1 are the pair made from words 2i and 2i+1
+			for (i=skip&~1;i<skip+m;i+=2) {
+				r = jit_math_sqrt(-2.*jit_math_log(JIT_NOISE_U24NZ(w[i])));
+				a = JIT_NOISE_TWOPI*JIT_NOISE_U24(w[i+1]);
+				if (i>=skip) {
+					*op = r*jit_math_cos(a);
+					op+=os;
+				}
+				if (i+1<skip+m) {
+					*op = r*jit_math_sin(a);
+					op+=os;
+				}
+			}
+			break;
+		case JIT_NOISE_DIST_EXPONENTIAL:
+			for (i=skip;i<skip+m;i++,op+=os)
+				*op = -jit_math_log(JIT_NOISE_U24NZ(w[i]));
+			break;
+		default:
+			for (i=skip;i<skip+m;i++,op+=os)
+				*op = JIT_NOISE_U24(w[i]);
+			break;
 		}		
-		vecdata->randlast = idum;
-	} else {
-		while (n--) {
-			idum = 1664525L * idum + 1013904223L;
-			itemp = jflone | (jflmsk & idum);
-			*op = ((*(float *)&itemp) - 1.0); 	
-			op+=os;
-		}
-		vecdata->randlast = idum;
+		e += m; n -= m;
 	}
 }
 
-void jit_noise_vector_float64(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out) 
+void jit_noise_vector_float64(long n, t_jit_noise_vecdata *vecdata, t_jit_op_info *out, t_jit_noise_index e)
 {
+	unsigned int w[JIT_NOISE_BLOCKS*4];
 	double *op;
-	long os;
-	unsigned long  idum=vecdata->randlast,itemp;
+	long os,i,m,skip,blocks;
+	double r,a;
 	
-	op  = ((float *)out->p);
+	op  = ((double *)out->p);
 	os  = out->stride; 
 	
-	if (os==1) {
-		++n;--op;
-		while (--n) {
-			idum = 1664525L * idum + 1013904223L;
-			itemp = jflone | (jflmsk & idum);
-			*++op = ((*(float *)&itemp) - 1.0); 
+	while (n>0) {
+		skip = (long)(e&1);
+		blocks = MIN(JIT_NOISE_BLOCKS,(skip+n+1)>>1);
+		jit_noise_philox(blocks,e>>1,vecdata->key,w);
+		m = MIN(n,blocks*2-skip);
+		switch (vecdata->dist) {
+		case JIT_NOISE_DIST_GAUSSIAN:
+			//each block is one pair
+			for (i=skip&~1;i<skip+m;i+=2) {
+				r = jit_math_sqrt(-2.*jit_math_log(JIT_NOISE_U53NZ(w[2*i],w[2*i+1])));
+				a = JIT_NOISE_TWOPI*JIT_NOISE_U53(w[2*i+2],w[2*i+3]);
+				if (i>=skip) {
+					*op = r*jit_math_cos(a);
+					op+=os;
+				}
+				if (i+1<skip+m) {
+					*op = r*jit_math_sin(a);
+					op+=os;
+				}
+			}
+			break;
+		case JIT_NOISE_DIST_EXPONENTIAL:
+			for (i=skip;i<skip+m;i++,op+=os)
+				*op = -jit_math_log(JIT_NOISE_U53NZ(w[2*i],w[2*i+1]));
+			break;
+		default:
+			for (i=skip;i<skip+m;i++,op+=os)
+				*op = JIT_NOISE_U53(w[2*i],w[2*i+1]);
+			break;
 		}		
-		vecdata->randlast = idum;
-	} else {
-		while (n--) {
-			idum = 1664525L * idum + 1013904223L;
-			itemp = jflone | (jflmsk & idum);
-			*op = ((*(float *)&itemp) - 1.0); 	
-			op+=os;
-		}
-		vecdata->randlast = idum;
+		e += m; n -= m;
 	}
 }
 
@@ -271,7 +479,8 @@ t_jit_noise *jit_noise_new(void)
 	t_jit_noise *x;
 		
 	if (x=(t_jit_noise *)jit_object_alloc(_jit_noise_class)) {
-		//nada
+		x->seed = 0;
+		x->dist = ps_uniform;
 	} else {
 		x = NULL;
 	}	
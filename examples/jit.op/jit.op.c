@@ -6,16 +6,35 @@
 #include "jit.common.h"
 #include "jit.op.h"
 
+#define JIT_OP_CHAIN_MAX	16
+#define JIT_OP_CHAIN_TILE	256		//elements per fused tile, 2K of float64 stays in L1
+
 typedef struct _jit_op 
 {
 	t_object	ob;
 	long		opsymcount;
 	t_symbol	*opsym[JIT_MATRIX_MAX_PLANECOUNT];
+	t_symbol	*precision;
+	long		chaincount;
+	t_symbol	*chain[JIT_OP_CHAIN_MAX];
+	long		chainvalcount;
+	t_atom		chainval[JIT_OP_CHAIN_MAX];
 } t_jit_op;
 
+typedef union _jit_op_chainval
+{
+	uchar		c;
+	int			l;		//long planes are 32 bit
+	float		f;
+	double		d;
+} t_jit_op_chainval;
+
 typedef struct _jit_op_vecdata
 {
-	t_jit_op_fn		opfn[JIT_MATRIX_MAX_PLANECOUNT];
+	t_jit_op_fn			opfn[JIT_MATRIX_MAX_PLANECOUNT];
+	long				chaincount;
+	t_jit_op_fn			chainfn[JIT_OP_CHAIN_MAX];
+	t_jit_op_chainval	chainval[JIT_OP_CHAIN_MAX];
 } t_jit_op_vecdata;
 
 void *_jit_op_class;
@@ -30,6 +49,8 @@ void jit_op_calculate_ndim(t_jit_op_vecdata *vecdata, long dim, long *dimsize, l
 	t_jit_matrix_info *in2_minfo, char *bip2, t_jit_matrix_info *out_minfo, char *bop);
 
 void jit_op_vector_ignore	(long n, void *vecdata, t_jit_op_info *in1, t_jit_op_info *in2, t_jit_op_info *out); 
+t_jit_op_fn jit_op_getfn(t_jit_op *x, t_symbol *opsym, t_symbol *type);
+void jit_op_vector_chain(long n, t_jit_op_vecdata *vecdata, long j, long size, t_jit_op_info *in1, t_jit_op_info *in2, t_jit_op_info *out);
 
 
 //arith
@@ -51,6 +72,8 @@ t_symbol *ps_sinh,*ps_cosh,*ps_tanh,*ps_asinh,*ps_acosh,*ps_atanh;
 t_symbol *ps_exp,*ps_exp2,*ps_ln,*ps_log2,*ps_log10,*ps_hypot,*ps_pow,*ps_sqrt;
 //rounding
 t_symbol *ps_ceil,*ps_floor,*ps_round,*ps_trunc;
+//precision
+t_symbol *ps_exact,*ps_fast;
 
 t_jit_err jit_op_init(void) 
 {
@@ -73,6 +96,18 @@ t_jit_err jit_op_init(void)
 	attr = jit_object_new(_jit_sym_jit_attr_offset_array,"op",_jit_sym_symbol,JIT_MATRIX_MAX_PLANECOUNT,attrflags,
 		(method)0L,(method)0L,calcoffset(t_jit_op,opsymcount),calcoffset(t_jit_op,opsym));
 	jit_class_addattr(_jit_op_class,attr);
+	//exact (default) or fast, which uses polynomial versions of the float transcendental ops
+	attr = jit_object_new(_jit_sym_jit_attr_offset,"precision",_jit_sym_symbol,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_op,precision));
+	jit_class_addattr(_jit_op_class,attr);
+	//ops applied in turn to the result of op, each against the matching chainval (default 0). 
+	//the whole chain is evaluated per tile, so intermediate results never leave the cache
+	attr = jit_object_new(_jit_sym_jit_attr_offset_array,"chain",_jit_sym_symbol,JIT_OP_CHAIN_MAX,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_op,chaincount),calcoffset(t_jit_op,chain));
+	jit_class_addattr(_jit_op_class,attr);
+	attr = jit_object_new(_jit_sym_jit_attr_offset_array,"chainval",_jit_sym_atom,JIT_OP_CHAIN_MAX,attrflags,
+		(method)0L,(method)0L,calcoffset(t_jit_op,chainvalcount),calcoffset(t_jit_op,chainval));
+	jit_class_addattr(_jit_op_class,attr);
 
 	jit_class_register(_jit_op_class);
 
@@ -158,6 +193,12 @@ t_jit_err jit_op_init(void)
 	ps_floor		= gensym("floor");
 	ps_round		= gensym("round");
 	ps_trunc		= gensym("trunc");
+	
+	//precision
+	ps_exact		= gensym("exact");
+	ps_fast			= gensym("fast");
+
+	jit_op_simd_init();
 
 	return JIT_ERR_NONE;
 }
@@ -169,6 +210,12 @@ void jit_op_vector_ignore	(long n, void *vecdata, t_jit_op_info *in1, t_jit_op_i
 
 t_jit_op_fn jit_op_sym2fn(t_symbol *opsym, t_symbol *type)
 {
+	t_jit_op_fn fn;
+	
+	//sse2/avx2/neon versions take precedence, the rest fall through to the library
+	if ((fn=jit_op_simd_sym2fn(opsym,type)))
+		return fn;
+	
 	if (type==_jit_sym_char) {
 		if (opsym==ps_pass) {						//arith(8bit fixed)
 			return jit_op_vector_pass_char;
@@ -583,15 +630,35 @@ t_jit_op_fn jit_op_sym2fn(t_symbol *opsym, t_symbol *type)
 	return jit_op_vector_ignore;  // $rbs$ -- warning fix
 }
 
+t_jit_op_fn jit_op_getfn(t_jit_op *x, t_symbol *opsym, t_symbol *type)
+{
+	t_jit_op_fn fn;
+	t_jit_op_fn_object *o;
+	
+	if (x->precision==ps_fast&&(fn=jit_op_simd_math_sym2fn(opsym,type)))
+		return fn;
+	fn = jit_op_sym2fn(opsym,type);
+	//ops registered by other objects (e.g. for jit.expr) are looked up in the shared registry
+	if (fn==(t_jit_op_fn)jit_op_vector_ignore&&opsym&&(o=jit_op_fn_lookup(opsym))) {
+		if (type==_jit_sym_char) fn = o->charfn;
+		else if (type==_jit_sym_long) fn = o->longfn;
+		else if (type==_jit_sym_float32) fn = o->float32fn;
+		else if (type==_jit_sym_float64) fn = o->float64fn;
+		if (!fn) fn = (t_jit_op_fn)jit_op_vector_ignore;
+	}
+	return fn;
+}
+
 t_jit_err jit_op_matrix_calc(t_jit_op *x, void *inputs, void *outputs)
 {
 	t_jit_err err=JIT_ERR_NONE;
 	long in1_savelock,in2_savelock,out_savelock;
-	t_jit_matrix_info in1_minfo,in2_minfo,out_minfo;
-	char *in1_bp,*in2_bp,*out_bp;
+	t_jit_matrix_info in1_minfo,in2_minfo,out_minfo,in1_pinfo,in2_pinfo,out_pinfo;
+	char *in1_bp,*in2_bp,*out_bp,*in1_pbp,*in2_pbp,*out_pbp;
 	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
-	t_jit_op_vecdata	vecdata;
+	t_jit_op_vecdata	vecdata,plane_vecdata;
 	void *in1_matrix,*in2_matrix,*out_matrix;
+	t_atom *av;
 	
 	in1_matrix 	= jit_object_method(inputs,_jit_sym_getindex,0);
 	in2_matrix 	= jit_object_method(inputs,_jit_sym_getindex,1);
@@ -628,11 +695,42 @@ t_jit_err jit_op_matrix_calc(t_jit_op *x, void *inputs, void *outputs)
 		}
 		
 		for (i=0;i<planecount;i++) {		
-			vecdata.opfn[i] = jit_op_sym2fn(x->opsym[i%x->opsymcount],in1_minfo.type);
+			vecdata.opfn[i] = jit_op_getfn(x,x->opsym[i%x->opsymcount],in1_minfo.type);
+		}
+		vecdata.chaincount = 0;
+		for (i=0;i<x->chaincount;i++) {
+			if (!x->chain[i]||x->chain[i]==_jit_sym_nothing)
+				continue;
+			vecdata.chainfn[vecdata.chaincount] = jit_op_getfn(x,x->chain[i],in1_minfo.type);
+			av = (i<x->chainvalcount)?(x->chainval+i):NULL;
+			if (in1_minfo.type==_jit_sym_char)
+				vecdata.chainval[vecdata.chaincount].c = av?jit_atom_getcharfix(av):0;
+			else if (in1_minfo.type==_jit_sym_long)
+				vecdata.chainval[vecdata.chaincount].l = av?jit_atom_getlong(av):0;
+			else if (in1_minfo.type==_jit_sym_float32)
+				vecdata.chainval[vecdata.chaincount].f = av?jit_atom_getfloat(av):0;
+			else
+				vecdata.chainval[vecdata.chaincount].d = av?jit_atom_getfloat(av):0;
+			vecdata.chaincount++;
+		}
+		if ((in1_minfo.flags|in2_minfo.flags|out_minfo.flags)&JIT_MATRIX_DATA_PLANAR) {
+			//a plane at a time, so that planes of planar matrices are contiguous rows 
+			//for the vector functions even when each plane has its own operator
+			plane_vecdata = vecdata;
+			for (i=0;i<planecount;i++) {
+				plane_vecdata.opfn[0] = vecdata.opfn[i];
+				jit_planar_plane(&in1_minfo,in1_bp,i,&in1_pinfo,&in1_pbp);
+				jit_planar_plane(&in2_minfo,in2_bp,i,&in2_pinfo,&in2_pbp);
+				jit_planar_plane(&out_minfo,out_bp,i,&out_pinfo,&out_pbp);
+				jit_parallel_ndim_simplecalc3((method)jit_op_calculate_ndim,
+					&plane_vecdata, dimcount, dim, 1, &in1_pinfo, in1_pbp, &in2_pinfo, in2_pbp, &out_pinfo, out_pbp,
+					0 /* flags1 */, 0 /* flags2 */, 0 /* flags3 */);
+			}
+		} else {
+			jit_parallel_ndim_simplecalc3((method)jit_op_calculate_ndim,
+				&vecdata, dimcount, dim, planecount, &in1_minfo, in1_bp, &in2_minfo, in2_bp, &out_minfo, out_bp,
+				0 /* flags1 */, 0 /* flags2 */, 0 /* flags3 */);
 		}
-		jit_parallel_ndim_simplecalc3((method)jit_op_calculate_ndim,
-			&vecdata, dimcount, dim, planecount, &in1_minfo, in1_bp, &in2_minfo, in2_bp, &out_minfo, out_bp,
-			0 /* flags1 */, 0 /* flags2 */, 0 /* flags3 */);
 
 	} else {
 		return JIT_ERR_INVALID_PTR;
@@ -687,7 +785,10 @@ void jit_op_calculate_ndim(t_jit_op_vecdata *vecdata, long dimcount, long *dim,
 					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + j%in1_minfo->planecount;
 					in2_opinfo.p = bip2 + i*in2_minfo->dimstride[1] + j%in2_minfo->planecount;
 					out_opinfo.p = bop  + i*out_minfo->dimstride[1] + j%out_minfo->planecount;
-					(*(vecdata->opfn[j]))(n,vecdata,&in1_opinfo,&in2_opinfo,&out_opinfo);
+					if (vecdata->chaincount)
+						jit_op_vector_chain(n,vecdata,j,1,&in1_opinfo,&in2_opinfo,&out_opinfo);
+					else
+						(*(vecdata->opfn[j]))(n,vecdata,&in1_opinfo,&in2_opinfo,&out_opinfo);
 				}
 			}
 		} else if (in1_minfo->type==_jit_sym_long) {
@@ -696,7 +797,10 @@ void jit_op_calculate_ndim(t_jit_op_vecdata *vecdata, long dimcount, long *dim,
 					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + (j%in1_minfo->planecount)*4;
 					in2_opinfo.p = bip2 + i*in2_minfo->dimstride[1] + (j%in2_minfo->planecount)*4;
 					out_opinfo.p = bop  + i*out_minfo->dimstride[1] + (j%out_minfo->planecount)*4;
-					(*(vecdata->opfn[j]))(n,vecdata,&in1_opinfo,&in2_opinfo,&out_opinfo);
+					if (vecdata->chaincount)
+						jit_op_vector_chain(n,vecdata,j,4,&in1_opinfo,&in2_opinfo,&out_opinfo);
+					else
+						(*(vecdata->opfn[j]))(n,vecdata,&in1_opinfo,&in2_opinfo,&out_opinfo);
 				}
 			}
 		} else if (in1_minfo->type==_jit_sym_float32) {
@@ -705,7 +809,10 @@ void jit_op_calculate_ndim(t_jit_op_vecdata *vecdata, long dimcount, long *dim,
 					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + (j%in1_minfo->planecount)*4;
 					in2_opinfo.p = bip2 + i*in2_minfo->dimstride[1] + (j%in2_minfo->planecount)*4;
 					out_opinfo.p = bop  + i*out_minfo->dimstride[1] + (j%out_minfo->planecount)*4;
-					(*(vecdata->opfn[j]))(n,vecdata,&in1_opinfo,&in2_opinfo,&out_opinfo);
+					if (vecdata->chaincount)
+						jit_op_vector_chain(n,vecdata,j,4,&in1_opinfo,&in2_opinfo,&out_opinfo);
+					else
+						(*(vecdata->opfn[j]))(n,vecdata,&in1_opinfo,&in2_opinfo,&out_opinfo);
 				}
 			}
 		} else if (in1_minfo->type==_jit_sym_float64) {
@@ -714,7 +821,10 @@ void jit_op_calculate_ndim(t_jit_op_vecdata *vecdata, long dimcount, long *dim,
 					in1_opinfo.p = bip1 + i*in1_minfo->dimstride[1] + (j%in1_minfo->planecount)*8;
 					in2_opinfo.p = bip2 + i*in2_minfo->dimstride[1] + (j%in2_minfo->planecount)*8;
 					out_opinfo.p = bop  + i*out_minfo->dimstride[1] + (j%out_minfo->planecount)*8;
-					(*(vecdata->opfn[j]))(n,vecdata,&in1_opinfo,&in2_opinfo,&out_opinfo);
+					if (vecdata->chaincount)
+						jit_op_vector_chain(n,vecdata,j,8,&in1_opinfo,&in2_opinfo,&out_opinfo);
+					else
+						(*(vecdata->opfn[j]))(n,vecdata,&in1_opinfo,&in2_opinfo,&out_opinfo);
 				}
 			}
 		}
@@ -729,6 +839,39 @@ void jit_op_calculate_ndim(t_jit_op_vecdata *vecdata, long dimcount, long *dim,
 	}
 }
 
+// fused evaluation of op followed by the chain ops. the row is processed a tile at a time: 
+// op writes the tile, each chain stage runs in place on it against its constant, and only 
+// the last stage writes to the output. results are identical to separate jit.op passes.
+void jit_op_vector_chain(long n, t_jit_op_vecdata *vecdata, long j, long size, t_jit_op_info *in1, t_jit_op_info *in2, t_jit_op_info *out)
+{
+	double tile[JIT_OP_CHAIN_TILE];	//double for alignment
+	t_jit_op_info a,b,t,o,k;
+	long i,c,m,last=vecdata->chaincount-1;
+	
+	//an unknown op leaves the output untouched, chained or not
+	if (vecdata->opfn[j]==(t_jit_op_fn)jit_op_vector_ignore)
+		return;
+	t.p = tile;
+	t.stride = 1;
+	k.stride = 0;
+	for (i=0;i<n;i+=m) {
+		m = MIN(JIT_OP_CHAIN_TILE,n-i);
+		a.p = (char *)in1->p + i*in1->stride*size;
+		a.stride = in1->stride;
+		b.p = (char *)in2->p + i*in2->stride*size;
+		b.stride = in2->stride;
+		o.p = (char *)out->p + i*out->stride*size;
+		o.stride = out->stride;
+		(*(vecdata->opfn[j]))(m,vecdata,&a,&b,&t);
+		for (c=0;c<last;c++) {
+			k.p = vecdata->chainval + c;
+			(*(vecdata->chainfn[c]))(m,vecdata,&t,&k,&t);
+		}
+		k.p = vecdata->chainval + last;
+		(*(vecdata->chainfn[last]))(m,vecdata,&t,&k,&o);
+	}
+}
+
 t_jit_op *jit_op_new(void)
 {
 	t_jit_op *x;
@@ -738,6 +881,13 @@ t_jit_op *jit_op_new(void)
 		x->opsymcount = 1;
 		for (i=0;i<JIT_MATRIX_MAX_PLANECOUNT;i++)
 			x->opsym[i] = NULL;
+		x->precision = ps_exact;
+		x->chaincount = 0;
+		x->chainvalcount = 0;
+		for (i=0;i<JIT_OP_CHAIN_MAX;i++) {
+			x->chain[i] = _jit_sym_nothing;
+			jit_atom_setlong(x->chainval+i,0);
+		}
 	} else {
 		x = NULL;
 	}	
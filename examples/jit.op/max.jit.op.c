@@ -18,6 +18,7 @@ typedef struct _max_jit_op
 	t_atom				val[JIT_MATRIX_MAX_PLANECOUNT];
 	long 				last;
 	t_jit_matrix_info	lastinfo;
+	t_max_jit_mop_async	async;
 } t_max_jit_op;
 
 t_jit_err jit_op_init(void); 
@@ -46,7 +47,8 @@ void main(void)
     
     addmess((method)max_jit_op_jit_matrix, "jit_matrix", A_GIMME, 0);
     max_jit_classex_mop_wrap(p,q,MAX_JIT_MOP_FLAGS_OWN_JIT_MATRIX); 		
-    max_jit_classex_mop_mproc(p,q,max_jit_op_mproc); 	//custom mproc
+    max_jit_classex_mop_async(p,q,calcoffset(t_max_jit_op,async)); 	//async/latency attributes
+    max_jit_classex_mop_mproc(p,q,max_jit_op_mproc); 	//custom mproc, replaces the async one
     max_jit_classex_standard_wrap(p,q,0);
         
     attrflags = JIT_ATTR_GET_DEFER_LOW | JIT_ATTR_SET_USURP_LOW ;
@@ -133,6 +135,10 @@ void max_jit_op_mproc(t_max_jit_op *x, void *mop)
 			jit_object_method(o,_jit_sym_setall,0L,x->valcount,x->val);		
 	}
 	
+	// input 2 now holds val, and is copied with the frame if it goes async
+	if (max_jit_mop_async_calc(x,mop))
+		return;
+	
 	if (err=(t_jit_err) jit_object_method(
 		max_jit_obex_jitob_get(x),
 		_jit_sym_matrix_calc,
@@ -147,6 +153,7 @@ void max_jit_op_mproc(t_max_jit_op *x, void *mop)
 
 void max_jit_op_free(t_max_jit_op *x)
 {
+	max_jit_mop_async_free(x);
 	max_jit_mop_free(x);
 	jit_object_free(max_jit_obex_jitob_get(x));
 	max_jit_obex_free(x);
@@ -161,6 +168,7 @@ void *max_jit_op_new(t_symbol *s, long argc, t_atom *argv)
 	if (x=(t_max_jit_op *)max_jit_obex_new(max_jit_op_class,gensym("jit_op"))) {
 		if (o=jit_object_new(gensym("jit_op"))) {
 			max_jit_mop_setup_simple(x,o,argc,argv);			
+			max_jit_mop_async_init(x);
 			x->last = OP_LAST_MATRIX;
 			x->valcount = 0;
 			for (i=0;i<JIT_MATRIX_MAX_PLANECOUNT;i++) 
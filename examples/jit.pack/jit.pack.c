@@ -23,6 +23,9 @@ void jit_pack_free(t_jit_pack *x);
 t_jit_err jit_pack_matrix_calc(t_jit_pack *x, void *inputs, void *outputs);
 void jit_pack_calculate_ndim(long dimcount, long *dim, long plane, long offset,
 	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop);
+t_jit_err jit_pack_merge(t_jit_pack *x, long in_count, void *inputs, void *out_matrix);
+void jit_pack_merge_ndim(long dimcount, long *dim, long in_count, t_jit_matrix_info *in_minfo, char **bip, 
+	t_jit_matrix_info *out_minfo, char *bop);
 
 t_jit_err jit_pack_offset(t_jit_pack *x, t_symbol *s, long argc, t_atom *argv);
 t_jit_err jit_pack_jump(t_jit_pack *x, t_symbol *s, long argc, t_atom *argv);
@@ -103,8 +106,8 @@ t_jit_err jit_pack_matrix_calc(t_jit_pack *x, void *inputs, void *outputs)
 {
 	t_jit_err err=JIT_ERR_NONE;
 	long in_savelock,out_savelock;
-	t_jit_matrix_info in_minfo,out_minfo;
-	char *in_bp,*out_bp;
+	t_jit_matrix_info in_minfo,out_minfo,in_pinfo,out_pinfo;
+	char *in_bp,*out_bp,*in_pbp,*out_pbp;
 	long i,j,dimcount,dim[JIT_MATRIX_MAX_DIMCOUNT];
 	void *in_matrix,*out_matrix;
 	long in_count,in_idx,in_plane,out_plane,k,n;
@@ -117,6 +120,11 @@ t_jit_err jit_pack_matrix_calc(t_jit_pack *x, void *inputs, void *outputs)
 		
 	in_idx = x->index;
 
+	//when JS hands over every input at once and each one is a plane of the output, 
+	//build each output row from all of them in one pass
+	if ((in_count>1)&&x&&out_matrix&&(jit_pack_merge(x,in_count,inputs,out_matrix)==JIT_ERR_NONE))
+		return JIT_ERR_NONE;
+
 	for (j=0;j<in_count;j++) {
 		//handles case where jit.pack is used in JS
 		if (in_count>1) {
@@ -171,7 +179,14 @@ t_jit_err jit_pack_matrix_calc(t_jit_pack *x, void *inputs, void *outputs)
 					(in_plane>=0)&&(in_plane<in_minfo.planecount))
 				{
 					//jit_object_post((t_object *)x,"copying in_plane=%d to out_plane%d for in_idx=%d",in_plane,out_plane,in_idx);
-					jit_pack_calculate_ndim(dimcount, dim, out_plane, in_plane, &in_minfo, in_bp, &out_minfo, out_bp);
+					if ((in_minfo.flags|out_minfo.flags)&JIT_MATRIX_DATA_PLANAR) {
+						//planes of planar matrices are contiguous
+						jit_planar_plane(&in_minfo,in_bp,in_plane,&in_pinfo,&in_pbp);
+						jit_planar_plane(&out_minfo,out_bp,out_plane,&out_pinfo,&out_pbp);
+						jit_pack_calculate_ndim(dimcount, dim, 0, 0, &in_pinfo, in_pbp, &out_pinfo, out_pbp);
+					} else {
+						jit_pack_calculate_ndim(dimcount, dim, out_plane, in_plane, &in_minfo, in_bp, &out_minfo, out_bp);
+					}
 				} else {
 					//jit_object_post((t_object *)x,"out of range in_plane=%d to out_plane%d for in_idx=%d",in_plane,out_plane,in_idx);
 				}
@@ -187,6 +202,93 @@ out:
 	return err;
 }
 
+//returns JIT_ERR_MISMATCH_PLANE without touching the output unless input j is exactly 
+//plane j of an interleaved output: single plane, same type and dim, default offset and jump 
+t_jit_err jit_pack_merge(t_jit_pack *x, long in_count, void *inputs, void *out_matrix)
+{
+	t_jit_err err=JIT_ERR_NONE;
+	long in_savelock[JIT_MATRIX_MAX_PLANECOUNT],out_savelock;
+	t_jit_matrix_info in_minfo[JIT_MATRIX_MAX_PLANECOUNT],out_minfo;
+	char *in_bp[JIT_MATRIX_MAX_PLANECOUNT],*out_bp;
+	void *in_matrix[JIT_MATRIX_MAX_PLANECOUNT];
+	long i,j,locked=0,dimcount,dim[JIT_MATRIX_MAX_DIMCOUNT];
+
+	if (in_count>JIT_MATRIX_MAX_PLANECOUNT)
+		return JIT_ERR_MISMATCH_PLANE;
+	for (j=0;j<in_count;j++) {
+		if ((x->offset[j]!=0)||(x->jump[j]!=1))
+			return JIT_ERR_MISMATCH_PLANE;
+		if (!(in_matrix[j]=jit_object_method(inputs,_jit_sym_getindex,j)))
+			return JIT_ERR_MISMATCH_PLANE;
+	}
+	
+	out_savelock = (long) jit_object_method(out_matrix,_jit_sym_lock,1);
+	for (;locked<in_count;locked++) 
+		in_savelock[locked] = (long) jit_object_method(in_matrix[locked],_jit_sym_lock,1);
+	jit_object_method(out_matrix,_jit_sym_getinfo,&out_minfo);
+	jit_object_method(out_matrix,_jit_sym_getdata,&out_bp);
+
+	if (!out_bp||(out_minfo.planecount!=in_count)||(out_minfo.flags&JIT_MATRIX_DATA_PLANAR)) { 
+		err=JIT_ERR_MISMATCH_PLANE; 
+		goto out;
+	}
+	dimcount = out_minfo.dimcount;
+	for (j=0;j<in_count;j++) {
+		jit_object_method(in_matrix[j],_jit_sym_getinfo,in_minfo+j);
+		jit_object_method(in_matrix[j],_jit_sym_getdata,in_bp+j);
+		if (!in_bp[j]||(in_minfo[j].type!=out_minfo.type)||(in_minfo[j].planecount!=1)||
+			(in_minfo[j].flags&JIT_MATRIX_DATA_PLANAR)||(in_minfo[j].dimcount!=dimcount)) 
+		{ 
+			err=JIT_ERR_MISMATCH_PLANE; 
+			goto out;
+		}
+		for (i=0;i<dimcount;i++) {
+			if (in_minfo[j].dim[i]!=out_minfo.dim[i]) {
+				err=JIT_ERR_MISMATCH_PLANE; 
+				goto out;
+			}
+		}
+	}
+	for (i=0;i<dimcount;i++)
+		dim[i] = out_minfo.dim[i];
+
+	jit_pack_merge_ndim(dimcount, dim, in_count, in_minfo, in_bp, &out_minfo, out_bp);
+
+out:
+	while (locked--)
+		jit_object_method(in_matrix[locked],_jit_sym_lock,in_savelock[locked]);
+	jit_object_method(out_matrix,_jit_sym_lock,out_savelock);
+	return err;
+}
+
+void jit_pack_merge_ndim(long dimcount, long *dim, long in_count, t_jit_matrix_info *in_minfo, char **bip, 
+	t_jit_matrix_info *out_minfo, char *bop)
+{
+	long i,j;
+	char *ip[JIT_MATRIX_MAX_PLANECOUNT],*op;
+		
+	if (dimcount<1) return; //safety
+	
+	switch(dimcount) {
+	case 1:
+		dim[1]=1;
+	case 2:
+		for (i=0;i<dim[1];i++){
+			for (j=0;j<in_count;j++)
+				ip[j] = bip[j] + i*in_minfo[j].dimstride[1];
+			op = bop + i*out_minfo->dimstride[1];
+			jit_planar_interleave(dim[0],in_count,jit_matrix_info_typesize(out_minfo),ip,op);
+		}
+		break;
+	default:
+		for	(i=0;i<dim[dimcount-1];i++) {
+			for (j=0;j<in_count;j++)
+				ip[j] = bip[j] + i*in_minfo[j].dimstride[dimcount-1];
+			op = bop + i*out_minfo->dimstride[dimcount-1];
+			jit_pack_merge_ndim(dimcount-1,dim,in_count,in_minfo,ip,out_minfo,op);
+		}
+	}
+}
 
 void jit_pack_calculate_ndim(long dimcount, long *dim, long plane, long offset,
 	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop)
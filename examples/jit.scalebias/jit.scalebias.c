@@ -4,6 +4,7 @@
 */
 
 #include "jit.common.h"
+#include "common/jit.charlut.h"
 
 typedef struct _jit_scalebias 
 {
@@ -19,18 +20,35 @@ typedef struct _jit_scalebias
 	float					rbias;
 	float					gbias;
 	float					bbias;
+	float					lutscale[4];	//argb scale and bias the char tables were built from
+	float					lutbias[4];
+	t_jit_charlut			lut;
 } t_jit_scalebias;
 
+// the state one frame is calculated with, taken once in matrix_calc so that
+// an attribute changed during the frame can't mix two settings
+typedef struct _jit_scalebias_vecdata
+{
+	long					mode;
+	long					ascale;		//fixed point, for mode 1
+	long					rscale;
+	long					gscale;
+	long					bscale;
+	long					sumbias;
+	t_jit_charlut			*lut;		//for mode 0
+} t_jit_scalebias_vecdata;
+
 void *_jit_scalebias_class;
 
 t_jit_err jit_scalebias_init(void);
 t_jit_scalebias *jit_scalebias_new(void);
 void jit_scalebias_free(t_jit_scalebias *x);
 t_jit_err jit_scalebias_matrix_calc(t_jit_scalebias *x, void *inputs, void *outputs);
-void jit_scalebias_calculate_ndim(t_jit_scalebias *x, long dimcount, long *dim, long planecount, 
+void jit_scalebias_calculate_ndim(t_jit_scalebias_vecdata *vecdata, long dimcount, long *dim, long planecount, 
 	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop);
 void jit_scalebias_scale(t_jit_scalebias *x, t_symbol *s, long argc, t_atom *argv);
 void jit_scalebias_bias(t_jit_scalebias *x, t_symbol *s, long argc, t_atom *argv);
+void jit_scalebias_charlut(t_jit_scalebias *x);
 
 t_jit_err jit_scalebias_init(void) 
 {
@@ -124,6 +142,36 @@ void jit_scalebias_bias(t_jit_scalebias *x, t_symbol *s, long argc, t_atom *argv
 	x->bbias  = f;		
 }
 
+//per plane tables for mode 0, rebuilt whenever a scale or bias has changed since the last frame
+void jit_scalebias_charlut(t_jit_scalebias *x)
+{
+	long i,j,scale,bias,tmp;
+	float s[4],b[4];
+	
+	s[0] = x->ascale; s[1] = x->rscale; s[2] = x->gscale; s[3] = x->bscale;
+	b[0] = x->abias;  b[1] = x->rbias;  b[2] = x->gbias;  b[3] = x->bbias;
+	for (j=0;j<4;j++) {
+		if ((s[j]!=x->lutscale[j])||(b[j]!=x->lutbias[j]))
+			x->lut.valid = 0;
+	}
+	if (x->lut.valid) 
+		return;
+	
+	for (j=0;j<4;j++) {
+		// same fixed point arithmetic as the per pixel loop
+		scale = s[j]*256.;
+		bias  = b[j]*256.;
+		for (i=0;i<256;i++) {
+			tmp = ((i*scale)>>8L)+bias;
+			x->lut.table[j][i] = (tmp>255)?255:((tmp<0)?0:tmp);
+		}
+		x->lutscale[j] = s[j];
+		x->lutbias[j]  = b[j];
+	}
+	x->lut.tablecount = 4;
+	x->lut.valid = 1;
+}
+
 t_jit_err jit_scalebias_matrix_calc(t_jit_scalebias *x, void *inputs, void *outputs)
 {
 	t_jit_err err=JIT_ERR_NONE;
@@ -132,6 +180,7 @@ t_jit_err jit_scalebias_matrix_calc(t_jit_scalebias *x, void *inputs, void *outp
 	char *in_bp,*out_bp;
 	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
 	void *in_matrix,*out_matrix;
+	t_jit_scalebias_vecdata vecdata;
 	
 	// get the zeroth index input and output from the 
 	// corresponding input and output lists
@@ -180,11 +229,28 @@ t_jit_err jit_scalebias_matrix_calc(t_jit_scalebias *x, void *inputs, void *outp
 			dim[i] = MIN(in_minfo.dim[i],out_minfo.dim[i]);
 		}		
 				
+		// take the mode once, so that the tables are built if and
+		// only if this frame uses them
+		vecdata.mode = x->mode;
+		if (vecdata.mode==1) {
+			// convert our floating point scale factors to a fixed point int
+			vecdata.ascale = x->ascale*256.;
+			vecdata.rscale = x->rscale*256.;
+			vecdata.gscale = x->gscale*256.;
+			vecdata.bscale = x->bscale*256.;
+			// for effiency in sum mode (1), make a single bias value
+			vecdata.sumbias = (x->abias+x->rbias+x->gbias+x->bbias)*256.;
+			vecdata.lut = NULL;
+		} else {
+			jit_scalebias_charlut(x);
+			vecdata.lut = &x->lut;
+		}
+		
 		// calculate, using the parallel utility function to
 		// call our calculate_ndim function in multiple
 		// threads if there are multiple processors available
 		jit_parallel_ndim_simplecalc2((method)jit_scalebias_calculate_ndim,
-			x, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp,
+			&vecdata, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp,
 			0 /* flags1 */, 0 /* flags2 */);
 
 	} else {
@@ -199,14 +265,14 @@ out:
 }
 
 //recursive function to handle higher dimension matrices, by processing 2D sections at a time 
-void jit_scalebias_calculate_ndim(t_jit_scalebias *x, long dimcount, long *dim, long planecount, 
+void jit_scalebias_calculate_ndim(t_jit_scalebias_vecdata *vecdata, long dimcount, long *dim, long planecount, 
 	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop)
 {
 	long i,j,width,height;
 	uchar *ip,*op;
-	long ascale,rscale,gscale,bscale;
-	long abias,rbias,gbias,bbias,sumbias;
+	long ascale,rscale,gscale,bscale,sumbias;
 	long tmp;
+	t_jit_op_info in_opinfo,out_opinfo;
 		
 	if (dimcount<1) return; //safety
 	
@@ -216,20 +282,12 @@ void jit_scalebias_calculate_ndim(t_jit_scalebias *x, long dimcount, long *dim,
 		// if only 1D, interperet as 2D, falling through to 2D case 
 		dim[1]=1;
 	case 2:
-		// convert our floating point scale factors to a fixed point int
-		ascale = x->ascale*256.;	
-		rscale = x->rscale*256.;	
-		gscale = x->gscale*256.;	
-		bscale = x->bscale*256.;	
-
-		// convert our floating point bias values to a fixed point int
-		abias  = x->abias*256.;	
-		rbias  = x->rbias*256.;	
-		gbias  = x->gbias*256.;	
-		bbias  = x->bbias*256.;	
-
-		// for effiency in sum mode (1), make a single bias value
-		sumbias = (x->abias+x->rbias+x->gbias+x->bbias)*256.;
+		// fixed point scale factors and bias for sum mode (1)
+		ascale  = vecdata->ascale;
+		rscale  = vecdata->rscale;
+		gscale  = vecdata->gscale;
+		bscale  = vecdata->bscale;
+		sumbias = vecdata->sumbias;
 				
 		width  = dim[0];
 		height = dim[1];
@@ -242,7 +300,7 @@ void jit_scalebias_calculate_ndim(t_jit_scalebias *x, long dimcount, long *dim,
 			op = bop + i*out_minfo->dimstride[1];
 			
 			// depending on our 
-			switch (x->mode) {
+			switch (vecdata->mode) {
 			case 1:	
 				// sum together, clamping to the range 0-255 
 				// and set all output planes
@@ -260,18 +318,13 @@ void jit_scalebias_calculate_ndim(t_jit_scalebias *x, long dimcount, long *dim,
 				}
 				break;				
 			default:	
-				// apply to each plane individually 
-				// clamping to the range 0-255
-				for (j=0;j<width;j++) {
-					tmp = (((long)(*ip++)*ascale)>>8L)+abias;
-					*op++ = (tmp>255)?255:((tmp<0)?0:tmp);
-					tmp = (((long)(*ip++)*rscale)>>8L)+rbias;
-					*op++ = (tmp>255)?255:((tmp<0)?0:tmp);
-					tmp = (((long)(*ip++)*gscale)>>8L)+gbias;
-					*op++ = (tmp>255)?255:((tmp<0)?0:tmp);
-					tmp = (((long)(*ip++)*bscale)>>8L)+bbias;
-					*op++ = (tmp>255)?255:((tmp<0)?0:tmp);
-				}
+				// apply to each plane individually, through the 
+				// tables jit_scalebias_charlut() built from the same
+				// fixed point values. cells are 4 contiguous planes
+				in_opinfo.p  = ip;
+				out_opinfo.p = op;
+				in_opinfo.stride = out_opinfo.stride = 1;
+				jit_charlut_vector(width*4,vecdata->lut,&in_opinfo,&out_opinfo);
 				break;
 			}
 		}
@@ -285,7 +338,7 @@ void jit_scalebias_calculate_ndim(t_jit_scalebias *x, long dimcount, long *dim,
 		{
 			ip = bip + i*in_minfo->dimstride[dimcount-1];
 			op = bop + i*out_minfo->dimstride[dimcount-1];
-			jit_scalebias_calculate_ndim(x,dimcount-1,dim,planecount,in_minfo,ip,out_minfo,op);
+			jit_scalebias_calculate_ndim(vecdata,dimcount-1,dim,planecount,in_minfo,ip,out_minfo,op);
 		}
 	}
 }
@@ -304,6 +357,7 @@ t_jit_scalebias *jit_scalebias_new(void)
 		x->rbias  = 0.;
 		x->gbias  = 0.;
 		x->bbias  = 0.;
+		x->lut.valid = 0;
 	} else {
 		x = NULL;
 	}	
@@ -4,6 +4,9 @@
 */
 
 #include "jit.common.h"
+#include <string.h>
+
+#define JIT_SCISSORS_MAX_TILES		64		//most rows or columns
 
 typedef struct _jit_scissors 
 {
@@ -20,6 +23,8 @@ t_jit_scissors *jit_scissors_new(void);
 void jit_scissors_free(t_jit_scissors *x);
 t_jit_err jit_scissors_matrix_calc(t_jit_scissors *x, void *inputs, void *outputs);
 t_jit_err jit_scissors_init(void);
+void jit_scissors_calculate_ndim(t_jit_scissors *x, long dimcount, long *dim, long planecount, 
+	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop);
 
 
 t_jit_err jit_scissors_init(void) 
@@ -39,11 +44,11 @@ t_jit_err jit_scissors_init(void)
 	attrflags = JIT_ATTR_GET_DEFER_LOW | JIT_ATTR_SET_USURP_LOW;
 	attr = jit_object_new(_jit_sym_jit_attr_offset, "rows", _jit_sym_long, attrflags,
 		(method)0, (method)0, calcoffset(t_jit_scissors, rows));
-	jit_attr_addfilterset_clip(attr, 1, 16, 1, 1);
+	jit_attr_addfilterset_clip(attr, 1, JIT_SCISSORS_MAX_TILES, 1, 1);
 	jit_class_addattr(_jit_scissors_class, attr);
 	attr = jit_object_new(_jit_sym_jit_attr_offset, "columns", _jit_sym_long, attrflags,
 		(method)0, (method)0, calcoffset(t_jit_scissors, cols));
-	jit_attr_addfilterset_clip(attr, 1, 16, 1, 1);
+	jit_attr_addfilterset_clip(attr, 1, JIT_SCISSORS_MAX_TILES, 1, 1);
 	jit_class_addattr(_jit_scissors_class, attr);
 
 	attrflags = JIT_ATTR_GET_OPAQUE_USER | JIT_ATTR_SET_OPAQUE_USER;
@@ -62,7 +67,7 @@ t_jit_err jit_scissors_matrix_calc(t_jit_scissors *x, void *inputs, void *output
 	t_jit_err err=JIT_ERR_NONE;
 	long in_savelock, out_savelock, dimmode;
 	t_jit_matrix_info in_minfo, out_minfo;
-	char *in_bp, *out_bp;
+	char *in_bp, *out_bp, *tile_bp;
 	long i, dimcount, planecount, dim[JIT_MATRIX_MAX_DIMCOUNT];
 	t_atom a[2];
 	t_matrix_conv_info conv;
@@ -134,7 +139,18 @@ t_jit_err jit_scissors_matrix_calc(t_jit_scissors *x, void *inputs, void *output
 			conv.srcdimend[0] = conv.srcdimstart[0] + dim[0] - 1;
 			conv.srcdimend[1] = conv.srcdimstart[1] + dim[1] - 1;
 
-			jit_object_method(out_matrix, _jit_sym_frommatrix, in_matrix, &conv);
+			if ((out_minfo.type==in_minfo.type)&&(out_minfo.planecount==in_minfo.planecount)&&
+				(out_minfo.dimstride[0]==in_minfo.dimstride[0])&&
+				(out_minfo.dim[0]==dim[0])&&(out_minfo.dim[1]==dim[1])) 
+			{
+				// copy the tile a row at a time, with rows split across processors
+				tile_bp = in_bp + conv.srcdimstart[0]*in_minfo.dimstride[0] + conv.srcdimstart[1]*in_minfo.dimstride[1];
+				jit_parallel_ndim_simplecalc2((method)jit_scissors_calculate_ndim,
+					x, dimcount, dim, planecount, &in_minfo, tile_bp, &out_minfo, out_bp,
+					0 /* flags1 */, 0 /* flags2 */);
+			} else {
+				jit_object_method(out_matrix, _jit_sym_frommatrix, in_matrix, &conv);
+			}
 			jit_object_method(out_matrix, _jit_sym_lock, out_savelock);
 
 			out_matrix 	= jit_object_method(outputs, _jit_sym_getindex, --maxn);
@@ -151,6 +167,25 @@ out:
 }
 
 
+//rows that already hold the same data are left alone, so tiles that have not 
+//changed since the last frame cost a read instead of a write
+void jit_scissors_calculate_ndim(t_jit_scissors *x, long dimcount, long *dim, long planecount, 
+	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop)
+{
+	long i,n;
+	char *ip,*op;
+
+	if (dimcount<2) return; //safety
+	
+	n = dim[0]*in_minfo->dimstride[0];
+	for (i=0;i<dim[1];i++) {
+		ip = bip + i*in_minfo->dimstride[1];
+		op = bop + i*out_minfo->dimstride[1];
+		if (memcmp(op,ip,n))
+			memcpy(op,ip,n);
+	}
+}
+
 t_jit_scissors *jit_scissors_new(void)
 {
 	t_jit_scissors *x;
@@ -18,7 +18,7 @@ void jit_transpose_free(t_jit_transpose *x);
 t_jit_err jit_transpose_output_adapt(void *mop, void *mop_io, void *matrix);
 t_jit_err jit_transpose_matrix_calc(t_jit_transpose *x, void *inputs, void *outputs);
 
-void jit_transpose_calculate_ndim(long dim, long *dimsize, long planecount, void *vecdata, t_jit_matrix_info *in_minfo, char *bip, 
+void jit_transpose_calculate_ndim(void *vecdata, long dim, long *dimsize, long planecount, t_jit_matrix_info *in_minfo, char *bip, 
 	t_jit_matrix_info *out_minfo, char *bop);
 
 t_jit_err jit_transpose_init(void) 
@@ -73,7 +73,7 @@ t_jit_err jit_transpose_matrix_calc(t_jit_transpose *x, void *inputs, void *outp
 	long in_savelock,out_savelock;
 	t_jit_matrix_info in_minfo,out_minfo;
 	char *in_bp,*out_bp;
-	long i,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
+	long i,tmp,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
 	void *in_matrix,*out_matrix;
 	
 	in_matrix 	= jit_object_method(inputs,_jit_sym_getindex,0);
@@ -119,8 +119,23 @@ t_jit_err jit_transpose_matrix_calc(t_jit_transpose *x, void *inputs, void *outp
 				dim[i] = in_minfo.dim[i];
 			}
 		}
+		
+		//from here on, look at the input in output order. dimensions 0 and 1 of both matrices
+		//then line up, which is also what jit_parallel needs to split them the same way
+		tmp = in_minfo.dim[0];
+		in_minfo.dim[0] = in_minfo.dim[1];
+		in_minfo.dim[1] = tmp;
+		tmp = in_minfo.dimstride[0];
+		in_minfo.dimstride[0] = in_minfo.dimstride[1];
+		in_minfo.dimstride[1] = tmp;
+		for (i=0;i<2;i++) {
+			if (in_minfo.dim[i]<=1)
+				in_minfo.dimstride[i] = 0;
+		}
 				
-		jit_transpose_calculate_ndim(dimcount, dim, planecount, NULL, &in_minfo, in_bp, &out_minfo, out_bp);
+		jit_parallel_ndim_simplecalc2((method)jit_transpose_calculate_ndim,
+			NULL, dimcount, dim, planecount, &in_minfo, in_bp, &out_minfo, out_bp,
+			0 /* flags1 */, 0 /* flags2 */);
 	} else {
 		return JIT_ERR_INVALID_PTR;
 	}
@@ -132,10 +147,10 @@ out:
 }
 
 
-void jit_transpose_calculate_ndim(long dimcount, long *dim, long planecount, void *vecdata, t_jit_matrix_info *in_minfo, char *bip, 
+void jit_transpose_calculate_ndim(void *vecdata, long dimcount, long *dim, long planecount, t_jit_matrix_info *in_minfo, char *bip, 
 	t_jit_matrix_info *out_minfo, char *bop)
 {
-	long i,j,n;
+	long i,j,n,typesize,cellsize;
 	char *ip=bip,*op=bop;
 	t_jit_op_info in_opinfo,out_opinfo;
 		
@@ -146,13 +161,24 @@ void jit_transpose_calculate_ndim(long dimcount, long *dim, long planecount, voi
 		dim[1] = 1;
 	case 2:
 		n = dim[0];
-		//using vertical stride for input
-		in_opinfo.stride = in_minfo->dim[1]>1?in_minfo->dimstride[1]/jit_matrix_info_typesize(in_minfo):0;
+		//in_minfo is in output order (see jit_transpose_matrix_calc), so dimstride[0] steps down 
+		//the input's columns and dimstride[1] along its rows.
+		typesize = jit_matrix_info_typesize(in_minfo);
+		cellsize = typesize*planecount;
+		if ((in_minfo->planecount==planecount)&&(out_minfo->planecount==planecount)&&
+			(in_minfo->dimstride[0])&&(in_minfo->dimstride[1]==cellsize)&&(out_minfo->dim[0]>1)) 
+		{
+			//whole cells move, so transpose them in cache sized blocks
+			jit_transpose_simd_cells(dim[1],n,cellsize,bip,in_minfo->dimstride[0],bop,out_minfo->dimstride[1]);
+			break;
+		}
+		//otherwise plane by plane, using vertical stride for input
+		in_opinfo.stride = in_minfo->dimstride[0]/typesize;
 		out_opinfo.stride = out_minfo->dim[0]>1?out_minfo->planecount:0;
 		if (in_minfo->type==_jit_sym_char) {
 			for (i=0;i<dim[1];i++){
 				for (j=0;j<planecount;j++) {
-					in_opinfo.p  = bip + i*in_minfo->dimstride[0] + j%in_minfo->planecount;
+					in_opinfo.p  = bip + i*in_minfo->dimstride[1] + j%in_minfo->planecount;
 					out_opinfo.p = bop + i*out_minfo->dimstride[1] + j%out_minfo->planecount;
 					jit_op_vector_pass_char(n,NULL,&in_opinfo,NULL,&out_opinfo);
 				}
@@ -160,7 +186,7 @@ void jit_transpose_calculate_ndim(long dimcount, long *dim, long planecount, voi
 		} else if (in_minfo->type==_jit_sym_long) {
 			for (i=0;i<dim[1];i++){
 				for (j=0;j<planecount;j++) {
-					in_opinfo.p  = bip + i*in_minfo->dimstride[0] + (j%in_minfo->planecount)*4;
+					in_opinfo.p  = bip + i*in_minfo->dimstride[1] + (j%in_minfo->planecount)*4;
 					out_opinfo.p = bop + i*out_minfo->dimstride[1] + (j%out_minfo->planecount)*4;
 					jit_op_vector_pass_long(n,NULL,&in_opinfo,NULL,&out_opinfo);
 				}
@@ -168,7 +194,7 @@ void jit_transpose_calculate_ndim(long dimcount, long *dim, long planecount, voi
 		} else if (in_minfo->type==_jit_sym_float32) {
 			for (i=0;i<dim[1];i++){
 				for (j=0;j<planecount;j++) {
-					in_opinfo.p  = bip + i*in_minfo->dimstride[0] + (j%in_minfo->planecount)*4;
+					in_opinfo.p  = bip + i*in_minfo->dimstride[1] + (j%in_minfo->planecount)*4;
 					out_opinfo.p = bop + i*out_minfo->dimstride[1] + (j%out_minfo->planecount)*4;
 					jit_op_vector_pass_float32(n,NULL,&in_opinfo,NULL,&out_opinfo);
 				}
@@ -176,7 +202,7 @@ void jit_transpose_calculate_ndim(long dimcount, long *dim, long planecount, voi
 		} else if (in_minfo->type==_jit_sym_float64) {
 			for (i=0;i<dim[1];i++){
 				for (j=0;j<planecount;j++) {
-					in_opinfo.p  = bip + i*in_minfo->dimstride[0] + (j%in_minfo->planecount)*8;
+					in_opinfo.p  = bip + i*in_minfo->dimstride[1] + (j%in_minfo->planecount)*8;
 					out_opinfo.p = bop + i*out_minfo->dimstride[1] + (j%out_minfo->planecount)*8;
 					jit_op_vector_pass_float64(n,NULL,&in_opinfo,NULL,&out_opinfo);
 				}
@@ -187,7 +213,7 @@ void jit_transpose_calculate_ndim(long dimcount, long *dim, long planecount, voi
 		for	(i=0;i<dim[dimcount-1];i++) {
 			ip = bip + i*in_minfo->dimstride[dimcount-1];
 			op  = bop  + i*out_minfo->dimstride[dimcount-1];
-			jit_transpose_calculate_ndim(dimcount-1,dim,planecount,vecdata,in_minfo,ip,out_minfo,op);
+			jit_transpose_calculate_ndim(vecdata,dimcount-1,dim,planecount,in_minfo,ip,out_minfo,op);
 		}
 	}
 }
@@ -22,6 +22,8 @@ void jit_unpack_free(t_jit_unpack *x);
 t_jit_err jit_unpack_matrix_calc(t_jit_unpack *x, void *inputs, void *outputs);
 void jit_unpack_calculate_ndim(long dimcount, long *dim, long planecount, long offset,
 	t_jit_matrix_info *in_minfo, char *bip, t_jit_matrix_info *out_minfo, char *bop);
+void jit_unpack_split_ndim(long dimcount, long *dim, t_jit_matrix_info *in_minfo, char *bip, 
+	long out_count, long *plane, t_jit_matrix_info *out_minfo, char **bop);
 
 t_jit_err jit_unpack_init(void) 
 {
@@ -57,9 +59,10 @@ t_jit_err jit_unpack_matrix_calc(t_jit_unpack *x, void *inputs, void *outputs)
 {
 	t_jit_err err=JIT_ERR_NONE;
 	long in_savelock,out_savelock[JIT_MATRIX_MAX_PLANECOUNT];
-	t_jit_matrix_info in_minfo,out_minfo[JIT_MATRIX_MAX_PLANECOUNT],outx_minfo;
-	char *in_bp,*out_bp[JIT_MATRIX_MAX_PLANECOUNT];
+	t_jit_matrix_info in_minfo,out_minfo[JIT_MATRIX_MAX_PLANECOUNT],outx_minfo,in_pinfo,out_pinfo;
+	char *in_bp,*out_bp[JIT_MATRIX_MAX_PLANECOUNT],*in_pbp,*out_pbp;
 	long i,j,out_count,dimcount,planecount,dim[JIT_MATRIX_MAX_DIMCOUNT];
+	long plane[JIT_MATRIX_MAX_PLANECOUNT],taken[JIT_MATRIX_MAX_PLANECOUNT],split;
 	void *in_matrix,*out_matrix[JIT_MATRIX_MAX_PLANECOUNT];
 
 	in_matrix 	= jit_object_method(inputs,_jit_sym_getindex,0);
@@ -110,6 +113,26 @@ t_jit_err jit_unpack_matrix_calc(t_jit_unpack *x, void *inputs, void *outputs)
 			}		
 		}
 
+		//when every output takes a single, different plane of an interleaved input, 
+		//split each row into all of them in one pass
+		split = !(in_minfo.flags&JIT_MATRIX_DATA_PLANAR);
+		for (i=0;i<in_minfo.planecount;i++)
+			taken[i] = 0;
+		for (i=0;split&&i<out_count;i++) {
+			j = plane[i] = x->offset[i];
+			if ((out_minfo[i].planecount!=1)||(j<0)||(j>=in_minfo.planecount)||taken[j])
+				split = 0;
+			else 
+				taken[j] = 1;
+		}
+		if (split) {
+			dimcount = in_minfo.dimcount;
+			for (j=0;j<dimcount;j++)
+				dim[j] = in_minfo.dim[j];
+			jit_unpack_split_ndim(dimcount, dim, &in_minfo, in_bp, out_count, plane, out_minfo, out_bp);
+			goto out;
+		}
+		
 		for (i=0;i<out_count;i++) {
 			//get dimensions/planecount
 			dimcount   = out_minfo[i].dimcount;
@@ -124,7 +147,16 @@ t_jit_err jit_unpack_matrix_calc(t_jit_unpack *x, void *inputs, void *outputs)
 				}
 			}
 		
-			jit_unpack_calculate_ndim(dimcount, dim, planecount, x->offset[i], &in_minfo, in_bp, out_minfo + i, out_bp[i]);
+			if ((in_minfo.flags|out_minfo[i].flags)&JIT_MATRIX_DATA_PLANAR) {
+				//a plane at a time, planes of planar matrices are contiguous
+				for (j=0;j<planecount;j++) {
+					jit_planar_plane(&in_minfo,in_bp,j+x->offset[i],&in_pinfo,&in_pbp);
+					jit_planar_plane(out_minfo+i,out_bp[i],j,&out_pinfo,&out_pbp);
+					jit_unpack_calculate_ndim(dimcount, dim, 1, 0, &in_pinfo, in_pbp, &out_pinfo, out_pbp);
+				}
+			} else {
+				jit_unpack_calculate_ndim(dimcount, dim, planecount, x->offset[i], &in_minfo, in_bp, out_minfo + i, out_bp[i]);
+			}
 		}
 	} else {
 		return JIT_ERR_INVALID_PTR;
@@ -203,6 +235,40 @@ void jit_unpack_calculate_ndim(long dimcount, long *dim, long planecount, long o
 	}
 }
 
+//plane[i] is the input plane for output i. each row of the input is taken apart 
+//into the rows of all the outputs at once
+void jit_unpack_split_ndim(long dimcount, long *dim, t_jit_matrix_info *in_minfo, char *bip, 
+	long out_count, long *plane, t_jit_matrix_info *out_minfo, char **bop)
+{
+	long i,j,typesize;
+	char *ip,*op[JIT_MATRIX_MAX_PLANECOUNT];
+		
+	if (dimcount<1) return; //safety
+	
+	switch(dimcount) {
+	case 1:
+		dim[1]=1;
+	case 2:
+		typesize = jit_matrix_info_typesize(in_minfo);
+		for (j=0;j<in_minfo->planecount;j++)
+			op[j] = NULL;
+		for (i=0;i<dim[1];i++) {
+			ip = bip + i*in_minfo->dimstride[1];
+			for (j=0;j<out_count;j++)
+				op[plane[j]] = bop[j] + i*out_minfo[j].dimstride[1];
+			jit_planar_deinterleave(dim[0],in_minfo->planecount,typesize,ip,op);
+		}
+		break;
+	default:
+		for	(i=0;i<dim[dimcount-1];i++) {
+			ip = bip + i*in_minfo->dimstride[dimcount-1];
+			for (j=0;j<out_count;j++)
+				op[j] = bop[j] + i*out_minfo[j].dimstride[dimcount-1];
+			jit_unpack_split_ndim(dimcount-1,dim,in_minfo,ip,out_count,plane,out_minfo,op);
+		}
+	}
+}
+
 t_jit_unpack *jit_unpack_new(void)
 {
 	t_jit_unpack *x;
@@ -1,16 +1,16 @@
 #include "ext.h"
 #include "ext_obex.h"
 #include "ext_systhread.h"
+#include "ext_atomic.h"
 
 
 typedef struct _simplethread {
     t_object			x_ob;								// standard max object
 	t_systhread		x_systhread;						// thread reference
-	t_systhread_mutex	x_mutex;							// mutual exclusion lock for threadsafety
 	bool				x_systhread_cancel;					// thread cancel flag
 	void				*x_qelem;							// for message passing between threads
 	void				*x_outlet;							// our outlet	
-	int				x_foo;							// simple data to pass between threads
+	t_int32_atomic		x_foo;							// simple data to pass between threads, updated atomically
 	int				x_sleeptime;						// how many milliseconds to sleep
 } t_simplethread;
 
@@ -58,9 +58,8 @@ void simplethread_bang(t_simplethread *x)
 
 void simplethread_foo(t_simplethread *x, long foo) 
 {
-	systhread_mutex_lock(x->x_mutex);
-	x->x_foo = foo;																// override our current value
-	systhread_mutex_unlock(x->x_mutex);	
+	x->x_foo = foo;																// override our current value, a single aligned write
+	ATOMIC_BARRIER();															// make it visible to the thread
 }
 
 void simplethread_sleeptime(t_simplethread *x, long sleeptime) 
@@ -99,11 +98,10 @@ void *simplethread_threadproc(t_simplethread *x)
 		if (x->x_systhread_cancel) 
 			break;
 
-		systhread_mutex_lock(x->x_mutex);	
-		x->x_foo++;																// fiddle with shared data
-		systhread_mutex_unlock(x->x_mutex);
+		ATOMIC_INCREMENT_BARRIER(&x->x_foo);									// fiddle with shared data, no lock needed
 		
-		qelem_set(x->x_qelem);													// notify main thread using qelem mechanism
+		qelem_set(x->x_qelem);													// notify main thread using qelem mechanism.
+																				// if it is already set, updates are coalesced
 		
 		
 		systhread_sleep(x->x_sleeptime);						// sleep a bit
@@ -121,9 +119,7 @@ void simplethread_qfn(t_simplethread *x)
 {
 	int myfoo;
 	
-	systhread_mutex_lock(x->x_mutex);
-	myfoo = x->x_foo;															// access shared data 
-	systhread_mutex_unlock(x->x_mutex);
+	myfoo = x->x_foo;															// access shared data, a single aligned read
 	
 	// *never* wrap outlet calls with systhread_mutex_lock()
 	outlet_int(x->x_outlet, myfoo);
@@ -145,10 +141,6 @@ void simplethread_free(t_simplethread *x)
 	// free our qelem
 	if (x->x_qelem)
 		qelem_free(x->x_qelem);
-
-	// free out mutex
-	if (x->x_mutex)
-		systhread_mutex_free(x->x_mutex);
 }
 
 void *simplethread_new(void) 
@@ -159,7 +151,6 @@ void *simplethread_new(void)
 	x->x_outlet = outlet_new(x,NULL);
 	x->x_qelem = qelem_new(x,(method)simplethread_qfn);
 	x->x_systhread = NULL;
-	systhread_mutex_new(&x->x_mutex,0);
 	x->x_foo = 0;
 	x->x_sleeptime = 1000;
 	
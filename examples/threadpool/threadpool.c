@@ -3,16 +3,27 @@
 #include "ext_systhread.h"
 #include "threadpooltask.h"
 
+#define THREADPOOL_RESULT_MAXATOMS		16
+
+typedef struct _threadpool_result {
+	long				ac;
+	t_atom				av[THREADPOOL_RESULT_MAXATOMS];
+} t_threadpool_result;
+
 typedef struct _threadpool {
     t_object			x_ob;								// standard max object
 	void				*x_outlet;							// our outlet	
+	t_threadpooltask_results *x_results;					// completed tasks waiting for output
 } t_threadpool;
 
 void threadpool_task(t_threadpool *x, t_symbol *s, long argc, t_atom *argv);	
 void threadpool_dotask(t_threadpool *x, t_symbol *s, long ac, t_atom *av);
 void threadpool_taskcomplete(t_threadpool *x, t_symbol *s, long ac, t_atom *av);
 void threadpool_taskoutput(t_threadpool *x, t_symbol *s, long ac, t_atom *av);
+void threadpool_taskdeliver(t_threadpool *x, t_threadpool_result *r);
 void threadpool_cancel(t_threadpool *x);
+void threadpool_bench(t_threadpool *x, long n);
+void threadpool_benchtask(t_threadpool *x, double *times, t_threadpooltask *task);
 void threadpool_stop(t_threadpool *x);
 void threadpool_assist(t_threadpool *x, void *b, long m, long a, char *s);
 void threadpool_free(t_threadpool *x);
@@ -29,6 +40,7 @@ int main(void)
 	
 	class_addmethod(c, (method)threadpool_task,				"task",				A_GIMME, 0);
 	class_addmethod(c, (method)threadpool_cancel,			"cancel",			0);
+	class_addmethod(c, (method)threadpool_bench,			"bench",			A_DEFLONG, 0);
 
 	// methods which we use internally. they all have A_GIMME style signature
 	class_addmethod(c, (method)threadpool_dotask,			"dotask",			A_GIMME, 0);
@@ -90,17 +102,30 @@ void threadpool_dotask(t_threadpool *x, t_symbol *s, long ac, t_atom *av)
 
 void threadpool_taskcomplete(t_threadpool *x, t_symbol *s, long ac, t_atom *av)
 {	
+	long i;
 	long textsize=0;
 	char *tmpstr=NULL; 
+	t_threadpool_result r;
 	// our completion method will be called from our bakground thread
 	// we cannot output to a patcher from this thread (ILLEGAL)
 	// so we must defer or schedule output to the patcher
 	
 	atom_gettext(ac,av,&textsize,&tmpstr,0);
 	post("threadpool background task (%s) completed in thread %x",tmpstr,systhread_self());
-	post("deferring output to the main thread");
 	
-	defer_low(x,(method)threadpool_taskoutput,gensym("taskoutput"),ac,av);
+	// push the result into our ring, which is drained in one go on the main thread.
+	// fall back to defer_low if there is no ring or the result doesn't fit
+	if (x->x_results&&ac<=THREADPOOL_RESULT_MAXATOMS) {
+		r.ac = ac;
+		for (i=0;i<ac;i++)
+			r.av[i] = av[i];
+		if (!threadpooltask_results_push(x->x_results,&r))
+			ac = -1;
+	}
+	if (ac>=0) {
+		post("deferring output to the main thread");
+		defer_low(x,(method)threadpool_taskoutput,gensym("taskoutput"),ac,av);
+	}
 	//schedule_delay(x,(method)threadpool_taskoutput,gensym("taskoutput"),ac,av);
 
 	if (tmpstr)
@@ -112,12 +137,55 @@ void threadpool_taskoutput(t_threadpool *x, t_symbol *s, long ac, t_atom *av)
 	outlet_anything(x->x_outlet, s, ac, av);
 }
 
+void threadpool_taskdeliver(t_threadpool *x, t_threadpool_result *r)
+{
+	threadpool_taskoutput(x, gensym("taskoutput"), r->ac, r->av);
+}
+
 void threadpool_cancel(t_threadpool *x)
 {
 	threadpool_stop(x);
 	outlet_anything(x->x_outlet,gensym("cancelled"), 0, NULL);
 }
 
+void threadpool_bench(t_threadpool *x, long n)
+{
+	long i;
+	double *times;
+	double start,end,latency,maxlatency=0,sumlatency=0;
+	
+	// submit n tiny tasks, and measure the time from submission until each one starts,
+	// as well as the overall throughput of the pool
+	if (n<=0)
+		n = 100000;
+	if (!(times=(double *)sysmem_newptr(n*2*sizeof(double))))
+		return;
+	
+	start = systimer_gettime();
+	for (i=0;i<n;i++) {
+		times[i*2] = systimer_gettime();
+		threadpooltask_execute((t_object *)x,times+i*2,(method)threadpool_benchtask,NULL,NULL,0);
+	}
+	threadpooltask_join_object((t_object *)x);
+	end = systimer_gettime();
+	
+	for (i=0;i<n;i++) {
+		latency = times[i*2+1]-times[i*2];
+		sumlatency += latency;
+		if (latency>maxlatency)
+			maxlatency = latency;
+	}
+	post("threadpool bench: %ld tasks in %f ms (%f tasks/sec), latency mean=%f ms max=%f ms",
+		 n,end-start,(end>start)?(n*1000./(end-start)):0.,sumlatency/n,maxlatency);
+	
+	sysmem_freeptr(times);
+}
+
+void threadpool_benchtask(t_threadpool *x, double *times, t_threadpooltask *task)
+{
+	times[1] = systimer_gettime();
+}
+
 void threadpool_stop(t_threadpool *x)
 {
 	// stop all tasks associated with my object if they are still present
@@ -135,6 +203,7 @@ void threadpool_assist(t_threadpool *x, void *b, long m, long a, char *s)
 void threadpool_free(t_threadpool *x) 
 {
 	threadpool_stop(x);
+	threadpooltask_results_free(x->x_results);
 }
 
 void *threadpool_new(void) 
@@ -143,6 +212,7 @@ void *threadpool_new(void)
 
 	x = (t_threadpool *)object_alloc(threadpool_class);
 	x->x_outlet = outlet_new(x,NULL);
+	x->x_results = threadpooltask_results_new((t_object *)x,sizeof(t_threadpool_result),1024,(method)threadpool_taskdeliver);
 	
 	return(x);
 }
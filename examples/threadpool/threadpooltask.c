@@ -4,34 +4,114 @@
 #include "ext.h"
 #include "ext_obex.h"
 #include "ext_systhread.h"
+#include "ext_sysparallel.h"
+#include "ext_atomic.h"
 #include "threadpooltask.h"
 
+#ifdef MAC_VERSION
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
 
-// POSSIBLE IMPROVEMENT:	
-// could reduce latency and polling, if we used cond vars instead of sleeping threads
-// a good pthread tutorial is online at http://www.laptev.org/doc/pthreads.html#condvar
-// for the most part you, can just replace the use "pthread" with "systhread"
 
+// workers park on a condition variable when there is no work, rather than sleep-polling.
+// each worker owns a deque of requests. requests made from a worker thread (i.e. from within
+// a task callback) go to that worker's own deque, all others are distributed round robin.
+// idle workers steal from the other deques before parking.
+//
+// each deque is a multi-level queue. high priority requests are taken before normal ones,
+// and normal before low. within a level, requests with a deadline are kept in deadline order
+// ahead of those without. low priority requests may occupy all but one worker, so there is
+// always a worker free to pick up interactive work.
+//
+// task graphs are built from ordinary requests. when a node completes, the first of its
+// successors to become ready runs straight away on the same worker, while it is cache-hot,
+// and any others are queued on that worker's own deque where idle workers can steal them.
+//
+// results are passed back through a bounded multi-producer, single-consumer ring. each slot
+// carries a sequence number which tells producers and the consumer whose turn it is, so
+// neither side takes a lock, and a single qelem drains everything that has arrived.
+//
+// parallel tasks keep their own workers, which wait on a generation counter. the caller runs
+// worker 0 itself, and both sides spin for a short while before parking, so a task executed 
+// once per frame normally never sleeps.
+//
+// requests are linked directly into the worker deques and into an index keyed by owner,
+// so cancel, join and purge never need to search. request structs are recycled rather than
+// freed, and their id changes when they are released, so a stale request and id pair is 
+// harmless. a request pointer on its own is only valid until the request completes.
 
-#define THREADPOOLTASK_THREAD_COUNT		4
-#define THREADPOOLTASK_SLEEPTIME		5
+
+#define THREADPOOLTASK_MAX_THREADS		SYSPARALLEL_MAX_WORKERS
+#define THREADPOOLTASK_SPINCOUNT		2000	// number of polls before parking an idle worker
+#define THREADPOOLTASK_OWNER_BUCKETS	64
+#define THREADPOOLTASK_LEVEL_COUNT		3		// high, normal, low
+#define THREADPOOLTASK_LANE_COUNT		(THREADPOOLTASK_LEVEL_COUNT*2)	// a deadline lane and a fifo lane per level
+#define THREADPOOLTASK_LEVEL_LOW		2
 
 // request state
 #define THREADPOOLTASK_REQ_COMPLETE		0
 #define THREADPOOLTASK_REQ_PENDING		1
 #define THREADPOOLTASK_REQ_PROCESSING	2
+#define THREADPOOLTASK_REQ_CANCELLED	3
 
 
 #define THREADPOOLTASK_MUTEX_NEW 	(systhread_mutex_new((t_systhread_mutex *)&s_threadpooltask_mutex,0))
 #define THREADPOOLTASK_MUTEX_LOCK 	(systhread_mutex_lock((t_systhread_mutex)s_threadpooltask_mutex))
 #define THREADPOOLTASK_MUTEX_UNLOCK 	(systhread_mutex_unlock((t_systhread_mutex)s_threadpooltask_mutex))
 
+#define THREADPOOLTASK_RESULT_HEADER	8		// slot sequence number, padded to keep items aligned
+
+#define THREADPOOLTASK_OWNER_HASH(owner)	((((unsigned long)(owner))>>4)%THREADPOOLTASK_OWNER_BUCKETS)
+
+typedef struct _threadpooltask_lane
+{
+	t_threadpooltask	*head;		// pending requests, earliest deadline or oldest first
+	t_threadpooltask	*tail;
+	long				count;
+} t_threadpooltask_lane;
+
+typedef struct _threadpooltask_worker
+{
+	t_systhread				thread;
+	t_systhread				self;		// as seen from within the worker thread
+	t_systhread_mutex		mutex;		// protects the deque
+	t_threadpooltask_lane	lanes[THREADPOOLTASK_LANE_COUNT];
+	long					count;
+	long					index;
+} t_threadpooltask_worker;
+
+typedef struct _threadpooltask_ownerbucket
+{
+	t_systhread_mutex			mutex;
+	t_threadpooltask_ownerlink	*head;
+} t_threadpooltask_ownerbucket;
+
+typedef struct _threadpooltask_handle
+{
+	t_threadpooltask	*task;
+	long				id;
+} t_threadpooltask_handle;
+
 // private
 void threadpooltask_terminate(void);
-void threadpooltask_threadproc(void);
+void threadpooltask_threadproc(t_threadpooltask_worker *w);
+void threadpooltask_park(void);
+t_threadpooltask_worker *threadpooltask_worker_self(void);
+void threadpooltask_worker_push(t_threadpooltask_worker *w, t_threadpooltask *task);
+t_threadpooltask *threadpooltask_worker_pop(t_threadpooltask_worker *w, long level);
+long threadpooltask_worker_levelcount(t_threadpooltask_worker *w, long level);
+long threadpooltask_canrun(void);
+void threadpooltask_worker_remove(t_threadpooltask_worker *w, t_threadpooltask *task);
+t_threadpooltask_worker *threadpooltask_worker_lock(t_threadpooltask *task);
+t_threadpooltask *threadpooltask_alloc(void);
+void threadpooltask_release(t_threadpooltask *task, long state);
+void threadpooltask_owner_index(t_threadpooltask *task);
+void threadpooltask_owner_unindex(t_threadpooltask *task);
+long threadpooltask_owner_handles(t_object *owner, t_threadpooltask_handle **handles);
 long threadpooltask_makerequest(t_threadpooltask *task); 
-long threadpooltask_getrequest(t_threadpooltask **task);
-void threadpooltask_completerequest(t_threadpooltask *task);
+long threadpooltask_getrequest(t_threadpooltask_worker *w, t_threadpooltask **task);
+void threadpooltask_completerequest(t_threadpooltask_worker *w, t_threadpooltask *task);
 
 typedef	struct _threadpooltask_method_caller
 {
@@ -50,33 +130,149 @@ void threadpooltask_method_caller_task(t_threadpooltask_method_caller *x);
 void threadpooltask_method_caller_complete(t_threadpooltask_method_caller *x);
 void threadpooltask_method_caller_free(t_threadpooltask_method_caller *x);
 
-static t_systhread			s_threadpooltask_thread_pool[THREADPOOLTASK_THREAD_COUNT];
-static t_systhread_mutex	s_threadpooltask_mutex = NULL;
-static t_linklist			*s_threadpooltask_requestlist = NULL;
-static t_linklist			*s_threadpooltask_executelist = NULL;
-static long					s_threadpooltask_numrequests = 0;
-static long					s_threadpooltask_init = 0;
-static long					s_threadpooltask_exit = 0;
-static long					s_threadpooltask_id = 0;
+struct _threadpooltask_node
+{
+	t_threadpooltask_graph	*graph;
+	void					*args;
+	method					cbtask;
+	method					cbcomplete;
+	long					flags;
+	long					index;
+	t_threadpooltask_node	**successors;
+	long					successorcount;
+	long					dependencycount;
+	t_int32_atomic			pending;		// dependencies yet to complete
+	t_threadpooltask		*task;			// request carrying this node, for cancel
+	long					taskid;
+};
+
+struct _threadpooltask_graph
+{
+	t_object				*owner;
+	void					*args;
+	method					cbcomplete;
+	t_threadpooltask_node	**nodes;
+	long					nodecount;
+	t_int32_atomic			remaining;		// nodes yet to complete or be skipped
+	long					running;
+	long					cancelled;
+	t_systhread_mutex		mutex;
+	t_systhread_cond		cond;
+};
+
+struct _threadpooltask_results
+{
+	t_object				*owner;
+	method					cbdeliver;
+	void					*qelem;
+	long					itemsize;
+	long					slotsize;
+	unsigned long			mask;
+	char					*slots;
+	t_int32_atomic			tail;			// next slot for producers
+	unsigned long			head;			// next slot for the consumer
+	t_int32_atomic			scheduled;		// qelem is set and has not started draining
+};
+
+typedef struct _threadpooltask_parallel_thread
+{
+	t_threadpooltask_parallel	*parallel;
+	t_systhread					thread;
+	long						index;
+	long						histogram[THREADPOOLTASK_PARALLEL_HISTOGRAM_BINS];
+} t_threadpooltask_parallel_thread;
+
+struct _threadpooltask_parallel
+{
+	t_sysparallel_task					task;		// data, workerproc, workercount, workers, benchmark, iteration, cancel
+	long								flags;
+	t_threadpooltask_parallel_thread	*threads;	// one per worker, thread 0 is the caller
+	t_int32_atomic						generation;	// incremented for each execution
+	t_int32_atomic						remaining;	// workers yet to finish this execution
+	t_int32_atomic						parked;		// workers waiting on cond
+	t_int32_atomic						waiting;	// the caller is waiting on donecond
+	long								exit;
+	t_systhread_mutex					mutex;
+	t_systhread_cond					cond;
+	t_systhread_cond					donecond;
+};
+
+void threadpooltask_parallel_threadproc(t_threadpooltask_parallel_thread *t);
+void threadpooltask_parallel_run(t_threadpooltask_parallel_thread *t);
+void threadpooltask_parallel_affinity(long index);
+
+void threadpooltask_graph_nodetask(t_threadpooltask_node *node, void *args, t_threadpooltask *task);
+long threadpooltask_graph_submit(t_threadpooltask_node *node);
+t_threadpooltask_node *threadpooltask_graph_resolve(t_threadpooltask_node *node);
+void threadpooltask_graph_skip(t_threadpooltask_node *node);
+void threadpooltask_graph_done(t_threadpooltask_graph *graph);
+long threadpooltask_graph_hascycle(t_threadpooltask_graph *graph);
+t_threadpooltask *threadpooltask_prepare(t_object *owner, void *args, method cbtask, method cbcomplete, long flags, double deadline);
+long threadpooltask_submit(t_threadpooltask *task);
+
+static t_threadpooltask_worker		s_threadpooltask_thread_pool[THREADPOOLTASK_MAX_THREADS];
+static long							s_threadpooltask_threadcount = 0;
+static t_threadpooltask_ownerbucket	s_threadpooltask_owners[THREADPOOLTASK_OWNER_BUCKETS];
+static t_systhread_mutex			s_threadpooltask_mutex = NULL;	// protects parking
+static t_systhread_cond				s_threadpooltask_cond = NULL;	// signalled when a request is made
+static t_systhread_mutex			s_threadpooltask_freemutex = NULL;
+static t_threadpooltask				*s_threadpooltask_freelist = NULL;
+static t_int32_atomic				s_threadpooltask_numrequests = 0;
+static t_int32_atomic				s_threadpooltask_numlow = 0;	// pending low priority requests
+static t_int32_atomic				s_threadpooltask_lowrunning = 0;
+static long							s_threadpooltask_lowlimit = 1;	// most workers which may run low priority requests
+static t_int32_atomic				s_threadpooltask_missed = 0;
+static t_int32_atomic				s_threadpooltask_idle = 0;
+static t_int32_atomic				s_threadpooltask_next = 0;
+static t_int32_atomic				s_threadpooltask_id = 0;
+static long							s_threadpooltask_init = 0;
+static long							s_threadpooltask_exit = 0;
 
 
 void threadpooltask_init(void)
 {
-	long i,err;
+	long i,j,err;
+	t_threadpooltask_worker *w;
 
 	if (s_threadpooltask_init)
 		return;
 
 	THREADPOOLTASK_MUTEX_NEW;
+	systhread_cond_new(&s_threadpooltask_cond,0);
+	systhread_mutex_new(&s_threadpooltask_freemutex,0);
 	s_threadpooltask_numrequests = 0;
 	s_threadpooltask_init = 1;
-	s_threadpooltask_requestlist = linklist_new();
-	s_threadpooltask_executelist = linklist_new();
 	
-	for (i=0;i<THREADPOOLTASK_THREAD_COUNT;i++) {
-		if (err=systhread_create((method)threadpooltask_threadproc,NULL,0,0,0,s_threadpooltask_thread_pool+i)) {
+	for (i=0;i<THREADPOOLTASK_OWNER_BUCKETS;i++) {
+		systhread_mutex_new(&s_threadpooltask_owners[i].mutex,0);
+		s_threadpooltask_owners[i].head = NULL;
+	}
+	
+	s_threadpooltask_threadcount = sysparallel_processorcount();
+	if (s_threadpooltask_threadcount<1)
+		s_threadpooltask_threadcount = 1;
+	else if (s_threadpooltask_threadcount>THREADPOOLTASK_MAX_THREADS)
+		s_threadpooltask_threadcount = THREADPOOLTASK_MAX_THREADS;
+	s_threadpooltask_lowlimit = (s_threadpooltask_threadcount>1) ? s_threadpooltask_threadcount-1 : 1;
+	
+	for (i=0;i<s_threadpooltask_threadcount;i++) {
+		w = s_threadpooltask_thread_pool+i;
+		w->index = i;
+		w->self = NULL;
+		for (j=0;j<THREADPOOLTASK_LANE_COUNT;j++) {
+			w->lanes[j].head = NULL;
+			w->lanes[j].tail = NULL;
+			w->lanes[j].count = 0;
+		}
+		w->count = 0;
+		systhread_mutex_new(&w->mutex,0);
+	}
+	// all workers must exist before any of them start stealing
+	for (i=0;i<s_threadpooltask_threadcount;i++) {
+		w = s_threadpooltask_thread_pool+i;
+		if (err=systhread_create((method)threadpooltask_threadproc,w,0,0,0,&w->thread)) {
 			error("threadpooltask thread could not be created: %d", err);
-			s_threadpooltask_thread_pool[i] = NULL;
+			w->thread = NULL;
 		}
 	}
 	quittask_install((method)threadpooltask_terminate,NULL);
@@ -85,235 +281,1177 @@ void threadpooltask_init(void)
 void threadpooltask_terminate(void)
 {
 	long i;
+	unsigned int ret;
+	t_threadpooltask_worker *w;
+	t_threadpooltask *task;
 	
+	THREADPOOLTASK_MUTEX_LOCK;
 	s_threadpooltask_exit = 1;
-	for (i=0;i<THREADPOOLTASK_THREAD_COUNT;i++) {
-		if (s_threadpooltask_thread_pool[i]) {
-			// may wish to join instead?
-			systhread_terminate(s_threadpooltask_thread_pool[i]);
-			s_threadpooltask_thread_pool[i] = NULL;
+	systhread_cond_broadcast(s_threadpooltask_cond);
+	THREADPOOLTASK_MUTEX_UNLOCK;
+	
+	// workers wake immediately, so we can join rather than terminate. 
+	// any request in progress will run to completion.
+	for (i=0;i<s_threadpooltask_threadcount;i++) {
+		w = s_threadpooltask_thread_pool+i;
+		if (w->thread) {
+			systhread_join(w->thread,&ret);
+			w->thread = NULL;
 		}
 	}
+	for (i=0;i<s_threadpooltask_threadcount;i++)
+		systhread_mutex_free(s_threadpooltask_thread_pool[i].mutex);
+	for (i=0;i<THREADPOOLTASK_OWNER_BUCKETS;i++)
+		systhread_mutex_free(s_threadpooltask_owners[i].mutex);
+	while (task=s_threadpooltask_freelist) {
+		s_threadpooltask_freelist = task->next;
+		systhread_cond_free(task->cond);
+		systhread_mutex_free(task->mutex);
+		sysmem_freeptr(task);
+	}
+	systhread_mutex_free(s_threadpooltask_freemutex);
+	systhread_cond_free(s_threadpooltask_cond);
 	systhread_mutex_free(s_threadpooltask_mutex);
 }
 
-void threadpooltask_threadproc(void)
+void threadpooltask_threadproc(t_threadpooltask_worker *w)
 {
 	t_threadpooltask *r;
 
-	while (true) {
-		if (threadpooltask_getrequest(&r)<0) {
-			systhread_sleep(THREADPOOLTASK_SLEEPTIME); // could change this number dynamically, or use condvars
+	w->self = systhread_self();
+	while (!s_threadpooltask_exit) {
+		if (threadpooltask_getrequest(w,&r)<0) {
+			threadpooltask_park();
 		} else {
 			if (r) {
-				r->state = THREADPOOLTASK_REQ_PROCESSING;
-				threadpooltask_completerequest(r);
+				threadpooltask_completerequest(w,r);
 			}
 		}
 	}
+	systhread_exit(0);
 }
 
-long threadpooltask_makerequest(t_threadpooltask *task) 
+void threadpooltask_park(void)
 {
-	long rv=-1;
-
-	if (s_threadpooltask_exit)
-		return -1;
+	long i;
 	
+	// a short spin catches requests which arrive right behind the one we just finished
+	for (i=0;i<THREADPOOLTASK_SPINCOUNT;i++) {
+		if (threadpooltask_canrun() || s_threadpooltask_exit)
+			return;
+	}
+	
+	// the idle count is raised before testing for requests, and the request count is raised
+	// before testing for idle workers, so either we see the request or the requester signals us
 	THREADPOOLTASK_MUTEX_LOCK;
-	linklist_append(s_threadpooltask_requestlist,task);
-	s_threadpooltask_numrequests++;
+	ATOMIC_INCREMENT_BARRIER(&s_threadpooltask_idle);
+	while (!threadpooltask_canrun() && !s_threadpooltask_exit)
+		systhread_cond_wait(s_threadpooltask_cond,s_threadpooltask_mutex);
+	ATOMIC_DECREMENT_BARRIER(&s_threadpooltask_idle);
 	THREADPOOLTASK_MUTEX_UNLOCK;
-	
-	rv = 0;
-	
-	return rv;
 }
 
-long threadpooltask_getrequest(t_threadpooltask **task) 
+// there is a request we are allowed to take: anything other than low priority,
+// or low priority with fewer than s_threadpooltask_lowlimit of them running
+long threadpooltask_canrun(void)
 {
-	long  rv=-1;
+	return (s_threadpooltask_numrequests>s_threadpooltask_numlow) || 
+		(s_threadpooltask_numlow>0 && s_threadpooltask_lowrunning<s_threadpooltask_lowlimit);
+}
 
-	THREADPOOLTASK_MUTEX_LOCK;
-	if (s_threadpooltask_numrequests>0) {
-		*task = (t_threadpooltask *)linklist_getindex(s_threadpooltask_requestlist,0);
-		linklist_chuckindex(s_threadpooltask_requestlist,0);
-		linklist_append(s_threadpooltask_executelist,*task);
-		s_threadpooltask_numrequests--;
-		rv = 0;
-	} else {
-		*task = NULL;
+t_threadpooltask_worker *threadpooltask_worker_self(void)
+{
+	long i;
+	t_systhread self = systhread_self();
+	
+	for (i=0;i<s_threadpooltask_threadcount;i++) {
+		if (s_threadpooltask_thread_pool[i].self==self)
+			return s_threadpooltask_thread_pool+i;
 	}
-	THREADPOOLTASK_MUTEX_UNLOCK;
-	return rv;
+	return NULL;
 }
 
-void threadpooltask_completerequest(t_threadpooltask *task)
+// call with w->mutex locked
+void threadpooltask_worker_push(t_threadpooltask_worker *w, t_threadpooltask *task)
 {
-	if (task&&task->cbtask) {
-		(*((method)task->cbtask))(task->owner,task->args,task);
+	t_threadpooltask_lane *lane;
+	t_threadpooltask *prev;
+	
+	task->lane = (task->flags&THREADPOOLTASK_PRIORITY_HIGH) ? 0 : ((task->flags&THREADPOOLTASK_PRIORITY_LOW) ? 2 : 1);
+	task->lane = task->lane*2 + (task->deadline>0 ? 0 : 1);
+	lane = w->lanes+task->lane;
+	
+	// deadlines usually arrive in order, so search back from the tail
+	prev = lane->tail;
+	if (task->deadline>0) {
+		while (prev && prev->deadline>task->deadline)
+			prev = prev->prev;
 	}
-	task->state = THREADPOOLTASK_REQ_COMPLETE; // redundant to set state
-	if (task&&task->cbcomplete) {
-		(*((method)task->cbcomplete))(task->owner,task->args,task);
+	task->prev = prev;
+	task->next = prev ? prev->next : lane->head;
+	if (task->next)
+		task->next->prev = task;
+	else
+		lane->tail = task;
+	if (prev)
+		prev->next = task;
+	else
+		lane->head = task;
+	task->queue = w;
+	lane->count++;
+	w->count++;
+}
+
+// call with w->mutex locked
+t_threadpooltask *threadpooltask_worker_pop(t_threadpooltask_worker *w, long level)
+{
+	t_threadpooltask *task=w->lanes[level*2].head;
+	
+	if (!task)
+		task = w->lanes[level*2+1].head;
+	if (task) {
+		threadpooltask_worker_remove(w,task);
+		task->state = THREADPOOLTASK_REQ_PROCESSING;
 	}
+	return task;
+}
+
+// call with w->mutex locked
+void threadpooltask_worker_remove(t_threadpooltask_worker *w, t_threadpooltask *task)
+{
+	t_threadpooltask_lane *lane=w->lanes+task->lane;
 	
-	THREADPOOLTASK_MUTEX_LOCK;
-	linklist_chuckobject(s_threadpooltask_executelist,task);
-	THREADPOOLTASK_MUTEX_UNLOCK;
+	if (task->prev)
+		task->prev->next = task->next;
+	else
+		lane->head = task->next;
+	if (task->next)
+		task->next->prev = task->prev;
+	else
+		lane->tail = task->prev;
+	task->prev = task->next = NULL;
+	task->queue = NULL;
+	lane->count--;
+	w->count--;
+}
+
+// unlocked, so only a hint
+long threadpooltask_worker_levelcount(t_threadpooltask_worker *w, long level)
+{
+	return w->lanes[level*2].count + w->lanes[level*2+1].count;
+}
+
+// lock the worker whose deque holds task. returns NULL if the request is no longer queued. 
+// the request may be stolen between reading task->queue and taking the lock, so check again.
+t_threadpooltask_worker *threadpooltask_worker_lock(t_threadpooltask *task)
+{
+	t_threadpooltask_worker *w;
+	
+	while (w=(t_threadpooltask_worker *)task->queue) {
+		systhread_mutex_lock(w->mutex);
+		if (task->queue==w)
+			return w;
+		systhread_mutex_unlock(w->mutex);
+	}
+	return NULL;
+}
 
-	sysmem_freeptr(task);
+t_threadpooltask *threadpooltask_alloc(void)
+{
+	t_threadpooltask *task;
+	
+	systhread_mutex_lock(s_threadpooltask_freemutex);
+	if (task=s_threadpooltask_freelist)
+		s_threadpooltask_freelist = task->next;
+	systhread_mutex_unlock(s_threadpooltask_freemutex);
+	
+	if (!task) {
+		if (!(task=(t_threadpooltask *)sysmem_newptrclear(sizeof(t_threadpooltask))))
+			return NULL;
+		systhread_mutex_new(&task->mutex,0);
+		systhread_cond_new(&task->cond,0);
+	}
+	task->prev = task->next = NULL;
+	task->queue = NULL;
+	task->id = ATOMIC_INCREMENT(&s_threadpooltask_id);
+	return task;
 }
 
-typedef struct _threadpooltask_requestmatch
+// signal the completion event and recycle the request. the id is cleared
+// so that anyone still holding a pointer to this request will not find it
+void threadpooltask_release(t_threadpooltask *task, long state)
 {
-	t_object	*owner;
-	t_linklist	*list;
-} t_threadpooltask_requestmatch;
+	threadpooltask_owner_unindex(task);
+	
+	systhread_mutex_lock(task->mutex);
+	task->state = state;
+	task->id = 0;
+	if (task->waiters)
+		systhread_cond_broadcast(task->cond);
+	systhread_mutex_unlock(task->mutex);
+	
+	systhread_mutex_lock(s_threadpooltask_freemutex);
+	task->next = s_threadpooltask_freelist;
+	s_threadpooltask_freelist = task;
+	systhread_mutex_unlock(s_threadpooltask_freemutex);
+}
 
-void threadpooltask_requestmatch_fn(t_threadpooltask *task, t_threadpooltask_requestmatch *match);
-void threadpooltask_requestmatch_fn(t_threadpooltask *task, t_threadpooltask_requestmatch *match)
+void threadpooltask_owner_index(t_threadpooltask *task)
 {
+	long i;
+	t_threadpooltask_ownerlink *link;
+	t_threadpooltask_ownerbucket *bucket;
 	t_threadpooltask_method_caller *caller;
 	
-	if (task&&match) {
-		if (task->owner==match->owner)
-			linklist_append(match->list,task);
-		if ((void *)task->cbtask==(void *)threadpooltask_method_caller_task) {
-			caller = (t_threadpooltask_method_caller *)task->owner;
-			if (caller->obtask==match->owner || caller->obcomp==match->owner)
-				linklist_append(match->list,task);
+	task->ownerlink[0].owner = task->owner;
+	task->ownerlink[1].owner = NULL;
+	if ((void *)task->cbtask==(void *)threadpooltask_method_caller_task) {
+		// the caller struct is private, so index by the objects it calls instead
+		caller = (t_threadpooltask_method_caller *)task->owner;
+		task->ownerlink[0].owner = caller->obtask;
+		if (caller->obcomp!=caller->obtask)
+			task->ownerlink[1].owner = caller->obcomp;
+	} else if ((void *)task->cbtask==(void *)threadpooltask_graph_nodetask) {
+		task->ownerlink[0].owner = ((t_threadpooltask_node *)task->owner)->graph->owner;
+	}
+	for (i=0;i<2;i++) {
+		link = task->ownerlink+i;
+		link->task = task;
+		link->prev = link->next = NULL;
+		if (!link->owner)
+			continue;
+		bucket = s_threadpooltask_owners+THREADPOOLTASK_OWNER_HASH(link->owner);
+		systhread_mutex_lock(bucket->mutex);
+		if (link->next=bucket->head)
+			link->next->prev = link;
+		bucket->head = link;
+		systhread_mutex_unlock(bucket->mutex);
+	}
+}
+
+void threadpooltask_owner_unindex(t_threadpooltask *task)
+{
+	long i;
+	t_threadpooltask_ownerlink *link;
+	t_threadpooltask_ownerbucket *bucket;
+	
+	for (i=0;i<2;i++) {
+		link = task->ownerlink+i;
+		if (!link->owner)
+			continue;
+		bucket = s_threadpooltask_owners+THREADPOOLTASK_OWNER_HASH(link->owner);
+		systhread_mutex_lock(bucket->mutex);
+		if (link->prev)
+			link->prev->next = link->next;
+		else
+			bucket->head = link->next;
+		if (link->next)
+			link->next->prev = link->prev;
+		systhread_mutex_unlock(bucket->mutex);
+		link->prev = link->next = NULL;
+		link->owner = NULL;
+	}
+}
+
+// fill an array with the (request,id) pairs belonging to owner. the ids let us tell 
+// if a request has been recycled before we get to cancel or join it
+long threadpooltask_owner_handles(t_object *owner, t_threadpooltask_handle **handles)
+{
+	long count=0,size=0;
+	t_threadpooltask_ownerlink *link;
+	t_threadpooltask_ownerbucket *bucket;
+	t_threadpooltask_handle *h;
+	
+	*handles = NULL;
+	bucket = s_threadpooltask_owners+THREADPOOLTASK_OWNER_HASH(owner);
+	systhread_mutex_lock(bucket->mutex);
+	for (link=bucket->head;link;link=link->next) {
+		if (link->owner==owner) {
+			if (count==size) {
+				size = size ? size*2 : 16;
+				if (!(h=(t_threadpooltask_handle *)sysmem_newptr(size*sizeof(t_threadpooltask_handle))))
+					break;
+				if (*handles) {
+					sysmem_copyptr(*handles,h,count*sizeof(t_threadpooltask_handle));
+					sysmem_freeptr(*handles);
+				}
+				*handles = h;
+			}
+			(*handles)[count].task = link->task;
+			(*handles)[count].id = link->task->id;
+			count++;
 		}
 	}
+	systhread_mutex_unlock(bucket->mutex);
+	
+	return count;
 }
 
-t_linklist *threadpooltask_object_requestlist(t_object *owner);
-t_linklist *threadpooltask_object_requestlist(t_object *owner)
+long threadpooltask_makerequest(t_threadpooltask *task) 
 {
-	t_linklist *list=NULL;
-	t_threadpooltask_requestmatch match;	
+	t_threadpooltask_worker *w;
+
+	if (s_threadpooltask_exit)
+		return -1;
 	
-	list = linklist_new();
-	linklist_flags(list,OBJ_FLAG_REF);
-	match.owner = owner;
-	match.list = list;
+	if (!(w=threadpooltask_worker_self()))
+		w = s_threadpooltask_thread_pool + ((unsigned long)ATOMIC_INCREMENT(&s_threadpooltask_next)%s_threadpooltask_threadcount);
 	
-	THREADPOOLTASK_MUTEX_LOCK;
-	linklist_funall(s_threadpooltask_requestlist,(method)threadpooltask_requestmatch_fn,(void *)&match);
-	linklist_funall(s_threadpooltask_executelist,(method)threadpooltask_requestmatch_fn,(void *)&match);
-	THREADPOOLTASK_MUTEX_UNLOCK;	
+	task->state = THREADPOOLTASK_REQ_PENDING;
+	systhread_mutex_lock(w->mutex);
+	threadpooltask_worker_push(w,task);
+	systhread_mutex_unlock(w->mutex);
+	
+	if (task->flags&THREADPOOLTASK_PRIORITY_LOW)
+		ATOMIC_INCREMENT_BARRIER(&s_threadpooltask_numlow);
+	ATOMIC_INCREMENT_BARRIER(&s_threadpooltask_numrequests);
+	if (s_threadpooltask_idle>0) {
+		THREADPOOLTASK_MUTEX_LOCK;
+		systhread_cond_signal(s_threadpooltask_cond);
+		THREADPOOLTASK_MUTEX_UNLOCK;
+	}
 	
-	return list;
+	return 0;
+}
+
+long threadpooltask_getrequest(t_threadpooltask_worker *w, t_threadpooltask **task) 
+{
+	long i,level;
+	t_threadpooltask_worker *victim;
+
+	*task = NULL;
+	if (!threadpooltask_canrun())
+		return -1;
+	
+	// take the highest level request we can find, our own first, then by stealing
+	for (level=0;!*task&&level<THREADPOOLTASK_LEVEL_COUNT;level++) {
+		if (level==THREADPOOLTASK_LEVEL_LOW) {
+			// reserve a low priority slot before looking, and give it back if there is nothing there
+			if (ATOMIC_INCREMENT_BARRIER(&s_threadpooltask_lowrunning)>s_threadpooltask_lowlimit) {
+				ATOMIC_DECREMENT_BARRIER(&s_threadpooltask_lowrunning);
+				break;
+			}
+		}
+		for (i=0;!*task&&i<s_threadpooltask_threadcount;i++) {
+			victim = s_threadpooltask_thread_pool + ((w->index+i)%s_threadpooltask_threadcount);
+			if (threadpooltask_worker_levelcount(victim,level)>0) {
+				systhread_mutex_lock(victim->mutex);
+				*task = threadpooltask_worker_pop(victim,level);
+				systhread_mutex_unlock(victim->mutex);
+			}
+		}
+		if (level==THREADPOOLTASK_LEVEL_LOW) {
+			if (*task)
+				ATOMIC_DECREMENT_BARRIER(&s_threadpooltask_numlow);
+			else
+				ATOMIC_DECREMENT_BARRIER(&s_threadpooltask_lowrunning);
+		}
+	}
+	
+	if (*task) {
+		ATOMIC_DECREMENT_BARRIER(&s_threadpooltask_numrequests);
+		return 0;
+	}
+	return -1;
+}
+
+void threadpooltask_completerequest(t_threadpooltask_worker *w, t_threadpooltask *task)
+{
+	if (task&&task->cbtask) {
+		(*((method)task->cbtask))(task->owner,task->args,task);
+	}
+	task->state = THREADPOOLTASK_REQ_COMPLETE; // redundant to set state
+	if (task->deadline>0 && systimer_gettime()>task->deadline) {
+		task->flags |= THREADPOOLTASK_FLAG_DEADLINE_MISSED;
+		ATOMIC_INCREMENT(&s_threadpooltask_missed);
+	}
+	if (task&&task->cbcomplete) {
+		(*((method)task->cbcomplete))(task->owner,task->args,task);
+	}
+	if (task->flags&THREADPOOLTASK_PRIORITY_LOW) {
+		// a low priority slot is free again, which may let a parked worker run
+		ATOMIC_DECREMENT_BARRIER(&s_threadpooltask_lowrunning);
+		if (s_threadpooltask_numlow>0 && s_threadpooltask_idle>0) {
+			THREADPOOLTASK_MUTEX_LOCK;
+			systhread_cond_signal(s_threadpooltask_cond);
+			THREADPOOLTASK_MUTEX_UNLOCK;
+		}
+	}
+	threadpooltask_release(task,THREADPOOLTASK_REQ_COMPLETE);
 }
 
 void threadpooltask_purge_object(t_object *owner)
 {
-	t_linklist *list;
-	t_threadpooltask *task;
+	long i,count;
+	t_threadpooltask_handle *handles;
 	
-	// build linklist of requests whose owner pointer matches
-	list = threadpooltask_object_requestlist(owner);
-	// call threadpooltask_cancel on each one
-	while (task = (t_threadpooltask *)linklist_getindex(list,0)) {
-		threadpooltask_cancel(task);
-		linklist_chuckindex(list,0);
+	// cancel each request indexed under this owner. requests in progress may queue 
+	// more (graph nodes, for example) before they finish, so repeat until there are none
+	while (count = threadpooltask_owner_handles(owner,&handles)) {
+		for (i=0;i<count;i++)
+			threadpooltask_cancel_id(handles[i].task,handles[i].id);
+		sysmem_freeptr(handles);
 	}
-	linklist_chuck(list);
 }
 
 void threadpooltask_join_object(t_object *owner)
 {
-	t_linklist *list;
-	t_threadpooltask *task;
+	long i,count;
+	t_threadpooltask_handle *handles;
 	
-	// build linklist of requests whose owner pointer matches
-	list = threadpooltask_object_requestlist(owner);
-	// call threadpooltask_join on each one
-	while (task = (t_threadpooltask *)linklist_getindex(list,0)) {
-		threadpooltask_join(task);
-		linklist_chuckindex(list,0);
+	// join each request indexed under this owner, including any they queue
+	while (count = threadpooltask_owner_handles(owner,&handles)) {
+		for (i=0;i<count;i++)
+			threadpooltask_join_id(handles[i].task,handles[i].id);
+		sysmem_freeptr(handles);
 	}
-	linklist_chuck(list);
 }
 
-long threadpooltask_cancel(t_threadpooltask *task)
+long threadpooltask_cancel_id(t_threadpooltask *task, long id)
 {
-	long i,wait=FALSE;
-	long rv = -1;
+	t_threadpooltask_worker *w;
 	
-	THREADPOOLTASK_MUTEX_LOCK;
-	i = linklist_objptr2index(s_threadpooltask_requestlist,task);
-	if (i>=0) {
-		linklist_chuckindex(s_threadpooltask_requestlist,i);
-		if ((void *)task->cbtask==(void *)threadpooltask_method_caller_task) {
-			threadpooltask_method_caller_free((t_threadpooltask_method_caller *)task->owner);
+	if (!id)
+		return -1;
+	
+	if (w=threadpooltask_worker_lock(task)) {
+		if (task->id==id && task->state==THREADPOOLTASK_REQ_PENDING) {
+			threadpooltask_worker_remove(w,task);
+			systhread_mutex_unlock(w->mutex);
+			if (task->flags&THREADPOOLTASK_PRIORITY_LOW)
+				ATOMIC_DECREMENT_BARRIER(&s_threadpooltask_numlow);
+			ATOMIC_DECREMENT_BARRIER(&s_threadpooltask_numrequests);
+			if ((void *)task->cbtask==(void *)threadpooltask_method_caller_task) {
+				threadpooltask_method_caller_free((t_threadpooltask_method_caller *)task->owner);
+			} else if ((void *)task->cbtask==(void *)threadpooltask_graph_nodetask) {
+				// cancelling any node cancels the rest of its graph
+				((t_threadpooltask_node *)task->owner)->graph->cancelled = 1;
+				threadpooltask_graph_skip((t_threadpooltask_node *)task->owner);
+			}
+			threadpooltask_release(task,THREADPOOLTASK_REQ_CANCELLED);
+			return 0; // found and cancelled
 		}
-		sysmem_freeptr(task);
-		rv = 0; // found and cancelled
-	} else {
-		i = linklist_objptr2index(s_threadpooltask_executelist,task);
-		wait = (i>=0);
-		rv = 1; // found and joined
+		systhread_mutex_unlock(w->mutex);
 	}
-	THREADPOOLTASK_MUTEX_UNLOCK;	
+	
+	// an executing graph node should not start any more of its graph
+	systhread_mutex_lock(task->mutex);
+	if (task->id==id && (void *)task->cbtask==(void *)threadpooltask_graph_nodetask)
+		((t_threadpooltask_node *)task->owner)->graph->cancelled = 1;
+	systhread_mutex_unlock(task->mutex);
 	
 	// if the task is executing, stall
-	while (wait) {
-		systhread_sleep(THREADPOOLTASK_SLEEPTIME);
-		i = linklist_objptr2index(s_threadpooltask_executelist,task);
-		wait = (i>=0);
+	if (!threadpooltask_join_id(task,id))
+		return 1; // found and joined
+	return -1;
+}
+
+long threadpooltask_join_id(t_threadpooltask *task, long id)
+{
+	long rv = -1;
+	
+	if (!id)
+		return -1;
+	
+	systhread_mutex_lock(task->mutex);
+	if (task->id==id) {
+		task->waiters++;
+		while (task->id==id)
+			systhread_cond_wait(task->cond,task->mutex);
+		task->waiters--;
+		rv = 0; // found and joined
 	}
+	systhread_mutex_unlock(task->mutex);
 	return rv;
 }
 
+// task must not have completed yet. callers which may hold on to a request after it
+// completes should keep the id from threadpooltask_execute_id() and use threadpooltask_cancel_id()
+long threadpooltask_cancel(t_threadpooltask *task)
+{
+	return threadpooltask_cancel_id(task,task->id);
+}
 
+// as above, use threadpooltask_join_id() if the request may already have completed
 long threadpooltask_join(t_threadpooltask *task)
 {
-	long i,j,wait=TRUE;
-	long rv = -1;
-	
-	while (wait) {
-		THREADPOOLTASK_MUTEX_LOCK;
-		i = linklist_objptr2index(s_threadpooltask_requestlist,task);
-		j = linklist_objptr2index(s_threadpooltask_executelist,task);
-		if (i>=0 || j>=0) {
-			wait = TRUE;	
-			rv = 0; // found and joined
-		} else {
-			wait = FALSE;
-		}
-		THREADPOOLTASK_MUTEX_UNLOCK;	
-		if (wait)
-			systhread_sleep(THREADPOOLTASK_SLEEPTIME);
-	}	
-	return rv;
+	return threadpooltask_join_id(task,task->id);
+}
+
+long threadpooltask_deadlines_missed(void)
+{
+	return s_threadpooltask_missed;
 }
 
 long threadpooltask_execute(t_object *owner, void *args, method cbtask, method cbcomplete, t_threadpooltask **task, long flags)
 {
-	long err=-1;
+	return threadpooltask_execute_deadline(owner,args,cbtask,cbcomplete,task,flags,0);
+}
+
+// deadline is in milliseconds from now, or 0 for none
+long threadpooltask_execute_deadline(t_object *owner, void *args, method cbtask, method cbcomplete, t_threadpooltask **task, long flags, double deadline)
+{
+	return threadpooltask_execute_id(owner,args,cbtask,cbcomplete,task,NULL,flags,deadline);
+}
+
+// id is read before the request is queued, so it is valid even if the request completes
+// straight away. pass task and id to threadpooltask_cancel_id() or threadpooltask_join_id()
+long threadpooltask_execute_id(t_object *owner, void *args, method cbtask, method cbcomplete, t_threadpooltask **task, long *id, long flags, double deadline)
+{
+	t_threadpooltask *bgt;
+
+	if (bgt=threadpooltask_prepare(owner,args,cbtask,cbcomplete,flags,deadline)) {
+		if (task)
+			*task = bgt;
+		if (id)
+			*id = bgt->id;
+		return threadpooltask_submit(bgt);
+	}
+	return -1;
+}
+
+t_threadpooltask *threadpooltask_prepare(t_object *owner, void *args, method cbtask, method cbcomplete, long flags, double deadline)
+{
 	t_threadpooltask *bgt;
 
 	if (!s_threadpooltask_init)
 		threadpooltask_init();
 
-	if (bgt=(t_threadpooltask *)sysmem_newptr(sizeof(t_threadpooltask))) {
+	if (bgt=threadpooltask_alloc()) {
 		// store flags and permissions for later use
-		bgt->flags = flags;
+		if ((flags&THREADPOOLTASK_PRIORITY_MASK)==THREADPOOLTASK_PRIORITY_MASK)
+			flags &= ~THREADPOOLTASK_PRIORITY_LOW;
+		bgt->flags = flags&~THREADPOOLTASK_FLAG_DEADLINE_MISSED;
+		bgt->deadline = (deadline>0) ? systimer_gettime()+deadline : 0;
 		bgt->state = THREADPOOLTASK_REQ_PENDING;
-		bgt->id = s_threadpooltask_id;
 		bgt->owner = owner;
 		bgt->cbtask = cbtask;
 		bgt->cbcomplete = cbcomplete;
 		bgt->args = args;
+		threadpooltask_owner_index(bgt);
+	}
+	return bgt;
+}
+
+long threadpooltask_submit(t_threadpooltask *task)
+{
+	long err;
+	
+	if (err=threadpooltask_makerequest(task))
+		threadpooltask_release(task,THREADPOOLTASK_REQ_CANCELLED);
+	return err;
+}
+
+
+t_threadpooltask_graph *threadpooltask_graph_new(t_object *owner, void *args, method cbcomplete)
+{
+	t_threadpooltask_graph *x;
+	
+	if (x=(t_threadpooltask_graph *)sysmem_newptrclear(sizeof(t_threadpooltask_graph))) {
+		x->owner = owner;
+		x->args = args;
+		x->cbcomplete = cbcomplete;
+		systhread_mutex_new(&x->mutex,0);
+		systhread_cond_new(&x->cond,0);
+	}
+	return x;
+}
+
+void threadpooltask_graph_free(t_threadpooltask_graph *x)
+{
+	long i;
+	
+	if (x) {
+		threadpooltask_graph_join(x);
+		for (i=0;i<x->nodecount;i++) {
+			if (x->nodes[i]->successors)
+				sysmem_freeptr(x->nodes[i]->successors);
+			sysmem_freeptr(x->nodes[i]);
+		}
+		if (x->nodes)
+			sysmem_freeptr(x->nodes);
+		systhread_cond_free(x->cond);
+		systhread_mutex_free(x->mutex);
+		sysmem_freeptr(x);
+	}
+}
+
+t_threadpooltask_node *threadpooltask_graph_node(t_threadpooltask_graph *x, void *args, method cbtask, method cbcomplete, long flags)
+{
+	t_threadpooltask_node *node;
+	t_threadpooltask_node **nodes;
+	
+	if (!x || x->running)
+		return NULL;
+	if (x->nodes)
+		nodes = (t_threadpooltask_node **)sysmem_resizeptr(x->nodes,(x->nodecount+1)*sizeof(t_threadpooltask_node *));
+	else
+		nodes = (t_threadpooltask_node **)sysmem_newptr(sizeof(t_threadpooltask_node *));
+	if (!nodes)
+		return NULL;
+	x->nodes = nodes;
+	if (node=(t_threadpooltask_node *)sysmem_newptrclear(sizeof(t_threadpooltask_node))) {
+		node->graph = x;
+		node->args = args;
+		node->cbtask = cbtask;
+		node->cbcomplete = cbcomplete;
+		node->flags = flags;
+		node->index = x->nodecount;
+		x->nodes[x->nodecount++] = node;
+	}
+	return node;
+}
+
+// node will not run until dependency has completed
+long threadpooltask_graph_depend(t_threadpooltask_node *node, t_threadpooltask_node *dependency)
+{
+	t_threadpooltask_node **successors;
+	
+	if (!node || !dependency || node==dependency || node->graph!=dependency->graph || node->graph->running)
+		return -1;
+	if (dependency->successors)
+		successors = (t_threadpooltask_node **)sysmem_resizeptr(dependency->successors,(dependency->successorcount+1)*sizeof(t_threadpooltask_node *));
+	else
+		successors = (t_threadpooltask_node **)sysmem_newptr(sizeof(t_threadpooltask_node *));
+	if (!successors)
+		return -1;
+	dependency->successors = successors;
+	dependency->successors[dependency->successorcount++] = node;
+	node->dependencycount++;
+	return 0;
+}
+
+long threadpooltask_graph_execute(t_threadpooltask_graph *x)
+{
+	long i;
+	t_threadpooltask_node *node;
+	
+	if (!x || x->running || !x->nodecount)
+		return -1;
+	if (threadpooltask_graph_hascycle(x)) {
+		error("threadpooltask graph has a cycle");
+		return -1;
+	}
+	
+	// a graph may be executed again once it has completed
+	x->cancelled = 0;
+	x->running = 1;
+	x->remaining = x->nodecount;
+	for (i=0;i<x->nodecount;i++) {
+		node = x->nodes[i];
+		node->pending = node->dependencycount;
+		node->task = NULL;
+		node->taskid = 0;
+	}
+	for (i=0;i<x->nodecount;i++) {
+		node = x->nodes[i];
+		if (!node->dependencycount)
+			threadpooltask_graph_submit(node);
+	}
+	return 0;
+}
+
+long threadpooltask_graph_cancel(t_threadpooltask_graph *x)
+{
+	long i;
+	t_threadpooltask_node *node;
+	
+	if (!x || !x->running)
+		return -1;
+	x->cancelled = 1;
+	for (i=0;i<x->nodecount;i++) {
+		node = x->nodes[i];
+		if (node->task)
+			threadpooltask_cancel_id(node->task,node->taskid);
+	}
+	return threadpooltask_graph_join(x);
+}
+
+long threadpooltask_graph_join(t_threadpooltask_graph *x)
+{
+	if (!x)
+		return -1;
+	systhread_mutex_lock(x->mutex);
+	while (x->running)
+		systhread_cond_wait(x->cond,x->mutex);
+	systhread_mutex_unlock(x->mutex);
+	return 0;
+}
+
+long threadpooltask_graph_submit(t_threadpooltask_node *node)
+{
+	t_threadpooltask *task;
+	
+	if (task=threadpooltask_prepare((t_object *)node,NULL,(method)threadpooltask_graph_nodetask,NULL,node->flags,0)) {
+		node->taskid = task->id;
+		node->task = task;
+		if (!threadpooltask_submit(task))
+			return 0;
+	}
+	// keep the graph accounting straight even if we could not queue the node
+	node->graph->cancelled = 1;
+	threadpooltask_graph_skip(node);
+	return -1;
+}
+
+// the carrier request for one node. run it, then keep going with whichever successor
+// it made ready first, for as long as there is one
+void threadpooltask_graph_nodetask(t_threadpooltask_node *node, void *args, t_threadpooltask *task)
+{
+	t_threadpooltask_graph *graph;
+	
+	while (node) {
+		graph = node->graph;
+		if (!graph->cancelled) {
+			if (node->cbtask)
+				(*((method)node->cbtask))(graph->owner,node->args,task);
+			if (node->cbcomplete)
+				(*((method)node->cbcomplete))(graph->owner,node->args,task);
+		}
+		node = threadpooltask_graph_resolve(node);
+	}
+}
+
+// mark node as finished, queue (or skip) any successors it made ready and return the 
+// first of them for the caller to continue with. nothing may touch the graph after
+// the last node is resolved, as the graph may be freed as soon as it is joined
+t_threadpooltask_node *threadpooltask_graph_resolve(t_threadpooltask_node *node)
+{
+	long i;
+	t_threadpooltask_node *successor,*next=NULL;
+	t_threadpooltask_graph *graph=node->graph;
+	
+	for (i=0;i<node->successorcount;i++) {
+		successor = node->successors[i];
+		if (ATOMIC_DECREMENT_BARRIER(&successor->pending)==0) {
+			if (!next)
+				next = successor;
+			else if (graph->cancelled)
+				threadpooltask_graph_skip(successor);
+			else
+				threadpooltask_graph_submit(successor);
+		}
+	}
+	if (ATOMIC_DECREMENT_BARRIER(&graph->remaining)==0)
+		threadpooltask_graph_done(graph);
+	return next;
+}
+
+void threadpooltask_graph_skip(t_threadpooltask_node *node)
+{
+	while (node)
+		node = threadpooltask_graph_resolve(node);
+}
+
+void threadpooltask_graph_done(t_threadpooltask_graph *x)
+{
+	if (x->cbcomplete)
+		(*((method)x->cbcomplete))(x->owner,x->args,x);
+	systhread_mutex_lock(x->mutex);
+	x->running = 0;
+	systhread_cond_broadcast(x->cond);
+	systhread_mutex_unlock(x->mutex);
+}
+
+// kahn's algorithm. if some nodes can never become ready, the graph would never complete
+long threadpooltask_graph_hascycle(t_threadpooltask_graph *x)
+{
+	long i,j,head=0,tail=0;
+	long *pending,*ready;
+	t_threadpooltask_node *node;
+	
+	pending = (long *)sysmem_newptr(x->nodecount*sizeof(long));
+	ready = (long *)sysmem_newptr(x->nodecount*sizeof(long));
+	if (!pending || !ready) {
+		if (pending)
+			sysmem_freeptr(pending);
+		if (ready)
+			sysmem_freeptr(ready);
+		return TRUE;
+	}
+	for (i=0;i<x->nodecount;i++) {
+		pending[i] = x->nodes[i]->dependencycount;
+		if (!pending[i])
+			ready[tail++] = i;
+	}
+	while (head<tail) {
+		node = x->nodes[ready[head++]];
+		for (j=0;j<node->successorcount;j++) {
+			if (--pending[node->successors[j]->index]==0)
+				ready[tail++] = node->successors[j]->index;
+		}
+	}
+	sysmem_freeptr(pending);
+	sysmem_freeptr(ready);
+	return (tail<x->nodecount);
+}
+
+
+t_threadpooltask_results *threadpooltask_results_new(t_object *owner, long itemsize, long capacity, method cbdeliver)
+{
+	long i;
+	t_threadpooltask_results *x;
+	
+	if (!(x=(t_threadpooltask_results *)sysmem_newptrclear(sizeof(t_threadpooltask_results))))
+		return NULL;
+	
+	// capacity is rounded up to a power of two
+	for (i=2;i<capacity;i<<=1)
+		;
+	x->owner = owner;
+	x->cbdeliver = cbdeliver;
+	x->itemsize = itemsize;
+	x->slotsize = THREADPOOLTASK_RESULT_HEADER + ((itemsize+7)&~7);
+	x->mask = i-1;
+	x->tail = 0;
+	x->head = 0;
+	x->scheduled = 0;
+	if (!(x->slots=(char *)sysmem_newptr(i*x->slotsize))) {
+		sysmem_freeptr(x);
+		return NULL;
+	}
+	for (i=0;i<=(long)x->mask;i++)
+		*((t_int32_atomic *)(x->slots+i*x->slotsize)) = i;
+	x->qelem = qelem_new(x,(method)threadpooltask_results_drain);
+	return x;
+}
+
+void threadpooltask_results_free(t_threadpooltask_results *x)
+{
+	if (x) {
+		qelem_free(x->qelem);
+		sysmem_freeptr(x->slots);
+		sysmem_freeptr(x);
+	}
+}
+
+// may be called from any thread. returns non-zero if the ring is full
+long threadpooltask_results_push(t_threadpooltask_results *x, void *item)
+{
+	unsigned long pos;
+	char *slot;
+	long dif;
+	
+	while (1) {
+		pos = (unsigned long)x->tail;
+		slot = x->slots + (pos&x->mask)*x->slotsize;
+		dif = (long)(int)((unsigned int)*((t_int32_atomic *)slot) - (unsigned int)pos);
+		if (dif==0) {
+			if (ATOMIC_COMPARE_SWAP32(pos,pos+1,&x->tail))
+				break;
+		} else if (dif<0) {
+			return -1; // full. the consumer has not yet released this slot
+		}
+	}
+	sysmem_copyptr(item,slot+THREADPOOLTASK_RESULT_HEADER,x->itemsize);
+	// publish the item. the swap is a full barrier, so the copy is visible first
+	ATOMIC_COMPARE_SWAP32(pos,pos+1,(t_int32_atomic *)slot);
+	
+	if (ATOMIC_COMPARE_SWAP32(0,1,&x->scheduled))
+		qelem_set(x->qelem);
+	return 0;
+}
+
+// main thread. delivers every item that has been pushed, in order, directly from the ring
+void threadpooltask_results_drain(t_threadpooltask_results *x)
+{
+	char *slot;
+	
+	// anything pushed from here on will set the qelem again
+	ATOMIC_COMPARE_SWAP32(1,0,&x->scheduled);
+	while (1) {
+		slot = x->slots + (x->head&x->mask)*x->slotsize;
+		if ((unsigned int)*((t_int32_atomic *)slot) != (unsigned int)(x->head+1))
+			break;
+		ATOMIC_BARRIER();
+		if (x->cbdeliver)
+			(*((method)x->cbdeliver))(x->owner,slot+THREADPOOLTASK_RESULT_HEADER);
+		// hand the slot back to producers for the next time around the ring
+		ATOMIC_COMPARE_SWAP32(x->head+1,x->head+x->mask+1,(t_int32_atomic *)slot);
+		x->head++;
+	}
+}
+
+
+t_threadpooltask_parallel *threadpooltask_parallel_new(void *data, method workerproc, long workercount, long flags)
+{
+	long i,err;
+	t_threadpooltask_parallel *x;
+	t_sysparallel_worker *w;
+	
+	if (workercount<1)
+		workercount = sysparallel_processorcount();
+	if (workercount<1)
+		workercount = 1;
+	else if (workercount>SYSPARALLEL_MAX_WORKERS)
+		workercount = SYSPARALLEL_MAX_WORKERS;
+	
+	if (!(x=(t_threadpooltask_parallel *)sysmem_newptrclear(sizeof(t_threadpooltask_parallel))))
+		return NULL;
+	x->flags = flags;
+	x->task.data = data;
+	x->task.workerproc = workerproc;
+	x->task.workercount = workercount;
+	x->task.benchmark = (flags&THREADPOOLTASK_PARALLEL_BENCHMARK) ? 1 : 0;
+	systhread_mutex_new(&x->mutex,0);
+	systhread_cond_new(&x->cond,0);
+	systhread_cond_new(&x->donecond,0);
+	x->task.workers = (t_sysparallel_worker **)sysmem_newptrclear(workercount*sizeof(t_sysparallel_worker *));
+	x->threads = (t_threadpooltask_parallel_thread *)sysmem_newptrclear(workercount*sizeof(t_threadpooltask_parallel_thread));
+	if (!x->task.workers || !x->threads) {
+		threadpooltask_parallel_free(x);
+		return NULL;
+	}
+	
+	for (i=0;i<workercount;i++) {
+		if (!(w=x->task.workers[i]=(t_sysparallel_worker *)sysmem_newptrclear(sizeof(t_sysparallel_worker)))) {
+			threadpooltask_parallel_free(x);
+			return NULL;
+		}
+		w->data = data;
+		w->workerproc = workerproc;
+		w->task = &x->task;
+		w->id = i;
+		x->threads[i].parallel = x;
+		x->threads[i].index = i;
+	}
+	// worker 0 runs in the calling thread
+	for (i=1;i<workercount;i++) {
+		if (err=systhread_create((method)threadpooltask_parallel_threadproc,x->threads+i,0,0,0,&x->threads[i].thread)) {
+			error("threadpooltask parallel thread could not be created: %d", err);
+			threadpooltask_parallel_free(x);
+			return NULL;
+		}
+	}
+	return x;
+}
+
+void threadpooltask_parallel_free(t_threadpooltask_parallel *x)
+{
+	long i;
+	unsigned int ret;
+	
+	if (!x)
+		return;
+	systhread_mutex_lock(x->mutex);
+	x->exit = 1;
+	systhread_cond_broadcast(x->cond);
+	systhread_mutex_unlock(x->mutex);
+	// also called from threadpooltask_parallel_new() to unwind a partial construction
+	if (x->threads) {
+		for (i=1;i<x->task.workercount;i++) {
+			if (x->threads[i].thread)
+				systhread_join(x->threads[i].thread,&ret);
+		}
+		sysmem_freeptr(x->threads);
+	}
+	if (x->task.workers) {
+		for (i=0;i<x->task.workercount;i++) {
+			if (x->task.workers[i])
+				sysmem_freeptr(x->task.workers[i]);
+		}
+		sysmem_freeptr(x->task.workers);
+	}
+	systhread_cond_free(x->donecond);
+	systhread_cond_free(x->cond);
+	systhread_mutex_free(x->mutex);
+	sysmem_freeptr(x);
+}
+
+// run every worker once, and return when they have all finished. no allocation takes place.
+long threadpooltask_parallel_execute(t_threadpooltask_parallel *x)
+{
+	long i;
+	
+	if (!x || !x->task.workerproc)
+		return -1;
+	
+	x->task.cancel = 0;
+	x->task.iteration++;
+	if (x->task.benchmark)
+		x->task.begintime = systimer_gettime();
+	
+	if (x->task.workercount>1) {
+		x->remaining = x->task.workercount-1;
+		// workers which are spinning will see the new generation. wake any which have parked
+		ATOMIC_INCREMENT_BARRIER(&x->generation);
+		if (x->parked>0) {
+			systhread_mutex_lock(x->mutex);
+			systhread_cond_broadcast(x->cond);
+			systhread_mutex_unlock(x->mutex);
+		}
+	}
+	
+	threadpooltask_parallel_run(x->threads);
+	
+	if (x->task.workercount>1) {
+		for (i=0;i<THREADPOOLTASK_SPINCOUNT && x->remaining>0;i++)
+			;
+		if (x->remaining>0) {
+			systhread_mutex_lock(x->mutex);
+			ATOMIC_INCREMENT_BARRIER(&x->waiting);
+			while (x->remaining>0)
+				systhread_cond_wait(x->donecond,x->mutex);
+			ATOMIC_DECREMENT_BARRIER(&x->waiting);
+			systhread_mutex_unlock(x->mutex);
+		}
+	}
+	
+	if (x->task.benchmark)
+		x->task.endtime = systimer_gettime();
+	return 0;
+}
+
+void threadpooltask_parallel_cancel(t_threadpooltask_parallel *x)
+{
+	if (x)
+		x->task.cancel = 1;	// worker procs may poll worker->task->cancel
+}
+
+void threadpooltask_parallel_data(t_threadpooltask_parallel *x, void *data)
+{
+	long i;
+	
+	if (x) {
+		x->task.data = data;
+		for (i=0;i<x->task.workercount;i++)
+			x->task.workers[i]->data = data;
+	}
+}
+
+// per worker data may be set through the worker's data member before executing
+t_sysparallel_worker *threadpooltask_parallel_worker(t_threadpooltask_parallel *x, long workerid)
+{
+	if (!x || workerid<0 || workerid>=x->task.workercount)
+		return NULL;
+	return x->task.workers[workerid];
+}
+
+// copy THREADPOOLTASK_PARALLEL_HISTOGRAM_BINS counts into bins. returns the number of executions recorded
+long threadpooltask_parallel_histogram(t_threadpooltask_parallel *x, long workerid, long *bins)
+{
+	long i,count=0;
+	
+	if (!x || workerid<0 || workerid>=x->task.workercount)
+		return 0;
+	for (i=0;i<THREADPOOLTASK_PARALLEL_HISTOGRAM_BINS;i++) {
+		if (bins)
+			bins[i] = x->threads[workerid].histogram[i];
+		count += x->threads[workerid].histogram[i];
+	}
+	return count;
+}
+
+void threadpooltask_parallel_histogram_clear(t_threadpooltask_parallel *x)
+{
+	long i,j;
+	
+	if (x) {
+		for (i=0;i<x->task.workercount;i++) {
+			for (j=0;j<THREADPOOLTASK_PARALLEL_HISTOGRAM_BINS;j++)
+				x->threads[i].histogram[j] = 0;
+		}
+	}
+}
+
+void threadpooltask_parallel_benchprint(t_threadpooltask_parallel *x)
+{
+	long i,j,count,median,sum;
+	t_sysparallel_worker *w;
+	
+	if (!x)
+		return;
+	post("threadpooltask parallel: iteration %ld, %ld workers, last execution %f ms",
+		 x->task.iteration,x->task.workercount,x->task.endtime-x->task.begintime);
+	for (i=0;i<x->task.workercount;i++) {
+		w = x->task.workers[i];
+		count = threadpooltask_parallel_histogram(x,i,NULL);
+		// the bin holding the median execution time
+		for (j=0,sum=0,median=0;j<THREADPOOLTASK_PARALLEL_HISTOGRAM_BINS;j++) {
+			sum += x->threads[i].histogram[j];
+			if (sum*2>=count) {
+				median = j;
+				break;
+			}
+		}
+		post("  worker %ld: last %f ms, %ld recorded, median under %ld us",i,w->endtime-w->begintime,count,1L<<median);
+	}
+}
+
+void threadpooltask_parallel_threadproc(t_threadpooltask_parallel_thread *t)
+{
+	long i,generation;
+	t_threadpooltask_parallel *x=t->parallel;
+	
+	if (x->flags&THREADPOOLTASK_PARALLEL_AFFINITY)
+		threadpooltask_parallel_affinity(t->index);
+	
+	generation = 0; // not x->generation, which may already have moved on before we started
+	while (!x->exit) {
+		// spin, then park until the next execution
+		for (i=0;i<THREADPOOLTASK_SPINCOUNT && x->generation==generation && !x->exit;i++)
+			;
+		if (x->generation==generation) {
+			systhread_mutex_lock(x->mutex);
+			ATOMIC_INCREMENT_BARRIER(&x->parked);
+			while (x->generation==generation && !x->exit)
+				systhread_cond_wait(x->cond,x->mutex);
+			ATOMIC_DECREMENT_BARRIER(&x->parked);
+			systhread_mutex_unlock(x->mutex);
+		}
+		if (x->exit)
+			break;
+		generation = x->generation;
 		
-		if (task)
-			*task = bgt;
+		threadpooltask_parallel_run(t);
 		
-		return threadpooltask_makerequest(bgt);
+		if (ATOMIC_DECREMENT_BARRIER(&x->remaining)==0 && x->waiting>0) {
+			systhread_mutex_lock(x->mutex);
+			systhread_cond_signal(x->donecond);
+			systhread_mutex_unlock(x->mutex);
+		}
 	}
+	systhread_exit(0);
+}
 
-	return err;
+void threadpooltask_parallel_run(t_threadpooltask_parallel_thread *t)
+{
+	long bin;
+	double us;
+	t_threadpooltask_parallel *x=t->parallel;
+	t_sysparallel_worker *w=x->task.workers[t->index];
+	
+	if (x->task.benchmark)
+		w->begintime = systimer_gettime();
+	(*((method)x->task.workerproc))(w);
+	if (x->task.benchmark) {
+		w->endtime = systimer_gettime();
+		us = (w->endtime-w->begintime)*1000.;
+		for (bin=0;bin<THREADPOOLTASK_PARALLEL_HISTOGRAM_BINS-1 && us>=(double)(1L<<bin);bin++)
+			;
+		t->histogram[bin]++;
+	}
+}
+
+// ask the os to keep this thread on one processor. on the mac this is an affinity tag, 
+// which keeps threads with different tags on different cores where possible
+void threadpooltask_parallel_affinity(long index)
+{
+	long count = sysparallel_processorcount();
+	
+	if (count<1)
+		count = 1;
+#ifdef MAC_VERSION
+	{
+		thread_affinity_policy_data_t policy;
+		
+		policy.affinity_tag = (index%count)+1;
+		thread_policy_set(mach_thread_self(),THREAD_AFFINITY_POLICY,(thread_policy_t)&policy,THREAD_AFFINITY_POLICY_COUNT);
+	}
+#endif
+#ifdef WIN_VERSION
+	SetThreadAffinityMask(GetCurrentThread(),((DWORD_PTR)1)<<(index%count));
+#endif
 }
 
 
@@ -2,6 +2,10 @@
 #ifndef __THREADPOOLTASK_H__
 #define __THREADPOOLTASK_H__
 
+#include "ext_systhread.h"
+#include "ext_atomic.h"
+#include "ext_sysparallel.h"
+
 #if C74_PRAGMA_STRUCT_PACKPUSH
 #pragma pack(push, 2)
 #elif C74_PRAGMA_STRUCT_PACK
@@ -12,25 +16,99 @@
 extern "C" {
 #endif // __cplusplus
 	
+// priority classes, passed in the flags argument of threadpooltask_execute() 
+#define THREADPOOLTASK_PRIORITY_NORMAL		0x00000000
+#define THREADPOOLTASK_PRIORITY_HIGH		0x00000001	// interactive work, runs ahead of everything else
+#define THREADPOOLTASK_PRIORITY_LOW			0x00000002	// batch work, never occupies every worker
+#define THREADPOOLTASK_PRIORITY_MASK		0x00000003
+
+// set in flags before cbcomplete is called, if the request finished after its deadline
+#define THREADPOOLTASK_FLAG_DEADLINE_MISSED	0x00000100
+
+struct _threadpooltask;
+
+typedef struct _threadpooltask_ownerlink
+{
+	struct _threadpooltask_ownerlink	*prev;
+	struct _threadpooltask_ownerlink	*next;
+	struct _threadpooltask				*task;
+	t_object							*owner;
+} t_threadpooltask_ownerlink;
+
 typedef struct _threadpooltask 
 {
-	long				flags; // rfu
-	long				state;
+	long				flags;
+	t_int32_atomic		state;
 	long				id;
 	t_object			*owner;
 	void				*args;
 	method				cbtask;
 	method				cbcomplete;
+	double				deadline;		// systimer_gettime() by which the request should be complete, or 0
+	// private
+	struct _threadpooltask	*prev;			// intrusive queue node
+	struct _threadpooltask	*next;
+	void * volatile			queue;			// worker queue holding this request, if any
+	long					lane;			// index of that queue within the worker
+	t_threadpooltask_ownerlink	ownerlink[2];	// owner index. method callers can have two owners
+	t_systhread_mutex		mutex;			// completion event
+	t_systhread_cond		cond;
+	long					waiters;
 } t_threadpooltask;
 
+// task graphs: nodes run once all of their dependencies have completed. 
+// node callbacks take the same arguments as threadpooltask callbacks, with the graph owner as the owner.
+typedef struct _threadpooltask_graph t_threadpooltask_graph;
+typedef struct _threadpooltask_node t_threadpooltask_node;
+
+// results: a lock-free ring of fixed size items pushed from any thread, delivered in batches on the main thread
+typedef struct _threadpooltask_results t_threadpooltask_results;
+
+// parallel tasks: like sysparallel tasks, but with their own persistent workers which spin briefly 
+// before parking, so they can be executed every frame without allocation or thread wake latency.
+// workerproc receives a t_sysparallel_worker, so sysparallel worker procs can be used unchanged.
+typedef struct _threadpooltask_parallel t_threadpooltask_parallel;
+
+#define THREADPOOLTASK_PARALLEL_AFFINITY		0x00000001	// pin each worker to its own processor
+#define THREADPOOLTASK_PARALLEL_BENCHMARK		0x00000002	// keep per-worker timing histograms
+#define THREADPOOLTASK_PARALLEL_HISTOGRAM_BINS	24			// bin n counts times under 2^n microseconds
+
 	void threadpooltask_init(void);
 long threadpooltask_execute(t_object *owner, void *args, method cbtask, method cbcomplete, t_threadpooltask **task, long flags);
+long threadpooltask_execute_deadline(t_object *owner, void *args, method cbtask, method cbcomplete, t_threadpooltask **task, long flags, double deadline);
+long threadpooltask_execute_id(t_object *owner, void *args, method cbtask, method cbcomplete, t_threadpooltask **task, long *id, long flags, double deadline);
 long threadpooltask_execute_method(t_object *obtask, t_symbol *mtask, long actask, t_atom *avtask, 
 								   t_object *obcomp, t_symbol *mcomp, long accomp, t_atom *avcomp,  t_threadpooltask **task, long flags);
 void threadpooltask_purge_object(t_object *owner);
 void threadpooltask_join_object(t_object *owner);
 long threadpooltask_cancel(t_threadpooltask *task);
 long threadpooltask_join(t_threadpooltask *task);
+long threadpooltask_cancel_id(t_threadpooltask *task, long id);
+long threadpooltask_join_id(t_threadpooltask *task, long id);
+long threadpooltask_deadlines_missed(void);
+
+t_threadpooltask_graph *threadpooltask_graph_new(t_object *owner, void *args, method cbcomplete);
+void threadpooltask_graph_free(t_threadpooltask_graph *graph);
+t_threadpooltask_node *threadpooltask_graph_node(t_threadpooltask_graph *graph, void *args, method cbtask, method cbcomplete, long flags);
+long threadpooltask_graph_depend(t_threadpooltask_node *node, t_threadpooltask_node *dependency);
+long threadpooltask_graph_execute(t_threadpooltask_graph *graph);
+long threadpooltask_graph_cancel(t_threadpooltask_graph *graph);
+long threadpooltask_graph_join(t_threadpooltask_graph *graph);
+
+t_threadpooltask_results *threadpooltask_results_new(t_object *owner, long itemsize, long capacity, method cbdeliver);
+void threadpooltask_results_free(t_threadpooltask_results *results);
+long threadpooltask_results_push(t_threadpooltask_results *results, void *item);
+void threadpooltask_results_drain(t_threadpooltask_results *results);
+
+t_threadpooltask_parallel *threadpooltask_parallel_new(void *data, method workerproc, long workercount, long flags);
+void threadpooltask_parallel_free(t_threadpooltask_parallel *x);
+long threadpooltask_parallel_execute(t_threadpooltask_parallel *x);
+void threadpooltask_parallel_cancel(t_threadpooltask_parallel *x);
+void threadpooltask_parallel_data(t_threadpooltask_parallel *x, void *data);
+t_sysparallel_worker *threadpooltask_parallel_worker(t_threadpooltask_parallel *x, long workerid);
+long threadpooltask_parallel_histogram(t_threadpooltask_parallel *x, long workerid, long *bins);
+void threadpooltask_parallel_histogram_clear(t_threadpooltask_parallel *x);
+void threadpooltask_parallel_benchprint(t_threadpooltask_parallel *x);
 	
 
 #ifdef __cplusplus